@@ -11,6 +11,7 @@
 #include "common.h"
 #include "json.h"
 #include "ses.h"
+#include "ses_control.h"
 #include <dirent.h>
 #include <string.h>
 #include <stdlib.h>
@@ -19,6 +20,11 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+const char *const slot_fields[] = {
+  "name", "slot", "phy", "status", "sas_addr", "fault", "devname",
+  "by_slot_name", NULL
+};
+
 const char* status_str(struct array_device_slot slot) {
   if ((slot.common_status & 0xf) == 0x5) {
     return "Not Installed";
@@ -59,9 +65,9 @@ void print_array_device_slot(struct array_device_slot *slot)
   if (slot->dev_name) {
     PRINT_JSON_ITEM("fault", "%s", fault_led_status_str(slot->fault));
     PRINT_JSON_ITEM("devname", "%s", slot->dev_name);
-    PRINT_JSON_LAST_ITEM("by_slot_name", "%s", slot->by_slot_name);
+    PRINT_JSON_ITEM("by_slot_name", "%s", slot->by_slot_name);
   } else
-    PRINT_JSON_LAST_ITEM("fault", "%s", fault_led_status_str(slot->fault));
+    PRINT_JSON_ITEM("fault", "%s", fault_led_status_str(slot->fault));
 
   PRINT_JSON_GROUP_ENDING;
 }
@@ -94,21 +100,31 @@ int extract_array_device_slot_info(
   return 0;
 }
 
+/* queue a change of one bit in the control element of the slot */
+static int control_slot_bit(
+  struct ses_txn *txn,
+  struct array_device_slot *slot,
+  int byte,
+  unsigned char bit,
+  int op)
+{
+  unsigned char and_mask[SES_ELEMENT_SIZE] = {0xf0, 0xff, 0xff, 0xff};
+  unsigned char or_mask[SES_ELEMENT_SIZE] = {0x80, 0, 0, 0};
+
+  if (op)
+    or_mask[byte] = bit;
+  else
+    and_mask[byte] = ~bit;
+  return ses_txn_element(txn, slot->page_two_offset, and_mask, or_mask);
+}
+
 int control_hdd_power(
-  unsigned char *page_two,
+  struct ses_txn *txn,
   struct array_device_slot *slot,
   int op /* 0 for power off; 1 for power on */)
 {
-  slot->common_control = slot->common_status & 0xf0;
-  slot->common_control |= 0x80;
-
-  page_two[slot->page_two_offset] = slot->common_control;
-  if (op) {
-    page_two[slot->page_two_offset + 3] &= 0xef;
-  } else {
-    page_two[slot->page_two_offset + 3] |= 0x10;
-  }
-  return 0;
+  /* this bit is DEVICE_OFF, so we need to reverse it */
+  return control_slot_bit(txn, slot, 3, 0x10, !op);
 }
 
 /* return whether the HDD is powered on */
@@ -121,20 +137,19 @@ int check_hdd_power(
 }
 
 int control_hdd_led_fault(
-  unsigned char *page_two,
+  struct ses_txn *txn,
   struct array_device_slot *slot,
   int op  /* 0 for clear fault request; 1 for request fault */)
 {
-  slot->common_control = slot->common_status & 0xf0;
-  slot->common_control |= 0x80;
+  return control_slot_bit(txn, slot, 3, 0x20, op);
+}
 
-  page_two[slot->page_two_offset] = slot->common_control;
-  if (op) {
-    page_two[slot->page_two_offset + 3] |= 0x20;
-  } else {
-    page_two[slot->page_two_offset + 3] &= 0xdf;
-  }
-  return 0;
+int control_hdd_led_ident(
+  struct ses_txn *txn,
+  struct array_device_slot *slot,
+  int op  /* 0 for clear ident request; 1 for request ident */)
+{
+  return control_slot_bit(txn, slot, 2, 0x02, op);
 }
 
 int find_dev_name(
@@ -12,6 +12,8 @@
 
 #include "common.h"
 
+struct ses_txn;
+
 /*
  * full information pulled for array_device_slot,
  * including info from SES page 0x02, 0x07, 0x0a
@@ -33,6 +35,20 @@ struct array_device_slot {
   int page_two_offset;     /* for control */
 };
 
+/* drive LEDs that can be controlled through SES page 0x02 */
+#define HDD_LED_FAULT 0
+#define HDD_LED_IDENT 1
+
+/* one LED change of an array_device_slot */
+struct hdd_led_change {
+  int slot;
+  int led;                /* HDD_LED_FAULT or HDD_LED_IDENT */
+  int op;                 /* 0 for clear request; 1 for request */
+};
+
+/* JSON items of a slot, for --fields; devname needs a sysfs lookup */
+extern const char *const slot_fields[];
+
 /* human-readable form of array_device_slot.common_status */
 extern const char* fault_led_status_str(int);
 
@@ -49,15 +65,20 @@ extern int extract_array_device_slot_info(
   struct array_device_slot *slotp);
 
 extern int control_hdd_power(
-  unsigned char *page_two,
+  struct ses_txn *txn,
   struct array_device_slot *slot,
   int op /* 0 for power off; 1 for power on */);
 
 extern int control_hdd_led_fault(
-  unsigned char *page_two,
+  struct ses_txn *txn,
   struct array_device_slot *slot,
   int op /* 0 for clear fault request; 1 for request fault */);
 
+extern int control_hdd_led_ident(
+  struct ses_txn *txn,
+  struct array_device_slot *slot,
+  int op /* 0 for clear ident request; 1 for request ident */);
+
 extern int check_hdd_power(
   unsigned char *page_two,
   struct array_device_slot *slot);
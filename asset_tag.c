@@ -0,0 +1,339 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <scsi/sg_lib.h>
+#include <scsi/sg_cmds.h>
+#include <errno.h>
+#include <json-c/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asset_tag.h"
+#include "enclosure_cache.h"
+#include "jbod_interface.h"
+#include "json.h"
+#include "parallel.h"
+#include "scsi_buffer.h"
+
+#define MAX_ASSET_TAGS 32
+#define ASSET_TAG_VALUE_LENGTH 64
+
+struct asset_tag_job {
+  char *devname;
+  char key[PATH_MAX];               /* SAS address, or devname */
+  const struct scsi_buffer_parameter *const *tags;
+  int tag_count;
+  char values[MAX_ASSET_TAGS][ASSET_TAG_VALUE_LENGTH];
+  const char *wanted[MAX_ASSET_TAGS];   /* NULL to keep the tag */
+  json_object *entry;                   /* of the import file */
+  int written;
+  int unchanged;
+  int rc;
+};
+
+struct asset_tag_ctx {
+  struct asset_tag_job *jobs;
+  json_object *import;
+};
+
+/* number of bytes written for value, as in jbod_set_asset_tag() */
+static int tag_write_length(const struct scsi_buffer_parameter *sbp,
+                            const char *value)
+{
+  int len = strlen(value);
+
+  return len < sbp->len ? len : sbp->len;
+}
+
+/*
+ * whether the tag read as value already holds wanted. --export prints
+ * tags through fix_none_ascii(), which turns NUL and 0xff padding into
+ * spaces, so the bytes read are compared the same way.
+ */
+static int tag_unchanged(const struct scsi_buffer_parameter *sbp,
+                         const unsigned char *value, const char *wanted)
+{
+  int len = tag_write_length(sbp, wanted);
+  char *printed;
+  int same;
+
+  printed = (char *) malloc(len + 1);
+  if (printed == NULL)
+    return 0;                       /* write it again */
+  memcpy(printed, value, len);
+  fix_none_ascii(printed, len);
+  same = memcmp(printed, wanted, len) == 0;
+  free(printed);
+  return same;
+}
+
+/* write changed tags inside span with one command; return 0 on success */
+static int write_span(int sg_fd, struct asset_tag_job *job,
+                      struct scsi_buffer_plan *plan,
+                      struct scsi_buffer_span *span, int changed[])
+{
+  unsigned char *buf;
+  const struct scsi_buffer_parameter *sbp;
+  int lo = -1, hi = -1;
+  int start, end;
+  int ret;
+  int i;
+
+  for (i = 0; i < job->tag_count; ++i) {
+    sbp = job->tags[i];
+    if (!changed[i] || scsi_buffer_plan_span(plan, sbp) != span)
+      continue;
+    start = sbp->buf_offset;
+    end = start + tag_write_length(sbp, job->wanted[i]);
+    if (lo < 0 || start < lo)
+      lo = start;
+    if (end > hi)
+      hi = end;
+  }
+  if (lo < 0 || hi <= lo)
+    return 0;
+
+  /* the bytes between changed tags are rewritten as they were just read */
+  buf = (unsigned char *) malloc(hi - lo);
+  if (buf == NULL)
+    return ENOMEM;
+  memcpy(buf, span->data + lo - span->start, hi - lo);
+  for (i = 0; i < job->tag_count; ++i) {
+    sbp = job->tags[i];
+    if (changed[i] && scsi_buffer_plan_span(plan, sbp) == span)
+      memcpy(buf + sbp->buf_offset - lo, job->wanted[i],
+             tag_write_length(sbp, job->wanted[i]));
+  }
+  ret = scsi_write_buffer(sg_fd, span->buf_id, lo, buf, hi - lo);
+  free(buf);
+  return ret;
+}
+
+static void write_changed_tags(int sg_fd, struct asset_tag_job *job,
+                               struct scsi_buffer_plan *plan)
+{
+  const struct scsi_buffer_parameter *sbp;
+  struct scsi_buffer_span *span;
+  int changed[MAX_ASSET_TAGS] = {0};
+  int done[MAX_ASSET_TAGS] = {0};
+  unsigned char *value;
+  int i, j;
+
+  for (i = 0; i < job->tag_count; ++i) {
+    if (job->wanted[i] == NULL)
+      continue;
+    value = scsi_buffer_plan_value(plan, job->tags[i]);
+    if (value != NULL && tag_unchanged(job->tags[i], value, job->wanted[i]))
+      ++job->unchanged;
+    else
+      changed[i] = 1;
+  }
+
+  for (i = 0; i < job->tag_count; ++i) {
+    if (!changed[i] || done[i])
+      continue;
+    sbp = job->tags[i];
+    span = scsi_buffer_plan_span(plan, sbp);
+    if (span != NULL && write_span(sg_fd, job, plan, span, changed) == 0) {
+      for (j = i; j < job->tag_count; ++j) {
+        if (changed[j] && scsi_buffer_plan_span(plan, job->tags[j]) == span) {
+          done[j] = 1;
+          ++job->written;
+        }
+      }
+      continue;
+    }
+    /* not read, or the firmware refused the larger write */
+    if (scsi_write_buffer(sg_fd, sbp->buf_id, sbp->buf_offset,
+                          (unsigned char *) job->wanted[i],
+                          tag_write_length(sbp, job->wanted[i])) == 0)
+      ++job->written;
+    else
+      job->rc = EIO;
+    done[i] = 1;
+  }
+
+  if (job->written)
+    invalidate_short_profile(sg_fd);
+}
+
+/* find the tags of job in the import file */
+static void match_import(struct asset_tag_job *job, json_object *import)
+{
+  int i;
+
+  if (!json_object_object_get_ex(import, job->key, &job->entry) &&
+      !json_object_object_get_ex(import, job->devname, &job->entry))
+    return;
+
+  json_object_object_foreach(job->entry, name, tag) {
+    for (i = 0; i < job->tag_count; ++i) {
+      if (strcmp(name, job->tags[i]->name) == 0)
+        break;
+    }
+    if (i == job->tag_count || !json_object_is_type(tag, json_type_string)) {
+      perr("%s: invalid tag %s\n", job->devname, name);
+      job->rc = EINVAL;
+      continue;
+    }
+    job->wanted[i] = json_object_get_string(tag);
+  }
+}
+
+static void asset_tag_one(int index, void *arg)
+{
+  struct asset_tag_ctx *ctx = (struct asset_tag_ctx *) arg;
+  struct asset_tag_job *job = ctx->jobs + index;
+  struct jbod_interface *jbod;
+  struct scsi_buffer_plan plan;
+  int sg_fd;
+  int i;
+
+  jbod = detect_dev(job->devname);
+  if (jbod == NULL || jbod->get_asset_tags == NULL) {
+    job->rc = ENODEV;
+    return;
+  }
+  sg_fd = sg_cmds_open_device(job->devname, 0 /* rw */, 0 /* not verbose */);
+  if (sg_fd < 0) {
+    job->rc = ENODEV;
+    return;
+  }
+
+  if (read_enclosure_attr(sg_fd, "sas_address", job->key, PATH_MAX) != 0)
+    snprintf(job->key, PATH_MAX, "%s", job->devname);
+  job->tag_count = jbod->get_asset_tags(&job->tags);
+  if (job->tag_count > MAX_ASSET_TAGS)
+    job->tag_count = MAX_ASSET_TAGS;
+
+  /* all tags with one coalesced pass */
+  scsi_buffer_plan_read(sg_fd, job->tags, job->tag_count, &plan);
+
+  if (ctx->import) {
+    match_import(job, ctx->import);
+    if (job->entry != NULL)
+      write_changed_tags(sg_fd, job, &plan);
+  } else {
+    for (i = 0; i < job->tag_count; ++i)
+      planned_buffer_string(sg_fd, &plan, job->tags[i], job->values[i],
+                            ASSET_TAG_VALUE_LENGTH);
+  }
+
+  scsi_buffer_plan_free(&plan);
+  sg_cmds_close_device(sg_fd);
+}
+
+static struct asset_tag_job *run_jobs(char *devnames[], int count,
+                                      int max_parallel, json_object *import)
+{
+  struct asset_tag_ctx ctx;
+  int i;
+
+  ctx.jobs = (struct asset_tag_job *)
+    calloc(count, sizeof(struct asset_tag_job));
+  if (ctx.jobs == NULL) {
+    perr("Cannot allocate memory.\n");
+    return NULL;
+  }
+  for (i = 0; i < count; ++i)
+    ctx.jobs[i].devname = devnames[i];
+  ctx.import = import;
+
+  run_parallel(count, max_parallel, asset_tag_one, &ctx);
+  return ctx.jobs;
+}
+
+int export_asset_tags(char *devnames[], int count, int max_parallel)
+{
+  struct asset_tag_job *jobs, *job;
+  json_object *root, *entry;
+  int rc = 0;
+  int i, j;
+
+  jobs = run_jobs(devnames, count, max_parallel, NULL);
+  if (jobs == NULL)
+    return ENOMEM;
+
+  root = json_object_new_object();
+  for (i = 0; i < count; ++i) {
+    job = jobs + i;
+    if (job->rc) {
+      perr("%s is not a jbod device\n", job->devname);
+      rc = job->rc;
+      continue;
+    }
+    entry = json_object_new_object();
+    for (j = 0; j < job->tag_count; ++j)
+      json_object_object_add(entry, job->tags[j]->name,
+                             json_object_new_string(job->values[j]));
+    json_object_object_add(root, job->key, entry);
+  }
+  printf("%s\n", json_object_to_json_string_ext(root,
+                                                JSON_C_TO_STRING_PRETTY));
+  json_object_put(root);
+  free(jobs);
+  return rc;
+}
+
+int import_asset_tags(const char *file, char *devnames[], int count,
+                      int max_parallel)
+{
+  struct asset_tag_job *jobs, *job;
+  json_object *import;
+  int matched;
+  int rc = 0;
+  int i;
+
+  import = json_object_from_file(file);
+  if (import == NULL || !json_object_is_type(import, json_type_object)) {
+    perr("Cannot parse %s.\n", file);
+    json_object_put(import);
+    return EINVAL;
+  }
+
+  jobs = run_jobs(devnames, count, max_parallel, import);
+  if (jobs == NULL) {
+    json_object_put(import);
+    return ENOMEM;
+  }
+
+  IF_PRINT_NONE_JSON printf("device\tkey\twritten\tunchanged\n");
+  for (i = 0; i < count; ++i) {
+    job = jobs + i;
+    if (job->rc)
+      rc = job->rc;
+    if (job->entry == NULL)
+      continue;
+    IF_PRINT_NONE_JSON
+      printf("%s\t%s\t%d\t%d%s\n", job->devname, job->key, job->written,
+             job->unchanged, job->rc ? "\tFailed" : "");
+    PRINT_JSON_GROUP_HEADER(job->devname);
+    PRINT_JSON_ITEM("key", "%s", job->key);
+    PRINT_JSON_ITEM("rc", "%d", job->rc);
+    PRINT_JSON_ITEM("written", "%d", job->written);
+    PRINT_JSON_ITEM("unchanged", "%d", job->unchanged);
+    PRINT_JSON_GROUP_ENDING;
+  }
+
+  /* entries of the file that match no enclosure */
+  json_object_object_foreach(import, key, entry) {
+    matched = 0;
+    for (i = 0; i < count && !matched; ++i)
+      matched = jobs[i].entry == entry;
+    if (!matched) {
+      perr("No enclosure for %s.\n", key);
+      rc = ENODEV;
+    }
+  }
+
+  free(jobs);
+  json_object_put(import);
+  return rc;
+}
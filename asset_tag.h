@@ -0,0 +1,31 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef ASSET_TAG_H
+#define ASSET_TAG_H
+
+/* enclosures to read or write at the same time */
+#define ASSET_TAG_DEFAULT_PARALLEL 8
+
+/*
+ * print all tags of devnames as one JSON object, keyed by the SAS address
+ * of each enclosure (or its devname if unknown):
+ *   {"0x500...": {"FB_Asset_Node": "...", ...}, ...}
+ */
+extern int export_asset_tags(char *devnames[], int count, int max_parallel);
+
+/*
+ * write the tags in file, in the format of export_asset_tags(), to the
+ * matching devnames. Tags already holding the value are not written, and
+ * changed tags of the same buffer are written with one command.
+ */
+extern int import_asset_tags(const char *file, char *devnames[], int count,
+                             int max_parallel);
+
+#endif
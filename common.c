@@ -7,6 +7,8 @@
  * of patent rights can be found in the PATENTS file in the same directory.
  */
 
+#include <time.h>
+
 #include "common.h"
 
 void print_sas_addr_a(unsigned char *sas_addr, char *sas_addr_str)
@@ -37,3 +39,11 @@ void fix_none_ascii(char *buf, int len)
       /* remove none ASCII, ", and ` (workaround HoneyBadger bug) */
       buf[i] = 0x20;
 }
+
+long long monotonic_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
@@ -47,6 +47,9 @@ extern void print_sas_addr_a(unsigned char *sas_addr, char *sas_addr_str);
 extern int sas_addr_invalid(unsigned char *addr);
 extern void fix_none_ascii(char *buf, int len);
 
+/* milliseconds from CLOCK_MONOTONIC, for timeouts */
+extern long long monotonic_ms(void);
+
 #ifndef NAME
 #define NAME "ocpjbod"
 #endif
@@ -12,13 +12,15 @@
 #include "json.h"
 #include "ses.h"
 
+const char *const fan_fields[] = {"name", "rpm", NULL};
+
 void print_cooling_fan(struct cooling_fan *fan)
 {
   IF_PRINT_NONE_JSON printf("Cooling: %s RPM: %d\n", fan->name, fan->rpm);
 
   PRINT_JSON_GROUP_HEADER(fan->name);
   PRINT_JSON_ITEM("name", "%s", fan->name);
-  PRINT_JSON_LAST_ITEM("rpm", "%d", fan->rpm);
+  PRINT_JSON_ITEM("rpm", "%d", fan->rpm);
   PRINT_JSON_GROUP_ENDING;
 }
 
@@ -18,6 +18,9 @@ struct cooling_fan {
   int page_two_offset;  /* for control */
 };
 
+/* JSON items of a fan, for --fields */
+extern const char *const fan_fields[];
+
 extern void print_cooling_fan(struct cooling_fan *fan);
 
 extern int extract_cooling_fan_info(
@@ -0,0 +1,1303 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <json-c/json.h>
+#include <limits.h>
+#include <poll.h>
+#include <scsi/sg_cmds.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "daemon.h"
+#include "jbod_interface.h"
+#include "libocpjbod.h"
+#include "options.h"
+#include "parallel.h"
+#include "scsi_buffer.h"
+#include "ses.h"
+#include "shm_snapshot.h"
+
+#define JSONRPC_PARSE_ERROR      -32700
+#define JSONRPC_INVALID_REQUEST  -32600
+#define JSONRPC_METHOD_NOT_FOUND -32601
+#define JSONRPC_INTERNAL_ERROR   -32603
+
+int daemon_disabled = 0;
+
+/*
+ * Enclosure data passes between the processes of the daemon as records.
+ * The poller sends all it read every interval, ending with CACHE_END; a
+ * query sends the buffers it had to read itself, and the daemon passes
+ * them on to the poller, which reads them from then on. CACHE_INVALIDATE
+ * tells the poller that an enclosure was written to. The processes are
+ * forks of the daemon, so an interface is the same pointer in all of them.
+ */
+enum cache_record_type {
+  CACHE_DETECTED,                   /* interface, then devname */
+  CACHE_SES,                        /* ses_record, then ses_pages */
+  CACHE_READ,                       /* read_record, then the data */
+  CACHE_INVALIDATE,                 /* invalidation count */
+  CACHE_END,                        /* invalidations seen before reading */
+};
+
+struct cache_record {
+  int type;
+  int length;                       /* of what follows */
+};
+
+struct ses_record {
+  dev_t rdev;
+  int page_two_size;
+  int what;
+};
+
+struct read_record {
+  dev_t rdev;
+  int buf_id;
+  int offset;
+};
+
+/* bytes read from a pipe, up to the last complete record */
+struct stream {
+  char *buf;
+  size_t len;
+  size_t size;
+};
+
+/* a query running in a child, which closes fd when it exits */
+struct job {
+  pid_t pid;                        /* -1 if there is none */
+  int fd;
+  FILE *out;
+  FILE *err;
+  json_object *id;
+  struct timespec started;
+  int killed;
+  struct stream learned;            /* CACHE_READ records of the child */
+};
+
+struct client {
+  int fd;
+  char *buf;
+  size_t len;
+  struct job job;
+};
+
+/* an enclosure of the poller, kept open between intervals */
+struct polled_enclosure {
+  char devname[PATH_MAX];
+  int sg_fd;
+  struct ocpjbod *jbod;             /* to publish; NULL without shm */
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static struct client clients[DAEMON_MAX_CLIENTS];
+static int listen_fd = -1;
+
+/* the poller process and the pipes to it, -1 if there is none */
+static pid_t poller = -1;
+static int poller_in = -1;
+static int poller_out = -1;
+static struct stream generation;
+static unsigned int invalidations = 0;
+static int notify_pending = 0;
+static const char *poller_shm_path = NULL;
+static int poller_interval_ms = DAEMON_DEFAULT_INTERVAL_MS;
+/* of the last generation taken, or of the start of the poller */
+static struct timespec generation_time;
+/* of the last generation sent, taken or not */
+static struct timespec poller_heard;
+/* a killed poller not reaped yet, e.g. stuck in a SCSI command */
+static pid_t lost_poller = -1;
+/* of the loss of the poller, and the pause before it is started again */
+static struct timespec poller_lost;
+static int restart_delay_ms = DAEMON_RESTART_MIN_MS;
+
+/* in the poller */
+static struct polled_enclosure polled[MAX_JBOD_PER_HOST];
+static int polled_count = 0;
+static struct shm_snapshot *published = NULL;
+
+static int write_full(int fd, const char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0) {
+    n = write(fd, buf, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+static int write_line(int fd, json_object *message)
+{
+  const char *text = json_object_to_json_string_ext(message,
+                                                    JSON_C_TO_STRING_PLAIN);
+
+  if (write_full(fd, text, strlen(text)) != 0)
+    return -1;
+  return write_full(fd, "\n", 1);
+}
+
+static void set_timeouts(int fd)
+{
+  struct timeval timeout = {DAEMON_TIMEOUT_SEC, 0};
+
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+static int socket_address(const char *path, struct sockaddr_un *addr)
+{
+  if (*path == '\0' || strlen(path) >= sizeof(addr->sun_path))
+    return -1;
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  strcpy(addr->sun_path, path);
+  return 0;
+}
+
+/*
+ * client side
+ */
+static int connect_daemon(void)
+{
+  struct sockaddr_un addr;
+  const char *path = getenv(DAEMON_SOCKET_ENV);
+  int fd;
+
+  if (daemon_disabled)
+    return -1;
+  if (socket_address(path != NULL ? path : DAEMON_SOCKET_PATH, &addr) != 0)
+    return -1;
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+  set_timeouts(fd);
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static json_object *new_request(const char *method, json_object *params)
+{
+  json_object *request = json_object_new_object();
+
+  json_object_object_add(request, "jsonrpc", json_object_new_string("2.0"));
+  json_object_object_add(request, "id", json_object_new_int(1));
+  json_object_object_add(request, "method", json_object_new_string(method));
+  if (params != NULL)
+    json_object_object_add(request, "params", params);
+  return request;
+}
+
+/* send a request and wait for the response line */
+static json_object *call_daemon(int fd, json_object *request)
+{
+  json_object *response = NULL;
+  char *line = NULL;
+  char *bigger;
+  size_t len = 0;
+  size_t size = 0;
+  ssize_t n;
+
+  if (write_line(fd, request) != 0)
+    return NULL;
+  for (;;) {
+    if (len + 1 >= size) {
+      size = size ? size * 2 : 4096;
+      bigger = (char *) realloc(line, size);
+      if (bigger == NULL)
+        break;
+      line = bigger;
+    }
+    n = read(fd, line + len, size - len - 1);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    len += n;
+    if (line[len - 1] == '\n') {
+      line[len] = '\0';
+      response = json_tokener_parse(line);
+      break;
+    }
+  }
+  free(line);
+  return response;
+}
+
+int daemon_forward(int argc, char *argv[], int *rc)
+{
+  json_object *request, *response, *result, *item;
+  json_object *params;
+  int ret = -1;
+  int fd;
+  int i;
+
+  if (argc < 2)
+    return -1;
+  fd = connect_daemon();
+  if (fd < 0)
+    return -1;
+
+  params = json_object_new_array();
+  for (i = 2; i < argc; ++i)
+    json_object_array_add(params, json_object_new_string(argv[i]));
+  request = new_request(argv[1], params);
+  response = call_daemon(fd, request);
+  close(fd);
+
+  /* on any error, nothing was printed and the caller runs the command */
+  if (response != NULL &&
+      json_object_object_get_ex(response, "result", &result) &&
+      json_object_object_get_ex(result, "rc", &item)) {
+    *rc = json_object_get_int(item);
+    if (json_object_object_get_ex(result, "stdout", &item))
+      fwrite(json_object_get_string(item), 1,
+             json_object_get_string_len(item), stdout);
+    fflush(stdout);
+    if (json_object_object_get_ex(result, "stderr", &item))
+      fwrite(json_object_get_string(item), 1,
+             json_object_get_string_len(item), stderr);
+    ret = 0;
+  }
+  json_object_put(request);
+  if (response != NULL)
+    json_object_put(response);
+  return ret;
+}
+
+void daemon_invalidate(void)
+{
+  json_object *request, *response;
+  int fd;
+
+  fd = connect_daemon();
+  if (fd < 0)
+    return;
+  request = new_request("invalidate", NULL);
+  response = call_daemon(fd, request);
+  close(fd);
+  json_object_put(request);
+  if (response != NULL)
+    json_object_put(response);
+}
+
+/*
+ * daemon side
+ */
+static long age_ms(const struct timespec *then)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - then->tv_sec) * 1000 +
+         (now.tv_nsec - then->tv_nsec) / 1000000;
+}
+
+static void set_nonblocking(int fd)
+{
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static void put_record(FILE *file, int type, const void *head, size_t head_len,
+                       const void *data, size_t data_len)
+{
+  struct cache_record record;
+
+  record.type = type;
+  record.length = head_len + data_len;
+  fwrite(&record, sizeof(record), 1, file);
+  fwrite(head, 1, head_len, file);
+  if (data_len > 0)
+    fwrite(data, 1, data_len, file);
+}
+
+static void put_detected(const char *devname,
+                         struct jbod_interface *interface, void *arg)
+{
+  put_record((FILE *) arg, CACHE_DETECTED, &interface, sizeof(interface),
+             devname, strlen(devname) + 1);
+}
+
+static void put_snapshot(dev_t rdev, const struct ses_pages *pages,
+                         int page_two_size, int what, void *arg)
+{
+  struct ses_record head;
+
+  memset(&head, 0, sizeof(head));
+  head.rdev = rdev;
+  head.page_two_size = page_two_size;
+  head.what = what;
+  put_record((FILE *) arg, CACHE_SES, &head, sizeof(head),
+             pages, sizeof(*pages));
+}
+
+static void put_read(dev_t rdev, int buf_id, int offset,
+                     const unsigned char *data, int len, void *arg)
+{
+  struct read_record head;
+
+  memset(&head, 0, sizeof(head));
+  head.rdev = rdev;
+  head.buf_id = buf_id;
+  head.offset = offset;
+  put_record((FILE *) arg, CACHE_READ, &head, sizeof(head), data, len);
+}
+
+/* read what fd has for now; return -1 once it is closed */
+static int read_stream(int fd, struct stream *stream)
+{
+  char *bigger;
+  size_t size;
+  ssize_t n;
+
+  for (;;) {
+    if (stream->size - stream->len < DAEMON_READ_CHUNK) {
+      size = stream->size ? stream->size * 2 : DAEMON_READ_CHUNK * 2;
+      bigger = (char *) realloc(stream->buf, size);
+      if (bigger == NULL)
+        return -1;
+      stream->buf = bigger;
+      stream->size = size;
+    }
+    n = read(fd, stream->buf + stream->len, stream->size - stream->len);
+    if (n > 0) {
+      stream->len += n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    return n < 0 && errno == EAGAIN ? 0 : -1;
+  }
+}
+
+static void free_stream(struct stream *stream)
+{
+  free(stream->buf);
+  memset(stream, 0, sizeof(*stream));
+}
+
+/* drop the first len bytes, which were handled */
+static void consume_stream(struct stream *stream, size_t len)
+{
+  stream->len -= len;
+  memmove(stream->buf, stream->buf + len, stream->len);
+}
+
+/*
+ * the payload of the record at offset, or NULL if it is not complete yet;
+ * a corrupt record ends the stream
+ */
+static const char *next_record(const struct stream *stream, size_t offset,
+                               struct cache_record *record)
+{
+  if (stream->len - offset < sizeof(*record))
+    return NULL;
+  memcpy(record, stream->buf + offset, sizeof(*record));
+  if (record->length < 0 ||
+      stream->len - offset - sizeof(*record) < (size_t) record->length)
+    return NULL;
+  return stream->buf + offset + sizeof(*record);
+}
+
+/* keep the data of a record, as if this process had read it */
+static void apply_record(const struct cache_record *record,
+                         const char *payload)
+{
+  struct jbod_interface *interface;
+  struct ses_record ses;
+  struct read_record read;
+  size_t len = record->length;
+
+  switch (record->type) {
+  case CACHE_DETECTED:
+    if (len <= sizeof(interface) || payload[len - 1] != '\0')
+      break;
+    memcpy(&interface, payload, sizeof(interface));
+    jbod_keep_detected(payload + sizeof(interface), interface);
+    break;
+  case CACHE_SES:
+    if (len != sizeof(ses) + sizeof(struct ses_pages))
+      break;
+    memcpy(&ses, payload, sizeof(ses));
+    ses_keep_snapshot(ses.rdev,
+                      (const struct ses_pages *) (payload + sizeof(ses)),
+                      ses.page_two_size, ses.what);
+    break;
+  case CACHE_READ:
+    if (len <= sizeof(read))
+      break;
+    memcpy(&read, payload, sizeof(read));
+    scsi_buffer_keep_read(read.rdev, read.buf_id, read.offset,
+                          (const unsigned char *) payload + sizeof(read),
+                          len - sizeof(read));
+    break;
+  }
+}
+
+/*
+ * poller side: read every enclosure each interval through handles kept
+ * open, and send all that was read to the daemon
+ */
+static void poll_one(int index, void *arg)
+{
+  struct polled_enclosure *p = polled + index;
+  struct ses_pages *pages;
+  struct shm_enclosure *e;
+  struct timespec now;
+  int error = ENODEV;
+
+  if (p->sg_fd < 0)
+    p->sg_fd = sg_cmds_open_device(p->devname, 0 /* rw */,
+                                   0 /* not verbose */);
+  if (p->sg_fd >= 0) {
+    scsi_buffer_refresh_reads(p->sg_fd);
+    pages = (struct ses_pages *) malloc(sizeof(struct ses_pages));
+    if (pages != NULL)
+      read_ses_pages_of(p->sg_fd, pages, NULL,
+                        SES_FETCH_ALL | SES_FETCH_FRESH);
+    free(pages);
+  }
+  if (published == NULL)
+    return;
+
+  e = (struct shm_enclosure *) calloc(1, sizeof(struct shm_enclosure));
+  if (e == NULL)
+    return;
+  if (p->jbod == NULL)
+    p->jbod = ocpjbod_open(p->devname, &error);
+  if (p->jbod != NULL) {
+    /* from the pages and buffers just read */
+    ocpjbod_read_status(p->jbod, 0 /* not fresh */, e);
+  } else {
+    snprintf(e->devname, sizeof(e->devname), "%s", p->devname);
+    e->rc = error;
+    e->power = -1;
+    clock_gettime(CLOCK_REALTIME, &now);
+    e->updated_ms = (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+  }
+  shm_snapshot_publish(published, index, e);
+  free(e);
+}
+
+static void close_polled(struct polled_enclosure *p)
+{
+  if (p->sg_fd >= 0)
+    sg_cmds_close_device(p->sg_fd);
+  ocpjbod_close(p->jbod);
+  p->sg_fd = -1;
+  p->jbod = NULL;
+}
+
+/* list the enclosures again, keeping the handles of those still there */
+static void discover(void)
+{
+  static struct jbod_device devices[MAX_JBOD_PER_HOST];
+  static struct polled_enclosure found[MAX_JBOD_PER_HOST];
+  int count, i, j;
+
+  jbod_drop_detected();
+  count = lib_list_jbod(devices, DAEMON_POLL_PARALLEL);
+  for (i = 0; i < count; ++i) {
+    snprintf(found[i].devname, PATH_MAX, "%s", devices[i].sg_device);
+    found[i].sg_fd = -1;
+    found[i].jbod = NULL;
+    for (j = 0; j < polled_count; ++j) {
+      if (strcmp(polled[j].devname, found[i].devname) == 0) {
+        found[i] = polled[j];
+        polled[j].sg_fd = -1;
+        polled[j].jbod = NULL;
+        break;
+      }
+    }
+  }
+  for (j = 0; j < polled_count; ++j)
+    close_polled(polled + j);
+  memcpy(polled, found, count * sizeof(struct polled_enclosure));
+  polled_count = count;
+}
+
+/* take the reads and invalidations the daemon sent; -1 once it is gone */
+static int read_requests(int fd, struct stream *requests,
+                         unsigned int *seen)
+{
+  struct cache_record record;
+  const char *payload;
+  size_t offset = 0;
+  int rc;
+
+  rc = read_stream(fd, requests);
+  while ((payload = next_record(requests, offset, &record)) != NULL) {
+    if (record.type == CACHE_INVALIDATE &&
+        record.length == sizeof(*seen))
+      memcpy(seen, payload, sizeof(*seen));
+    else
+      apply_record(&record, payload);
+    offset += sizeof(record) + record.length;
+  }
+  consume_stream(requests, offset);
+  return rc;
+}
+
+static int run_poller(int in_fd, int out_fd, const char *shm_path,
+                      int interval_ms)
+{
+  struct stream requests;
+  struct timespec discovered;
+  struct pollfd pfd;
+  unsigned int seen = 0;
+  unsigned int read_after;
+  FILE *out;
+  int i;
+
+  memset(&requests, 0, sizeof(requests));
+  out = fdopen(out_fd, "w");
+  if (out == NULL)
+    return errno;
+  /* queries are still answered if it cannot be created */
+  if (shm_path && shm_path[0])
+    published = shm_snapshot_create(shm_path, interval_ms);
+
+  for (i = 0; i < MAX_JBOD_PER_HOST; ++i)
+    polled[i].sg_fd = -1;
+  discover();
+  clock_gettime(CLOCK_MONOTONIC, &discovered);
+
+  while (!stopping) {
+    if (read_requests(in_fd, &requests, &seen) != 0)
+      break;
+    if (age_ms(&discovered) >= DAEMON_DISCOVERY_INTERVAL_MS) {
+      discover();
+      clock_gettime(CLOCK_MONOTONIC, &discovered);
+    }
+
+    /* what is read from now on is newer than those invalidations */
+    read_after = seen;
+    run_parallel(polled_count, DAEMON_POLL_PARALLEL, poll_one, NULL);
+    if (published != NULL)
+      shm_snapshot_set_count(published, polled_count);
+
+    jbod_foreach_detected(put_detected, out);
+    ses_foreach_snapshot(put_snapshot, out);
+    scsi_buffer_foreach_read(0, put_read, out);
+    put_record(out, CACHE_END, &read_after, sizeof(read_after), NULL, 0);
+    if (fflush(out) != 0)
+      break;
+
+    /* an invalidation cuts the pause short */
+    pfd.fd = in_fd;
+    pfd.events = POLLIN;
+    poll(&pfd, 1, interval_ms);
+  }
+
+  for (i = 0; i < polled_count; ++i)
+    close_polled(polled + i);
+  if (published != NULL) {
+    unlink(shm_path);
+    shm_snapshot_close(published);
+  }
+  free_stream(&requests);
+  fclose(out);
+  return 0;
+}
+
+/* forget all that was kept, so queries read the enclosures themselves */
+static void drop_kept(void)
+{
+  jbod_drop_detected();
+  ses_drop_snapshots();
+  scsi_buffer_drop_reads();
+}
+
+/* the poller runs in a process of its own, so no thread is forked */
+static void start_poller(const char *shm_path, int interval_ms)
+{
+  int to_daemon[2], to_poller[2];
+
+  clock_gettime(CLOCK_MONOTONIC, &generation_time);
+  poller_heard = generation_time;
+
+  if (pipe(to_daemon) != 0)
+    goto fail;
+  if (pipe(to_poller) != 0) {
+    close(to_daemon[0]);
+    close(to_daemon[1]);
+    goto fail;
+  }
+  poller = fork();
+  if (poller == 0) {
+    close(listen_fd);
+    close(to_daemon[0]);
+    close(to_poller[1]);
+    set_nonblocking(to_poller[0]);
+    _exit(run_poller(to_poller[0], to_daemon[1], shm_path, interval_ms));
+  }
+  close(to_daemon[1]);
+  close(to_poller[0]);
+  if (poller < 0) {
+    close(to_daemon[0]);
+    close(to_poller[1]);
+    goto fail;
+  }
+  poller_in = to_daemon[0];
+  poller_out = to_poller[1];
+  set_nonblocking(poller_in);
+  set_nonblocking(poller_out);
+  return;
+
+fail:
+  perr("Cannot start the poller: %s\n", strerror(errno));
+  clock_gettime(CLOCK_MONOTONIC, &poller_lost);
+}
+
+/* nothing from the poller is trusted once it is gone */
+static void close_poller(void)
+{
+  if (poller_in >= 0)
+    close(poller_in);
+  if (poller_out >= 0)
+    close(poller_out);
+  poller_in = poller_out = -1;
+  notify_pending = 0;
+  free_stream(&generation);
+  drop_kept();
+}
+
+static void stop_poller(int signo)
+{
+  if (poller <= 0)
+    return;
+  kill(poller, signo);
+  close_poller();
+  while (waitpid(poller, NULL, 0) < 0 && errno == EINTR)
+    ;
+  poller = -1;
+}
+
+/*
+ * kill a poller that exited or hangs, without waiting for it; it is
+ * reaped and started again by keep_poller()
+ */
+static void lose_poller(const char *why)
+{
+  perr("The poller %s; queries read the enclosures themselves\n", why);
+  kill(poller, SIGKILL);
+  close_poller();
+  lost_poller = poller;
+  poller = -1;
+  clock_gettime(CLOCK_MONOTONIC, &poller_lost);
+}
+
+/*
+ * drop what a late poller read, and replace a lost or hung one after a
+ * pause; return ms until it is due, or -1
+ */
+static int keep_poller(void)
+{
+  long left;
+
+  if (age_ms(&generation_time) >=
+      DAEMON_STALE_INTERVALS * (long) poller_interval_ms)
+    drop_kept();
+  if (poller > 0 && age_ms(&poller_heard) >= DAEMON_TIMEOUT_SEC * 1000L)
+    lose_poller("is hung");
+  if (lost_poller > 0 && waitpid(lost_poller, NULL, WNOHANG) != 0)
+    lost_poller = -1;
+  if (poller > 0)
+    return -1;
+
+  left = restart_delay_ms - age_ms(&poller_lost);
+  if (left > 0)
+    return left;
+  start_poller(poller_shm_path, poller_interval_ms);
+  /* until a generation is taken, the next pause is longer */
+  restart_delay_ms *= 2;
+  if (restart_delay_ms > DAEMON_RESTART_MAX_MS)
+    restart_delay_ms = DAEMON_RESTART_MAX_MS;
+  return poller > 0 ? -1 : restart_delay_ms;
+}
+
+/* tell the poller the latest invalidation count, once the pipe has room */
+static void notify_poller(void)
+{
+  struct {
+    struct cache_record record;
+    unsigned int count;
+  } message;
+
+  if (poller_out < 0) {
+    notify_pending = 0;
+    return;
+  }
+  memset(&message, 0, sizeof(message));
+  message.record.type = CACHE_INVALIDATE;
+  message.record.length = sizeof(message.count);
+  message.count = invalidations;
+  /* short, so written whole or not at all */
+  notify_pending = write(poller_out, &message, sizeof(message)) !=
+                   sizeof(message);
+}
+
+/*
+ * take what the poller sent; a complete sweep replaces all that is kept,
+ * unless an enclosure was written to since the poller started reading it
+ */
+static void receive_generation(void)
+{
+  struct cache_record record;
+  unsigned int read_after;
+  const char *payload;
+  size_t offset = 0;
+  size_t end;
+
+  if (read_stream(poller_in, &generation) != 0) {
+    lose_poller("stopped");
+    return;
+  }
+
+  for (;;) {
+    offset = 0;
+    while ((payload = next_record(&generation, offset, &record)) != NULL &&
+           record.type != CACHE_END)
+      offset += sizeof(record) + record.length;
+    if (payload == NULL)
+      return;
+
+    end = offset + sizeof(record) + record.length;
+    clock_gettime(CLOCK_MONOTONIC, &poller_heard);
+    read_after = invalidations + 1;
+    if (record.length == sizeof(read_after))
+      memcpy(&read_after, payload, sizeof(read_after));
+    if (read_after == invalidations) {
+      drop_kept();
+      clock_gettime(CLOCK_MONOTONIC, &generation_time);
+      restart_delay_ms = DAEMON_RESTART_MIN_MS;
+      for (offset = 0;
+           (payload = next_record(&generation, offset, &record)) != NULL &&
+           record.type != CACHE_END;
+           offset += sizeof(record) + record.length)
+        apply_record(&record, payload);
+    }
+    consume_stream(&generation, end);
+  }
+}
+
+/* drop what was kept, and have the poller read the enclosures again */
+static void invalidate(void)
+{
+  ses_drop_snapshots();
+  scsi_buffer_drop_reads();
+  ++invalidations;
+  notify_poller();
+}
+
+/*
+ * keep the buffers a query read itself, and pass them on to the poller;
+ * a record the pipe has no room for is learned by a later query again
+ */
+static void learn_reads(struct stream *learned)
+{
+  struct cache_record record;
+  const char *payload;
+  int forward = poller_out >= 0;
+  size_t offset = 0;
+  size_t len;
+
+  while ((payload = next_record(learned, offset, &record)) != NULL) {
+    len = sizeof(record) + record.length;
+    if (record.type == CACHE_READ) {
+      apply_record(&record, payload);
+      /* up to PIPE_BUF, a record is written whole or not at all */
+      if (forward && len <= PIPE_BUF &&
+          write(poller_out, learned->buf + offset, len) < 0)
+        forward = 0;
+    }
+    offset += len;
+  }
+}
+
+static int read_file(FILE *file, char **buf, int *len)
+{
+  long size;
+
+  if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0)
+    return -1;
+  rewind(file);
+  *buf = (char *) malloc(size + 1);
+  if (*buf == NULL)
+    return -1;
+  *len = fread(*buf, 1, size, file);
+  (*buf)[*len] = '\0';
+  return 0;
+}
+
+static json_object *new_response(json_object *id)
+{
+  json_object *response = json_object_new_object();
+
+  json_object_object_add(response, "jsonrpc", json_object_new_string("2.0"));
+  json_object_object_add(response, "id",
+                         id != NULL ? json_object_get(id) : NULL);
+  return response;
+}
+
+static json_object *new_error(json_object *id, int code, const char *message)
+{
+  json_object *response = new_response(id);
+  json_object *error = json_object_new_object();
+
+  json_object_object_add(error, "code", json_object_new_int(code));
+  json_object_object_add(error, "message", json_object_new_string(message));
+  json_object_object_add(response, "error", error);
+  return response;
+}
+
+/* in a query child, so it holds nothing of the daemon open */
+static void close_inherited(void)
+{
+  int i;
+
+  close(listen_fd);
+  if (poller_in >= 0)
+    close(poller_in);
+  if (poller_out >= 0)
+    close(poller_out);
+  for (i = 0; i < DAEMON_MAX_CLIENTS; ++i) {
+    if (clients[i].fd != -1)
+      close(clients[i].fd);
+    if (clients[i].job.pid > 0)
+      close(clients[i].job.fd);
+  }
+}
+
+/*
+ * run the command line in a child, as the CLI would. The child starts from
+ * the kept enclosure data of the daemon, and nothing a command leaves
+ * behind (options, globals, open handles) leaks into the daemon.
+ */
+static int start_query(struct client *client, int argc, char *argv[],
+                       json_object *id)
+{
+  struct job *job = &client->job;
+  FILE *learned;
+  int done[2];
+  int rc;
+
+  job->out = tmpfile();
+  job->err = tmpfile();
+  if (job->out == NULL || job->err == NULL || pipe(done) != 0)
+    goto fail;
+
+  fflush(stdout);
+  fflush(stderr);
+  job->pid = fork();
+  if (job->pid == 0) {
+    dup2(fileno(job->out), STDOUT_FILENO);
+    dup2(fileno(job->err), STDERR_FILENO);
+    close(done[0]);
+    close_inherited();
+    rc = parse_cmd(argc, argv);
+    fflush(stdout);
+    learned = fdopen(done[1], "w");
+    if (learned != NULL) {
+      scsi_buffer_foreach_read(1 /* learned only */, put_read, learned);
+      fclose(learned);
+    }
+    exit(rc);
+  }
+  close(done[1]);
+  if (job->pid < 0) {
+    close(done[0]);
+    goto fail;
+  }
+  job->fd = done[0];
+  set_nonblocking(job->fd);
+  job->id = id != NULL ? json_object_get(id) : NULL;
+  job->killed = 0;
+  clock_gettime(CLOCK_MONOTONIC, &job->started);
+  return 0;
+
+fail:
+  if (job->out != NULL)
+    fclose(job->out);
+  if (job->err != NULL)
+    fclose(job->err);
+  job->out = job->err = NULL;
+  job->pid = -1;
+  return -1;
+}
+
+/* reap the child of a job; its fd is closed once it exited */
+static int end_job(struct job *job)
+{
+  int status = 0;
+
+  while (waitpid(job->pid, &status, 0) < 0 && errno == EINTR)
+    ;
+  close(job->fd);
+  job->fd = -1;
+  job->pid = -1;
+  return status;
+}
+
+static void free_job(struct job *job)
+{
+  if (job->out != NULL)
+    fclose(job->out);
+  if (job->err != NULL)
+    fclose(job->err);
+  if (job->id != NULL)
+    json_object_put(job->id);
+  free_stream(&job->learned);
+  job->out = job->err = NULL;
+  job->id = NULL;
+}
+
+static void drop_client(struct client *client)
+{
+  if (client->job.pid > 0) {
+    kill(client->job.pid, SIGKILL);
+    end_job(&client->job);
+  }
+  free_job(&client->job);
+  close(client->fd);
+  free(client->buf);
+  client->fd = -1;
+  client->buf = NULL;
+  client->len = 0;
+}
+
+/*
+ * the response to a request, or NULL if there is none yet: a query is
+ * answered once its child exits, and a notification never is
+ */
+static json_object *answer(struct client *client, json_object *request)
+{
+  json_object *id = NULL;
+  json_object *method, *params, *param, *response;
+  char *argv[DAEMON_MAX_ARGS + 2];
+  int notification;
+  int argc = 0;
+  int i;
+
+  if (request == NULL)
+    return new_error(NULL, JSONRPC_PARSE_ERROR, "Parse error");
+  notification = !json_object_object_get_ex(request, "id", &id);
+  if (!json_object_object_get_ex(request, "method", &method) ||
+      !json_object_is_type(method, json_type_string))
+    return new_error(id, JSONRPC_INVALID_REQUEST, "Invalid Request");
+
+  /* nobody reads the answer, so only an invalidation does anything */
+  if (notification) {
+    if (strcmp(json_object_get_string(method), "invalidate") == 0)
+      invalidate();
+    return NULL;
+  }
+
+  if (strcmp(json_object_get_string(method), "invalidate") == 0) {
+    invalidate();
+    response = new_response(id);
+    json_object_object_add(response, "result", json_object_new_object());
+    return response;
+  }
+
+  argv[argc++] = NAME;
+  argv[argc++] = (char *) json_object_get_string(method);
+  if (json_object_object_get_ex(request, "params", &params)) {
+    if (!json_object_is_type(params, json_type_array) ||
+        json_object_array_length(params) > DAEMON_MAX_ARGS)
+      return new_error(id, JSONRPC_INVALID_REQUEST, "Invalid Request");
+    for (i = 0; i < json_object_array_length(params); ++i) {
+      param = json_object_array_get_idx(params, i);
+      if (!json_object_is_type(param, json_type_string))
+        return new_error(id, JSONRPC_INVALID_REQUEST, "Invalid Request");
+      argv[argc++] = (char *) json_object_get_string(param);
+    }
+  }
+  argv[argc] = NULL;
+  if (!is_query_command(argc, argv))
+    return new_error(id, JSONRPC_METHOD_NOT_FOUND,
+                     "Not a query; run it without the daemon");
+  if (start_query(client, argc, argv, id) != 0)
+    return new_error(id, JSONRPC_INTERNAL_ERROR, "Cannot run command");
+  return NULL;
+}
+
+static int send_response(struct client *client, json_object *response)
+{
+  int rc = write_line(client->fd, response);
+
+  json_object_put(response);
+  return rc;
+}
+
+/* answer the complete lines received, up to the first query */
+static void answer_lines(struct client *client)
+{
+  json_object *request, *response;
+  char *line, *end;
+  int rc = 0;
+
+  line = client->buf;
+  while (rc == 0 && client->job.pid < 0 &&
+         (end = memchr(line, '\n', client->len - (line - client->buf)))
+         != NULL) {
+    *end = '\0';
+    request = json_tokener_parse(line);
+    response = answer(client, request);
+    if (response != NULL)
+      rc = send_response(client, response);
+    if (request != NULL)
+      json_object_put(request);
+    line = end + 1;
+  }
+  client->len -= line - client->buf;
+  memmove(client->buf, line, client->len);
+  if (rc != 0)
+    drop_client(client);
+}
+
+/* read what the client sent; it is not read while its query runs */
+static void serve_client(struct client *client)
+{
+  ssize_t n;
+
+  if (client->buf == NULL) {
+    client->buf = (char *) malloc(DAEMON_MAX_REQUEST + 1);
+    if (client->buf == NULL) {
+      drop_client(client);
+      return;
+    }
+  }
+  n = read(client->fd, client->buf + client->len,
+           DAEMON_MAX_REQUEST - client->len);
+  if (n < 0 && errno == EINTR)
+    return;
+  if (n <= 0) {
+    drop_client(client);
+    return;
+  }
+  client->len += n;
+  answer_lines(client);
+  if (client->fd != -1 && client->job.pid < 0 &&
+      client->len == DAEMON_MAX_REQUEST)
+    drop_client(client);
+}
+
+/* take what the query child sent; answer the client once it exited */
+static void serve_job(struct client *client)
+{
+  struct job *job = &client->job;
+  json_object *response, *result;
+  char *out = NULL, *err = NULL;
+  int out_len, err_len;
+  int status;
+
+  if (read_stream(job->fd, &job->learned) == 0)
+    return;
+  status = end_job(job);
+  learn_reads(&job->learned);
+
+  if (job->killed)
+    response = new_error(job->id, JSONRPC_INTERNAL_ERROR,
+                         "Command timed out");
+  else if (!WIFEXITED(status) ||
+           read_file(job->out, &out, &out_len) != 0 ||
+           read_file(job->err, &err, &err_len) != 0)
+    response = new_error(job->id, JSONRPC_INTERNAL_ERROR,
+                         "Cannot run command");
+  else {
+    response = new_response(job->id);
+    result = json_object_new_object();
+    json_object_object_add(result, "rc",
+                           json_object_new_int(WEXITSTATUS(status)));
+    json_object_object_add(result, "stdout",
+                           json_object_new_string_len(out, out_len));
+    json_object_object_add(result, "stderr",
+                           json_object_new_string_len(err, err_len));
+    json_object_object_add(response, "result", result);
+  }
+  free(out);
+  free(err);
+  free_job(job);
+
+  if (send_response(client, response) != 0)
+    drop_client(client);
+  else
+    answer_lines(client);
+}
+
+/* kill queries running too long; return ms until the next may be, or -1 */
+static int kill_late_jobs(void)
+{
+  struct job *job;
+  int timeout = -1;
+  long left;
+  int i;
+
+  for (i = 0; i < DAEMON_MAX_CLIENTS; ++i) {
+    job = &clients[i].job;
+    if (clients[i].fd == -1 || job->pid < 0 || job->killed)
+      continue;
+    left = DAEMON_TIMEOUT_SEC * 1000L - age_ms(&job->started);
+    if (left <= 0) {
+      kill(job->pid, SIGKILL);        /* serve_job() answers at its exit */
+      job->killed = 1;
+    } else if (timeout < 0 || left < timeout) {
+      timeout = left;
+    }
+  }
+  return timeout;
+}
+
+static void stop(int signo)
+{
+  stopping = 1;
+}
+
+int daemon_serve(const char *path, const char *shm_path, int interval_ms)
+{
+  struct pollfd fds[2 * DAEMON_MAX_CLIENTS + 3];
+  struct sigaction action;
+  struct sockaddr_un addr;
+  struct client *client;
+  int timeout, restart;
+  int fd;
+  int count, i;
+
+  daemon_disabled = 1;
+  if (socket_address(path, &addr) != 0) {
+    perr("Invalid socket path %s.\n", path);
+    return EINVAL;
+  }
+  listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0) {
+    perr("Cannot create socket: %s\n", strerror(errno));
+    return errno;
+  }
+  unlink(path);
+  if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+      chmod(path, 0600) != 0 || listen(listen_fd, DAEMON_MAX_CLIENTS) != 0) {
+    perr("Cannot listen on %s: %s\n", path, strerror(errno));
+    close(listen_fd);
+    return errno;
+  }
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stop;          /* no SA_RESTART, to wake up poll() */
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  /* queries are answered from what the poller read, see daemon.h */
+  jbod_keep_snapshots(1);
+  scsi_buffer_keep_reads(1);
+  poller_shm_path = shm_path;
+  if (interval_ms > 0)
+    poller_interval_ms = interval_ms;
+  start_poller(poller_shm_path, poller_interval_ms);
+
+  for (i = 0; i < DAEMON_MAX_CLIENTS; ++i) {
+    memset(clients + i, 0, sizeof(struct client));
+    clients[i].fd = -1;
+    clients[i].job.fd = -1;
+    clients[i].job.pid = -1;
+  }
+
+  while (!stopping) {
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = poller_in;                /* -1 is ignored */
+    fds[1].events = POLLIN;
+    fds[2].fd = notify_pending ? poller_out : -1;
+    fds[2].events = POLLOUT;
+    for (i = 0; i < DAEMON_MAX_CLIENTS; ++i) {
+      client = clients + i;
+      fds[3 + i].fd = client->job.pid < 0 ? client->fd : -1;
+      fds[3 + i].events = POLLIN;
+      fds[3 + DAEMON_MAX_CLIENTS + i].fd = client->job.pid > 0 ?
+                                           client->job.fd : -1;
+      fds[3 + DAEMON_MAX_CLIENTS + i].events = POLLIN;
+    }
+    timeout = kill_late_jobs();
+    restart = keep_poller();
+    if (restart >= 0 && (timeout < 0 || restart < timeout))
+      timeout = restart;
+    count = poll(fds, 2 * DAEMON_MAX_CLIENTS + 3, timeout);
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+      perr("poll: %s\n", strerror(errno));
+      break;
+    }
+
+    if (fds[1].revents)
+      receive_generation();
+    /* before any query is started from what is kept */
+    keep_poller();
+    if (fds[2].revents)
+      notify_poller();
+    for (i = 0; i < DAEMON_MAX_CLIENTS; ++i) {
+      client = clients + i;
+      if (client->job.pid > 0 &&
+          fds[3 + DAEMON_MAX_CLIENTS + i].fd == client->job.fd &&
+          fds[3 + DAEMON_MAX_CLIENTS + i].revents)
+        serve_job(client);
+      else if (client->fd != -1 && fds[3 + i].fd == client->fd &&
+               fds[3 + i].revents)
+        serve_client(client);
+    }
+    if (fds[0].revents & POLLIN) {
+      fd = accept(listen_fd, NULL, NULL);
+      if (fd >= 0)
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+      for (i = 0; fd >= 0 && i < DAEMON_MAX_CLIENTS; ++i) {
+        if (clients[i].fd == -1) {
+          set_timeouts(fd);
+          clients[i].fd = fd;
+          fd = -1;
+        }
+      }
+      if (fd >= 0)
+        close(fd);                        /* too many clients */
+    }
+  }
+
+  for (i = 0; i < DAEMON_MAX_CLIENTS; ++i) {
+    if (clients[i].fd != -1)
+      drop_client(clients + i);
+  }
+  stop_poller(SIGTERM);
+  close(listen_fd);
+  unlink(path);
+  return 0;
+}
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+/* where ocpjbodd listens; OCPJBODD_SOCKET overrides it, "" disables it */
+#define DAEMON_SOCKET_PATH "/run/" NAME "d.sock"
+#define DAEMON_SOCKET_ENV "OCPJBODD_SOCKET"
+
+/* how often the poller of the daemon reads every enclosure */
+#define DAEMON_DEFAULT_INTERVAL_MS 1000
+
+/* and how often it lists them again, to see hot plugs */
+#define DAEMON_DISCOVERY_INTERVAL_MS 60000
+
+/* enclosures the poller reads at the same time */
+#define DAEMON_POLL_PARALLEL 8
+
+/* what the poller read is not used once this many intervals old */
+#define DAEMON_STALE_INTERVALS 5
+
+/* a lost poller is started again after this, doubled up to the max */
+#define DAEMON_RESTART_MIN_MS 1000
+#define DAEMON_RESTART_MAX_MS 60000
+
+/*
+ * seconds a client waits for the daemon before running a command itself,
+ * and the daemon lets a query run
+ */
+#define DAEMON_TIMEOUT_SEC 60
+
+#define DAEMON_MAX_CLIENTS 64
+#define DAEMON_MAX_REQUEST 65536
+#define DAEMON_MAX_ARGS 64
+#define DAEMON_READ_CHUNK 65536
+
+/*
+ * The daemon speaks JSON-RPC 2.0, one request or response per line:
+ *   {"jsonrpc": "2.0", "id": 1, "method": "hdd",
+ *    "params": ["--json", "/dev/sg1"]}
+ *   {"jsonrpc": "2.0", "id": 1,
+ *    "result": {"rc": 0, "stdout": "...", "stderr": ""}}
+ * The method is a command and the params are its command line. Only
+ * commands that read (see is_query_command()) are answered, each by a
+ * child of the daemon, so a slow one holds up only its own client.
+ * Requests without an id are notifications, and are not answered.
+ *
+ * The enclosures see one poller however many clients ask: it keeps them
+ * open, and every interval reads their SES pages and the vendor buffers
+ * any query read, then hands all of it to the daemon. A query starts
+ * from that and reads the enclosures only for what it lacks, which the
+ * poller reads from then on. The method "invalidate" drops what was read,
+ * until the poller read the enclosures again. So does a poller that is
+ * late by DAEMON_STALE_INTERVALS; one that exits, or stays silent for
+ * DAEMON_TIMEOUT_SEC, is started again.
+ */
+
+/* set in the daemon and its workers, so commands are never forwarded */
+extern int daemon_disabled;
+
+/*
+ * run a query command line through ocpjbodd, if it is running: print its
+ * output and set *rc. Return 0 if the daemon answered, else -1 and the
+ * caller runs the command itself.
+ */
+extern int daemon_forward(int argc, char *argv[], int *rc);
+
+/* tell ocpjbodd that enclosures were changed, so what it read is stale */
+extern void daemon_invalidate(void);
+
+/*
+ * answer queries on path until SIGINT or SIGTERM, reading the enclosures
+ * every interval_ms. Unless shm_path is NULL or "", what is read is also
+ * published there, see shm_snapshot.h.
+ */
+extern int daemon_serve(const char *path, const char *shm_path,
+                        int interval_ms);
+
+#endif
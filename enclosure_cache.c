@@ -0,0 +1,302 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+
+#include "enclosure_cache.h"
+
+int read_enclosure_attr(int sg_fd, const char *attr, char *out, int size)
+{
+  char path[PATH_MAX];
+  struct stat st;
+  int fd, len;
+
+  if (fstat(sg_fd, &st) != 0 || !S_ISCHR(st.st_mode))
+    return ENODEV;
+  snprintf(path, PATH_MAX, "/sys/dev/char/%u:%u/device/%s",
+           major(st.st_rdev), minor(st.st_rdev), attr);
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return ENODEV;
+  len = read(fd, out, size - 1);
+  close(fd);
+  if (len <= 0)
+    return ENODEV;
+
+  out[len] = '\0';
+  while (len > 0 && (out[len - 1] == '\n' || out[len - 1] == ' '))
+    out[--len] = '\0';
+  return 0;
+}
+
+static unsigned int hash_value(const char *value)
+{
+  unsigned int hash = 2166136261u;      /* FNV-1a */
+
+  while (*value)
+    hash = (hash ^ (unsigned char) *value++) * 16777619u;
+  return hash;
+}
+
+/*
+ * read the entries of cache->path into cache; return 1 if they are of
+ * another firmware than cache->firmware
+ */
+static int load_entries(struct enclosure_cache *cache)
+{
+  char line[ENCLOSURE_CACHE_KEY_LENGTH + ENCLOSURE_CACHE_VALUE_LENGTH + 2];
+  struct enclosure_cache_entry *entry;
+  char *value;
+  FILE *fp;
+  int stale = 0;
+
+  cache->count = 0;
+  fp = fopen(cache->path, "r");
+  if (fp == NULL)
+    return 0;
+
+  /* each line is "key value" */
+  while (fgets(line, sizeof(line), fp) &&
+         cache->count < ENCLOSURE_CACHE_MAX_ENTRIES) {
+    line[strcspn(line, "\n")] = '\0';
+    value = strchr(line, ' ');
+    if (value == NULL)
+      continue;
+    *value++ = '\0';
+    if (strcmp(line, "firmware") == 0) {
+      stale = strcmp(value, cache->firmware) != 0;
+      continue;
+    }
+    entry = cache->entries + cache->count++;
+    snprintf(entry->key, ENCLOSURE_CACHE_KEY_LENGTH, "%s", line);
+    snprintf(entry->value, ENCLOSURE_CACHE_VALUE_LENGTH, "%s", value);
+    entry->changed = 0;
+    entry->known = 1;
+    entry->base = hash_value(entry->value);
+  }
+  fclose(fp);
+  return stale;
+}
+
+int enclosure_cache_open(int sg_fd, struct enclosure_cache *cache)
+{
+  char sas_address[SAS_ADDR_STR_LENGTH + 4];
+
+  memset(cache, 0, sizeof(*cache));
+  if (read_enclosure_attr(sg_fd, "sas_address", sas_address,
+                       sizeof(sas_address)) != 0)
+    return ENODEV;
+  snprintf(cache->path, PATH_MAX, "%s/%s", CACHE_DIR, sas_address);
+  if (read_enclosure_attr(sg_fd, "rev", cache->firmware,
+                       ENCLOSURE_FIRMWARE_LENGTH) != 0)
+    cache->firmware[0] = '\0';
+
+  /* what we learned may not hold for another firmware */
+  if (load_entries(cache)) {
+    cache->count = 0;
+    cache->dirty = 1;
+  }
+  return 0;
+}
+
+const char *enclosure_cache_get(struct enclosure_cache *cache,
+                                const char *key)
+{
+  int i;
+
+  for (i = 0; i < cache->count; ++i) {
+    if (strcmp(cache->entries[i].key, key) == 0)
+      return cache->entries[i].value;
+  }
+  return NULL;
+}
+
+void enclosure_cache_set(struct enclosure_cache *cache,
+                         const char *key, const char *value)
+{
+  struct enclosure_cache_entry *entry = NULL;
+  int i;
+
+  if (cache->path[0] == '\0')
+    return;
+
+  for (i = 0; i < cache->count; ++i) {
+    if (strcmp(cache->entries[i].key, key) == 0) {
+      entry = cache->entries + i;
+      break;
+    }
+  }
+  if (entry == NULL) {
+    if (cache->count >= ENCLOSURE_CACHE_MAX_ENTRIES)
+      return;
+    entry = cache->entries + cache->count++;
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->key, ENCLOSURE_CACHE_KEY_LENGTH, "%s", key);
+  } else if (strcmp(entry->value, value) == 0) {
+    return;
+  }
+  snprintf(entry->value, ENCLOSURE_CACHE_VALUE_LENGTH, "%s", value);
+  entry->changed = 1;
+  cache->dirty = 1;
+}
+
+/* whether another handle changed entry since cache was opened */
+static int changed_elsewhere(const struct enclosure_cache_entry *entry,
+                             struct enclosure_cache *saved)
+{
+  const char *value = enclosure_cache_get(saved, entry->key);
+
+  if (value == NULL)
+    return entry->known;
+  return !entry->known || hash_value(value) != entry->base;
+}
+
+/* write the merged entries to a new file and rename it over the old one */
+static int write_entries(struct enclosure_cache *cache)
+{
+  char tmp_path[PATH_MAX];
+  FILE *fp;
+  int fd;
+  int i;
+
+  /* unique per thread too, and never seen partially by readers */
+  snprintf(tmp_path, PATH_MAX, "%s.XXXXXX", cache->path);
+  fd = mkstemp(tmp_path);
+  if (fd < 0) {
+#ifdef DEBUG
+    perr("Cannot write %s.\n", tmp_path);
+#endif
+    return errno;
+  }
+  fchmod(fd, 0644);
+  fp = fdopen(fd, "w");
+  if (fp == NULL) {
+    close(fd);
+    unlink(tmp_path);
+    return errno;
+  }
+  fprintf(fp, "firmware %s\n", cache->firmware);
+  for (i = 0; i < cache->count; ++i)
+    fprintf(fp, "%s %s\n", cache->entries[i].key, cache->entries[i].value);
+  if (fclose(fp) != 0 || rename(tmp_path, cache->path) != 0) {
+    unlink(tmp_path);
+    return errno;
+  }
+  return 0;
+}
+
+static int save_cache(struct enclosure_cache *cache, int force)
+{
+  struct enclosure_cache *saved;
+  struct enclosure_cache_entry *entry;
+  char lock_path[PATH_MAX];
+  struct stat st;
+  int lock_fd;
+  int rc;
+  int i;
+
+  if (!cache->dirty || cache->path[0] == '\0')
+    return 0;
+
+  if (stat(CACHE_DIR, &st) != 0)
+    mkdir(CACHE_DIR, 0755);
+
+  saved = (struct enclosure_cache *) malloc(sizeof(struct enclosure_cache));
+  if (saved == NULL)
+    return ENOMEM;
+
+  /* one writer per enclosure; flock() excludes threads with their own fd */
+  snprintf(lock_path, PATH_MAX, "%s.lock", cache->path);
+  lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0) {
+    rc = errno;
+    if (lock_fd >= 0)
+      close(lock_fd);
+    free(saved);
+    return rc;
+  }
+
+  /* what others saved meanwhile, plus what only this handle changed */
+  memcpy(saved->path, cache->path, sizeof(saved->path));
+  memcpy(saved->firmware, cache->firmware, sizeof(saved->firmware));
+  saved->dirty = 0;
+  if (load_entries(saved))
+    saved->count = 0;
+  for (i = 0; i < cache->count; ++i) {
+    entry = cache->entries + i;
+    if (entry->changed && (force || !changed_elsewhere(entry, saved)))
+      enclosure_cache_set(saved, entry->key, entry->value);
+  }
+
+  rc = write_entries(saved);
+  close(lock_fd);
+  if (rc == 0) {
+    /* go on from what was saved */
+    cache->count = saved->count;
+    for (i = 0; i < cache->count; ++i) {
+      cache->entries[i] = saved->entries[i];
+      cache->entries[i].changed = 0;
+      cache->entries[i].known = 1;
+      cache->entries[i].base = hash_value(cache->entries[i].value);
+    }
+    cache->dirty = 0;
+  }
+  free(saved);
+  return rc;
+}
+
+int enclosure_cache_save(struct enclosure_cache *cache)
+{
+  return save_cache(cache, 0);
+}
+
+int enclosure_cache_read(int sg_fd, const char *key, char *value, int size)
+{
+  struct enclosure_cache *cache;
+  const char *cached;
+  int rc = ENOENT;
+
+  cache = (struct enclosure_cache *) malloc(sizeof(struct enclosure_cache));
+  if (cache == NULL)
+    return ENOMEM;
+  if (enclosure_cache_open(sg_fd, cache) == 0 &&
+      (cached = enclosure_cache_get(cache, key)) != NULL) {
+    snprintf(value, size, "%s", cached);
+    rc = 0;
+  }
+  free(cache);
+  return rc;
+}
+
+int enclosure_cache_write(int sg_fd, const char *key, const char *value)
+{
+  struct enclosure_cache *cache;
+  int rc;
+
+  cache = (struct enclosure_cache *) malloc(sizeof(struct enclosure_cache));
+  if (cache == NULL)
+    return ENOMEM;
+  rc = enclosure_cache_open(sg_fd, cache);
+  if (rc == 0) {
+    enclosure_cache_set(cache, key, value);
+    rc = save_cache(cache, 1 /* force */);
+  }
+  free(cache);
+  return rc;
+}
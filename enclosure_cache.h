@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef ENCLOSURE_CACHE_H
+#define ENCLOSURE_CACHE_H
+
+#include <limits.h>
+#include "common.h"
+
+#ifndef CACHE_DIR
+#define CACHE_DIR "/var/cache/" NAME
+#endif
+
+#define ENCLOSURE_CACHE_MAX_ENTRIES   128
+#define ENCLOSURE_CACHE_KEY_LENGTH    64
+#define ENCLOSURE_CACHE_VALUE_LENGTH  256
+#define ENCLOSURE_FIRMWARE_LENGTH     64
+
+struct enclosure_cache_entry {
+  char key[ENCLOSURE_CACHE_KEY_LENGTH];
+  char value[ENCLOSURE_CACHE_VALUE_LENGTH];
+  int changed;                  /* set since the cache was opened */
+  int known;                    /* in the file when it was opened */
+  unsigned int base;            /* hash of the value then */
+};
+
+/*
+ * facts learned about one enclosure (capabilities, counters, etc.),
+ * persisted in CACHE_DIR and keyed by the SAS address of its SES device.
+ * Entries are dropped when the firmware revision changes.
+ */
+struct enclosure_cache {
+  char path[PATH_MAX];
+  char firmware[ENCLOSURE_FIRMWARE_LENGTH];
+  struct enclosure_cache_entry entries[ENCLOSURE_CACHE_MAX_ENTRIES];
+  int count;
+  int dirty;
+};
+
+/*
+ * read a one-line sysfs attribute (e.g. sas_address) of the SCSI device
+ * behind sg_fd; return 0 on success
+ */
+extern int read_enclosure_attr(int sg_fd, const char *attr,
+                               char *out, int size);
+
+/*
+ * load the cache of the enclosure behind sg_fd;
+ * return 0 on success, or ENODEV if the enclosure has no SAS address
+ */
+extern int enclosure_cache_open(int sg_fd, struct enclosure_cache *cache);
+
+/* return the value of key, or NULL if not cached */
+extern const char *enclosure_cache_get(struct enclosure_cache *cache,
+                                       const char *key);
+
+extern void enclosure_cache_set(struct enclosure_cache *cache,
+                                const char *key, const char *value);
+
+/*
+ * write the cache back if it changed. Entries are merged with what other
+ * handles saved meanwhile, under a lock: only keys set through this one
+ * are written, and not those another handle changed since it was opened.
+ */
+extern int enclosure_cache_save(struct enclosure_cache *cache);
+
+/* one-shot helpers; return 0 on success. The write always wins. */
+extern int enclosure_cache_read(int sg_fd, const char *key,
+                                char *value, int size);
+extern int enclosure_cache_write(int sg_fd, const char *key,
+                                 const char *value);
+
+#endif
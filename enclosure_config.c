@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <scsi/sg_lib.h>
+#include <scsi/sg_cmds.h>
+#include <errno.h>
+#include <json-c/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "enclosure_cache.h"
+#include "enclosure_config.h"
+#include "jbod_interface.h"
+#include "json.h"
+#include "parallel.h"
+
+struct config_job {
+  char *devname;
+  char key[PATH_MAX];               /* SAS address, or devname */
+  const struct config_item *configs;
+  int values[CONFIG_ITEM_COUNT];
+  int wanted[CONFIG_ITEM_COUNT];    /* -1 to keep the item */
+  json_object *entry;               /* of the apply file */
+  int written;
+  int unchanged;
+  int rc;
+};
+
+struct config_ctx {
+  struct config_job *jobs;
+  json_object *apply;
+  int for_all;                      /* apply is one profile for all */
+};
+
+static int config_supported(const struct config_item *config)
+{
+  return config->buffer_id != -1 && config->buffer_offset != -1;
+}
+
+/* find the wanted values of job in the apply file */
+static void match_apply(struct config_job *job, struct config_ctx *ctx)
+{
+  int val;
+  int i;
+
+  if (ctx->for_all)
+    job->entry = ctx->apply;
+  else if (!json_object_object_get_ex(ctx->apply, job->key, &job->entry) &&
+           !json_object_object_get_ex(ctx->apply, job->devname, &job->entry))
+    return;
+
+  json_object_object_foreach(job->entry, name, value) {
+    for (i = 0; i < CONFIG_ITEM_COUNT; ++i) {
+      if (strcmp(name, job->configs[i].name) == 0)
+        break;
+    }
+    if (i == CONFIG_ITEM_COUNT || !config_supported(job->configs + i)) {
+      perr("%s: %s is not supported.\n", job->devname, name);
+      job->rc = EINVAL;
+      continue;
+    }
+    val = json_object_get_int(value);
+    if (!json_object_is_type(value, json_type_int) || val < 0 || val > 0xff) {
+      perr("%s: invalid value of %s.\n", job->devname, name);
+      job->rc = EINVAL;
+      continue;
+    }
+    job->wanted[i] = val;
+  }
+}
+
+static void write_changed_configs(int sg_fd, struct config_job *job)
+{
+  int i;
+
+  for (i = 0; i < CONFIG_ITEM_COUNT; ++i) {
+    if (job->wanted[i] == -1)
+      continue;
+    if (job->values[i] == job->wanted[i]) {
+      ++job->unchanged;
+      continue;
+    }
+    change_config(sg_fd, job->wanted[i], job->configs + i);
+    ++job->written;
+  }
+  if (job->written == 0)
+    return;
+
+  /* the writes do not report errors; read back instead */
+  jbod_read_configs(sg_fd, job->configs, job->values);
+  for (i = 0; i < CONFIG_ITEM_COUNT; ++i) {
+    if (job->wanted[i] != -1 && job->values[i] != job->wanted[i]) {
+      perr("%s: %s is %d, not %d.\n", job->devname, job->configs[i].name,
+           job->values[i], job->wanted[i]);
+      job->rc = EIO;
+    }
+  }
+}
+
+static void config_one(int index, void *arg)
+{
+  struct config_ctx *ctx = (struct config_ctx *) arg;
+  struct config_job *job = ctx->jobs + index;
+  struct jbod_interface *jbod;
+  int sg_fd;
+  int i;
+
+  for (i = 0; i < CONFIG_ITEM_COUNT; ++i)
+    job->wanted[i] = -1;
+
+  jbod = detect_dev(job->devname);
+  if (jbod == NULL || jbod->get_configs == NULL) {
+    job->rc = ENODEV;
+    return;
+  }
+  sg_fd = sg_cmds_open_device(job->devname, 0 /* rw */, 0 /* not verbose */);
+  if (sg_fd < 0) {
+    job->rc = ENODEV;
+    return;
+  }
+
+  if (read_enclosure_attr(sg_fd, "sas_address", job->key, PATH_MAX) != 0)
+    snprintf(job->key, PATH_MAX, "%s", job->devname);
+  job->configs = jbod->get_configs();
+
+  /* all items, one command per buffer */
+  jbod_read_configs(sg_fd, job->configs, job->values);
+
+  if (ctx->apply) {
+    match_apply(job, ctx);
+    if (job->entry != NULL && job->rc == 0)
+      write_changed_configs(sg_fd, job);
+  }
+  sg_cmds_close_device(sg_fd);
+}
+
+static struct config_job *run_jobs(char *devnames[], int count,
+                                   int max_parallel, struct config_ctx *ctx)
+{
+  int i;
+
+  ctx->jobs = (struct config_job *) calloc(count, sizeof(struct config_job));
+  if (ctx->jobs == NULL) {
+    perr("Cannot allocate memory.\n");
+    return NULL;
+  }
+  for (i = 0; i < count; ++i)
+    ctx->jobs[i].devname = devnames[i];
+
+  run_parallel(count, max_parallel, config_one, ctx);
+  return ctx->jobs;
+}
+
+int export_configs(char *devnames[], int count, int max_parallel)
+{
+  struct config_ctx ctx = {NULL, NULL, 0};
+  struct config_job *jobs, *job;
+  json_object *root, *entry;
+  int rc = 0;
+  int i, j;
+
+  jobs = run_jobs(devnames, count, max_parallel, &ctx);
+  if (jobs == NULL)
+    return ENOMEM;
+
+  root = json_object_new_object();
+  for (i = 0; i < count; ++i) {
+    job = jobs + i;
+    if (job->rc) {
+      perr("%s is not a jbod device\n", job->devname);
+      rc = job->rc;
+      continue;
+    }
+    entry = json_object_new_object();
+    for (j = 0; j < CONFIG_ITEM_COUNT; ++j) {
+      if (job->values[j] != -1)
+        json_object_object_add(entry, job->configs[j].name,
+                               json_object_new_int(job->values[j]));
+    }
+    json_object_object_add(root, job->key, entry);
+  }
+  printf("%s\n", json_object_to_json_string_ext(root,
+                                                JSON_C_TO_STRING_PRETTY));
+  json_object_put(root);
+  free(jobs);
+  return rc;
+}
+
+int apply_configs(const char *file, char *devnames[], int count,
+                  int max_parallel)
+{
+  struct config_ctx ctx = {NULL, NULL, 1};
+  struct config_job *jobs, *job;
+  int matched;
+  int rc = 0;
+  int i;
+
+  ctx.apply = json_object_from_file(file);
+  if (ctx.apply == NULL || !json_object_is_type(ctx.apply, json_type_object)) {
+    perr("Cannot parse %s.\n", file);
+    json_object_put(ctx.apply);
+    return EINVAL;
+  }
+  /* enclosures map to objects, profile items to numbers */
+  json_object_object_foreach(ctx.apply, name, value) {
+    (void) name;
+    if (json_object_is_type(value, json_type_object))
+      ctx.for_all = 0;
+  }
+
+  jobs = run_jobs(devnames, count, max_parallel, &ctx);
+  if (jobs == NULL) {
+    json_object_put(ctx.apply);
+    return ENOMEM;
+  }
+
+  IF_PRINT_NONE_JSON printf("device\tkey\twritten\tunchanged\n");
+  for (i = 0; i < count; ++i) {
+    job = jobs + i;
+    if (job->rc == ENODEV)
+      perr("%s is not a jbod device\n", job->devname);
+    if (job->rc)
+      rc = job->rc;
+    if (job->entry == NULL)
+      continue;
+    IF_PRINT_NONE_JSON
+      printf("%s\t%s\t%d\t%d%s\n", job->devname, job->key, job->written,
+             job->unchanged, job->rc ? "\tFailed" : "");
+    PRINT_JSON_GROUP_HEADER(job->devname);
+    PRINT_JSON_ITEM("key", "%s", job->key);
+    PRINT_JSON_ITEM("rc", "%d", job->rc);
+    PRINT_JSON_ITEM("written", "%d", job->written);
+    PRINT_JSON_ITEM("unchanged", "%d", job->unchanged);
+    PRINT_JSON_GROUP_ENDING;
+  }
+
+  /* entries of the file that match no enclosure */
+  if (!ctx.for_all) {
+    json_object_object_foreach(ctx.apply, key, entry) {
+      matched = 0;
+      for (i = 0; i < count && !matched; ++i)
+        matched = jobs[i].entry == entry;
+      if (!matched) {
+        perr("No enclosure for %s.\n", key);
+        rc = ENODEV;
+      }
+    }
+  }
+
+  free(jobs);
+  json_object_put(ctx.apply);
+  return rc;
+}
@@ -0,0 +1,33 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef ENCLOSURE_CONFIG_H
+#define ENCLOSURE_CONFIG_H
+
+/* enclosures to read or write at the same time */
+#define CONFIG_DEFAULT_PARALLEL 8
+
+/*
+ * print the supported config items of devnames as one JSON object, keyed
+ * by the SAS address of each enclosure (or its devname if unknown):
+ *   {"0x500...": {"Power Window": 5, ...}, ...}
+ */
+extern int export_configs(char *devnames[], int count, int max_parallel);
+
+/*
+ * make the config of devnames match file. The file is either in the format
+ * of export_configs(), or one profile for all enclosures:
+ *   {"HDD Temperature Interval": 5}
+ * Only items that differ are written, and each enclosure is read back to
+ * verify them.
+ */
+extern int apply_configs(const char *file, char *devnames[], int count,
+                         int max_parallel);
+
+#endif
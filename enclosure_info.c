@@ -8,6 +8,7 @@
  */
 
 #include "enclosure_info.h"
+#include "ses_control.h"
 
 int extract_enclosure_control(
   unsigned char *enclosure_element,
@@ -20,17 +21,14 @@ int extract_enclosure_control(
 }
 
 int power_cycle_enclosure(
-  unsigned char *page_two,
+  struct ses_txn *txn,
   struct enclosure_control *enclosurep)
 {
+  const unsigned char and_mask[SES_ELEMENT_SIZE] = {0xf0, 0xff, 0, 0};
+  const unsigned char or_mask[SES_ELEMENT_SIZE] = {0x80, 0, 0x40, 0x04};
 
   printf("Page 2 offset %d\n", enclosurep->page_two_offset);
 
-  page_two[enclosurep->page_two_offset] &= 0xf0;
-  page_two[enclosurep->page_two_offset] |= 0x80;
-
-  page_two[enclosurep->page_two_offset + 2] = 0x40;
-  page_two[enclosurep->page_two_offset + 3] = 0x04;
-
-  return 0;
+  return ses_txn_element(txn, enclosurep->page_two_offset,
+                         and_mask, or_mask);
 }
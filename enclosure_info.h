@@ -16,6 +16,8 @@
 
 #include "common.h"
 
+struct ses_txn;
+
 struct enclosure_descriptor {
   SAS_ADDR(sas_addr);
   SAS_ADDR_STR(sas_addr_str);
@@ -34,7 +36,7 @@ extern int extract_enclosure_control(
   struct enclosure_control *enclosurep);
 
 extern int power_cycle_enclosure(
-  unsigned char *page_two,
+  struct ses_txn *txn,
   struct enclosure_control *enclosurep);
 
 #endif
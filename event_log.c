@@ -0,0 +1,285 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <scsi/sg_lib.h>
+#include <scsi/sg_cmds.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "enclosure_cache.h"
+#include "event_log.h"
+#include "json.h"
+#include "scsi_buffer.h"
+
+#define EVENT_LOG_READ_MODE 2
+#define EVENT_LOG_KEY_LENGTH 32
+
+/* the newest event printed so far; slot is -1 if its position is unknown */
+struct event_log_cursor {
+  int slot;
+  int id;
+  long long timestamp;
+};
+
+struct slotted_record {
+  int slot;
+  struct event_record r;
+};
+
+static unsigned long long little_endian(unsigned char *p, int len)
+{
+  unsigned long long v = 0;
+  int i;
+
+  for (i = len - 1; i >= 0; --i)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+static void decode_record(unsigned char *p, struct event_record *r)
+{
+  r->timestamp = (long long) little_endian(p, 8);
+  r->id = little_endian(p + 12, 2);
+  r->code = little_endian(p + 14, 2);
+  r->data = little_endian(p + 16, 4);
+  memcpy(r->description, p + EVENT_LOG_DESCRIPTION_OFFSET,
+         EVENT_LOG_DESCRIPTION_LENGTH);
+  r->description[EVENT_LOG_DESCRIPTION_LENGTH] = '\0';
+  fix_none_ascii(r->description, strlen(r->description));
+}
+
+/* unused records are all zeros, or all ones after an erase */
+static int record_empty(struct event_record *r)
+{
+  return r->timestamp == 0 || r->timestamp == -1;
+}
+
+static int record_newer(struct event_record *r, struct event_log_cursor *c)
+{
+  return r->timestamp > c->timestamp ||
+         (r->timestamp == c->timestamp && r->id > c->id);
+}
+
+static int compare_events(const void *a, const void *b)
+{
+  const struct event_record *ra = (const struct event_record *) a;
+  const struct event_record *rb = (const struct event_record *) b;
+
+  if (ra->timestamp != rb->timestamp)
+    return ra->timestamp < rb->timestamp ? -1 : 1;
+  return ra->id - rb->id;
+}
+
+static int compare_records(const void *a, const void *b)
+{
+  return compare_events(&((const struct slotted_record *) a)->r,
+                        &((const struct slotted_record *) b)->r);
+}
+
+/* read count records starting at slot first with one command */
+static int read_records(int sg_fd, int buffer_id, int first, int count,
+                        unsigned char *buf)
+{
+  return sg_ll_read_buffer(sg_fd, EVENT_LOG_READ_MODE, buffer_id,
+                           first * EVENT_LOG_RECORD_LENGTH, (void *) buf,
+                           count * EVENT_LOG_RECORD_LENGTH,
+                           1 /* noisy */, 0 /* not verbose */) == 0 ? 0 : EIO;
+}
+
+int read_event_log(int sg_fd, int buffer_id,
+                   struct event_record records[EVENT_LOG_RECORD_COUNT])
+{
+  unsigned char buf[EVENT_LOG_BUFFER_SIZE];
+  int count = 0;
+  int i;
+
+  memset(buf, 0, sizeof(buf));
+  if (read_records(sg_fd, buffer_id, 0, EVENT_LOG_RECORD_COUNT, buf) != 0)
+    return -1;
+  for (i = 0; i < EVENT_LOG_RECORD_COUNT; ++i) {
+    decode_record(buf + i * EVENT_LOG_RECORD_LENGTH, records + count);
+    if (!record_empty(records + count))
+      ++count;
+  }
+  qsort(records, count, sizeof(struct event_record), compare_events);
+  return count;
+}
+
+void print_event_log(int sg_fd, int buffer_id)
+{
+  unsigned char buf[EVENT_LOG_BUFFER_SIZE];
+  struct event_record r;
+  char id_str[16];
+  int count = EVENT_LOG_RECORD_COUNT;
+  int i;
+
+  memset(buf, 0, sizeof(buf));
+  if (read_records(sg_fd, buffer_id, 0, count, buf) != 0) {
+    perr("Failed to read event log.\n");
+    return;
+  }
+
+  for (i = 0; i < count; ++i) {
+    decode_record(buf + i * EVENT_LOG_RECORD_LENGTH, &r);
+    IF_PRINT_NONE_JSON
+      printf("[%11lld][Event %d] %d %x %s\n", r.timestamp, r.id, r.code,
+             r.data, r.description);
+
+    snprintf(id_str, 16, "%d", r.id);
+    PRINT_JSON_GROUP_HEADER(id_str);
+    PRINT_JSON_ITEM("timestamp", "%lld", r.timestamp);
+    PRINT_JSON_ITEM("id", "%d", r.id);
+    PRINT_JSON_ITEM("description", "%s", r.description);
+    PRINT_JSON_GROUP_ENDING;
+  }
+}
+
+static void print_event_line(const char *devname, int slot,
+                             struct event_record *r)
+{
+  json_record_begin();
+  json_item("device", "%s", devname);
+  json_item("slot", "%d", slot);
+  json_item("timestamp", "%lld", r->timestamp);
+  json_item("id", "%d", r->id);
+  json_item("code", "%d", r->code);
+  json_item("data", "0x%x", r->data);
+  json_item("description", "%s", r->description);
+  json_record_end();
+}
+
+static void advance_cursor(struct event_log_cursor *c, int slot,
+                           struct event_record *r)
+{
+  c->slot = slot;
+  c->id = r->id;
+  c->timestamp = r->timestamp;
+}
+
+/*
+ * read forward from the remembered record, a chunk at a time, and stop at
+ * the first record that is not newer. Return ESTALE, before printing
+ * anything, if the remembered record is no longer where it was.
+ */
+static int print_after_cursor(int sg_fd, const char *devname, int buffer_id,
+                              int count, struct event_log_cursor *cursor)
+{
+  unsigned char buf[EVENT_LOG_CHUNK_RECORDS * EVENT_LOG_RECORD_LENGTH];
+  struct event_record r;
+  int slot = cursor->slot;
+  int anchored = 0;
+  int seen = 0;
+  int chunk;
+  int i;
+
+  while (seen < count) {
+    chunk = count - slot < EVENT_LOG_CHUNK_RECORDS ?
+      count - slot : EVENT_LOG_CHUNK_RECORDS;
+    if (read_records(sg_fd, buffer_id, slot, chunk, buf) != 0)
+      return anchored ? EIO : ESTALE;
+    for (i = 0; i < chunk; ++i, ++seen) {
+      decode_record(buf + i * EVENT_LOG_RECORD_LENGTH, &r);
+      if (!anchored) {
+        if (r.timestamp != cursor->timestamp || r.id != cursor->id)
+          return ESTALE;
+        anchored = 1;
+        continue;
+      }
+      if (record_empty(&r) || !record_newer(&r, cursor))
+        return 0;
+      print_event_line(devname, slot + i, &r);
+      advance_cursor(cursor, slot + i, &r);
+    }
+    slot = (slot + chunk) % count;
+  }
+  return 0;
+}
+
+/* read the whole log, and print the records newer than cursor in order */
+static int print_all_newer(int sg_fd, const char *devname, int buffer_id,
+                           int count, struct event_log_cursor *cursor)
+{
+  unsigned char buf[EVENT_LOG_BUFFER_SIZE];
+  struct slotted_record records[EVENT_LOG_RECORD_COUNT];
+  struct slotted_record *sr;
+  int new_count = 0;
+  int i;
+
+  if (read_records(sg_fd, buffer_id, 0, count, buf) != 0)
+    return EIO;
+
+  for (i = 0; i < count; ++i) {
+    sr = records + new_count;
+    decode_record(buf + i * EVENT_LOG_RECORD_LENGTH, &sr->r);
+    if (record_empty(&sr->r))
+      continue;
+    if (sr->r.timestamp == cursor->timestamp && sr->r.id == cursor->id)
+      cursor->slot = i;
+    else if (record_newer(&sr->r, cursor))
+      records[new_count++].slot = i;
+  }
+
+  qsort(records, new_count, sizeof(records[0]), compare_records);
+  for (i = 0; i < new_count; ++i) {
+    print_event_line(devname, records[i].slot, &records[i].r);
+    advance_cursor(cursor, records[i].slot, &records[i].r);
+  }
+  return 0;
+}
+
+int print_new_events(int sg_fd, const char *devname, int buffer_id)
+{
+  struct enclosure_cache *cache;
+  struct scsi_buffer_geometry geometry;
+  struct event_log_cursor cursor = {-1, -1, -1};
+  char key[EVENT_LOG_KEY_LENGTH];
+  char value[ENCLOSURE_CACHE_VALUE_LENGTH];
+  const char *cached;
+  int count = EVENT_LOG_RECORD_COUNT;
+  int ret = ESTALE;
+
+  cache = (struct enclosure_cache *) malloc(sizeof(struct enclosure_cache));
+  if (cache == NULL)
+    return ENOMEM;
+  if (enclosure_cache_open(sg_fd, cache) != 0)
+    perr("Cannot remember events of %s, printing all.\n", devname);
+
+  snprintf(key, EVENT_LOG_KEY_LENGTH, "event_log_0x%02x", buffer_id);
+  cached = enclosure_cache_get(cache, key);
+  if (cached == NULL ||
+      sscanf(cached, "%d %d %lld", &cursor.slot, &cursor.id,
+             &cursor.timestamp) != 3) {
+    cursor.slot = -1;
+    cursor.id = -1;
+    cursor.timestamp = -1;
+  }
+
+  /* records can only be read from where the buffer allows an offset */
+  scsi_buffer_cached_geometry(sg_fd, cache, buffer_id, &geometry);
+
+  if (cursor.slot >= 0 && cursor.slot < count &&
+      (geometry.offset_boundary < 0 ||
+       (geometry.offset_boundary > 0 &&
+        EVENT_LOG_RECORD_LENGTH % geometry.offset_boundary == 0)))
+    ret = print_after_cursor(sg_fd, devname, buffer_id, count, &cursor);
+  if (ret == ESTALE) {
+    cursor.slot = -1;
+    ret = print_all_newer(sg_fd, devname, buffer_id, count, &cursor);
+  }
+
+  snprintf(value, ENCLOSURE_CACHE_VALUE_LENGTH, "%d %d %lld",
+           cursor.slot, cursor.id, cursor.timestamp);
+  enclosure_cache_set(cache, key, value);
+  enclosure_cache_save(cache);
+  free(cache);
+  return ret;
+}
@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+/*
+ * The event log buffer is a ring of 64-byte records, read with READ BUFFER
+ * mode 2. Each record holds a little-endian timestamp at byte 0, event id
+ * at 12, event code at 14, data at 16 and a description from byte 24.
+ */
+#define EVENT_LOG_BUFFER_ID           0xe5
+#define EVENT_LOG_BUFFER_SIZE         8192
+#define EVENT_LOG_RECORD_LENGTH       64
+#define EVENT_LOG_RECORD_COUNT \
+  (EVENT_LOG_BUFFER_SIZE / EVENT_LOG_RECORD_LENGTH)
+#define EVENT_LOG_DESCRIPTION_OFFSET  24
+#define EVENT_LOG_DESCRIPTION_LENGTH \
+  (EVENT_LOG_RECORD_LENGTH - EVENT_LOG_DESCRIPTION_OFFSET)
+
+/* records read per command while looking for new events */
+#define EVENT_LOG_CHUNK_RECORDS       8
+
+/* how often event --log --new --watch looks for new events */
+#define EVENT_LOG_WATCH_INTERVAL_MS   10000
+
+struct event_record {
+  long long timestamp;
+  int id;
+  int code;
+  unsigned int data;
+  char description[EVENT_LOG_DESCRIPTION_LENGTH + 1];
+};
+
+/*
+ * read the whole log into records, the used ones only, oldest first;
+ * return their count, or -1 if the log cannot be read
+ */
+extern int read_event_log(int sg_fd, int buffer_id,
+                          struct event_record records[EVENT_LOG_RECORD_COUNT]);
+
+/* read the whole log and print every record */
+extern void print_event_log(int sg_fd, int buffer_id);
+
+/*
+ * print the events logged since the previous call on the same expander as
+ * one NDJSON line each, oldest first, and remember the newest one. Only
+ * the records after the remembered one are read, unless the log was
+ * cleared or wrapped past it.
+ */
+extern int print_new_events(int sg_fd, const char *devname, int buffer_id);
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "enclosure_cache.h"
+#include "event_status.h"
+#include "json.h"
+
+#define EVENT_STATUS_KEY_LENGTH 32
+
+#define BIT_GET(set, i) (((set)[(i) / 8] >> ((i) % 8)) & 1)
+#define BIT_SET(set, i) ((set)[(i) / 8] |= 1 << ((i) % 8))
+
+void event_status_snapshot(const unsigned char *buf, int length,
+                           const char *const (*descriptions)[3],
+                           struct event_status_snapshot *snapshot)
+{
+  int i;
+
+  memset(snapshot, 0, sizeof(*snapshot));
+  snapshot->count = length < EVENT_STATUS_MAX_COUNT ?
+    length : EVENT_STATUS_MAX_COUNT;
+  for (i = 0; i < snapshot->count; ++i) {
+    if (descriptions[i][0] == NULL || buf[i] > 1)
+      continue;
+    BIT_SET(snapshot->valid, i);
+    if (buf[i])
+      BIT_SET(snapshot->on, i);
+  }
+}
+
+static void bitset_to_hex(const unsigned char *set, char *hex)
+{
+  int i;
+
+  for (i = 0; i < EVENT_STATUS_BITSET_BYTES; ++i)
+    sprintf(hex + i * 2, "%02x", set[i]);
+}
+
+static int hex_to_bitset(const char *hex, unsigned char *set)
+{
+  unsigned int byte;
+  int i;
+
+  if (strlen(hex) != EVENT_STATUS_BITSET_BYTES * 2)
+    return -1;
+  for (i = 0; i < EVENT_STATUS_BITSET_BYTES; ++i) {
+    if (sscanf(hex + i * 2, "%2x", &byte) != 1)
+      return -1;
+    set[i] = byte;
+  }
+  return 0;
+}
+
+/* cached as "count valid on", the bitsets in hex */
+static int load_snapshot(struct enclosure_cache *cache, const char *key,
+                         struct event_status_snapshot *snapshot)
+{
+  char valid[EVENT_STATUS_BITSET_BYTES * 2 + 1];
+  char on[EVENT_STATUS_BITSET_BYTES * 2 + 1];
+  const char *cached;
+
+  memset(snapshot, 0, sizeof(*snapshot));
+  cached = enclosure_cache_get(cache, key);
+  if (cached == NULL ||
+      sscanf(cached, "%d %32s %32s", &snapshot->count, valid, on) != 3 ||
+      hex_to_bitset(valid, snapshot->valid) != 0 ||
+      hex_to_bitset(on, snapshot->on) != 0) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    return -1;
+  }
+  return 0;
+}
+
+static void save_snapshot(struct enclosure_cache *cache, const char *key,
+                          struct event_status_snapshot *snapshot)
+{
+  char value[ENCLOSURE_CACHE_VALUE_LENGTH];
+  char valid[EVENT_STATUS_BITSET_BYTES * 2 + 1];
+  char on[EVENT_STATUS_BITSET_BYTES * 2 + 1];
+
+  bitset_to_hex(snapshot->valid, valid);
+  bitset_to_hex(snapshot->on, on);
+  snprintf(value, ENCLOSURE_CACHE_VALUE_LENGTH, "%d %s %s",
+           snapshot->count, valid, on);
+  enclosure_cache_set(cache, key, value);
+}
+
+int print_event_status_changes(int sg_fd, const char *devname,
+                               int buffer_id, const unsigned char *buf,
+                               int length,
+                               const char *const (*descriptions)[3])
+{
+  struct enclosure_cache *cache;
+  struct event_status_snapshot old_snapshot;
+  struct event_status_snapshot new_snapshot;
+  char key[EVENT_STATUS_KEY_LENGTH];
+  const char *from;
+  const char *to;
+  int changes = 0;
+  int i;
+
+  cache = (struct enclosure_cache *) malloc(sizeof(struct enclosure_cache));
+  if (cache == NULL)
+    return 0;
+  if (enclosure_cache_open(sg_fd, cache) != 0)
+    perr("Cannot remember event status of %s.\n", devname);
+
+  snprintf(key, EVENT_STATUS_KEY_LENGTH, "event_status_0x%02x", buffer_id);
+  load_snapshot(cache, key, &old_snapshot);
+  event_status_snapshot(buf, length, descriptions, &new_snapshot);
+
+  /* compare whole bytes first; most of them never change */
+  for (i = 0; i < new_snapshot.count; ++i) {
+    if (i % 8 == 0 &&
+        old_snapshot.valid[i / 8] == new_snapshot.valid[i / 8] &&
+        old_snapshot.on[i / 8] == new_snapshot.on[i / 8]) {
+      i += 7;
+      continue;
+    }
+    if (!BIT_GET(new_snapshot.valid, i))
+      continue;
+    if (BIT_GET(old_snapshot.valid, i)) {
+      if (BIT_GET(old_snapshot.on, i) == BIT_GET(new_snapshot.on, i))
+        continue;
+      from = descriptions[i][BIT_GET(old_snapshot.on, i) + 1];
+    } else {
+      if (!BIT_GET(new_snapshot.on, i))
+        continue;
+      from = "Unknown";
+    }
+    to = descriptions[i][BIT_GET(new_snapshot.on, i) + 1];
+
+    IF_PRINT_NONE_JSON
+      printf("%s\t%s:\t%s -> %s\n", devname, descriptions[i][0], from, to);
+
+    PRINT_JSON_GROUP_HEADER(descriptions[i][0]);
+    PRINT_JSON_ITEM("name", "%s", descriptions[i][0]);
+    PRINT_JSON_ITEM("from", "%s", from);
+    PRINT_JSON_ITEM("status", "%s", to);
+    PRINT_JSON_ITEM("value", "%d", BIT_GET(new_snapshot.on, i));
+    PRINT_JSON_GROUP_ENDING;
+    ++changes;
+  }
+
+  save_snapshot(cache, key, &new_snapshot);
+  enclosure_cache_save(cache);
+  free(cache);
+  return changes;
+}
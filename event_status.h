@@ -0,0 +1,42 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef EVENT_STATUS_H
+#define EVENT_STATUS_H
+
+/* the event status buffer holds one byte per event, 0 for Off, 1 for On */
+#define EVENT_STATUS_MAX_COUNT      128
+#define EVENT_STATUS_BITSET_BYTES   (EVENT_STATUS_MAX_COUNT / 8)
+
+/*
+ * one bit per event. valid marks events that are described and read as
+ * Off or On; on holds their values.
+ */
+struct event_status_snapshot {
+  int count;
+  unsigned char valid[EVENT_STATUS_BITSET_BYTES];
+  unsigned char on[EVENT_STATUS_BITSET_BYTES];
+};
+
+extern void event_status_snapshot(const unsigned char *buf, int length,
+                                  const char *const (*descriptions)[3],
+                                  struct event_status_snapshot *snapshot);
+
+/*
+ * print the events of buf that changed since the snapshot saved by the
+ * previous call on the same expander, and save the new snapshot. Without
+ * a previous snapshot, events that are On are printed. Return the number
+ * of events printed.
+ */
+extern int print_event_status_changes(int sg_fd, const char *devname,
+                                      int buffer_id, const unsigned char *buf,
+                                      int length,
+                                      const char *const (*descriptions)[3]);
+
+#endif
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <scsi/sg_lib.h>
+#include <scsi/sg_cmds.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include "hdd_led.h"
+#include "jbod_interface.h"
+#include "parallel.h"
+
+int parse_slot_list(const char *str, int *slots, int max)
+{
+  const char *p = str;
+  char *end;
+  long first, last;
+  int count = 0;
+
+  for (;;) {
+    if (!isdigit((unsigned char) *p))
+      return -1;
+    first = last = strtol(p, &end, 10);
+    p = end;
+    if (*p == '-') {
+      ++p;
+      if (!isdigit((unsigned char) *p))
+        return -1;
+      last = strtol(p, &end, 10);
+      p = end;
+    }
+    if (last < first)
+      return -1;
+    for (; first <= last; ++first) {
+      if (count >= max)
+        return -1;
+      slots[count++] = (int) first;
+    }
+    if (*p == '\0')
+      return count;
+    if (*p != ',')
+      return -1;
+    ++p;
+  }
+}
+
+int add_hdd_led_changes(struct hdd_led_request *request,
+                        const char *slot_list, int led, int op)
+{
+  int slots[HDD_LED_MAX_CHANGES];
+  struct hdd_led_change *change;
+  int count;
+  int i;
+
+  count = parse_slot_list(slot_list, slots, HDD_LED_MAX_CHANGES);
+  if (count < 0)
+    return EINVAL;
+  if (request->change_count + count > HDD_LED_MAX_CHANGES)
+    return E2BIG;
+
+  for (i = 0; i < count; ++i) {
+    change = request->changes + request->change_count++;
+    change->slot = slots[i];
+    change->led = led;
+    change->op = op;
+  }
+  return 0;
+}
+
+static void hdd_led_control_one(int index, void *arg)
+{
+  struct hdd_led_request *request = (struct hdd_led_request *) arg + index;
+  struct jbod_interface *jbod;
+  int sg_fd;
+
+  jbod = detect_dev(request->devname);
+  if (jbod == NULL) {
+    request->rc = ENODEV;
+    return;
+  }
+
+  sg_fd = sg_cmds_open_device(request->devname, 0 /* rw */,
+                              0 /* not verbose */);
+  if (sg_fd < 0) {
+    request->rc = ENODEV;
+    return;
+  }
+  request->rc = jbod->hdd_leds_control(sg_fd, request->changes,
+                                       request->change_count);
+  sg_cmds_close_device(sg_fd);
+}
+
+void hdd_led_control_enclosures(struct hdd_led_request *requests,
+                                int count, int max_parallel)
+{
+  run_parallel(count, max_parallel, hdd_led_control_one, requests);
+}
@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef HDD_LED_H
+#define HDD_LED_H
+
+#include <limits.h>
+#include "array_device_slot.h"
+
+/* LED changes that can be queued for one enclosure */
+#define HDD_LED_MAX_CHANGES 256
+
+/* enclosures to update at the same time */
+#define HDD_LED_DEFAULT_PARALLEL 8
+
+/* all LED changes of one enclosure, applied with one page 0x02 write */
+struct hdd_led_request {
+  char devname[PATH_MAX];
+  struct hdd_led_change changes[HDD_LED_MAX_CHANGES];
+  int change_count;
+  int rc;
+};
+
+/*
+ * parse a slot list like "1,3,5-7" into slots[];
+ * return the number of slots, or -1 if the list is malformed or too long
+ */
+extern int parse_slot_list(const char *str, int *slots, int max);
+
+/*
+ * queue op for led of every slot in slot_list;
+ * return 0 on success, or EINVAL/E2BIG
+ */
+extern int add_hdd_led_changes(struct hdd_led_request *request,
+                               const char *slot_list, int led, int op);
+
+/* apply requests to their enclosures, up to max_parallel at a time */
+extern void hdd_led_control_enclosures(struct hdd_led_request *requests,
+                                       int count, int max_parallel);
+
+#endif
@@ -0,0 +1,1071 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <scsi/sg_lib.h>
+#include <scsi/sg_cmds.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "enclosure_cache.h"
+#include "history.h"
+#include "jbod_interface.h"
+#include "json.h"
+#include "parallel.h"
+#include "scsi_buffer.h"
+#include "ses.h"
+
+/* the longest record: two varints, and three per series */
+#define HISTORY_MAX_RECORD (20 + HISTORY_MAX_SERIES * 30)
+
+#define HISTORY_SERIES_TYPES (HISTORY_POWER + 1)
+
+static const char *const resolution_names[HISTORY_RESOLUTIONS] = {
+  "1s", "1m", "1h"};
+static const int64_t resolution_ms[HISTORY_RESOLUTIONS] = {
+  1000, 60 * 1000, 60 * 60 * 1000};
+static const uint32_t ring_blocks[HISTORY_RESOLUTIONS] = {2048, 256, 128};
+
+static const char *const series_types[HISTORY_SERIES_TYPES] = {
+  "temperature", "voltage", "current", "fan", "power"};
+static const char *const series_units[HISTORY_SERIES_TYPES] = {
+  "C", "V", "A", "RPM", "W"};
+/* voltages and currents are kept in hundredths */
+static const int series_scale[HISTORY_SERIES_TYPES] = {1, 100, 100, 1, 1};
+
+/* one reading of every series of an enclosure */
+struct history_sample {
+  int64_t time_ms;
+  int count;
+  struct history_series series[HISTORY_MAX_SERIES];
+  int64_t values[HISTORY_MAX_SERIES];
+};
+
+/* samples folded into one bucket of a resolution */
+struct history_bucket {
+  int64_t start_ms;
+  int64_t count;
+  int64_t min[HISTORY_MAX_SERIES];
+  int64_t max[HISTORY_MAX_SERIES];
+  int64_t sum[HISTORY_MAX_SERIES];
+};
+
+/* a closed bucket, as appended or decoded */
+struct history_record {
+  int64_t start_ms;
+  int64_t count;
+  int64_t min[HISTORY_MAX_SERIES];
+  int64_t max[HISTORY_MAX_SERIES];
+  int64_t mean[HISTORY_MAX_SERIES];
+};
+
+struct history_file {
+  int fd;
+  int lock_fd;                      /* of the recorder, else -1 */
+  size_t size;
+  unsigned char *base;
+  struct history_header *header;
+
+  /* the state of the recorder, per resolution */
+  struct history_bucket buckets[HISTORY_RESOLUTIONS];
+  int64_t prev_ms[HISTORY_RESOLUTIONS];
+  int64_t prev_min[HISTORY_RESOLUTIONS][HISTORY_MAX_SERIES];
+  int started[HISTORY_RESOLUTIONS];   /* a block was started since open */
+};
+
+struct record_job {
+  char *devname;
+  struct history_file *file;        /* NULL until the first sample */
+  int busy;                         /* recorded by another process */
+  struct history_sample *sample;
+};
+
+/* what a query found in one series, or in all of them */
+struct history_summary {
+  int series_count;
+  int64_t records;
+  int64_t samples;
+  int64_t first_ms;
+  int64_t last_ms;
+  int64_t min[HISTORY_MAX_SERIES];
+  int64_t max[HISTORY_MAX_SERIES];
+  double sum[HISTORY_MAX_SERIES];     /* of means, weighted by samples */
+};
+
+struct history_point {
+  const struct history_series *series;
+  int index;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static int64_t now_ms(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static int64_t round_value(double value)
+{
+  return (int64_t) (value < 0 ? value - 0.5 : value + 0.5);
+}
+
+static int put_varint(unsigned char *out, uint64_t value)
+{
+  int len = 0;
+
+  while (value >= 0x80) {
+    out[len++] = (unsigned char) (value | 0x80);
+    value >>= 7;
+  }
+  out[len++] = (unsigned char) value;
+  return len;
+}
+
+/* return the bytes taken, or 0 if the varint is cut short */
+static int get_varint(const unsigned char *in, const unsigned char *end,
+                      uint64_t *value)
+{
+  int shift = 0;
+  int len = 0;
+
+  *value = 0;
+  while (in + len < end && shift < 64) {
+    *value |= (uint64_t) (in[len] & 0x7f) << shift;
+    if ((in[len++] & 0x80) == 0)
+      return len;
+    shift += 7;
+  }
+  return 0;
+}
+
+static uint64_t zigzag(int64_t value)
+{
+  return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+  return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+static size_t header_area(void)
+{
+  return (sizeof(struct history_header) + HISTORY_BLOCK_SIZE - 1) /
+    HISTORY_BLOCK_SIZE * HISTORY_BLOCK_SIZE;
+}
+
+static size_t history_size(void)
+{
+  size_t size = header_area();
+  int r;
+
+  for (r = 0; r < HISTORY_RESOLUTIONS; ++r)
+    size += (size_t) ring_blocks[r] * HISTORY_BLOCK_SIZE;
+  return size;
+}
+
+static struct history_block *block_of(struct history_file *file, int r,
+                                      uint32_t index)
+{
+  return (struct history_block *) (file->base +
+    file->header->rings[r].offset + (size_t) index * HISTORY_BLOCK_SIZE);
+}
+
+static struct history_file *map_history(int fd, size_t size, int prot)
+{
+  struct history_file *file;
+  void *base;
+
+  base = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED)
+    return NULL;
+  file = (struct history_file *) calloc(1, sizeof(struct history_file));
+  if (file == NULL) {
+    munmap(base, size);
+    return NULL;
+  }
+  file->fd = fd;
+  file->lock_fd = -1;
+  file->size = size;
+  file->base = (unsigned char *) base;
+  file->header = (struct history_header *) base;
+  return file;
+}
+
+static void unmap_history(struct history_file *file)
+{
+  munmap(file->base, file->size);
+  close(file->fd);
+  if (file->lock_fd >= 0)
+    close(file->lock_fd);
+  free(file);
+}
+
+static void copy_name(char *dst, size_t size, const char *src)
+{
+  snprintf(dst, size, "%s", src ? src : "");
+}
+
+/* like mkdir -p */
+static void make_dirs(const char *path)
+{
+  char dir[PATH_MAX];
+  char *slash;
+
+  copy_name(dir, sizeof(dir), path);
+  for (slash = strchr(dir + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    mkdir(dir, 0755);
+    *slash = '/';
+  }
+  mkdir(dir, 0755);
+}
+
+static int same_series(const struct history_header *header,
+                       const struct history_sample *sample)
+{
+  int i;
+
+  if (header->series_count != sample->count)
+    return 0;
+  for (i = 0; i < sample->count; ++i) {
+    if (header->series[i].type != sample->series[i].type ||
+        strncmp(header->series[i].name, sample->series[i].name,
+                HISTORY_NAME_LENGTH) != 0)
+      return 0;
+  }
+  return 1;
+}
+
+static int valid_layout(const struct history_header *header, size_t size)
+{
+  size_t offset = header_area();
+  int r;
+
+  if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != HISTORY_MAGIC ||
+      header->version != HISTORY_VERSION ||
+      header->block_size != HISTORY_BLOCK_SIZE ||
+      header->series_count > HISTORY_MAX_SERIES)
+    return 0;
+  for (r = 0; r < HISTORY_RESOLUTIONS; ++r) {
+    if (header->rings[r].resolution_ms != resolution_ms[r] ||
+        header->rings[r].blocks != ring_blocks[r] ||
+        header->rings[r].offset != offset)
+      return 0;
+    offset += (size_t) ring_blocks[r] * HISTORY_BLOCK_SIZE;
+  }
+  for (r = 0; r < header->series_count; ++r) {
+    if (header->series[r].type >= HISTORY_SERIES_TYPES)
+      return 0;
+  }
+  return offset <= size;
+}
+
+/*
+ * a new file for the series of sample; it replaces path once it is
+ * complete, so queries never see a partial header
+ */
+static struct history_file *create_history(const char *path,
+                                           const char *devname,
+                                           const char *sas_addr,
+                                           const struct history_sample *sample)
+{
+  struct history_file *file;
+  struct history_header *header;
+  char tmp[PATH_MAX];
+  size_t offset;
+  int fd, r;
+
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  unlink(tmp);
+  fd = open(tmp, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    perr("Cannot create %s: %s\n", tmp, strerror(errno));
+    return NULL;
+  }
+  /* sparse; blocks take space once they are written */
+  if (ftruncate(fd, history_size()) != 0 ||
+      (file = map_history(fd, history_size(),
+                          PROT_READ | PROT_WRITE)) == NULL) {
+    perr("Cannot map %s: %s\n", tmp, strerror(errno));
+    close(fd);
+    unlink(tmp);
+    return NULL;
+  }
+
+  header = file->header;
+  header->version = HISTORY_VERSION;
+  header->block_size = HISTORY_BLOCK_SIZE;
+  header->series_count = sample->count;
+  copy_name(header->devname, sizeof(header->devname), devname);
+  copy_name(header->sas_addr, sizeof(header->sas_addr), sas_addr);
+  offset = header_area();
+  for (r = 0; r < HISTORY_RESOLUTIONS; ++r) {
+    header->rings[r].head = 0;
+    header->rings[r].blocks = ring_blocks[r];
+    header->rings[r].resolution_ms = resolution_ms[r];
+    header->rings[r].offset = offset;
+    offset += (size_t) ring_blocks[r] * HISTORY_BLOCK_SIZE;
+  }
+  memcpy(header->series, sample->series,
+         sample->count * sizeof(struct history_series));
+  __atomic_store_n(&header->magic, HISTORY_MAGIC, __ATOMIC_RELEASE);
+
+  if (rename(tmp, path) != 0) {
+    perr("Cannot rename %s to %s: %s\n", tmp, path, strerror(errno));
+    unmap_history(file);
+    unlink(tmp);
+    return NULL;
+  }
+  return file;
+}
+
+/*
+ * one recorder per enclosure: two would append to the same rings, each
+ * from its own deltas, and the records would not decode. The lock is on a
+ * file of its own, as the history file is replaced when it is created.
+ */
+static int lock_recorder(const char *devname, const char *sas_addr)
+{
+  char path[PATH_MAX];
+  int fd;
+
+  snprintf(path, sizeof(path), "%s/%s.lock", HISTORY_DIR, sas_addr);
+  fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    perr("Cannot open %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    if (errno == EWOULDBLOCK) {
+      perr("%s is recorded by another process already.\n", devname);
+      close(fd);
+      errno = EBUSY;
+    } else {
+      perr("Cannot lock %s: %s\n", path, strerror(errno));
+      close(fd);
+    }
+    return -1;
+  }
+  return fd;
+}
+
+/*
+ * the file of an enclosure, appended to if it has the same series; return
+ * NULL with errno EBUSY if another process records it
+ */
+static struct history_file *open_recorder(const char *devname,
+                                          const char *sas_addr,
+                                          const struct history_sample *sample)
+{
+  struct history_file *file = NULL;
+  char path[PATH_MAX];
+  struct stat st;
+  int lock_fd;
+  int fd;
+
+  lock_fd = lock_recorder(devname, sas_addr);
+  if (lock_fd < 0)
+    return NULL;
+
+  snprintf(path, sizeof(path), "%s/%s", HISTORY_DIR, sas_addr);
+  fd = open(path, O_RDWR | O_CLOEXEC);
+  if (fd >= 0) {
+    if (fstat(fd, &st) == 0 && st.st_size == history_size())
+      file = map_history(fd, history_size(), PROT_READ | PROT_WRITE);
+    if (file == NULL) {
+      close(fd);
+    } else if (!valid_layout(file->header, file->size) ||
+               !same_series(file->header, sample)) {
+      unmap_history(file);
+      file = NULL;
+    }
+  }
+  if (file == NULL)
+    file = create_history(path, devname, sas_addr, sample);
+  else  /* the devname may have changed since */
+    copy_name(file->header->devname, sizeof(file->header->devname), devname);
+  if (file == NULL) {
+    close(lock_fd);
+    return NULL;
+  }
+  file->lock_fd = lock_fd;
+  return file;
+}
+
+/* recycle the next block of ring r; queries drop a block they copy meanwhile */
+static struct history_block *start_block(struct history_file *file, int r,
+                                         int64_t first_ms)
+{
+  struct history_ring *ring = file->header->rings + r;
+  uint32_t next = (ring->head + 1) % ring->blocks;
+  struct history_block *block = block_of(file, r, next);
+  uint32_t seq = block->seq;
+
+  __atomic_store_n(&block->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  block->used = 0;
+  block->first_ms = first_ms;
+  __atomic_store_n(&block->seq, seq + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->head, next, __ATOMIC_RELEASE);
+
+  file->prev_ms[r] = first_ms;
+  memset(file->prev_min[r], 0, sizeof(file->prev_min[r]));
+  file->started[r] = 1;
+  return block;
+}
+
+static int encode_record(struct history_file *file, int r,
+                         const struct history_record *record,
+                         unsigned char *out)
+{
+  int len = 0;
+  int i;
+
+  len += put_varint(out + len, zigzag(record->start_ms - file->prev_ms[r]));
+  len += put_varint(out + len, record->count);
+  for (i = 0; i < file->header->series_count; ++i) {
+    len += put_varint(out + len,
+                      zigzag(record->min[i] - file->prev_min[r][i]));
+    len += put_varint(out + len, record->max[i] - record->min[i]);
+    len += put_varint(out + len, record->mean[i] - record->min[i]);
+  }
+  return len;
+}
+
+static void append_record(struct history_file *file, int r,
+                          const struct history_record *record)
+{
+  unsigned char buf[HISTORY_MAX_RECORD];
+  struct history_block *block;
+  int len;
+
+  if (file->started[r])
+    block = block_of(file, r, file->header->rings[r].head);
+  else
+    block = start_block(file, r, record->start_ms);
+  len = encode_record(file, r, record, buf);
+  if (block->used + len > sizeof(block->data)) {
+    block = start_block(file, r, record->start_ms);
+    len = encode_record(file, r, record, buf);
+  }
+
+  memcpy(block->data + block->used, buf, len);
+  __atomic_store_n(&block->used, block->used + len, __ATOMIC_RELEASE);
+  file->prev_ms[r] = record->start_ms;
+  memcpy(file->prev_min[r], record->min,
+         file->header->series_count * sizeof(int64_t));
+}
+
+static void flush_bucket(struct history_file *file, int r)
+{
+  struct history_bucket *bucket = file->buckets + r;
+  struct history_record *record;
+  int i;
+
+  if (bucket->count == 0)
+    return;
+  record = (struct history_record *) malloc(sizeof(struct history_record));
+  if (record != NULL) {
+    record->start_ms = bucket->start_ms;
+    record->count = bucket->count;
+    for (i = 0; i < file->header->series_count; ++i) {
+      record->min[i] = bucket->min[i];
+      record->max[i] = bucket->max[i];
+      record->mean[i] = round_value((double) bucket->sum[i] / bucket->count);
+    }
+    append_record(file, r, record);
+    free(record);
+  }
+  bucket->count = 0;
+}
+
+static void add_sample(struct history_file *file,
+                       const struct history_sample *sample)
+{
+  struct history_bucket *bucket;
+  int64_t start;
+  int r, i;
+
+  for (r = 0; r < HISTORY_RESOLUTIONS; ++r) {
+    bucket = file->buckets + r;
+    start = sample->time_ms - sample->time_ms % resolution_ms[r];
+    if (bucket->count && bucket->start_ms != start)
+      flush_bucket(file, r);
+    if (bucket->count == 0) {
+      bucket->start_ms = start;
+      for (i = 0; i < sample->count; ++i) {
+        bucket->min[i] = bucket->max[i] = sample->values[i];
+        bucket->sum[i] = 0;
+      }
+    }
+    for (i = 0; i < sample->count; ++i) {
+      if (sample->values[i] < bucket->min[i])
+        bucket->min[i] = sample->values[i];
+      if (sample->values[i] > bucket->max[i])
+        bucket->max[i] = sample->values[i];
+      bucket->sum[i] += sample->values[i];
+    }
+    ++bucket->count;
+  }
+}
+
+/*
+ * the open buckets are appended, so stopping loses no samples; if the
+ * recorder starts again within their periods, the rest of a bucket is
+ * appended with the same start, and queries merge the two
+ */
+static void close_recorder(struct history_file *file)
+{
+  int r;
+
+  for (r = 0; r < HISTORY_RESOLUTIONS; ++r)
+    flush_bucket(file, r);
+  unmap_history(file);
+}
+
+static void add_series(struct history_sample *sample, const char *name,
+                       int type, int64_t value)
+{
+  struct history_series *series;
+
+  if (sample->count >= HISTORY_MAX_SERIES)
+    return;
+  series = sample->series + sample->count;
+  memset(series, 0, sizeof(*series));
+  copy_name(series->name, sizeof(series->name), name);
+  series->type = type;
+  sample->values[sample->count++] = value;
+}
+
+static int read_sample(int sg_fd, struct jbod_interface *jbod,
+                       struct history_sample *sample)
+{
+  const struct metrics_profile *profile = NULL;
+  struct ses_status_info *ses;
+  int power;
+  int i, rc;
+
+  ses = (struct ses_status_info *) malloc(sizeof(struct ses_status_info));
+  if (ses == NULL)
+    return ENOMEM;
+  /* thresholds and slots are not recorded */
+  rc = fetch_ses_status_of(sg_fd, ses, SES_FETCH_FRESH);
+  if (rc != 0) {
+    free(ses);
+    return rc;
+  }
+
+  sample->time_ms = now_ms();
+  sample->count = 0;
+  for (i = 0; i < ses->temp_count; ++i)
+    add_series(sample, ses->temp_sensors[i].name, HISTORY_TEMPERATURE,
+               ses->temp_sensors[i].temperature);
+  for (i = 0; i < ses->vol_count; ++i)
+    add_series(sample, ses->vol_sensors[i].name, HISTORY_VOLTAGE,
+               round_value(ses->vol_sensors[i].voltage *
+                        series_scale[HISTORY_VOLTAGE]));
+  for (i = 0; i < ses->curr_count; ++i)
+    add_series(sample, ses->curr_sensors[i].name, HISTORY_CURRENT,
+               round_value(ses->curr_sensors[i].current *
+                        series_scale[HISTORY_CURRENT]));
+  for (i = 0; i < ses->fan_count; ++i)
+    add_series(sample, ses->fans[i].name, HISTORY_FAN, ses->fans[i].rpm);
+  free_ses_status(ses);
+  free(ses);
+
+  if (jbod->get_metrics_profile)
+    profile = jbod->get_metrics_profile();
+  if (profile != NULL && profile->power != NULL &&
+      read_value_as_int(sg_fd, profile->power, &power) == 0)
+    add_series(sample, profile->power->name, HISTORY_POWER, power);
+  return 0;
+}
+
+static void record_one(int index, void *arg)
+{
+  struct record_job *job = (struct record_job *) arg + index;
+  struct jbod_interface *jbod;
+  char sas_addr[HISTORY_NAME_LENGTH];
+  int sg_fd;
+  int rc;
+
+  if (job->busy)
+    return;
+  jbod = detect_dev(job->devname);
+  if (jbod == NULL)
+    return;
+  sg_fd = sg_cmds_open_device(job->devname, 0 /* rw */, 0 /* not verbose */);
+  if (sg_fd < 0)
+    return;
+  rc = read_sample(sg_fd, jbod, job->sample);
+  if (rc == 0 && (job->file == NULL ||
+                  !same_series(job->file->header, job->sample))) {
+    /* new, or the enclosure changed; its series start over */
+    if (job->file != NULL)
+      close_recorder(job->file);
+    job->file = NULL;
+    if (read_enclosure_attr(sg_fd, "sas_address", sas_addr,
+                            sizeof(sas_addr)) == 0) {
+      job->file = open_recorder(job->devname, sas_addr, job->sample);
+      job->busy = job->file == NULL && errno == EBUSY;
+    }
+  }
+  sg_cmds_close_device(sg_fd);
+  if (rc == 0 && job->file != NULL)
+    add_sample(job->file, job->sample);
+}
+
+static void stop(int signo)
+{
+  stopping = 1;
+}
+
+int history_record(char *devnames[], int count, int interval_ms,
+                   int max_parallel)
+{
+  struct record_job *jobs;
+  struct sigaction action;
+  struct timespec pause;
+  int64_t started, left;
+  int i;
+
+  jobs = (struct record_job *) calloc(count, sizeof(struct record_job));
+  if (jobs == NULL)
+    return ENOMEM;
+  for (i = 0; i < count; ++i) {
+    jobs[i].devname = devnames[i];
+    jobs[i].sample = (struct history_sample *)
+      malloc(sizeof(struct history_sample));
+    if (jobs[i].sample == NULL)
+      count = i;
+  }
+  make_dirs(HISTORY_DIR);
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  while (!stopping) {
+    started = now_ms();
+    run_parallel(count, max_parallel, record_one, jobs);
+    left = started + interval_ms - now_ms();
+    if (left > 0) {
+      pause.tv_sec = left / 1000;
+      pause.tv_nsec = (left % 1000) * 1000000L;
+      nanosleep(&pause, NULL);    /* cut short by SIGTERM */
+    }
+  }
+
+  for (i = 0; i < count; ++i) {
+    if (jobs[i].file != NULL)
+      close_recorder(jobs[i].file);
+    free(jobs[i].sample);
+  }
+  free(jobs);
+  return 0;
+}
+
+static struct history_file *open_history(const char *path)
+{
+  struct history_file *file;
+  struct stat st;
+  int fd;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &st) != 0 || st.st_size < history_size() ||
+      (file = map_history(fd, st.st_size, PROT_READ)) == NULL) {
+    close(fd);
+    return NULL;
+  }
+  if (!valid_layout(file->header, file->size)) {
+    unmap_history(file);
+    return NULL;
+  }
+  return file;
+}
+
+/* the blocks of ring r with records, oldest first, copied while unchanged */
+static int copy_ring(struct history_file *file, int r,
+                     struct history_block *blocks)
+{
+  const struct history_ring *ring = file->header->rings + r;
+  const struct history_block *src;
+  struct history_block *dst;
+  uint32_t head, seq, used;
+  int count = 0;
+  uint32_t i;
+
+  head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) % ring->blocks;
+  for (i = 1; i <= ring->blocks; ++i) {
+    src = block_of(file, r, (head + i) % ring->blocks);
+    seq = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1)
+      continue;
+    used = __atomic_load_n(&src->used, __ATOMIC_ACQUIRE);
+    if (used == 0 || used > sizeof(src->data))
+      continue;
+    dst = blocks + count;
+    dst->used = used;
+    dst->first_ms = src->first_ms;
+    memcpy(dst->data, src->data, used);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&src->seq, __ATOMIC_RELAXED) == seq)
+      ++count;
+  }
+  return count;
+}
+
+/* fold part, a later record of the same bucket, into into */
+static void merge_record(struct history_record *into,
+                         const struct history_record *part, int series_count)
+{
+  int64_t count = into->count + part->count;
+  int i;
+
+  if (count <= 0)
+    return;
+  for (i = 0; i < series_count; ++i) {
+    if (part->min[i] < into->min[i])
+      into->min[i] = part->min[i];
+    if (part->max[i] > into->max[i])
+      into->max[i] = part->max[i];
+    into->mean[i] = round_value(((double) into->mean[i] * into->count +
+                                 (double) part->mean[i] * part->count) /
+                                count);
+  }
+  into->count = count;
+}
+
+/* call fn for every record from from_ms on, a bucket recorded in parts once */
+static void decode_ring(const struct history_block *blocks, int count,
+                        int series_count, int64_t from_ms,
+                        void (*fn)(const struct history_record *, void *),
+                        void *arg)
+{
+  struct history_record *record, *merged;
+  const unsigned char *in, *end;
+  int pending = 0;
+  uint64_t value;
+  int b, i, len;
+
+  record = (struct history_record *)
+    malloc(2 * sizeof(struct history_record));
+  if (record == NULL)
+    return;
+  merged = record + 1;
+  for (b = 0; b < count; ++b) {
+    in = blocks[b].data;
+    end = in + blocks[b].used;
+    record->start_ms = blocks[b].first_ms;
+    memset(record->min, 0, sizeof(record->min));
+    while (in < end) {
+      if ((len = get_varint(in, end, &value)) == 0)
+        break;
+      in += len;
+      record->start_ms += unzigzag(value);
+      if ((len = get_varint(in, end, &value)) == 0)
+        break;
+      in += len;
+      record->count = value;
+      for (i = 0; i < series_count && len; ++i) {
+        if ((len = get_varint(in, end, &value)) == 0)
+          break;
+        in += len;
+        record->min[i] += unzigzag(value);
+        if ((len = get_varint(in, end, &value)) == 0)
+          break;
+        in += len;
+        record->max[i] = record->min[i] + value;
+        if ((len = get_varint(in, end, &value)) == 0)
+          break;
+        in += len;
+        record->mean[i] = record->min[i] + value;
+      }
+      if (len == 0)
+        break;
+      if (record->start_ms < from_ms)
+        continue;
+      if (pending && record->start_ms == merged->start_ms) {
+        merge_record(merged, record, series_count);
+        continue;
+      }
+      if (pending)
+        fn(merged, arg);
+      memcpy(merged, record, sizeof(struct history_record));
+      pending = 1;
+    }
+  }
+  if (pending)
+    fn(merged, arg);
+  free(record);
+}
+
+/* the oldest record of ring r, or INT64_MAX if it has none */
+static int64_t oldest_record(struct history_file *file, int r)
+{
+  const struct history_ring *ring = file->header->rings + r;
+  const struct history_block *block;
+  int64_t oldest = INT64_MAX;
+  uint32_t i;
+
+  for (i = 0; i < ring->blocks; ++i) {
+    block = block_of(file, r, i);
+    if (__atomic_load_n(&block->used, __ATOMIC_ACQUIRE) > 0 &&
+        block->first_ms < oldest)
+      oldest = block->first_ms;
+  }
+  return oldest;
+}
+
+/* the finest resolution that reaches back to from_ms, else the longest */
+static int pick_resolution(struct history_file *file, int64_t from_ms)
+{
+  int64_t oldest, longest = INT64_MAX;
+  int best = HISTORY_1S;
+  int r;
+
+  for (r = 0; r < HISTORY_RESOLUTIONS; ++r) {
+    oldest = oldest_record(file, r);
+    if (oldest <= from_ms)
+      return r;
+    if (oldest < longest) {
+      longest = oldest;
+      best = r;
+    }
+  }
+  return best;
+}
+
+static void summarize(const struct history_record *record, void *arg)
+{
+  struct history_summary *summary = (struct history_summary *) arg;
+  int i;
+
+  if (summary->records == 0) {
+    summary->first_ms = record->start_ms;
+    for (i = 0; i < summary->series_count; ++i) {
+      summary->min[i] = record->min[i];
+      summary->max[i] = record->max[i];
+    }
+  }
+  for (i = 0; i < summary->series_count; ++i) {
+    if (record->min[i] < summary->min[i])
+      summary->min[i] = record->min[i];
+    if (record->max[i] > summary->max[i])
+      summary->max[i] = record->max[i];
+    summary->sum[i] += (double) record->mean[i] * record->count;
+  }
+  summary->last_ms = record->start_ms;
+  summary->samples += record->count;
+  ++summary->records;
+}
+
+static double scaled(const struct history_series *series, double value)
+{
+  return value / series_scale[series->type];
+}
+
+static void format_time(int64_t ms, char *out, size_t size)
+{
+  time_t seconds = ms / 1000;
+  struct tm tm;
+
+  gmtime_r(&seconds, &tm);
+  strftime(out, size, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+static void print_point(const struct history_record *record, void *arg)
+{
+  struct history_point *point = (struct history_point *) arg;
+  char time[32];
+  int i = point->index;
+
+  IF_PRINT_NONE_JSON {
+    format_time(record->start_ms, time, sizeof(time));
+    printf("\t%s\t%.2f\t%.2f\t%.2f\n", time,
+           scaled(point->series, record->min[i]),
+           scaled(point->series, record->mean[i]),
+           scaled(point->series, record->max[i]));
+  }
+  PRINT_JSON_GROUP_HEADER(NULL);
+  PRINT_JSON_ITEM("time", "%lld", (long long) (record->start_ms / 1000));
+  PRINT_JSON_ITEM("samples", "%lld", (long long) record->count);
+  PRINT_JSON_ITEM("min", "%.2f", scaled(point->series, record->min[i]));
+  PRINT_JSON_ITEM("avg", "%.2f", scaled(point->series, record->mean[i]));
+  PRINT_JSON_ITEM("max", "%.2f", scaled(point->series, record->max[i]));
+  PRINT_JSON_GROUP_ENDING;
+}
+
+static int print_history(struct history_file *file, int resolution,
+                         int since_sec, int detail)
+{
+  struct history_summary *summary;
+  struct history_block *blocks;
+  struct history_series series;
+  struct history_point point;
+  int64_t from_ms = now_ms() - (int64_t) since_sec * 1000;
+  int r = resolution;
+  int count, i;
+
+  if (r < 0)
+    r = pick_resolution(file, from_ms);
+  blocks = (struct history_block *)
+    malloc(file->header->rings[r].blocks * sizeof(struct history_block));
+  summary = (struct history_summary *) calloc(1, sizeof(*summary));
+  if (blocks == NULL || summary == NULL) {
+    free(blocks);
+    free(summary);
+    return ENOMEM;
+  }
+  count = copy_ring(file, r, blocks);
+  summary->series_count = file->header->series_count;
+  decode_ring(blocks, count, summary->series_count, from_ms, summarize,
+              summary);
+  if (summary->records == 0) {
+    perr("No records of %.*s in the last %d seconds.\n", HISTORY_NAME_LENGTH,
+         file->header->devname, since_sec);
+    free(blocks);
+    free(summary);
+    return ENOENT;
+  }
+
+  for (i = 0; i < summary->series_count; ++i) {
+    series = file->header->series[i];
+    series.name[sizeof(series.name) - 1] = '\0';
+    IF_PRINT_NONE_JSON
+      printf("%s\tmin %.2f\tavg %.2f\tmax %.2f %s\t(%lld records at %s)\n",
+             series.name, scaled(&series, summary->min[i]),
+             scaled(&series, summary->sum[i] / summary->samples),
+             scaled(&series, summary->max[i]), series_units[series.type],
+             (long long) summary->records, resolution_names[r]);
+    PRINT_JSON_GROUP_HEADER(series.name);
+    PRINT_JSON_ITEM("type", "%s", series_types[series.type]);
+    PRINT_JSON_ITEM("unit", "%s", series_units[series.type]);
+    PRINT_JSON_ITEM("resolution", "%s", resolution_names[r]);
+    PRINT_JSON_ITEM("records", "%lld", (long long) summary->records);
+    PRINT_JSON_ITEM("samples", "%lld", (long long) summary->samples);
+    PRINT_JSON_ITEM("first", "%lld", (long long) (summary->first_ms / 1000));
+    PRINT_JSON_ITEM("last", "%lld", (long long) (summary->last_ms / 1000));
+    PRINT_JSON_ITEM("min", "%.2f", scaled(&series, summary->min[i]));
+    PRINT_JSON_ITEM("avg", "%.2f",
+                    scaled(&series, summary->sum[i] / summary->samples));
+    PRINT_JSON_ITEM("max", "%.2f", scaled(&series, summary->max[i]));
+    if (detail) {
+      point.series = &series;
+      point.index = i;
+      PRINT_JSON_ARRAY_HEADER("records");
+      decode_ring(blocks, count, summary->series_count, from_ms, print_point,
+                  &point);
+      PRINT_JSON_ARRAY_ENDING;
+    }
+    PRINT_JSON_GROUP_ENDING;
+  }
+  free(blocks);
+  free(summary);
+  return 0;
+}
+
+int history_print(const char *devname, int resolution, int since_sec,
+                  int detail)
+{
+  struct history_file *file;
+  char sas_addr[HISTORY_NAME_LENGTH];
+  char path[PATH_MAX];
+  char name[HISTORY_NAME_LENGTH];
+  struct dirent *entry;
+  DIR *dir;
+  int sg_fd;
+  int ret = ENOENT;
+  int rc;
+
+  if (devname != NULL) {
+    /* the SAS address is in sysfs; nothing is sent to the enclosure */
+    sg_fd = sg_cmds_open_device(devname, 1 /* ro */, 0 /* not verbose */);
+    if (sg_fd < 0) {
+      perr("%s is not a jbod device (doesn't exist)\n", devname);
+      return ENODEV;
+    }
+    rc = read_enclosure_attr(sg_fd, "sas_address", sas_addr,
+                             sizeof(sas_addr));
+    sg_cmds_close_device(sg_fd);
+    if (rc != 0) {
+      perr("%s has no SAS address.\n", devname);
+      return ENODEV;
+    }
+    snprintf(path, sizeof(path), "%s/%s", HISTORY_DIR, sas_addr);
+    file = open_history(path);
+    if (file == NULL) {
+      perr("No history of %s in %s.\n", devname, HISTORY_DIR);
+      return ENOENT;
+    }
+    rc = print_history(file, resolution, since_sec, detail);
+    unmap_history(file);
+    return rc;
+  }
+
+  dir = opendir(HISTORY_DIR);
+  if (dir == NULL) {
+    perr("No history in %s.\n", HISTORY_DIR);
+    return ENOENT;
+  }
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.' || strstr(entry->d_name, ".tmp") ||
+        strstr(entry->d_name, ".lock"))
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", HISTORY_DIR, entry->d_name);
+    file = open_history(path);
+    if (file == NULL)
+      continue;
+    snprintf(name, sizeof(name), "%.*s", HISTORY_NAME_LENGTH - 1,
+             file->header->devname);
+    IF_PRINT_NONE_JSON
+      printf(">>> %s \n", name);
+    PRINT_JSON_GROUP_HEADER(name);
+    rc = print_history(file, resolution, since_sec, detail);
+    /* ENOENT only if no enclosure has records */
+    if (rc != 0 && rc != ENOENT)
+      ret = rc;
+    else if (rc == 0 && ret == ENOENT)
+      ret = 0;
+    PRINT_JSON_GROUP_ENDING;
+    unmap_history(file);
+  }
+  closedir(dir);
+  if (ret == ENOENT)
+    perr("No history in %s.\n", HISTORY_DIR);
+  return ret;
+}
+
+int history_resolution_from_name(const char *name)
+{
+  int r;
+
+  for (r = 0; r < HISTORY_RESOLUTIONS; ++r) {
+    if (strcmp(name, resolution_names[r]) == 0)
+      return r;
+  }
+  return -1;
+}
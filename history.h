@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+#ifndef HISTORY_DIR
+#define HISTORY_DIR "/var/lib/" NAME "/history"
+#endif
+
+#define HISTORY_MAGIC   0x5453434fu       /* "OCST" */
+#define HISTORY_VERSION 1
+
+/* temperature, voltage and current sensors, fans and power */
+#define HISTORY_MAX_SERIES   128
+#define HISTORY_NAME_LENGTH  32
+#define HISTORY_BLOCK_SIZE   4096
+
+/* enclosures to sample at the same time */
+#define HISTORY_DEFAULT_PARALLEL 8
+#define HISTORY_DEFAULT_INTERVAL_MS 1000
+#define HISTORY_MIN_INTERVAL_MS 100
+
+/* what a query covers without --since */
+#define HISTORY_DEFAULT_SINCE_SEC 3600
+
+/*
+ * Every sample is folded into buckets of 1 s, 1 min and 1 h. A closed
+ * bucket becomes one record, with the count, min, max and mean of every
+ * series, in the ring of its resolution. With 40 series, the rings keep
+ * about 19 hours, 3 days and 3 months.
+ */
+enum history_resolution {
+  HISTORY_1S,
+  HISTORY_1M,
+  HISTORY_1H,
+  HISTORY_RESOLUTIONS
+};
+
+enum history_series_type {
+  HISTORY_TEMPERATURE,
+  HISTORY_VOLTAGE,
+  HISTORY_CURRENT,
+  HISTORY_FAN,
+  HISTORY_POWER
+};
+
+struct history_series {
+  char name[HISTORY_NAME_LENGTH];
+  uint32_t type;
+  uint32_t reserved;
+};
+
+/* where the blocks of a resolution are */
+struct history_ring {
+  uint32_t head;                  /* the block records are appended to */
+  uint32_t blocks;
+  int64_t resolution_ms;
+  uint64_t offset;                /* of the first block in the file */
+};
+
+/*
+ * One file per enclosure, HISTORY_DIR/<SAS address>, mapped by the
+ * recorder and by queries: this header, then the blocks of each ring.
+ * The recorder holds an flock() on HISTORY_DIR/<SAS address>.lock.
+ */
+struct history_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t block_size;
+  uint32_t series_count;
+  char devname[HISTORY_NAME_LENGTH];
+  char sas_addr[HISTORY_NAME_LENGTH];
+  struct history_ring rings[HISTORY_RESOLUTIONS];
+  struct history_series series[HISTORY_MAX_SERIES];
+};
+
+/*
+ * Records are appended to the data of a block, each as
+ *   zigzag varint   start of the bucket - start of the previous record
+ *   varint          samples in the bucket
+ * and per series, in C, RPM or W, or hundredths of V or A,
+ *   zigzag varint   min - min of the previous record
+ *   varint          max - min
+ *   varint          mean - min
+ * The first record of a block is relative to first_ms and zeros, so every
+ * block decodes on its own. A bucket open when the recorder stopped is
+ * appended then, and its rest after a restart with the same start; queries
+ * merge consecutive records of the same start. The recorder makes seq odd
+ * while it recycles the block; queries copy a block and drop it if seq
+ * changed meanwhile.
+ */
+struct history_block {
+  uint32_t seq;
+  uint32_t used;                  /* bytes of data */
+  int64_t first_ms;
+  unsigned char data[HISTORY_BLOCK_SIZE - 16];
+};
+
+/*
+ * sample devnames every interval_ms, until SIGINT or SIGTERM, reading
+ * up to max_parallel enclosures at a time
+ */
+extern int history_record(char *devnames[], int count, int interval_ms,
+                          int max_parallel);
+
+/*
+ * print min, mean and max of every series of devname, or of every
+ * recorded enclosure if devname is NULL, over the last since_sec seconds.
+ * resolution is an enum history_resolution, or -1 for the finest that
+ * covers the range. With detail, every record is printed too. Only the
+ * history files are read. Return ENOENT if there are no records.
+ */
+extern int history_print(const char *devname, int resolution, int since_sec,
+                         int detail);
+
+/* "1s", "1m" or "1h"; return -1 for anything else */
+extern int history_resolution_from_name(const char *name);
+
+#endif
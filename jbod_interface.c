@@ -21,17 +21,19 @@
 #include <time.h>
 #include <unistd.h>
 #include <libgen.h>
+#include <pthread.h>
 
+#include "enclosure_cache.h"
+#include "event_status.h"
 #include "jbod_interface.h"
+#include "parallel.h"
 #include "scsi_buffer.h"
 #include "ses.h"
+#include "ses_control.h"
 #include "led.h"
 #include "json.h"
 #include "drive_control.h"
 
-#include "knox.c"
-#include "triton.c"
-
 #define SCSI_BUFFER_MAX_SIZE 64
 
 struct jbod_profile jbod_library[] = {
@@ -43,6 +45,23 @@ struct jbod_profile jbod_library[] = {
 
 int library_size = sizeof(jbod_library) / sizeof(struct jbod_profile);
 
+/*
+ * what devices were detected as while snapshots are kept, by devname; every
+ * disk has a sg device, so there are more of them than enclosures
+ */
+#define MAX_DETECTED_DEVS 1024
+#define DETECTED_NAME_LENGTH 64
+
+struct detected_dev {
+  char devname[DETECTED_NAME_LENGTH];
+  struct jbod_interface *interface;   /* NULL if not a supported JBOD */
+};
+
+static int keep_detected = 0;
+static struct detected_dev detected[MAX_DETECTED_DEVS];
+static int detected_count = 0;
+static pthread_mutex_t detected_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static int inquiry_would_block(int sg_fd, const char *devname) {
   int accessibility_res = -1;
   int command = SG_SCSI_RESET_NOTHING;
@@ -116,12 +135,15 @@ done:
   return profile;
 }
 
-struct jbod_interface *detect_dev(const char *devname)
+/* set *answered if the device answered the INQUIRY */
+static struct jbod_interface *detect_dev_inquiry(const char *devname,
+                                                 int *answered)
 {
   struct jbod_profile *profile;
   int i;
 
   profile = extract_profile(devname);
+  *answered = profile != NULL;
   if (profile == NULL) {
     return NULL;
   }
@@ -139,6 +161,83 @@ struct jbod_interface *detect_dev(const char *devname)
   return NULL;
 }
 
+/* with the lock held; return -1 if devname was not detected */
+static int find_detected(const char *devname)
+{
+  int i;
+
+  for (i = 0; i < detected_count; ++i) {
+    if (strcmp(detected[i].devname, devname) == 0)
+      return i;
+  }
+  return -1;
+}
+
+void jbod_keep_detected(const char *devname, struct jbod_interface *interface)
+{
+  int i;
+
+  if (strlen(devname) >= DETECTED_NAME_LENGTH)
+    return;
+  pthread_mutex_lock(&detected_lock);
+  i = find_detected(devname);
+  if (i < 0 && detected_count < MAX_DETECTED_DEVS)
+    i = detected_count++;
+  if (i >= 0) {
+    strcpy(detected[i].devname, devname);
+    detected[i].interface = interface;
+  }
+  pthread_mutex_unlock(&detected_lock);
+}
+
+struct jbod_interface *detect_dev(const char *devname)
+{
+  struct jbod_interface *interface = NULL;
+  int answered;
+  int i;
+
+  if (!keep_detected || devname == NULL)
+    return detect_dev_inquiry(devname, &answered);
+
+  pthread_mutex_lock(&detected_lock);
+  i = find_detected(devname);
+  if (i >= 0)
+    interface = detected[i].interface;
+  pthread_mutex_unlock(&detected_lock);
+  if (i >= 0)
+    return interface;
+
+  /* a device that did not answer may be an enclosure being reset */
+  interface = detect_dev_inquiry(devname, &answered);
+  if (answered)
+    jbod_keep_detected(devname, interface);
+  return interface;
+}
+
+void jbod_drop_detected(void)
+{
+  pthread_mutex_lock(&detected_lock);
+  detected_count = 0;
+  pthread_mutex_unlock(&detected_lock);
+}
+
+void jbod_foreach_detected(jbod_detected_fn fn, void *arg)
+{
+  int i;
+
+  pthread_mutex_lock(&detected_lock);
+  for (i = 0; i < detected_count; ++i)
+    fn(detected[i].devname, detected[i].interface, arg);
+  pthread_mutex_unlock(&detected_lock);
+}
+
+void jbod_keep_snapshots(int keep)
+{
+  keep_detected = keep;
+  jbod_drop_detected();
+  ses_keep_snapshots(keep);
+}
+
 static int jbod_interface_to_index(struct jbod_interface *interface)
 {
   int i;
@@ -219,8 +318,6 @@ void print_list_of_jbod(struct jbod_device jbod_devices[MAX_JBOD_PER_HOST], int
           d.profile_name);
       }
     }
-    if (i != 0)
-      PRINT_JSON_MORE_GROUP;
     PRINT_JSON_GROUP_HEADER(d.sg_device);
     PRINT_JSON_ITEM("sg_device", "%s", d.sg_device);
     PRINT_JSON_ITEM(
@@ -230,68 +327,212 @@ void print_list_of_jbod(struct jbod_device jbod_devices[MAX_JBOD_PER_HOST], int
       PRINT_JSON_ITEM("name", "%s", d.profile_name);
       PRINT_JSON_ITEM("Node_SN", "%s", d.short_profile.node_sn);
       PRINT_JSON_ITEM("FB_Asset_Node", "%s", d.short_profile.fb_asset_node);
-      PRINT_JSON_LAST_ITEM("FB_Asset_Chassis", "%s",
-                           d.short_profile.fb_asset_chassis);
+      PRINT_JSON_ITEM("FB_Asset_Chassis", "%s",
+                      d.short_profile.fb_asset_chassis);
     } else {
-      PRINT_JSON_LAST_ITEM("name", "%s", d.profile_name);
+      PRINT_JSON_ITEM("name", "%s", d.profile_name);
     }
 
     PRINT_JSON_GROUP_ENDING;
   }
 }
 
-int lib_list_jbod(struct jbod_device out[MAX_JBOD_PER_HOST])
+/* devices to probe in one directory, and what they were detected as */
+struct probe_list {
+  char (*paths)[PATH_MAX];
+  struct jbod_interface **interfaces;
+  int count;
+  int size;
+};
+
+static int add_probe(struct probe_list *list, const char *dir,
+                     const char *name)
+{
+  char (*paths)[PATH_MAX];
+  struct jbod_interface **interfaces;
+  int size;
+
+  if (list->count == list->size) {
+    size = list->size ? list->size * 2 : 64;
+    paths = realloc(list->paths, size * sizeof(*paths));
+    if (paths == NULL)
+      return ENOMEM;
+    list->paths = paths;
+    interfaces = realloc(list->interfaces, size * sizeof(*interfaces));
+    if (interfaces == NULL)
+      return ENOMEM;
+    list->interfaces = interfaces;
+    list->size = size;
+  }
+  snprintf(list->paths[list->count++], PATH_MAX, "%s%s", dir, name);
+  return 0;
+}
+
+/* an INQUIRY each, and up to 10 seconds for devices being reset */
+static void probe_one(int index, void *arg)
+{
+  struct probe_list *list = (struct probe_list *) arg;
+
+  list->interfaces[index] = detect_dev(list->paths[index]);
+}
+
+int lib_list_jbod(struct jbod_device out[MAX_JBOD_PER_HOST], int max_parallel)
 {
   DIR *dir;
   struct dirent *ent;
   int index;
   struct jbod_interface *interface;
-  char sg_path[PATH_MAX];
   char bsg_path[PATH_MAX];
   int jbod_count = 0;
-  struct jbod_short_profile short_p;
+  struct jbod_short_profile short_p = {"N/A", "N/A", "N/A"};
+  struct probe_list list;
 #define DEVICE_PATH_COUNT 2
   /* first search /dev/sgXX, then /dev/bsg/XX */
   char *path_prefix[DEVICE_PATH_COUNT][2] =
     {{"/dev/", "sg"}, {"/dev/bsg/", ""}};
-  int p;
+  int p, i;
 
+  memset(&list, 0, sizeof(list));
   for (p = 0; p < DEVICE_PATH_COUNT; ++p) {
-    if ((dir = opendir(path_prefix[p][0])) != NULL) {
-      while ((ent = readdir (dir)) != NULL) {
-        if (strncmp(path_prefix[p][1], ent->d_name, strlen(path_prefix[p][1]))
-            != 0)
-          continue;
-        snprintf(sg_path, PATH_MAX, "%s%s", path_prefix[p][0], ent->d_name);
-
-        interface = detect_dev(sg_path);
-        if (interface) {
-
-          index = jbod_interface_to_index(interface);
-          short_p = interface->get_short_profile(sg_path);
-
-          snprintf(out[jbod_count].sg_device, PATH_MAX, "%s", sg_path);
-          snprintf(out[jbod_count].bsg_device, PATH_MAX, "%s",
-            find_bsg_device(basename(sg_path), bsg_path) ? bsg_path : "");
-          snprintf(
-            out[jbod_count].profile_name, TYPE_NAME_MAX, "%s", jbod_library[index].name);
-          memcpy(
-            &out[jbod_count].short_profile,
-            &short_p,
-            sizeof(struct jbod_short_profile));
-
-          jbod_count ++;
-        }
-      }
-      closedir (dir);
-      if (jbod_count > 0)  /* found /dev/sgXXX, skip search in /dev/bsgXXX */
+    if ((dir = opendir(path_prefix[p][0])) == NULL)
+      continue;
+    list.count = 0;
+    while ((ent = readdir (dir)) != NULL) {
+      if (strncmp(path_prefix[p][1], ent->d_name, strlen(path_prefix[p][1]))
+          != 0)
+        continue;
+      if (add_probe(&list, path_prefix[p][0], ent->d_name) != 0)
         break;
     }
+    closedir (dir);
+
+    /* every disk has a sg device too; probe them all at once */
+    run_parallel(list.count, max_parallel, probe_one, &list);
+
+    for (i = 0; i < list.count && jbod_count < MAX_JBOD_PER_HOST; ++i) {
+      interface = list.interfaces[i];
+      if (interface == NULL)
+        continue;
+
+      index = jbod_interface_to_index(interface);
+
+      snprintf(out[jbod_count].sg_device, PATH_MAX, "%s", list.paths[i]);
+      snprintf(out[jbod_count].bsg_device, PATH_MAX, "%s",
+        find_bsg_device(basename(list.paths[i]), bsg_path) ? bsg_path : "");
+      snprintf(
+        out[jbod_count].profile_name, TYPE_NAME_MAX, "%s", jbod_library[index].name);
+      memcpy(
+        &out[jbod_count].short_profile,
+        &short_p,
+        sizeof(struct jbod_short_profile));
+      out[jbod_count].interface = interface;
+
+      jbod_count ++;
+    }
+    if (jbod_count > 0)  /* found /dev/sgXXX, skip search in /dev/bsgXXX */
+      break;
   }
+  free(list.paths);
+  free(list.interfaces);
   return jbod_count;
 }
 
+#define SHORT_PROFILE_FIELDS 3
+
+static const char *short_profile_keys[SHORT_PROFILE_FIELDS] = {
+  "short_profile_node_sn",
+  "short_profile_asset_node",
+  "short_profile_asset_chassis",
+};
+
+static char *short_profile_field(struct jbod_short_profile *p, int i)
+{
+  switch (i) {
+    case 0:
+      return p->node_sn;
+    case 1:
+      return p->fb_asset_node;
+    default:
+      return p->fb_asset_chassis;
+  }
+}
+
+static int load_short_profile(struct enclosure_cache *cache,
+                              struct jbod_short_profile *p)
+{
+  const char *value;
+  long cached_time;
+  int i;
+
+  value = enclosure_cache_get(cache, "short_profile_time");
+  if (value == NULL || sscanf(value, "%ld", &cached_time) != 1 ||
+      time(NULL) - cached_time > SHORT_PROFILE_CACHE_TTL ||
+      time(NULL) < cached_time)
+    return ENOENT;
+
+  for (i = 0; i < SHORT_PROFILE_FIELDS; ++i) {
+    value = enclosure_cache_get(cache, short_profile_keys[i]);
+    if (value == NULL)
+      return ENOENT;
+    snprintf(short_profile_field(p, i), MAX_TAG_LENGTH, "%s", value);
+  }
+  return 0;
+}
+
+static void store_short_profile(struct enclosure_cache *cache,
+                                struct jbod_short_profile *p)
+{
+  char value[ENCLOSURE_CACHE_VALUE_LENGTH];
+  int i;
+
+  for (i = 0; i < SHORT_PROFILE_FIELDS; ++i)
+    enclosure_cache_set(cache, short_profile_keys[i],
+                        short_profile_field(p, i));
+  snprintf(value, ENCLOSURE_CACHE_VALUE_LENGTH, "%ld", (long) time(NULL));
+  enclosure_cache_set(cache, "short_profile_time", value);
+}
+
+static void fetch_short_profile(int index, void *arg)
+{
+  struct jbod_device *d = (struct jbod_device *) arg + index;
+  struct enclosure_cache *cache;
+  int sg_fd;
+
+  if (d->interface == NULL)
+    return;
+  sg_fd = sg_cmds_open_device(d->sg_device, 0 /* rw */, 0 /* not verbose */);
+  if (sg_fd < 0)
+    return;
+
+  cache = (struct enclosure_cache *) malloc(sizeof(struct enclosure_cache));
+  if (cache == NULL || enclosure_cache_open(sg_fd, cache) != 0) {
+    d->short_profile = d->interface->get_short_profile(sg_fd);
+  } else if (load_short_profile(cache, &d->short_profile) != 0) {
+    d->short_profile = d->interface->get_short_profile(sg_fd);
+    store_short_profile(cache, &d->short_profile);
+    enclosure_cache_save(cache);
+  }
+  free(cache);
+  sg_cmds_close_device(sg_fd);
+}
+
+void lib_fetch_short_profiles(struct jbod_device devices[], int count,
+                              int max_parallel)
+{
+  run_parallel(count, max_parallel, fetch_short_profile, devices);
+}
+
+void invalidate_short_profile(int sg_fd)
+{
+  enclosure_cache_write(sg_fd, "short_profile_time", "");
+}
+
 int fetch_ses_status(int sg_fd, struct ses_status_info *ses_info)
+{
+  return fetch_ses_status_of(sg_fd, ses_info, SES_FETCH_ALL);
+}
+
+int fetch_ses_status_of(int sg_fd, struct ses_status_info *ses_info, int what)
 {
   int rc = 0;
   struct ses_pages *pages = NULL;
@@ -301,9 +542,9 @@ int fetch_ses_status(int sg_fd, struct ses_status_info *ses_info)
   pages = (struct ses_pages *) calloc(1, sizeof(struct ses_pages));
   assert(pages != NULL);
 
-  rc = read_ses_pages(sg_fd, pages, NULL);
+  rc = read_ses_pages_of(sg_fd, pages, NULL, what);
   if (0 == rc) {
-    interpret_ses_pages(pages, ses_info);
+    interpret_ses_pages_of(pages, ses_info, what);
   }
 
   if (pages) {
@@ -314,52 +555,105 @@ int fetch_ses_status(int sg_fd, struct ses_status_info *ses_info)
   return rc;
 }
 
-void jbod_print_temperature_reading(int sg_fd, int print_thresholds)
+int jbod_prefetch_ses(const char *devname, int what)
 {
-  int i, rc;
-  struct ses_status_info ses_info = {};
+  struct ses_pages *pages;
+  int sg_fd;
+  int rc;
 
-  rc = fetch_ses_status(sg_fd, &ses_info);
-  if (0 == rc) {
-    for (i = 0; i < ses_info.temp_count; i++) {
-      PRINT_JSON_GROUP_SEPARATE;
-      print_temperature_sensor(ses_info.temp_sensors + i, print_thresholds);
-    }
-  }
+  sg_fd = sg_cmds_open_device(devname, 0 /* rw */, 0 /* not verbose */);
+  if (sg_fd < 0)
+    return ENODEV;
+  pages = (struct ses_pages *) malloc(sizeof(struct ses_pages));
+  rc = pages ? read_ses_pages_of(sg_fd, pages, NULL, what) : ENOMEM;
+  free(pages);
+  sg_cmds_close_device(sg_fd);
+  return rc;
 }
 
-void jbod_print_voltage_reading(int sg_fd, int print_thresholds) {
-  int i, rc;
-  struct ses_status_info ses_info = {};
+void free_ses_status(struct ses_status_info *ses_info)
+{
+  int i;
 
-  rc = fetch_ses_status(sg_fd, &ses_info);
-  if (0 == rc) {
-    for (i = 0; i < ses_info.vol_count; i++) {
-      PRINT_JSON_MORE_GROUP;
-      print_volatage_sensor(ses_info.vol_sensors + i, print_thresholds);
-    }
+  for (i = 0; i < ses_info->slot_count; ++i) {
+    free(ses_info->slots[i].name);
+    free(ses_info->slots[i].dev_name);
+    free(ses_info->slots[i].by_slot_name);
   }
+  for (i = 0; i < ses_info->temp_count; ++i)
+    free(ses_info->temp_sensors[i].name);
+  for (i = 0; i < ses_info->vol_count; ++i)
+    free(ses_info->vol_sensors[i].name);
+  for (i = 0; i < ses_info->curr_count; ++i)
+    free(ses_info->curr_sensors[i].name);
+  for (i = 0; i < ses_info->fan_count; ++i)
+    free(ses_info->fans[i].name);
+  free(ses_info->expander.name);
+  memset(ses_info, 0, sizeof(*ses_info));
 }
 
-void jbod_print_current_reading(int sg_fd, int print_thresholds)
+/* the optional parts of a SES snapshot that the selected fields need */
+static int ses_fetch_wanted(int print_thresholds)
+{
+  int what = 0;
+
+  if (print_thresholds && json_fields_wanted(sensor_threshold_fields))
+    what |= SES_FETCH_THRESHOLDS;
+  if (json_field_wanted("devname") || json_field_wanted("by_slot_name"))
+    what |= SES_FETCH_DEV_NAMES;
+  return what;
+}
+
+#define SENSOR_TEMPERATURE  0x1
+#define SENSOR_VOLTAGE      0x2
+#define SENSOR_CURRENT      0x4
+
+/* one SES snapshot for all sensor types asked for */
+static void print_sensor_readings(int sg_fd, int types, int print_thresholds)
 {
-  int i, rc;
   struct ses_status_info ses_info = {};
+  int i, rc;
 
-  rc = fetch_ses_status(sg_fd, &ses_info);
+  if (!json_fields_wanted(sensor_fields) &&
+      !(print_thresholds && json_fields_wanted(sensor_threshold_fields)))
+    return;
+  /* slots are not printed here */
+  rc = fetch_ses_status_of(sg_fd, &ses_info,
+                           ses_fetch_wanted(print_thresholds) &
+                           ~SES_FETCH_DEV_NAMES);
   if (0 == rc) {
-    for (i = 0; i < ses_info.curr_count; i++) {
-      PRINT_JSON_MORE_GROUP;
-      print_current_sensor(ses_info.curr_sensors + i, print_thresholds);
-    }
+    if (types & SENSOR_TEMPERATURE)
+      for (i = 0; i < ses_info.temp_count; i++)
+        print_temperature_sensor(ses_info.temp_sensors + i, print_thresholds);
+    if (types & SENSOR_VOLTAGE)
+      for (i = 0; i < ses_info.vol_count; i++)
+        print_volatage_sensor(ses_info.vol_sensors + i, print_thresholds);
+    if (types & SENSOR_CURRENT)
+      for (i = 0; i < ses_info.curr_count; i++)
+        print_current_sensor(ses_info.curr_sensors + i, print_thresholds);
   }
+  free_ses_status(&ses_info);
+}
+
+void jbod_print_temperature_reading(int sg_fd, int print_thresholds)
+{
+  print_sensor_readings(sg_fd, SENSOR_TEMPERATURE, print_thresholds);
+}
+
+void jbod_print_voltage_reading(int sg_fd, int print_thresholds) {
+  print_sensor_readings(sg_fd, SENSOR_VOLTAGE, print_thresholds);
+}
+
+void jbod_print_current_reading(int sg_fd, int print_thresholds)
+{
+  print_sensor_readings(sg_fd, SENSOR_CURRENT, print_thresholds);
 }
 
 void jbod_print_all_sensor_reading(int sg_fd, int print_thresholds)
 {
-  jbod_print_temperature_reading(sg_fd, print_thresholds);
-  jbod_print_voltage_reading(sg_fd, print_thresholds);
-  jbod_print_current_reading(sg_fd, print_thresholds);
+  print_sensor_readings(sg_fd,
+                        SENSOR_TEMPERATURE | SENSOR_VOLTAGE | SENSOR_CURRENT,
+                        print_thresholds);
 }
 
 void jbod_print_fan_info(int sg_fd)
@@ -367,37 +661,35 @@ void jbod_print_fan_info(int sg_fd)
   struct ses_status_info ses_info = {};
   int i, rc;
 
-  rc = fetch_ses_status(sg_fd, &ses_info);
+  if (!json_fields_wanted(fan_fields))
+    return;
+  rc = fetch_ses_status_of(sg_fd, &ses_info, 0);
   if (0 == rc) {
     for (i = 0; i < ses_info.fan_count; i++) {
-      PRINT_JSON_GROUP_SEPARATE;
       print_cooling_fan(ses_info.fans + i);
     }
   }
+  free_ses_status(&ses_info);
 }
 
-int fan_pwm_buffer_id = -1;
-int fan_pwm_buffer_offset = -1;
-void jbod_control_fan_pwm(int sg_fd, int pwm)
+void jbod_control_fan_pwm(int sg_fd, int buffer_id, int buffer_offset, int pwm)
 {
   unsigned char buf[SCSI_BUFFER_MAX_SIZE];
   int write_len;
   int i;
 
-  if (fan_pwm_buffer_id == -1 || fan_pwm_buffer_offset == -1) {
+  if (buffer_id == -1 || buffer_offset == -1) {
     perr("Fan pwm control is not supported.\n");
     return;
   }
   assert(pwm >= 0);
   assert(pwm <= 100);
-  scsi_read_buffer(sg_fd, fan_pwm_buffer_id, fan_pwm_buffer_offset,
-                   buf, SCSI_BUFFER_MAX_SIZE);
+  scsi_read_buffer(sg_fd, buffer_id, buffer_offset, buf, SCSI_BUFFER_MAX_SIZE);
   write_len = (int) buf[0] + 1;
   for (i = 0; i < write_len; i ++) {
     buf[i + 1] = (char) pwm;
   }
-  scsi_write_buffer(sg_fd, fan_pwm_buffer_id, fan_pwm_buffer_offset,
-                    buf, write_len);
+  scsi_write_buffer(sg_fd, buffer_id, buffer_offset, buf, write_len);
 }
 
 void jbod_print_hdd_info (int sg_fd)
@@ -405,13 +697,15 @@ void jbod_print_hdd_info (int sg_fd)
   struct ses_status_info ses_info = {};
   int i, rc;
 
-  rc = fetch_ses_status(sg_fd, &ses_info);
+  if (!json_fields_wanted(slot_fields))
+    return;
+  rc = fetch_ses_status_of(sg_fd, &ses_info, ses_fetch_wanted(0));
   if (0 == rc) {
     for (i = 0; i < ses_info.slot_count; i++) {
-      PRINT_JSON_GROUP_SEPARATE;
       print_array_device_slot(ses_info.slots + i);
     }
   }
+  free_ses_status(&ses_info);
 }
 
 void jbod_print_enclosure_info (int sg_fd)
@@ -419,7 +713,9 @@ void jbod_print_enclosure_info (int sg_fd)
   int rc;
   struct ses_status_info ses_info = {};
 
-  rc = fetch_ses_status(sg_fd, &ses_info);
+  if (!json_field_wanted("Expander SAS Addr"))
+    return;
+  rc = fetch_ses_status_of(sg_fd, &ses_info, 0);
   if (0 == rc) {
     IF_PRINT_NONE_JSON
     printf("Expander SAS Addr\t0x%s\n", ses_info.expander.sas_addr_str);
@@ -427,6 +723,7 @@ void jbod_print_enclosure_info (int sg_fd)
     PRINT_JSON_ITEM(
         "Expander SAS Addr", "0x%s", ses_info.expander.sas_addr_str);
   }
+  free_ses_status(&ses_info);
 }
 
 /*
@@ -437,52 +734,51 @@ void jbod_print_enclosure_info (int sg_fd)
 int jbod_hdd_power_off_with_timeout(int sg_fd, int slot_id, int timeout,
                                     int cold_storage)
 {
-  struct ses_pages pages;
-  struct ses_status_info ses_status;
-  int page_two_size;
+  struct ses_txn txn;
+  struct ses_status_info *ses_status = &txn.status;
   int rc;
 
-  rc = read_ses_pages(sg_fd, &pages, &page_two_size);
+  rc = ses_txn_begin(sg_fd, &txn);
   if (0 != rc) {
-    perr("Couldn't read ses pages: %d\n", rc);
     return rc;
   }
-  interpret_ses_pages(&pages, &ses_status);
-  if (slot_id < 0 || slot_id >= ses_status.slot_count) {
+  if (slot_id < 0 || slot_id >= ses_status->slot_count) {
     perr("Slot_id %d is invalid\n", slot_id);
     perr("Valid slot_ids [%d, %d]\n", 0,
-            ses_status.slot_count);
+            ses_status->slot_count);
     return EINVAL;
   }
 
   /* clear link in /dev/disk/by-slot */
-  if (ses_status.slots[slot_id].by_slot_name)
-    unlink(ses_status.slots[slot_id].by_slot_name);
+  if (ses_status->slots[slot_id].by_slot_name)
+    unlink(ses_status->slots[slot_id].by_slot_name);
 
 
   /* gracefully shutdown the HDD */
   if (timeout >= 0)
-    remove_hdd(ses_status.slots[slot_id].dev_name,
-               ses_status.slots[slot_id].sas_addr_str);
+    remove_hdd(ses_status->slots[slot_id].dev_name,
+               ses_status->slots[slot_id].sas_addr_str);
 
   /* pull HDD power in hardware */
-  control_hdd_power(pages.page_two, ses_status.slots + slot_id, 0);
-  rc = sg_send_ses_page(sg_fd, pages.page_two, page_two_size);
+  control_hdd_power(&txn, ses_status->slots + slot_id, 0);
+  rc = ses_txn_commit(&txn);
   if (timeout <= 0 || 0 != rc) {
     return rc;
   }
   int i = 0;
   for (i = 0; i < timeout; ++i) {
-    rc = fetch_ses_status(sg_fd, &ses_status);
-    if ((0 == rc) && ses_status.slots[slot_id].dev_name == NULL) {
+    /* waiting for a change, so never from a snapshot */
+    rc = fetch_ses_status_of(sg_fd, ses_status,
+                             SES_FETCH_ALL | SES_FETCH_FRESH);
+    if ((0 == rc) && ses_status->slots[slot_id].dev_name == NULL) {
       return rc;
     }
     sleep(1);
   }
-  if (ses_status.slots[slot_id].dev_name) {
+  if (ses_status->slots[slot_id].dev_name) {
     perr(
         "the device %s is still there, errno: %d\n",
-        ses_status.slots[slot_id].dev_name,
+        ses_status->slots[slot_id].dev_name,
         rc);
     return 1;
   }
@@ -499,61 +795,52 @@ int jbod_hdd_power_off_with_timeout(int sg_fd, int slot_id, int timeout,
 int jbod_hdd_power_on_with_timeout(int sg_fd, int slot_id,
                                    int timeout, int cold_storage)
 {
-  struct ses_pages pages;
-  struct ses_status_info ses_status;
-  int page_two_size, rc;
+  struct ses_txn txn;
+  struct ses_status_info *ses_status = &txn.status;
+  int rc;
   const int max_power_on_cycle_time_s = 60;
   const int dev_check_period = 1;
 
-  rc = read_ses_pages(sg_fd, &pages, &page_two_size);
+  rc = ses_txn_begin(sg_fd, &txn);
   if (0 != rc) {
-    perr("Couldn't read ses pages: %d\n", rc);
     return rc;
   }
-  interpret_ses_pages(&pages, &ses_status);
-  if (slot_id < 0 || slot_id >= ses_status.slot_count) {
+  if (slot_id < 0 || slot_id >= ses_status->slot_count) {
     perr("Slot_id %d is invalid\n", slot_id);
     perr("Valid slot_ids [%d, %d]\n", 0,
-            ses_status.slot_count);
+            ses_status->slot_count);
     return EINVAL;
   }
 
   int start_time = time(NULL);
   int end_time = start_time + timeout;
   do {
-    memset(&ses_status, 0, sizeof(ses_status));
-    memset(&pages, 0, sizeof(pages));
-    page_two_size = 0;
-    rc = read_ses_pages(sg_fd, &pages, &page_two_size);
+    rc = ses_txn_begin(sg_fd, &txn);
     if (0 != rc) {
-      perr("Couldn't read ses pages: %d\n", rc);
       return rc;
     }
-    interpret_ses_pages(&pages, &ses_status);
 
-    if (ses_status.slots[slot_id].dev_name && /* device on AND show dev_name */
-        (ses_status.slots[slot_id].device_off == 0)) {
+    if (ses_status->slots[slot_id].dev_name && /* device on AND show dev_name */
+        (ses_status->slots[slot_id].device_off == 0)) {
       perr("slot %d is already powered and has a device, %s\n", slot_id,
-        ses_status.slots[slot_id].dev_name);
+        ses_status->slots[slot_id].dev_name);
       return 0;
     }
     if (cold_storage) {
       int slot_to_power_off = 0;
-      for (; slot_to_power_off < ses_status.slot_count; ++slot_to_power_off) {
+      for (; slot_to_power_off < ses_status->slot_count; ++slot_to_power_off) {
         jbod_hdd_power_off_with_timeout(sg_fd, slot_to_power_off, 5, cold_storage);
       }
     }
-    control_hdd_power(pages.page_two, ses_status.slots + slot_id, 1);
+    control_hdd_power(&txn, ses_status->slots + slot_id, 1);
     // TODO(xuanji): we ignore the return value of this
-    sg_send_ses_page(sg_fd, pages.page_two, page_two_size);
-    memset(&pages, 0, sizeof(pages));
-    page_two_size = 0;
-    rc = read_ses_pages(sg_fd, &pages, &page_two_size);
+    ses_txn_commit(&txn);
+    rc = read_ses_pages(sg_fd, &txn.pages, NULL);
     if (0 != rc) {
       perr("Couldn't read ses pages: %d\n", rc);
       return rc;
     }
-    if (!check_hdd_power(pages.page_two, ses_status.slots + slot_id))
+    if (!check_hdd_power(txn.pages.page_two, ses_status->slots + slot_id))
       return -2;
     if (timeout < 0) {
       timeout = 0;
@@ -564,12 +851,13 @@ int jbod_hdd_power_on_with_timeout(int sg_fd, int slot_id,
     int i = 0;
     for (i = 0; i < max_power_on_cycle_time_s; ++i) {
       if (i % dev_check_period == 0) {
-        rc = fetch_ses_status(sg_fd, &ses_status);
+        rc = fetch_ses_status_of(sg_fd, ses_status,
+                                 SES_FETCH_ALL | SES_FETCH_FRESH);
         if (0 != rc) {
           perr("Couldn't fetch ses status: %d", rc);
           return rc;
         }
-        if (ses_status.slots[slot_id].dev_name == NULL) {
+        if (ses_status->slots[slot_id].dev_name == NULL) {
           if (end_time < time(NULL)) {
             perr("the device didn't show up before timeout\n");
 
@@ -610,193 +898,229 @@ int jbod_hdd_power_control (int sg_fd, int slot_id, int op,
 
 int jbod_hdd_led_control (int sg_fd, int slot_id, int op)
 {
-  struct ses_pages pages;
-  struct ses_status_info ses_status;
-  int page_two_size;
+  struct hdd_led_change change = {slot_id, HDD_LED_FAULT, op};
 
-  read_ses_pages(sg_fd, &pages, &page_two_size);
-  interpret_ses_pages(&pages, &ses_status);
-  if (slot_id < 0 || slot_id >= ses_status.slot_count) {
-    perr("Slot_id %d is invalid5\n", slot_id);
-    perr("Valid slot_ids [%d, %d]\n", 0,
-            ses_status.slot_count);
-    return EINVAL;
+  return jbod_hdd_leds_control(sg_fd, &change, 1);
+}
+
+/*
+ * apply all changes with one read and one write of SES page 0x02;
+ * nothing is written if any slot is invalid
+ */
+int jbod_hdd_leds_control (int sg_fd, struct hdd_led_change *changes,
+                           int count)
+{
+  struct ses_txn txn;
+  struct array_device_slot *slot;
+  int rc;
+  int i;
+
+  rc = ses_txn_begin(sg_fd, &txn);
+  if (0 != rc) {
+    return rc;
+  }
+
+  for (i = 0; i < count; ++i) {
+    if (changes[i].slot < 0 || changes[i].slot >= txn.status.slot_count) {
+      perr("Slot_id %d is invalid\n", changes[i].slot);
+      perr("Valid slot_ids [%d, %d]\n", 0,
+              txn.status.slot_count);
+      return EINVAL;
+    }
   }
-  control_hdd_led_fault(pages.page_two, ses_status.slots + slot_id, op);
-  return sg_send_ses_page(sg_fd, pages.page_two, page_two_size);
+
+  for (i = 0; i < count; ++i) {
+    slot = txn.status.slots + changes[i].slot;
+    if (changes[i].led == HDD_LED_IDENT)
+      rc = control_hdd_led_ident(&txn, slot, changes[i].op);
+    else
+      rc = control_hdd_led_fault(&txn, slot, changes[i].op);
+    if (0 != rc)
+      return rc;
+  }
+  return ses_txn_commit(&txn);
 }
 
 void jbod_power_cycle_enclosure(int sg_fd)
 {
-  struct ses_pages pages;
-  struct ses_status_info ses_status;
-  int page_two_size;
+  struct ses_txn txn;
   int ret;
 
-  read_ses_pages(sg_fd, &pages, &page_two_size);
-  interpret_ses_pages(&pages, &ses_status);
-  power_cycle_enclosure(
-    pages.page_two, &(ses_status.enclosure_control));
-  ret = sg_send_ses_page(sg_fd, pages.page_two, page_two_size);
+  ret = ses_txn_begin(sg_fd, &txn);
+  if (0 == ret) {
+    power_cycle_enclosure(&txn, &(txn.status.enclosure_control));
+    ret = ses_txn_commit(&txn);
+  }
   printf("sg_send returns: %d\n", ret);
 }
 
-int gpio_buffer_id = -1;
-int gpio_buffer_length = -1;
-char *(*gpio_descriptions)[3];
-
-void jbod_print_gpio(int sg_fd)
+void jbod_print_gpio(int sg_fd, const struct signal_buffer *gpio)
 {
+  const char *const (*descriptions)[3] = gpio->descriptions;
   unsigned char buf[SCSI_BUFFER_MAX_SIZE];
   int i;
 
-  if (gpio_buffer_id == -1 ||
-      gpio_buffer_length == -1 ||
-      gpio_descriptions == NULL) {
+  if (gpio->buffer_id == -1 ||
+      gpio->length == -1 ||
+      descriptions == NULL) {
     perr("GPIO reading is not supported.\n");
     return;
   }
 
-  scsi_read_buffer(sg_fd, gpio_buffer_id, 0,
-                   buf, gpio_buffer_length);
+  if (scsi_read_buffer(sg_fd, gpio->buffer_id, 0, buf, gpio->length) != 0) {
+    perr("Failed to read GPIO buffer.\n");
+    return;
+  }
 
-  for (i = 0; i < gpio_buffer_length; i ++) {
+  for (i = 0; i < gpio->length; i ++) {
 
-    if (gpio_descriptions[i][0])
+    if (descriptions[i][0])
       if (buf[i] == 0 || buf[i] == 1) {
 
         IF_PRINT_NONE_JSON
-          printf("%50s:\t%s (%d)\n", gpio_descriptions[i][0],
-                 gpio_descriptions[i][buf[i] + 1], buf[i]);
-
-        PRINT_JSON_GROUP_SEPARATE;
-        PRINT_JSON_GROUP_HEADER(gpio_descriptions[i][0]);
-        PRINT_JSON_ITEM("name", "%s", gpio_descriptions[i][0]);
-        PRINT_JSON_ITEM("status", "%s", gpio_descriptions[i][buf[i] + 1]);
-        PRINT_JSON_LAST_ITEM("val", "%d", buf[i]);
+          printf("%50s:\t%s (%d)\n", descriptions[i][0],
+                 descriptions[i][buf[i] + 1], buf[i]);
+
+        PRINT_JSON_GROUP_HEADER(descriptions[i][0]);
+        PRINT_JSON_ITEM("name", "%s", descriptions[i][0]);
+        PRINT_JSON_ITEM("status", "%s", descriptions[i][buf[i] + 1]);
+        PRINT_JSON_ITEM("val", "%d", buf[i]);
         PRINT_JSON_GROUP_ENDING;
       }
   }
 }
 
-int event_status_buffer_id = -1;
-int event_status_buffer_length = -1;
-char *(*event_status_descriptions)[3];
-
-void jbod_print_event_status(int sg_fd)
+int jbod_read_event_status(int sg_fd, const struct signal_buffer *status,
+                           unsigned char *buf)
 {
-  unsigned char *buf;
-  int i;
+  int length = status->length;
 
-  if (event_status_buffer_id == -1 ||
-      event_status_buffer_length == -1 ||
-      event_status_descriptions == NULL) {
+  if (status->buffer_id == -1 ||
+      status->length == -1 ||
+      status->descriptions == NULL) {
     perr("Event status reading is not supported.\n");
-    return;
+    return 0;
   }
-  buf = (unsigned char *) malloc(event_status_buffer_length);
-  scsi_read_buffer(sg_fd, event_status_buffer_id, 0,
-                   buf, event_status_buffer_length);
-  for (i = 0; i < event_status_buffer_length; i ++) {
-    if (event_status_descriptions[i][0])
+  if (length > EVENT_STATUS_MAX_COUNT)
+    length = EVENT_STATUS_MAX_COUNT;
+  if (scsi_read_buffer(sg_fd, status->buffer_id, 0, buf, length) != 0) {
+    perr("Failed to read event status buffer.\n");
+    return 0;
+  }
+  return length;
+}
+
+void jbod_print_event_status(int sg_fd, const struct signal_buffer *status)
+{
+  const char *const (*descriptions)[3] = status->descriptions;
+  unsigned char buf[EVENT_STATUS_MAX_COUNT];
+  int length;
+  int i;
+
+  length = jbod_read_event_status(sg_fd, status, buf);
+  for (i = 0; i < length; i ++) {
+    if (descriptions[i][0])
       if (buf[i] == 0 || buf[i] == 1) {
         IF_PRINT_NONE_JSON
-          printf("%s:\t%s (%d)\n", event_status_descriptions[i][0],
-                 event_status_descriptions[i][buf[i] + 1], buf[i]);
-
-        PRINT_JSON_GROUP_SEPARATE;
+          printf("%s:\t%s (%d)\n", descriptions[i][0],
+                 descriptions[i][buf[i] + 1], buf[i]);
 
-        PRINT_JSON_GROUP_HEADER(event_status_descriptions[i][0]);
-        PRINT_JSON_ITEM("name", "%s", event_status_descriptions[i][0]);
+        PRINT_JSON_GROUP_HEADER(descriptions[i][0]);
+        PRINT_JSON_ITEM("name", "%s", descriptions[i][0]);
         PRINT_JSON_ITEM("status", "%s",
-                        event_status_descriptions[i][buf[i] + 1]);
-        PRINT_JSON_LAST_ITEM("value", "%d", buf[i]);
+                        descriptions[i][buf[i] + 1]);
+        PRINT_JSON_ITEM("value", "%d", buf[i]);
         PRINT_JSON_GROUP_ENDING;
       }
   }
-  free(buf);
 }
 
+int jbod_print_event_status_changes(int sg_fd, const char *devname,
+                                    const struct signal_buffer *status)
+{
+  unsigned char buf[EVENT_STATUS_MAX_COUNT];
+  int length;
+
+  length = jbod_read_event_status(sg_fd, status, buf);
+  if (length == 0)
+    return -1;
+  return print_event_status_changes(sg_fd, devname, status->buffer_id,
+                                    buf, length, status->descriptions);
+}
 
-int asset_tag_count = 0;
-struct scsi_buffer_parameter ** asset_tag_list = NULL;
-
-void jbod_print_asset_tag(int sg_fd)
+void jbod_print_asset_tag(int sg_fd,
+                          const struct scsi_buffer_parameter *const *tags,
+                          int count)
 {
+  const struct scsi_buffer_parameter *wanted[count + 1];
+  struct scsi_buffer_plan plan;
   int i;
+
+  scsi_buffer_plan_read(sg_fd, wanted,
+                        select_wanted_values(tags, count, wanted), &plan);
   IF_PRINT_NONE_JSON printf("ID\tName\tValue\n");
-  for (i = 0; i < asset_tag_count; i++) {
+  for (i = 0; i < count; i++) {
     IF_PRINT_NONE_JSON printf("%d\t", i);
-    PRINT_JSON_GROUP_SEPARATE;
-    print_read_value(sg_fd, asset_tag_list[i]);
+    print_planned_value(sg_fd, &plan, tags[i]);
   }
+  scsi_buffer_plan_free(&plan);
 }
 
-void jbod_set_asset_tag(int sg_fd, int tag_id, char *tag)
+void jbod_set_asset_tag(int sg_fd,
+                        const struct scsi_buffer_parameter *const *tags,
+                        int count, int tag_id, char *tag)
 {
   int len;
 
-  if (asset_tag_list == NULL || asset_tag_count == -1) {
+  if (tags == NULL || count <= 0) {
     perr("Asset set is not supported.\n");
+    return;
   }
-  if (tag_id >= asset_tag_count) {
+  if (tag_id < 0 || tag_id >= count) {
     perr("Invalid tag ID: %d\n", tag_id);
     return;
   }
 
-  len = asset_tag_list[tag_id]->len;
+  len = tags[tag_id]->len;
 
   if (len > strlen(tag))
     len = strlen(tag);
 
-  scsi_write_buffer(sg_fd, asset_tag_list[tag_id]->buf_id,
-                    asset_tag_list[tag_id]->buf_offset,
+  scsi_write_buffer(sg_fd, tags[tag_id]->buf_id, tags[tag_id]->buf_offset,
                     (unsigned char*) tag, len);
+  invalidate_short_profile(sg_fd);
   perr("Updated tag ID: %d\n", tag_id);
 }
 
-void jbod_set_asset_tag_by_name(int sg_fd, char *tag_name, char *tag)
+void jbod_set_asset_tag_by_name(int sg_fd,
+                                const struct scsi_buffer_parameter *const *tags,
+                                int count, char *tag_name, char *tag)
 {
   int i;
 
-  if (asset_tag_list == NULL || asset_tag_count == -1) {
+  if (tags == NULL || count <= 0) {
     perr("Asset set is not supported.\n");
     return;
   }
 
-  for (i = 0; i < asset_tag_count; i++) {
-    if (strcmp(tag_name, asset_tag_list[i]->name) == 0) {
-      jbod_set_asset_tag(sg_fd, i, tag);
+  for (i = 0; i < count; i++) {
+    if (strcmp(tag_name, tags[i]->name) == 0) {
+      jbod_set_asset_tag(sg_fd, tags, count, i, tag);
       return;
     }
   }
   perr("Invalid tag: %s\n", tag_name);
 }
 
-struct led_info *jbod_leds = NULL;
-int jbod_led_buffer_length = -1;
-int jbod_led_buffer_id = -1;
-
-void jbod_print_sys_led(int sg_fd)
+void jbod_print_sys_led(int sg_fd, struct led_state *state)
 {
-  unsigned char *buf;
-  int i;
-  if (jbod_led_buffer_id == -1 || jbod_led_buffer_length == -1) {
+  if (state->buffer_id == -1 || state->count == -1) {
     perr("LED reading is not supported.\n");
     return;
   }
-  buf = (unsigned char *) malloc(jbod_led_buffer_length);
-  scsi_read_buffer(sg_fd, jbod_led_buffer_id, 0, buf, jbod_led_buffer_length);
-
-  IF_PRINT_NONE_JSON {
-    printf("%s\t%s\t%s\n", "ID", "Name", "Status");
-  }
-
-  for (i = 0; i < jbod_led_buffer_length; i ++) {
-    jbod_leds[i].status = buf[i];
-    print_led(i, jbod_leds + i);
-  }
-  free(buf);
+  if (read_led_state(sg_fd, state) != 0)
+    return;
+  print_led_state(state);
 }
 
 void jbod_control_sys_led(int sg_fd, int led_id, int value)
@@ -804,68 +1128,85 @@ void jbod_control_sys_led(int sg_fd, int led_id, int value)
   perr("Sorry, led control is not supported.\n");
 }
 
-struct config_item all_configs[3] = {
-  {-1, -1, "Power Window", NULL, NULL},
-  {-1, -1, "HDD Temperature Interval", NULL, NULL},
-  {-1, -1, "Fan Profile", NULL, NULL}};
+static int config_supported(const struct config_item *config)
+{
+  return config->buffer_id != -1 && config->buffer_offset != -1;
+}
+
+void jbod_read_configs(int sg_fd, const struct config_item *configs,
+                       int values[])
+{
+  unsigned char buf[SCSI_BUFFER_MAX_SIZE];
+  int len;
+  int i, j;
+
+  for (i = 0; i < CONFIG_ITEM_COUNT; ++i)
+    values[i] = -1;
+
+  for (i = 0; i < CONFIG_ITEM_COUNT; ++i) {
+    if (!config_supported(configs + i) || values[i] != -1)
+      continue;
+
+    /* one read covers all items of the buffer */
+    len = 0;
+    for (j = i; j < CONFIG_ITEM_COUNT; ++j) {
+      if (config_supported(configs + j) &&
+          configs[j].buffer_id == configs[i].buffer_id &&
+          configs[j].value_offset + 1 > len)
+        len = configs[j].value_offset + 1;
+    }
+    if (len > SCSI_BUFFER_MAX_SIZE ||
+        scsi_read_buffer(sg_fd, configs[i].buffer_id, 0, buf, len) != 0)
+      continue;
+    for (j = i; j < CONFIG_ITEM_COUNT; ++j) {
+      if (config_supported(configs + j) &&
+          configs[j].buffer_id == configs[i].buffer_id)
+        values[j] = buf[configs[j].value_offset];
+    }
+  }
+}
 
-void jbod_show_config(int sg_fd)
+void jbod_show_config(int sg_fd, const struct config_item *configs)
 {
+  int values[CONFIG_ITEM_COUNT];
   int i;
-  unsigned char buf[1];
-
-  for (i = 0; i < 3; i ++) {
-    if (all_configs[i].show_func)
-      all_configs[i].show_func(sg_fd, all_configs + i);
-    else if (all_configs[i].buffer_id != -1 &&
-        all_configs[i].buffer_offset != -1) {
-      scsi_read_buffer(sg_fd, all_configs[i].buffer_id,
-                       0, buf, all_configs[i].buffer_offset + 1);
-      IF_PRINT_NONE_JSON printf("%s:\t %d\n", all_configs[i].name,
-                                buf[all_configs[i].buffer_offset]);
-
-      PRINT_JSON_GROUP_SEPARATE;
-      PRINT_JSON_GROUP_HEADER(all_configs[i].name);
-      PRINT_JSON_ITEM("name", "%s", all_configs[i].name);
-      PRINT_JSON_LAST_ITEM("value", "%d", buf[all_configs[i].buffer_offset]);
-      PRINT_JSON_GROUP_ENDING;
 
+  jbod_read_configs(sg_fd, configs, values);
+  for (i = 0; i < CONFIG_ITEM_COUNT; i ++) {
+    if (!config_supported(configs + i))
+      continue;
+    if (values[i] == -1) {
+      perr("Failed to read %s.\n", configs[i].name);
+      continue;
     }
+    IF_PRINT_NONE_JSON printf("%s:\t %d\n", configs[i].name, values[i]);
+
+    PRINT_JSON_GROUP_HEADER(configs[i].name);
+    PRINT_JSON_ITEM("name", "%s", configs[i].name);
+    PRINT_JSON_ITEM("value", "%d", values[i]);
+    PRINT_JSON_GROUP_ENDING;
   }
 }
 
-void change_config(int sg_fd, int val, struct config_item *config)
+void change_config(int sg_fd, int val, const struct config_item *config)
 {
   unsigned char buf[1] = {((unsigned char)(val & 0xff))};
   if (config->change_func)
     config->change_func(sg_fd, val, config);
-  else if (config->buffer_id != -1 &&
-      config->buffer_offset != -1) {
+  else if (config_supported(config)) {
     scsi_write_buffer(sg_fd, config->buffer_id, config->buffer_offset, buf, 1);
   } else {
     printf("Sorry, this command is not supported.\n");
   }
 }
 
-void jbod_config_power_window(int sg_fd, int val)
-{
-  change_config(sg_fd, val, all_configs);
-}
-
-void jbod_config_hdd_temp_interval(int sg_fd, int val)
+/* the interval is the last byte of a 4-byte write from offset 0 */
+void jbod_change_hdd_temp_interval(int sg_fd, int val,
+                                   const struct config_item *config)
 {
   unsigned char buf[4] = {0, 0, 0, ((unsigned char)(val & 0xff))};
-  if (all_configs[1].buffer_id != -1 &&
-      all_configs[1].buffer_offset != -1) {
-    scsi_write_buffer(sg_fd, all_configs[1].buffer_id, 0, buf, 4);
-  } else {
-    printf("Sorry, this command is not supported.\n");
-  }
-}
 
-void jbod_config_fan_profile(int sg_fd, int val)
-{
-  change_config(sg_fd, val, all_configs + 2);
+  scsi_write_buffer(sg_fd, config->buffer_id, 0, buf, 4);
 }
 
 void jbod_identify_enclosure(int sg_fd, int val)
@@ -897,7 +1238,7 @@ void jbod_print_profile(struct jbod_profile *profile)
   PRINT_JSON_ITEM("fw version", "%s", profile->specific);
 }
 
-struct jbod_short_profile jbod_get_short_profile (char *devname)
+struct jbod_short_profile jbod_get_short_profile (int sg_fd)
 {
   struct jbod_short_profile p = {"N/A", "N/A", "N/A"};
   return p;
@@ -49,8 +49,14 @@ struct jbod_device {
   char sg_device[PATH_MAX];
   char bsg_device[PATH_MAX];
   struct jbod_short_profile short_profile;
+  struct jbod_interface *interface;
 };
 
+struct hdd_led_change;
+struct scsi_buffer_parameter;
+struct metrics_profile;
+struct signal_buffer;
+
 typedef struct jbod_interface {
   /* enclosure info */
   void (*print_enclosure_info) (int sg_fd);
@@ -68,6 +74,8 @@ typedef struct jbod_interface {
   void (*print_hdd_info) (int sg_fd);
   int (*hdd_power_control) (int sg_fd, int slot, int op, int timeout, int cold_storage);
   int (*hdd_led_control) (int sg_fd, int slot, int op);
+  int (*hdd_leds_control) (int sg_fd, struct hdd_led_change *changes,
+                           int count);
 
   /* fan info and control */
   void (*print_fan_info)(int sg_fd);
@@ -77,6 +85,8 @@ typedef struct jbod_interface {
   void (*set_asset_tag) (int sg_fd, int tag_id, char *tag);
   void (*set_asset_tag_by_name) (int sg_fd, char *tag_name, char *tag);
   void (*print_asset_tag) (int sg_fd);
+  /* all tags of the enclosure; return the count */
+  int (*get_asset_tags) (const struct scsi_buffer_parameter *const **tags);
 
   /* power cycle enclosure */
   void (*power_cycle_enclosure)(int sg_fd);
@@ -86,7 +96,14 @@ typedef struct jbod_interface {
 
   /* event log and status */
   void (*print_event_log) (int sg_fd);
+  /* stream events newer than the last call as NDJSON */
+  int (*print_new_events) (int sg_fd, const char *devname);
   void (*print_event_status) (int sg_fd);
+  /*
+   * print event status changes since the last call; return their count,
+   * or -1 if the status cannot be read
+   */
+  int (*print_event_status_changes) (int sg_fd, const char *devname);
 
   /* system led read and control */
   void (*print_sys_led) (int sg_fd);
@@ -97,6 +114,8 @@ typedef struct jbod_interface {
   void (*config_power_window) (int sg_fd, int val);
   void (*config_hdd_temp_interval) (int sg_fd, int val);
   void (*config_fan_profile) (int sg_fd, int val);
+  /* all CONFIG_ITEM_COUNT items, in the order of enum config_item_id */
+  const struct config_item *(*get_configs) (void);
 
   /* set identify LED of the enclosure, val=1 id on, val=0 id off */
   void (*identify_enclosure) (int sg_fd, int val);
@@ -105,13 +124,20 @@ typedef struct jbod_interface {
   void (*print_phyerr) (int sg_fd);
   void (*reset_phyerr) (int sg_fd);
 
+  /* vendor buffers of the metrics, besides the SES pages */
+  const struct metrics_profile *(*get_metrics_profile) (void);
+
   /* print jbod profile */
   void (*print_profile) (struct jbod_profile *profile);
 
-  struct jbod_short_profile (*get_short_profile) (char *devname);
+  struct jbod_short_profile (*get_short_profile) (int sg_fd);
 
   void (*print_pwm)(int sg_fd);
   void (*print_cfm)(int sg_fd);
+
+  /* the event status and GPIO buffers, for reading them apart from printing */
+  const struct signal_buffer *(*get_event_status) (void);
+  const struct signal_buffer *(*get_gpio) (void);
 } jbod_interface_t;
 
 extern struct jbod_interface knox;
@@ -125,17 +151,62 @@ extern int library_size;
 /* check device and figure out which jbod_interface it is */
 extern struct jbod_interface *detect_dev(const char *devname);
 
+/*
+ * keep detected interfaces and SES pages between commands, until an
+ * enclosure is written to (see ses_keep_snapshots()); for batch
+ */
+extern void jbod_keep_snapshots(int keep);
+
+/* forget what devices were detected as, e.g. after hot plugs */
+extern void jbod_drop_detected(void);
+
+typedef void (*jbod_detected_fn)(const char *devname,
+                                 struct jbod_interface *interface, void *arg);
+
+/*
+ * call fn with every kept detection, locked meanwhile, and keep one made
+ * by another process; interface is NULL for devices that are not JBODs.
+ * For ocpjbodd, whose processes are forks of one another.
+ */
+extern void jbod_foreach_detected(jbod_detected_fn fn, void *arg);
+extern void jbod_keep_detected(const char *devname,
+                               struct jbod_interface *interface);
+
 /* extrace the jbod_profile from device name */
 extern struct jbod_profile *extract_profile(const char *devname);
 
-/* list all supported JBODs */
-extern int lib_list_jbod(struct jbod_device[MAX_JBOD_PER_HOST]);
+/* list all supported JBODs, probing up to max_parallel devices at a time */
+extern int lib_list_jbod(struct jbod_device[MAX_JBOD_PER_HOST],
+                         int max_parallel);
 
 extern void print_list_of_jbod(struct jbod_device[MAX_JBOD_PER_HOST], int, int);
 
+/* short profiles are cached in the enclosure cache for this long */
+#define SHORT_PROFILE_CACHE_TTL 86400
+
+/*
+ * fill short_profile of all devices, up to max_parallel at a time, from
+ * the enclosure cache when possible
+ */
+extern void lib_fetch_short_profiles(struct jbod_device devices[], int count,
+                                     int max_parallel);
+
+/* drop the cached short profile, after a tag was written */
+extern void invalidate_short_profile(int sg_fd);
+
 /* fetch SES pages and extract information */
 struct ses_status_info;
 extern int fetch_ses_status(int sg_fd, struct ses_status_info *ses_info);
+/* skip the parts of SES_FETCH_ALL not in what */
+extern int fetch_ses_status_of(int sg_fd, struct ses_status_info *ses_info,
+                               int what);
+/*
+ * read the SES pages of devname into the snapshots kept with
+ * ses_keep_snapshots(), for printers called later; return the read error
+ */
+extern int jbod_prefetch_ses(const char *devname, int what);
+/* free the names allocated by fetch_ses_status() */
+extern void free_ses_status(struct ses_status_info *ses_info);
 
 /* default functions for different JBODs */
 
@@ -150,6 +221,8 @@ extern void jbod_print_hdd_info (int sg_fd);
 extern int jbod_hdd_power_control (int sg_fd, int slot_id, int op, int timeout,
   int cold_storage);
 extern int jbod_hdd_led_control (int sg_fd, int slot_id, int op);
+extern int jbod_hdd_leds_control (int sg_fd, struct hdd_led_change *changes,
+                                  int count);
 
 extern int jbod_hdd_power_on_with_timeout(int sg_fd, int slot_id, int timeout,
   int cold_storage);
@@ -159,54 +232,93 @@ extern int jbod_hdd_power_off_with_timeout(int sg_fd, int slot_id, int timeout,
 extern void jbod_print_all_sensor_reading(int sg_fd, int print_thresholds);
 
 extern void jbod_print_fan_info(int sg_fd);
-extern int fan_pwm_buffer_id;
-extern int fan_pwm_buffer_offset;
-extern void jbod_control_fan_pwm(int sg_fd, int pwm);
+/*
+ * write pwm to every fan byte of a vendor buffer, whose first byte at
+ * buffer_offset is the count of fans
+ */
+extern void jbod_control_fan_pwm(int sg_fd, int buffer_id, int buffer_offset,
+                                 int pwm);
 
-extern int asset_tag_count;
-extern struct scsi_buffer_parameter ** asset_tag_list;
-extern void jbod_print_asset_tag(int sg_fd);
-extern void jbod_set_asset_tag(int sg_fd, int tag_id, char *tag);
-extern void jbod_set_asset_tag_by_name(int sg_fd, char *tag_name, char *tag);
+/*
+ * the defaults take the vendor tables as arguments, so enclosures of
+ * different types may be served at the same time
+ */
+extern void jbod_print_asset_tag(
+  int sg_fd, const struct scsi_buffer_parameter *const *tags, int count);
+extern void jbod_set_asset_tag(int sg_fd,
+                               const struct scsi_buffer_parameter *const *tags,
+                               int count, int tag_id, char *tag);
+extern void jbod_set_asset_tag_by_name(
+  int sg_fd, const struct scsi_buffer_parameter *const *tags, int count,
+  char *tag_name, char *tag);
 
 extern void jbod_power_cycle_enclosure(int sg_fd);
 
-extern int gpio_buffer_id;
-extern int gpio_buffer_length;
-extern char *(*gpio_descriptions)[3];
-extern void jbod_print_gpio(int sg_fd);
+/* a vendor buffer with one byte, 0 or 1, per signal, e.g. the GPIOs */
+struct signal_buffer {
+  int buffer_id;
+  int length;
+  /* per signal: its name, or NULL if unused, then the meaning of 0 and 1 */
+  const char *const (*descriptions)[3];
+};
+
+extern void jbod_print_gpio(int sg_fd, const struct signal_buffer *gpio);
 
-extern int event_status_buffer_id;
-extern int event_status_buffer_length;
-extern char *(*event_status_descriptions)[3];
-extern void jbod_print_event_status(int sg_fd);
+/* read the buffer of status into buf; return its length, or 0 on failure */
+extern int jbod_read_event_status(int sg_fd,
+                                  const struct signal_buffer *status,
+                                  unsigned char *buf);
+extern void jbod_print_event_status(int sg_fd,
+                                    const struct signal_buffer *status);
+extern int jbod_print_event_status_changes(int sg_fd, const char *devname,
+                                           const struct signal_buffer *status);
 
-extern struct led_info *jbod_leds;
-extern int jbod_led_buffer_length;
-extern int jbod_led_buffer_id;
-extern void jbod_print_sys_led(int sg_fd);
+/* read the LEDs laid out in state, see struct led_state, and print them */
+struct led_state;
+extern void jbod_print_sys_led(int sg_fd, struct led_state *state);
 extern void jbod_control_sys_led(int sg_fd, int led_id, int value);
 
+#define CONFIG_ITEM_COUNT 3
+
 struct config_item {
   int buffer_id;
   int buffer_offset;
+  int value_offset;     /* of the value, in a read from offset 0 */
   char *name;
-  void (*show_func)(int sg_fd, struct config_item *config);
-  void (*change_func)(int sg_fd, int val, struct config_item *config);
+  void (*change_func)(int sg_fd, int val, const struct config_item *config);
+};
+
+/* the order of the items of every table */
+enum config_item_id {
+  CONFIG_POWER_WINDOW,
+  CONFIG_HDD_TEMP_INTERVAL,
+  CONFIG_FAN_PROFILE
 };
 
-extern struct config_item all_configs[3];
+/*
+ * read all CONFIG_ITEM_COUNT items of configs, with one command per
+ * buffer; values of unsupported or unreadable items are -1
+ */
+extern void jbod_read_configs(int sg_fd, const struct config_item *configs,
+                              int values[]);
+extern void change_config(int sg_fd, int val,
+                          const struct config_item *config);
+extern void jbod_change_hdd_temp_interval(int sg_fd, int val,
+                                          const struct config_item *config);
 
-extern void jbod_show_config(int sg_fd);
-extern void jbod_config_power_window(int sg_fd, int val);
-extern void jbod_config_hdd_temp_interval(int sg_fd, int val);
-extern void jbod_config_fan_profile(int sg_fd, int val);
+extern void jbod_show_config(int sg_fd, const struct config_item *configs);
 
 extern void jbod_identify_enclosure(int sg_fd, int val);
 extern void jbod_print_phyerr(int sg_fd);
 extern void jbod_reset_phyerr(int sg_fd);
 
+struct metrics_profile {
+  const struct scsi_buffer_parameter *power;    /* NULL if not supported */
+  int phyerr_buffer_id;                         /* -1 if not supported */
+  int phyerr_phy_count;
+};
+
 extern void jbod_print_profile(struct jbod_profile *profile);
 
-extern struct jbod_short_profile jbod_get_short_profile (char *devname);
+extern struct jbod_short_profile jbod_get_short_profile (int sg_fd);
 #endif
@@ -20,8 +20,6 @@
 #include "jbof_interface.h"
 #include "json.h"
 
-#include "lightning.c"
-
 #define SCSI_BUFFER_MAX_SIZE 64
 
 static const char *pci_devs_path = "/sys/bus/pci/devices/";
@@ -132,10 +130,10 @@ int list_jbof(char jbof_names[MAX_JBOF_PER_HOST][PATH_MAX],
     closedir(dir);
   }
   if (!quiet && print_json) {
-    // strip off outer { and }
+    // strip off outer { and }, the writer joins them with the jbods
     char *jstr = strdup(json_object_get_string(enclosure_list));
     jstr[strlen(jstr) - 1] = 0;
-    printf("%s\n", jstr + 1);
+    json_members(jstr + 1);
     free(jstr);
   }
   json_object_put(enclosure_list);
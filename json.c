@@ -9,53 +9,769 @@
 
 #include "json.h"
 
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#define JSON_INITIAL_SIZE 4096
+
+/* a field of --fields, split at '/' */
+struct json_field {
+  char *parts[JSON_MAX_DEPTH];
+  int count;
+};
+
+struct json_writer {
+  char *buf;
+  size_t len;
+  size_t size;
+  int failed;                               /* out of memory */
+  int depth;                                /* 0 outside a document */
+  int implicit;                             /* NDJSON line, no json_begin */
+  int record;                               /* json_record_begin() */
+  unsigned char has_members[JSON_MAX_DEPTH];
+  unsigned char is_array[JSON_MAX_DEPTH];
+  /* with --fields, to match paths and to drop groups left empty */
+  char *keys[JSON_MAX_DEPTH];
+  size_t starts[JSON_MAX_DEPTH];
+  unsigned char parent_had[JSON_MAX_DEPTH];
+};
 
-int do_new_item = 0;
 int print_json = 0;
+int print_ndjson = 0;
+int print_cbor = 0;
+
+/* set while parsing options, before any thread prints */
+static struct json_field fields[JSON_MAX_FIELDS];
+static int field_count = 0;
+static char *field_list = NULL;
+
+/* one writer per thread, so enclosures can be printed in parallel */
+static __thread struct json_writer writer;
+
+/* the document a record interrupts */
+static __thread struct json_writer outer_writer;
+
+/* NDJSON lines of different threads must not interleave */
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* records are always JSON text */
+static int writing_cbor(void)
+{
+  return print_cbor && !writer.record;
+}
+
+static int reserve(size_t extra)
+{
+  size_t size;
+  char *buf;
+
+  if (writer.failed)
+    return -1;
+  if (writer.len + extra <= writer.size)
+    return 0;
+  size = writer.size ? writer.size : JSON_INITIAL_SIZE;
+  while (size < writer.len + extra)
+    size <<= 1;
+  buf = realloc(writer.buf, size);
+  if (buf == NULL) {
+    writer.failed = 1;
+    return -1;
+  }
+  writer.buf = buf;
+  writer.size = size;
+  return 0;
+}
+
+static void append(const char *s, size_t len)
+{
+  if (reserve(len) != 0)
+    return;
+  memcpy(writer.buf + writer.len, s, len);
+  writer.len += len;
+}
+
+static void append_str(const char *s)
+{
+  append(s, strlen(s));
+}
+
+/* bytes needed to escape c, beyond the byte itself */
+static int escape_extra(unsigned char c)
+{
+  if (c == '"' || c == '\\' || c == '\b' || c == '\f' || c == '\n' ||
+      c == '\r' || c == '\t')
+    return 1;
+  if (c < 0x20 || c >= 0x7f)
+    return 5;                               /* \u00XX, as Latin-1 */
+  return 0;
+}
+
+/* escape writer.buf[start, len) in place, from the back */
+static void escape_tail(size_t start)
+{
+  static const char hex[] = "0123456789abcdef";
+  size_t extra = 0;
+  size_t i, j;
+  unsigned char c;
+
+  for (i = start; i < writer.len; ++i)
+    extra += escape_extra(writer.buf[i]);
+  if (extra == 0 || reserve(extra) != 0)
+    return;
 
-char* str_escape(const char* src) {
-  size_t i, j, max_len = 256;
-  char *dst;
-
-  dst = malloc(max_len);
-  if (dst == NULL)
-    return dst;
-
-  for (i = 0, j = 0; src[i]; ++i) {
-    if (j + 6 >= max_len) {
-      max_len = max_len << 1;
-      dst = realloc(dst, max_len);
-      if (dst == NULL) {
-        return dst;
-      }
+  i = writer.len;
+  j = writer.len + extra;
+  writer.len = j;
+  while (i > start) {
+    c = writer.buf[--i];
+    switch (escape_extra(c)) {
+    case 0:
+      writer.buf[--j] = c;
+      continue;
+    case 1:
+      writer.buf[--j] = c == '\b' ? 'b' : c == '\f' ? 'f' : c == '\n' ? 'n' :
+                        c == '\r' ? 'r' : c == '\t' ? 't' : c;
+      break;
+    default:
+      writer.buf[--j] = hex[c & 0xf];
+      writer.buf[--j] = hex[c >> 4];
+      writer.buf[--j] = '0';
+      writer.buf[--j] = '0';
+      writer.buf[--j] = 'u';
+      break;
     }
-    // ASCII
-    if (src[i] >= ' ' && src[i] < 127 && src[i] != '\"' && src[i] != '\\') {
-      dst[j] = src[i];
-      ++j;
+    writer.buf[--j] = '\\';
+  }
+}
+
+static void append_escaped(const char *s)
+{
+  size_t start = writer.len;
+
+  append_str(s);
+  if (!writer.failed)
+    escape_tail(start);
+}
+
+/* format straight into the buffer; returns where the text starts */
+static size_t append_v(const char *fmt, va_list ap)
+{
+  size_t start = writer.len;
+  va_list copy;
+  int n;
+
+  if (reserve(1) != 0)
+    return start;
+  va_copy(copy, ap);
+  n = vsnprintf(writer.buf + writer.len, writer.size - writer.len, fmt, copy);
+  va_end(copy);
+  if (n < 0)
+    return start;
+  if ((size_t) n >= writer.size - writer.len) {
+    if (reserve(n + 1) != 0)
+      return start;
+    vsnprintf(writer.buf + writer.len, writer.size - writer.len, fmt, ap);
+  }
+  writer.len += n;
+  return start;
+}
+
+/*
+ * CBOR (RFC 8949). Groups and arrays have indefinite length, so nothing
+ * needs to be counted ahead.
+ */
+#define CBOR_UINT         0
+#define CBOR_NEGATIVE     1
+#define CBOR_BYTES        2
+#define CBOR_TEXT         3
+#define CBOR_TAG          6
+#define CBOR_MAP_BEGIN    0xbf
+#define CBOR_ARRAY_BEGIN  0x9f
+#define CBOR_FLOAT32      0xfa
+#define CBOR_FLOAT64      0xfb
+#define CBOR_BREAK        0xff
+#define CBOR_TAG_JSON     262                 /* embedded JSON, bytes */
+
+static int cbor_encode_head(unsigned char *head, int major, uint64_t value)
+{
+  int bytes, i;
+
+  if (value < 24) {
+    head[0] = major << 5 | value;
+    return 1;
+  }
+  bytes = value <= 0xff ? 1 : value <= 0xffff ? 2 : value <= 0xffffffff ? 4 : 8;
+  head[0] = major << 5 | (bytes == 1 ? 24 : bytes == 2 ? 25 :
+                          bytes == 4 ? 26 : 27);
+  for (i = 0; i < bytes; ++i)
+    head[bytes - i] = value >> (i * 8);
+  return bytes + 1;
+}
+
+static void cbor_head(int major, uint64_t value)
+{
+  unsigned char head[9];
+
+  append((const char *) head, cbor_encode_head(head, major, value));
+}
+
+static void cbor_byte(unsigned char byte)
+{
+  append((const char *) &byte, 1);
+}
+
+static void cbor_int(long long value)
+{
+  if (value >= 0)
+    cbor_head(CBOR_UINT, value);
+  else
+    cbor_head(CBOR_NEGATIVE, -1 - value);
+}
+
+static void cbor_double(double value)
+{
+  unsigned char out[9];
+  union { float f; uint32_t u; } f32;
+  union { double d; uint64_t u; } f64;
+  int i;
+
+  f32.f = (float) value;
+  if ((double) f32.f == value) {
+    out[0] = CBOR_FLOAT32;
+    for (i = 0; i < 4; ++i)
+      out[4 - i] = f32.u >> (i * 8);
+    append((const char *) out, 5);
+    return;
+  }
+  f64.d = value;
+  out[0] = CBOR_FLOAT64;
+  for (i = 0; i < 8; ++i)
+    out[8 - i] = f64.u >> (i * 8);
+  append((const char *) out, 9);
+}
+
+/*
+ * make writer.buf[start, len) a CBOR text string in place, from the back.
+ * Bytes above 0x7f are Latin-1, as in the JSON output, and become UTF-8.
+ */
+static void cbor_text_tail(size_t start)
+{
+  unsigned char head[9];
+  size_t extra = 0;
+  size_t i, j;
+  unsigned char c;
+  int h;
+
+  if (writer.failed)
+    return;
+  for (i = start; i < writer.len; ++i)
+    extra += (unsigned char) writer.buf[i] >= 0x80;
+  h = cbor_encode_head(head, CBOR_TEXT, writer.len - start + extra);
+  if (reserve(h + extra) != 0)
+    return;
+
+  i = writer.len;
+  j = writer.len + h + extra;
+  writer.len = j;
+  while (i > start) {
+    c = writer.buf[--i];
+    if (c < 0x80) {
+      writer.buf[--j] = c;
     } else {
-      // Special cases
-      dst[j]='\\';
-      ++j;
-      switch (src[i]) {
-      case '\"': dst[j]='\"'; ++j; break;
-      case '\\': dst[j]='\\'; ++j; break;
-      case '\b': dst[j]='b'; ++j; break;
-      case '\f': dst[j]='f'; ++j; break;
-      case '\n': dst[j]='n'; ++j; break;
-      case '\r': dst[j]='r'; ++j; break;
-      case '\t': dst[j]='t'; ++j; break;
-      default:
-        // Assume Latin-1 encoding
-        snprintf(&dst[j], 5, "u%04x", *src);
-        j += 5;
+      writer.buf[--j] = 0x80 | (c & 0x3f);
+      writer.buf[--j] = 0xc0 | (c >> 6);
+    }
+  }
+  memcpy(writer.buf + start, head, h);
+}
+
+static void cbor_text(const char *s)
+{
+  size_t start = writer.len;
+
+  append_str(s);
+  cbor_text_tail(start);
+}
+
+/* JSON serialized elsewhere, as a tagged byte string */
+static void cbor_json(const char *prefix, const char *json, const char *suffix)
+{
+  cbor_head(CBOR_TAG, CBOR_TAG_JSON);
+  cbor_head(CBOR_BYTES, strlen(prefix) + strlen(json) + strlen(suffix));
+  append_str(prefix);
+  append_str(json);
+  append_str(suffix);
+}
+
+/*
+ * the conversion of fmt if fmt is a single numeric conversion, e.g. "%d"
+ * or "%.2f", else 0. *longs is the count of 'l', or 3 for 'z'.
+ */
+static char numeric_conversion(const char *fmt, int *longs)
+{
+  if (*fmt++ != '%')
+    return 0;
+  fmt += strspn(fmt, "-+ #0");
+  fmt += strspn(fmt, "0123456789");
+  if (*fmt == '.') {
+    ++fmt;
+    fmt += strspn(fmt, "0123456789");
+  }
+  *longs = 0;
+  if (*fmt == 'z') {
+    *longs = 3;
+    ++fmt;
+  } else {
+    while (*fmt == 'h')
+      ++fmt;
+    while (*fmt == 'l' && *longs < 2) {
+      ++*longs;
+      ++fmt;
+    }
+  }
+  if (*fmt == '\0' || fmt[1] != '\0' || strchr("diouxXfFeEgG", *fmt) == NULL)
+    return 0;
+  return *fmt;
+}
+
+/* a typed number for numeric formats, else the formatted text */
+static void cbor_value_v(const char *fmt, va_list ap)
+{
+  int longs;
+  char conversion = numeric_conversion(fmt, &longs);
+
+  if (conversion == 'd' || conversion == 'i') {
+    cbor_int(longs == 3 ? (long long) va_arg(ap, ssize_t) :
+             longs == 2 ? va_arg(ap, long long) :
+             longs == 1 ? va_arg(ap, long) : va_arg(ap, int));
+  } else if (conversion != 0 && strchr("ouxX", conversion) != NULL) {
+    cbor_head(CBOR_UINT,
+              longs == 3 ? va_arg(ap, size_t) :
+              longs == 2 ? va_arg(ap, unsigned long long) :
+              longs == 1 ? va_arg(ap, unsigned long) :
+              va_arg(ap, unsigned int));
+  } else if (conversion != 0) {
+    cbor_double(va_arg(ap, double));
+  } else {
+    cbor_text_tail(append_v(fmt, ap));
+  }
+}
+
+int json_select_fields(const char *list)
+{
+  struct json_field *field;
+  char *save, *part_save, *name, *part;
+
+  /* options are parsed twice; the last list wins */
+  free(field_list);
+  field_count = 0;
+  field_list = strdup(list);
+  if (field_list == NULL) {
+    perr("Cannot allocate memory.\n");
+    return -1;
+  }
+  for (name = strtok_r(field_list, ",", &save); name != NULL;
+       name = strtok_r(NULL, ",", &save)) {
+    if (field_count == JSON_MAX_FIELDS) {
+      perr("At most %d fields can be selected.\n", JSON_MAX_FIELDS);
+      /* no partial selection */
+      field_count = 0;
+      return -1;
+    }
+    field = fields + field_count;
+    field->count = 0;
+    for (part = strtok_r(name, "/", &part_save);
+         part != NULL && field->count < JSON_MAX_DEPTH;
+         part = strtok_r(NULL, "/", &part_save))
+      field->parts[field->count++] = part;
+    if (field->count > 0)
+      ++field_count;
+  }
+  return 0;
+}
+
+int json_field_wanted(const char *name)
+{
+  int i;
+
+  if (field_count == 0)
+    return 1;
+  for (i = 0; i < field_count; ++i) {
+    if (strcasecmp(fields[i].parts[fields[i].count - 1], name) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+int json_fields_wanted(const char *const *names)
+{
+  for (; *names != NULL; ++names) {
+    if (json_field_wanted(*names))
+      return 1;
+  }
+  return 0;
+}
+
+/*
+ * whether an item with key is selected: the keys of its enclosing groups
+ * and its own key must end with the parts of a field. Items of arrays are
+ * named by the array.
+ */
+static int item_wanted(const char *key)
+{
+  const char *path[JSON_MAX_DEPTH + 1];
+  const struct json_field *field;
+  int count = 0;
+  int i, j;
+
+  if (field_count == 0)
+    return 1;
+  for (i = 1; i < writer.depth; ++i) {
+    if (writer.keys[i] != NULL)
+      path[count++] = writer.keys[i];
+  }
+  if (key != NULL)
+    path[count++] = key;
+  if (count == 0)
+    return 0;
+
+  for (i = 0; i < field_count; ++i) {
+    field = fields + i;
+    if (field->count > count)
+      continue;
+    for (j = 1; j <= field->count; ++j) {
+      if (strcasecmp(field->parts[field->count - j], path[count - j]) != 0)
         break;
-      }
     }
+    if (j > field->count)
+      return 1;
+  }
+  return 0;
+}
+
+/* separator and key of the next member of the current group */
+static void begin_member(const char *key)
+{
+  int had;
+
+  if (writer.depth == 0)
+    return;
+  had = writer.has_members[writer.depth - 1];
+  writer.has_members[writer.depth - 1] = 1;
+  if (writing_cbor()) {
+    if (print_ndjson && writer.depth == 1)
+      cbor_byte(CBOR_MAP_BEGIN);            /* each member is an item */
+    if (key != NULL && !writer.is_array[writer.depth - 1])
+      cbor_text(key);
+    return;
+  }
+  if (print_ndjson && writer.depth == 1 && !writer.record)
+    append_str("{");                        /* each member is a line */
+  else if (had)
+    append_str(writer.depth == 1 && !writer.record ? ",\n" : ", ");
+  if (key != NULL && !writer.is_array[writer.depth - 1]) {
+    append_str("\"");
+    append_escaped(key);
+    append_str("\": ");
+  }
+}
+
+static void push(const char *key, int is_array)
+{
+  if (writer.depth >= JSON_MAX_DEPTH) {
+    writer.failed = 1;
+    return;
+  }
+  writer.has_members[writer.depth] = 0;
+  writer.is_array[writer.depth] = is_array;
+  writer.keys[writer.depth] = NULL;
+  if (field_count > 0 && key != NULL) {
+    /* the caller's key may not outlive the group */
+    writer.keys[writer.depth] = strdup(key);
+    if (writer.keys[writer.depth] == NULL)
+      writer.failed = 1;
+  }
+  ++writer.depth;
+}
+
+/* remember where a group starts, to drop it if nothing is selected */
+static void mark_group(void)
+{
+  if (writer.depth >= JSON_MAX_DEPTH)
+    return;
+  writer.starts[writer.depth] = writer.len;
+  writer.parent_had[writer.depth] = writer.has_members[writer.depth - 1];
+}
+
+static int write_all(const char *buf, size_t len)
+{
+  ssize_t n;
+
+  /* text printed with stdio goes first */
+  fflush(stdout);
+  while (len > 0) {
+    n = write(STDOUT_FILENO, buf, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+static void release(void)
+{
+  int i;
+
+  if (writer.failed)
+    perr("Cannot allocate memory for JSON output.\n");
+  for (i = 0; i < JSON_MAX_DEPTH; ++i)
+    free(writer.keys[i]);
+  free(writer.buf);
+  memset(&writer, 0, sizeof(writer));
+}
+
+/* in NDJSON mode, write a top level member as soon as it is complete */
+static void end_member(void)
+{
+  if (!print_ndjson || writer.depth != 1 || writer.record)
+    return;
+  if (print_cbor)
+    cbor_byte(CBOR_BREAK);
+  else
+    append_str("}\n");
+  if (writer.failed) {
+    perr("Cannot allocate memory for JSON output.\n");
+  } else {
+    pthread_mutex_lock(&write_lock);
+    write_all(writer.buf, writer.len);
+    pthread_mutex_unlock(&write_lock);
+  }
+  writer.failed = 0;
+  writer.len = 0;
+  writer.has_members[0] = 0;
+  if (writer.implicit)
+    release();
+}
+
+/*
+ * whether a document is open. In NDJSON mode, worker threads print
+ * without json_begin(), and each of their members opens its own line.
+ */
+static int in_document(void)
+{
+  if (writer.depth > 0)
+    return 1;
+  if (!print_ndjson)
+    return 0;
+  writer.implicit = 1;
+  push(NULL, 0);
+  return 1;
+}
+
+void json_begin(void)
+{
+  writer.len = 0;
+  writer.failed = 0;
+  writer.depth = 0;
+  writer.implicit = 0;
+  if (print_cbor && !print_ndjson)
+    cbor_byte(CBOR_MAP_BEGIN);
+  else if (!print_ndjson)
+    append_str("{\n");
+  push(NULL, 0);
+}
+
+void json_end(void)
+{
+  if (writer.depth == 0)
+    return;
+  while (writer.depth > 1)
+    json_group_end();
+  if (print_ndjson) {
+    release();
+    return;
   }
+  writer.depth = 0;
+  if (print_cbor)
+    cbor_byte(CBOR_BREAK);
+  else
+    append_str("\n}\n");
 
-  dst[j] = 0;
-  return dst;
+  if (!writer.failed)
+    write_all(writer.buf, writer.len);
+  release();
+}
+
+void json_record_begin(void)
+{
+  /* a document of this thread may be open, e.g. with --json */
+  outer_writer = writer;
+  memset(&writer, 0, sizeof(writer));
+  writer.record = 1;
+  append_str("{");
+  push(NULL, 0);
+}
+
+void json_record_end(void)
+{
+  if (!writer.record)
+    return;
+  while (writer.depth > 1)
+    json_group_end();
+  append_str("}\n");
+  if (writer.failed) {
+    perr("Cannot allocate memory for JSON output.\n");
+  } else if (writer.has_members[0]) {
+    /* with --fields, nothing is printed if nothing is selected */
+    pthread_mutex_lock(&write_lock);
+    write_all(writer.buf, writer.len);
+    pthread_mutex_unlock(&write_lock);
+  }
+  release();
+  writer = outer_writer;
+  memset(&outer_writer, 0, sizeof(outer_writer));
+}
+
+void json_item(const char *key, const char *fmt, ...)
+{
+  va_list ap;
+
+  if (!item_wanted(key) || !in_document())
+    return;
+  begin_member(key);
+  va_start(ap, fmt);
+  if (writing_cbor()) {
+    cbor_value_v(fmt, ap);
+  } else {
+    append_str("\"");
+    escape_tail(append_v(fmt, ap));
+    append_str("\"");
+  }
+  va_end(ap);
+  end_member();
+}
+
+void json_group_begin(const char *key)
+{
+  if (!in_document())
+    return;
+  mark_group();
+  begin_member(key);
+  if (writing_cbor())
+    cbor_byte(CBOR_MAP_BEGIN);
+  else
+    append_str("{");
+  push(key, 0);
+}
+
+void json_group_end(void)
+{
+  if (writer.depth <= 1)
+    return;
+  --writer.depth;
+  free(writer.keys[writer.depth]);
+  writer.keys[writer.depth] = NULL;
+  if (field_count > 0 && !writer.has_members[writer.depth]) {
+    /* nothing selected in the group; drop it with its key */
+    writer.len = writer.starts[writer.depth];
+    writer.has_members[writer.depth - 1] = writer.parent_had[writer.depth];
+    if (writer.implicit && writer.depth == 1 && writer.len == 0)
+      release();
+    return;
+  }
+  if (writing_cbor())
+    cbor_byte(CBOR_BREAK);
+  else
+    append_str(writer.is_array[writer.depth] ? "]" : "}");
+  end_member();
+}
+
+void json_array_begin(const char *key)
+{
+  if (!in_document())
+    return;
+  mark_group();
+  begin_member(key);
+  if (writing_cbor())
+    cbor_byte(CBOR_ARRAY_BEGIN);
+  else
+    append_str("[");
+  push(key, 1);
+}
+
+void json_array_end(void)
+{
+  json_group_end();
+}
+
+void json_members(const char *members)
+{
+  while (*members == ' ' || *members == '\n')
+    ++members;
+  if (*members == '\0' || !in_document())
+    return;
+  if (writing_cbor()) {
+    /* no JSON parser here; the members stay JSON, under one key */
+    begin_member("json");
+    cbor_json("{", members, "}");
+  } else {
+    begin_member(NULL);
+    append_str(members);
+  }
+  end_member();
+}
+
+void json_document(const char *document)
+{
+  char *line, *out;
+
+  if (print_cbor) {
+    unsigned char head[18];
+    int h = cbor_encode_head(head, CBOR_TAG, CBOR_TAG_JSON);
+
+    h += cbor_encode_head(head + h, CBOR_BYTES, strlen(document));
+    pthread_mutex_lock(&write_lock);
+    write_all((const char *) head, h);
+    write_all(document, strlen(document));
+    pthread_mutex_unlock(&write_lock);
+    return;
+  }
+
+  if (!print_ndjson) {
+    write_all(document, strlen(document));
+    write_all("\n", 1);
+    return;
+  }
+
+  /* newlines of a serialized document are never inside strings */
+  line = (char *) malloc(strlen(document) + 2);
+  if (line == NULL) {
+    perr("Cannot allocate memory for JSON output.\n");
+    return;
+  }
+  for (out = line; *document; ++document) {
+    if (*document != '\n') {
+      *out++ = *document;
+      continue;
+    }
+    while (document[1] == ' ')
+      ++document;
+  }
+  *out++ = '\n';
+  pthread_mutex_lock(&write_lock);
+  write_all(line, out - line);
+  pthread_mutex_unlock(&write_lock);
+  free(line);
 }
@@ -13,43 +13,113 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+/* groups and arrays nested in one document */
+#define JSON_MAX_DEPTH 16
+
+/* fields of --fields */
+#define JSON_MAX_FIELDS 32
+
+/*
+ * JSON output is built in one growable buffer and written with a single
+ * write() when the document ends. The writer tracks whether a group
+ * already has members, so callers never print separators themselves.
+ *
+ * With --ndjson, every top level member, usually one enclosure, is
+ * instead written as its own line, {"key": value}, as soon as it is
+ * complete. The writer is per thread, and worker threads may print
+ * members without json_begin() in this mode.
+ *
+ * With --cbor, the same calls build CBOR (RFC 8949) with the same keys.
+ * An item whose format is a single numeric conversion, e.g. "%d" or
+ * "%.2f", becomes a typed number; everything else becomes text. With
+ * --ndjson as well, every top level member is one item of a CBOR sequence.
+ */
+extern void json_begin(void);
+extern void json_end(void);
+
 /*
- * Don't forget to call free().
+ * a record of a stream, e.g. a slot change: one flat object on its own
+ * line, written with a single write() by json_record_end(), whatever the
+ * output format. It may be printed while a document is open.
  */
-char* str_escape(const char* src);
+extern void json_record_begin(void);
+extern void json_record_end(void);
+
+/* "key": "value", the value formatted as printf(); key is NULL in arrays */
+extern void json_item(const char *key, const char *fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+extern void json_group_begin(const char *key);
+extern void json_group_end(void);
+extern void json_array_begin(const char *key);
+extern void json_array_end(void);
+
+/*
+ * members of an object serialized elsewhere, e.g. by json-c, without {}.
+ * In CBOR they are embedded as JSON (tag 262) under the key "json".
+ */
+extern void json_members(const char *members);
+
+/*
+ * a complete document serialized elsewhere, written on its own: a line,
+ * or a tag 262 item in CBOR
+ */
+extern void json_document(const char *document);
+
+/*
+ * --fields: a comma separated list of the items to print, e.g.
+ * "devname,Power". A field is the key of an item, qualified by the keys
+ * of enclosing groups when needed, e.g. "ArrayDevice07/devname". Items
+ * of arrays are named by the array. Groups left without items are dropped.
+ * Members and documents serialized elsewhere are printed as they are.
+ */
+extern int json_select_fields(const char *list);
+
+/*
+ * whether an item named name may be printed, for callers to skip reading
+ * what nobody asked for. Always 1 without --fields.
+ */
+extern int json_field_wanted(const char *name);
+
+/* whether any of names, a NULL terminated list, may be printed */
+extern int json_fields_wanted(const char *const *names);
 
 #define IF_PRINT_JSON if (print_json)
 
 #define IF_PRINT_NONE_JSON if (!print_json)
 
-#define JSON_HEADER IF_PRINT_JSON printf("{\n")
+#define JSON_HEADER IF_PRINT_JSON json_begin()
 
-#define JSON_ENDING IF_PRINT_JSON printf("\n}\n")
+#define JSON_ENDING IF_PRINT_JSON json_end()
 
-#define CASE_JSON case 'j': print_json = 1; break
+/* --ndjson, --cbor and --fields have no short options */
+#define NDJSON_OPTION 'L'
+#define CBOR_OPTION   'K'
+#define FIELDS_OPTION 'Z'
 
-#define PRINT_JSON_ITEM(k, f, v) IF_PRINT_JSON \
-  printf("\"%s\": \"" f "\", ", (k), (v))
-#define PRINT_JSON_LAST_ITEM(k, f, v) IF_PRINT_JSON \
-  printf("\"%s\": \"" f "\"", (k), (v))
+/* in a function returning an error code, as an invalid --fields is one */
+#define CASE_JSON case 'j': print_json = 1; break; \
+  case NDJSON_OPTION: print_json = print_ndjson = 1; break; \
+  case CBOR_OPTION: print_json = print_cbor = 1; break; \
+  case FIELDS_OPTION: \
+    if (json_select_fields(optarg) != 0) \
+      return EINVAL; \
+    print_json = 1; \
+    break
+
+#define PRINT_JSON_ITEM(k, f, v) IF_PRINT_JSON json_item((k), f, (v))
 
 #define PRINT_JSON_ITEM_UNIT(k, f, v, u) IF_PRINT_JSON \
-  printf("\"%s\": \"" f "%s\", ", (k), (v), (u))
-#define PRINT_JSON_LAST_ITEM_UNIT(k, f, v, u) IF_PRINT_JSON \
-  printf("\"%s\": \"" f "%s\"", (k), (v), (u))
+  json_item((k), f "%s", (v), (u))
 
-#define PRINT_JSON_MORE_ITEM IF_PRINT_JSON printf(", ")
+#define PRINT_JSON_GROUP_HEADER(k) IF_PRINT_JSON json_group_begin(k)
+#define PRINT_JSON_GROUP_ENDING IF_PRINT_JSON json_group_end()
 
-#define PRINT_JSON_GROUP_HEADER(k) IF_PRINT_JSON printf("\"%s\": {", (k))
-#define PRINT_JSON_GROUP_ENDING IF_PRINT_JSON printf("}")
-#define PRINT_JSON_MORE_GROUP IF_PRINT_JSON printf(",\n")
+#define PRINT_JSON_ARRAY_HEADER(k) IF_PRINT_JSON json_array_begin(k)
+#define PRINT_JSON_ARRAY_ENDING IF_PRINT_JSON json_array_end()
 
-extern int do_new_item;
 extern int print_json;
-
-#define PRINT_JSON_GROUP_SEPARATE if (do_new_item) PRINT_JSON_MORE_GROUP ; \
-  do_new_item = 1
-
-#define PRINT_JSON_RESET_GROUP do_new_item = 0
+extern int print_ndjson;
+extern int print_cbor;
 
 #endif
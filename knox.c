@@ -16,7 +16,10 @@
 #include "jbod_interface.h"
 #include "scsi_buffer.h"
 #include "ses.h"
+#include "ses_control.h"
 #include "led.h"
+#include "event_log.h"
+#include "phyerr.h"
 #include "cooling.h"
 #include "json.h"
 
@@ -27,286 +30,283 @@ void knox_print_power_reading(int sg_fd)
   print_read_value(sg_fd, &power);
 }
 
+static const struct scsi_buffer_parameter *const knox_enclosure_info_list[] =
+{&seb_pn, &seb_sn, &knox_dpb_pn, &knox_dpb_sn, &fcb_pn, &fcb_sn, &tray_sn,
+ &node_sn, &tray_asset, &chassis_tag};
+
 void knox_print_enclosure_info (int sg_fd)
 {
   jbod_print_enclosure_info(sg_fd);
-  print_read_value(sg_fd, &seb_pn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &seb_sn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &knox_dpb_pn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &knox_dpb_sn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &fcb_pn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &fcb_sn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &tray_sn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &node_sn); PRINT_JSON_MORE_ITEM;
-
-  print_read_value(sg_fd, &tray_asset); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &chassis_tag);
+  print_read_values(sg_fd, knox_enclosure_info_list,
+                    sizeof(knox_enclosure_info_list) /
+                    sizeof(knox_enclosure_info_list[0]));
 }
 
-struct scsi_buffer_parameter *knox_asset_tag_list[] =
+static const struct scsi_buffer_parameter *const knox_asset_tag_list[] =
 {&tray_asset, &chassis_tag,
  &seb_pn, &seb_sn, &knox_dpb_pn, &knox_dpb_sn, &fcb_pn, &fcb_sn, &tray_pn,
  &tray_sn, &node_pn, &node_sn, &rack_pos};
 
-void knox_config_asset_tags()
-{
-  asset_tag_count = sizeof(knox_asset_tag_list) /
-    sizeof(knox_asset_tag_list[0]);
-  asset_tag_list = knox_asset_tag_list;
-}
+#define KNOX_ASSET_TAG_COUNT \
+  (sizeof(knox_asset_tag_list) / sizeof(knox_asset_tag_list[0]))
 
 void knox_set_asset_tag(int sg_fd, int tag_id, char *tag)
 {
-  knox_config_asset_tags();
-  jbod_set_asset_tag(sg_fd, tag_id, tag);
+  jbod_set_asset_tag(sg_fd, knox_asset_tag_list, KNOX_ASSET_TAG_COUNT,
+                     tag_id, tag);
 }
 
 void knox_set_asset_tag_by_name(int sg_fd, char *tag_name, char *tag)
 {
-  knox_config_asset_tags();
-  jbod_set_asset_tag_by_name(sg_fd, tag_name, tag);
+  jbod_set_asset_tag_by_name(sg_fd, knox_asset_tag_list,
+                             KNOX_ASSET_TAG_COUNT, tag_name, tag);
 }
 
 void knox_print_asset_tag(int sg_fd)
 {
-  knox_config_asset_tags();
-  jbod_print_asset_tag(sg_fd);
+  jbod_print_asset_tag(sg_fd, knox_asset_tag_list, KNOX_ASSET_TAG_COUNT);
 }
 
+int knox_get_asset_tags(const struct scsi_buffer_parameter *const **tags)
+{
+  *tags = knox_asset_tag_list;
+  return KNOX_ASSET_TAG_COUNT;
+}
+
+static const struct scsi_buffer_parameter *const honeybadger_enclosure_info_list[] =
+{&fcb_pn, &fcb_sn};  /* TODO: fix the chassis tag and add it */
+
 void honeybadger_print_enclosure_info (int sg_fd)
 {
   jbod_print_enclosure_info(sg_fd);
-  print_read_value(sg_fd, &fcb_pn);
-  PRINT_JSON_MORE_ITEM; print_read_value(sg_fd, &fcb_sn);
-  /* PRINT_JSON_MORE_ITEM; print_read_value(sg_fd, &chassis_tag); */
+  print_read_values(sg_fd, honeybadger_enclosure_info_list,
+                    sizeof(honeybadger_enclosure_info_list) /
+                    sizeof(honeybadger_enclosure_info_list[0]));
 }
 
-struct scsi_buffer_parameter *honeybadger_asset_tag_list[] =
+static const struct scsi_buffer_parameter *const honeybadger_asset_tag_list[] =
 {&fcb_pn, &fcb_sn};  /* TODO: add more information and fix the chassis tag */
 
-void honeybadger_config_asset_tags()
-{
-  asset_tag_count = sizeof(honeybadger_asset_tag_list)
-    / sizeof(struct scsi_buffer_parameter *);
-  asset_tag_list = honeybadger_asset_tag_list;
-}
+#define HONEYBADGER_ASSET_TAG_COUNT \
+  (sizeof(honeybadger_asset_tag_list) / sizeof(honeybadger_asset_tag_list[0]))
 
 void honeybadger_set_asset_tag(int sg_fd, int tag_id, char *tag)
 {
-  honeybadger_config_asset_tags();
-  jbod_set_asset_tag(sg_fd, tag_id, tag);
+  jbod_set_asset_tag(sg_fd, honeybadger_asset_tag_list,
+                     HONEYBADGER_ASSET_TAG_COUNT, tag_id, tag);
 }
 
 void honeybadger_set_asset_tag_by_name(int sg_fd, char *tag_name, char *tag)
 {
-  honeybadger_config_asset_tags();
-  jbod_set_asset_tag_by_name(sg_fd, tag_name, tag);
+  jbod_set_asset_tag_by_name(sg_fd, honeybadger_asset_tag_list,
+                             HONEYBADGER_ASSET_TAG_COUNT, tag_name, tag);
 }
 
 void honeybadger_print_asset_tag(int sg_fd)
 {
-  honeybadger_config_asset_tags();
-  jbod_print_asset_tag(sg_fd);
+  jbod_print_asset_tag(sg_fd, honeybadger_asset_tag_list,
+                       HONEYBADGER_ASSET_TAG_COUNT);
 }
 
+int honeybadger_get_asset_tags(const struct scsi_buffer_parameter *const **tags)
+{
+  *tags = honeybadger_asset_tag_list;
+  return HONEYBADGER_ASSET_TAG_COUNT;
+}
+
+static const char *const knox_gpio_description[15][3] = {
+  {"Expander ID ", "Expander A", "Expander B"},
+  {"Debug board detection ", "Bottom Tray", "Top Tray"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {"Peer SEB Heartbeat Detection ", "No Heartbeat", "Heartbeat alive"},
+  {"Pulling Out Detection For Self Tray ", "Tray not out", "Tray out"},
+  {"Pulling Out Detection For Peer Tray ", "Tray not out", "Tray out"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {"Peer SEB Detection ", "Peer SEB attached", "Peer SEB not attached"},
+  {"FCB HW Revision ", "Normal storage", "Cold storage"},
+  {"DPB HW Revision ", "No interconnection", "x1 SAS interconnection"},
+  {"Peer Tray SEB A Heartbeat Detection ", "No Heartbeat", "Heartbeat alive"},
+  {"Peer Tray SEB B Heartbeat Detection ", "No Heartbeat", "Heartbeat alive"},
+};
+
+static const struct signal_buffer knox_gpio = {
+  0x70, 15, knox_gpio_description};
+
 void knox_print_gpio(int sg_fd)
 {
-  gpio_buffer_id = 0x70;
-  gpio_buffer_length = 15;
-  char *knox_gpio_description[15][3] = {
-    {"Expander ID ", "Expander A", "Expander B"},
-    {"Debug board detection ", "Bottom Tray", "Top Tray"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {"Peer SEB Heartbeat Detection ", "No Heartbeat", "Heartbeat alive"},
-    {"Pulling Out Detection For Self Tray ", "Tray not out", "Tray out"},
-    {"Pulling Out Detection For Peer Tray ", "Tray not out", "Tray out"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {"Peer SEB Detection ", "Peer SEB attached", "Peer SEB not attached"},
-    {"FCB HW Revision ", "Normal storage", "Cold storage"},
-    {"DPB HW Revision ", "No interconnection", "x1 SAS interconnection"},
-    {"Peer Tray SEB A Heartbeat Detection ", "No Heartbeat", "Heartbeat alive"},
-    {"Peer Tray SEB B Heartbeat Detection ", "No Heartbeat", "Heartbeat alive"},
-  };
-
-  gpio_descriptions = knox_gpio_description;
-  jbod_print_gpio(sg_fd);
+  jbod_print_gpio(sg_fd, &knox_gpio);
 }
 
+const struct signal_buffer *knox_get_gpio()
+{
+  return &knox_gpio;
+}
+
+static const char *const honeybadger_gpio_description[15][3] = {
+  {"FCB HW Revision", "Low", "High"},
+  {"DPB HW Revision", "Low", "High"},
+  {"Pulling Out Detection For Self Tray ", "Tray not out", "Tray out"},
+  {NULL, "Low", "High"},
+  {"Pulling Out Detection For Peer Tray ", "Tray not out", "Tray out"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {"Expander ID ", "Expander A", "Expander B"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+};
+
+static const struct signal_buffer honeybadger_gpio = {
+  0x70, 15, honeybadger_gpio_description};
+
 void honeybadger_print_gpio(int sg_fd)
 {
-  gpio_buffer_id = 0x70;
-  gpio_buffer_length = 15;
-  char *honeybadger_gpio_description[15][3] = {
-    {"FCB HW Revision", "Low", "High"},
-    {"DPB HW Revision", "Low", "High"},
-    {"Pulling Out Detection For Self Tray ", "Tray not out", "Tray out"},
-    {NULL, "Low", "High"},
-    {"Pulling Out Detection For Peer Tray ", "Tray not out", "Tray out"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {"Expander ID ", "Expander A", "Expander B"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-  };
-
-  gpio_descriptions = honeybadger_gpio_description;
-  jbod_print_gpio(sg_fd);
+  jbod_print_gpio(sg_fd, &honeybadger_gpio);
+}
+
+const struct signal_buffer *honeybadger_get_gpio()
+{
+  return &honeybadger_gpio;
 }
 
 
 void knox_print_event_log(int sg_fd)
 {
-#define EVENT_LOG_BUFFER_SIZE 8192
-  unsigned char buf[EVENT_LOG_BUFFER_SIZE];
-  unsigned char *buf_ptr;
-  int64_t timestamp = 0;
-  int i;
-  char id_str[16];
-
   perr("NOTE: Event log in Knox is not complete at this time...\n");
+  print_event_log(sg_fd, EVENT_LOG_BUFFER_ID);
+}
+
+int knox_print_new_events(int sg_fd, const char *devname)
+{
+  return print_new_events(sg_fd, devname, EVENT_LOG_BUFFER_ID);
+}
+
+static const char *const knox_event_status_description[100][3] = {
+  {NULL, "Off", "On"},
+  {"Expander A fault ", "Off", "On"},
+  {"Expander B fault ", "Off", "On"},
+  {"I2C bus A crash ", "Off", "On"},
+  {"I2C bus B crash ", "Off", "On"},
+  {"I2C bus C crash ", "Off", "On"},
+  {"I2C bus D crash ", "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {"Fan 1 front fault ", "Off", "On"},
+  {"Fan 1 rear fault ", "Off", "On"},
+  {"Fan 2 front fault ", "Off", "On"},
+  {"Fan 2 rear fault ", "Off", "On"},
+  {"Fan 3 front fault ", "Off", "On"},
+  {"Fan 3 rear fault ", "Off", "On"},
+  {"Fan 4 front fault ", "Off", "On"},
+  {"Fan 4 rear fault ", "Off", "On"},
+  {"Fan 5 front fault ", "Off", "On"},
+  {"Fan 5 rear fault ", "Off", "On"},
+  {"Fan 6 front fault ", "Off", "On"},
+  {"Fan 6 rear fault ", "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {"DPB temp. sensor 1 warning ", "Off", "On"},
+  {"DPB temp. sensor 2 warning ", "Off", "On"},
+  {"DPB temp. sensor 3 warning ", "Off", "On"},
+  {"DPB temp. sensor 4 warning ", "Off", "On"},
+  {"SEB temp. sensor A warning ", "Off", "On"},
+  {"SEB temp. sensor B warning ", "Off", "On"},
+  {"Ambient temp. sensor A1 warning ", "Off", "On"},
+  {"Ambient temp. sensor A2 warning ", "Off", "On"},
+  {"Ambient temp. sensor B1 warning ", "Off", "On"},
+  {"Ambient temp. sensor B2 warning ", "Off", "On"},
+  {"BJT temp. sensor 1 ", "Off", "On"},
+  {"BJT temp. sensor 2 warning ", "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {"SEB voltage sensor warning ", "Off", "On"},
+  {"DPB voltage sensor warning ", "Off", "On"},
+  {"FCB voltage sensor warning ", "Off", "On"},
+  {"FCB current sensor warning ", "Off", "On"},
+  {NULL, "Off", "On"},
+  {"HDD0 SMART temp. warning ", "Off", "On"},
+  {"HDD1 SMART temp. warning ", "Off", "On"},
+  {"HDD2 SMART temp. warning ", "Off", "On"},
+  {"HDD3 SMART temp. warning ", "Off", "On"},
+  {"HDD4 SMART temp. warning ", "Off", "On"},
+  {"HDD5 SMART temp. warning ", "Off", "On"},
+  {"HDD6 SMART temp. warning ", "Off", "On"},
+  {"HDD7 SMART temp. warning ", "Off", "On"},
+  {"HDD8 SMART temp. warning ", "Off", "On"},
+  {"HDD9 SMART temp. ", "Off", "On"},
+  {"HDD10 SMART temp. warning ", "Off", "On"},
+  {"HDD11 SMART temp. warning ", "Off", "On"},
+  {"HDD12 SMART temp. warning ", "Off", "On"},
+  {"HDD13 SMART temp. warning ", "Off", "On"},
+  {"HDD14 SMART temp. warning ", "Off", "On"},
+  {"Expander A Internal temp. warning ", "Off", "On"},
+  {"Expander B Internal temp. warning ", "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {"HDD0 fault ", "Off", "On"},
+  {"HDD1 fault ", "Off", "On"},
+  {"HDD2 fault ", "Off", "On"},
+  {"HDD3 fault ", "Off", "On"},
+  {"HDD4 fault ", "Off", "On"},
+  {"HDD5 fault ", "Off", "On"},
+  {"HDD6 fault ", "Off", "On"},
+  {"HDD7 fault ", "Off", "On"},
+  {"HDD8 fault ", "Off", "On"},
+  {"HDD9 fault ", "Off", "On"},
+  {"HDD10 fault ", "Off", "On"},
+  {"HDD11 fault ", "Off", "On"},
+  {"HDD12 fault ", "Off", "On"},
+  {"HDD13 fault ", "Off", "On"},
+  {"HDD14 fault ", "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {"External Mini-SAS link error ", "Off", "On"},
+  {"Internal Mini-SAS 1 link error ", "Off", "On"},
+  {"Internal Mini-SAS 2 link error ", "Off", "On"},
+  {"Self tray is pulled out ", "Off", "On"},
+  {"Peer tray is pulled out ", "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {"Firmware and hardware not match ", "Off", "On"},
+};
 
-  sg_ll_read_buffer(sg_fd, 2, 0xe5, 0, (void *) buf,
-                    EVENT_LOG_BUFFER_SIZE, 1, 0);
-
-  for (i = 0; i < EVENT_LOG_BUFFER_SIZE; i += 64) {
-    buf_ptr = buf + i;
-    timestamp = *((int64_t *)(buf_ptr));
-    IF_PRINT_NONE_JSON
-      printf("[%11ld][Event %d] %d %x %s\n", timestamp,
-             buf_ptr[13] * 256 + buf_ptr[12],
-             buf_ptr[15] * 256 + buf_ptr[14],
-             *((int *)(buf_ptr + 16)),
-             (char *)(buf_ptr + 24));
-
-    PRINT_JSON_GROUP_SEPARATE;
-
-    snprintf(id_str, 16, "%d", buf_ptr[13] * 256 + buf_ptr[12]);
-    PRINT_JSON_GROUP_HEADER(id_str);
-    PRINT_JSON_ITEM("timestamp", "%ld", timestamp);
-    PRINT_JSON_ITEM("id", "%d", buf_ptr[13] * 256 + buf_ptr[12]);
-    fix_none_ascii((char *)(buf_ptr + 24), strlen((char *)(buf_ptr + 24)));
-    PRINT_JSON_LAST_ITEM("description", "%s", (char *)(buf_ptr + 24));
-    PRINT_JSON_GROUP_ENDING;
-  }
-}
+static const struct signal_buffer knox_event_status = {
+  0x76, 100, knox_event_status_description};
 
 void knox_print_event_status(int sg_fd)
 {
-  event_status_buffer_id = 0x76;
-  event_status_buffer_length = 100;
-  char *knox_event_status_description[100][3] = {
-    {NULL, "Off", "On"},
-    {"Expander A fault ", "Off", "On"},
-    {"Expander B fault ", "Off", "On"},
-    {"I2C bus A crash ", "Off", "On"},
-    {"I2C bus B crash ", "Off", "On"},
-    {"I2C bus C crash ", "Off", "On"},
-    {"I2C bus D crash ", "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {"Fan 1 front fault ", "Off", "On"},
-    {"Fan 1 rear fault ", "Off", "On"},
-    {"Fan 2 front fault ", "Off", "On"},
-    {"Fan 2 rear fault ", "Off", "On"},
-    {"Fan 3 front fault ", "Off", "On"},
-    {"Fan 3 rear fault ", "Off", "On"},
-    {"Fan 4 front fault ", "Off", "On"},
-    {"Fan 4 rear fault ", "Off", "On"},
-    {"Fan 5 front fault ", "Off", "On"},
-    {"Fan 5 rear fault ", "Off", "On"},
-    {"Fan 6 front fault ", "Off", "On"},
-    {"Fan 6 rear fault ", "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {"DPB temp. sensor 1 warning ", "Off", "On"},
-    {"DPB temp. sensor 2 warning ", "Off", "On"},
-    {"DPB temp. sensor 3 warning ", "Off", "On"},
-    {"DPB temp. sensor 4 warning ", "Off", "On"},
-    {"SEB temp. sensor A warning ", "Off", "On"},
-    {"SEB temp. sensor B warning ", "Off", "On"},
-    {"Ambient temp. sensor A1 warning ", "Off", "On"},
-    {"Ambient temp. sensor A2 warning ", "Off", "On"},
-    {"Ambient temp. sensor B1 warning ", "Off", "On"},
-    {"Ambient temp. sensor B2 warning ", "Off", "On"},
-    {"BJT temp. sensor 1 ", "Off", "On"},
-    {"BJT temp. sensor 2 warning ", "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {"SEB voltage sensor warning ", "Off", "On"},
-    {"DPB voltage sensor warning ", "Off", "On"},
-    {"FCB voltage sensor warning ", "Off", "On"},
-    {"FCB current sensor warning ", "Off", "On"},
-    {NULL, "Off", "On"},
-    {"HDD0 SMART temp. warning ", "Off", "On"},
-    {"HDD1 SMART temp. warning ", "Off", "On"},
-    {"HDD2 SMART temp. warning ", "Off", "On"},
-    {"HDD3 SMART temp. warning ", "Off", "On"},
-    {"HDD4 SMART temp. warning ", "Off", "On"},
-    {"HDD5 SMART temp. warning ", "Off", "On"},
-    {"HDD6 SMART temp. warning ", "Off", "On"},
-    {"HDD7 SMART temp. warning ", "Off", "On"},
-    {"HDD8 SMART temp. warning ", "Off", "On"},
-    {"HDD9 SMART temp. ", "Off", "On"},
-    {"HDD10 SMART temp. warning ", "Off", "On"},
-    {"HDD11 SMART temp. warning ", "Off", "On"},
-    {"HDD12 SMART temp. warning ", "Off", "On"},
-    {"HDD13 SMART temp. warning ", "Off", "On"},
-    {"HDD14 SMART temp. warning ", "Off", "On"},
-    {"Expander A Internal temp. warning ", "Off", "On"},
-    {"Expander B Internal temp. warning ", "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {"HDD0 fault ", "Off", "On"},
-    {"HDD1 fault ", "Off", "On"},
-    {"HDD2 fault ", "Off", "On"},
-    {"HDD3 fault ", "Off", "On"},
-    {"HDD4 fault ", "Off", "On"},
-    {"HDD5 fault ", "Off", "On"},
-    {"HDD6 fault ", "Off", "On"},
-    {"HDD7 fault ", "Off", "On"},
-    {"HDD8 fault ", "Off", "On"},
-    {"HDD9 fault ", "Off", "On"},
-    {"HDD10 fault ", "Off", "On"},
-    {"HDD11 fault ", "Off", "On"},
-    {"HDD12 fault ", "Off", "On"},
-    {"HDD13 fault ", "Off", "On"},
-    {"HDD14 fault ", "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {"External Mini-SAS link error ", "Off", "On"},
-    {"Internal Mini-SAS 1 link error ", "Off", "On"},
-    {"Internal Mini-SAS 2 link error ", "Off", "On"},
-    {"Self tray is pulled out ", "Off", "On"},
-    {"Peer tray is pulled out ", "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {"Firmware and hardware not match ", "Off", "On"},
-  };
-
-  event_status_descriptions = knox_event_status_description;
-  jbod_print_event_status(sg_fd);
+  jbod_print_event_status(sg_fd, &knox_event_status);
+}
+
+const struct signal_buffer *knox_get_event_status()
+{
+  return &knox_event_status;
+}
+
+int knox_print_event_status_changes(int sg_fd, const char *devname)
+{
+  return jbod_print_event_status_changes(sg_fd, devname, &knox_event_status);
 }
 
 void honeybadger_print_event_status(int sg_fd)
@@ -314,75 +314,75 @@ void honeybadger_print_event_status(int sg_fd)
   perr("Event Status is not yet supported for Honey Badger\n");
 }
 
-void set_knox_config()
+int honeybadger_print_event_status_changes(int sg_fd, const char *devname)
 {
-  all_configs[0].buffer_id = -1;
-  all_configs[0].buffer_offset = -1;
-  all_configs[1].buffer_id = -1;
-  all_configs[1].buffer_offset = -1;
-  all_configs[2].buffer_id = 0x44;
-  all_configs[2].buffer_offset = 0;
+  perr("Event Status is not yet supported for Honey Badger\n");
+  return -1;
+}
+
+static const struct config_item knox_configs[CONFIG_ITEM_COUNT] = {
+  {-1, -1, -1, "Power Window", NULL},
+  {-1, -1, -1, "HDD Temperature Interval", NULL},
+  {0x44, 0, 0, "Fan Profile", NULL},
+};
+
+const struct config_item *knox_get_configs()
+{
+  return knox_configs;
 }
 
 void knox_show_config(int sg_fd)
 {
-  set_knox_config();
-  jbod_show_config(sg_fd);
+  jbod_show_config(sg_fd, knox_configs);
 }
 
 void knox_config_power_window(int sg_fd, int val)
 {
-  set_knox_config();
-  jbod_config_power_window(sg_fd, val);
+  change_config(sg_fd, val, knox_configs + CONFIG_POWER_WINDOW);
 }
 
 void knox_config_hdd_temp_interval(int sg_fd, int val)
 {
-  set_knox_config();
-  jbod_config_hdd_temp_interval(sg_fd, val);
+  change_config(sg_fd, val, knox_configs + CONFIG_HDD_TEMP_INTERVAL);
 }
 
 void knox_config_fan_profile(int sg_fd, int val)
 {
-  set_knox_config();
-  jbod_config_fan_profile(sg_fd, val);
+  change_config(sg_fd, val, knox_configs + CONFIG_FAN_PROFILE);
 }
 
-void set_honeybadger_config()
+static const struct config_item honeybadger_configs[CONFIG_ITEM_COUNT] = {
+  {-1, -1, -1, "Power Window", NULL},
+  {0x72, 3, 3, "HDD Temperature Interval", jbod_change_hdd_temp_interval},
+  {-1, -1, -1, "Fan Profile", NULL},
+};
+
+const struct config_item *honeybadger_get_configs()
 {
-  all_configs[0].buffer_id = -1;
-  all_configs[0].buffer_offset = -1;
-  all_configs[1].buffer_id = 0x72;
-  all_configs[1].buffer_offset = 3;
-  all_configs[2].buffer_id = -1;
-  all_configs[2].buffer_offset = -1;
+  return honeybadger_configs;
 }
 
 void honeybadger_show_config(int sg_fd)
 {
-  set_honeybadger_config();
-  jbod_show_config(sg_fd);
+  jbod_show_config(sg_fd, honeybadger_configs);
 }
 
 void honeybadger_config_power_window(int sg_fd, int val)
 {
-  set_honeybadger_config();
-  jbod_config_power_window(sg_fd, val);
+  change_config(sg_fd, val, honeybadger_configs + CONFIG_POWER_WINDOW);
 }
 
 void honeybadger_config_hdd_temp_interval(int sg_fd, int val)
 {
-  set_honeybadger_config();
-  jbod_config_hdd_temp_interval(sg_fd, val);
+  change_config(sg_fd, val, honeybadger_configs + CONFIG_HDD_TEMP_INTERVAL);
 }
 
 void honeybadger_config_fan_profile(int sg_fd, int val)
 {
-  set_honeybadger_config();
-  jbod_config_fan_profile(sg_fd, val);
+  change_config(sg_fd, val, honeybadger_configs + CONFIG_FAN_PROFILE);
 }
 
-struct led_info knox_leds[] = {
+static const struct led_info knox_leds[] = {
   {SINGLE_COLOR, -1, NULL, NULL, NULL},
   {SINGLE_COLOR, -1, "Ext. Mini SAS", "Red", NULL},
   {SINGLE_COLOR, -1, "Ext. Mini SAS", "Blue", NULL},
@@ -405,15 +405,23 @@ struct led_info knox_leds[] = {
 #define KNOX_LED_BUFFER_ID 0x75
 #define KNOX_LED_BUFFER_LENGTH 17
 
+static void knox_led_state(struct led_state *state)
+{
+  memset(state, 0, sizeof(*state));
+  state->leds = knox_leds;
+  state->count = KNOX_LED_BUFFER_LENGTH;
+  state->buffer_id = KNOX_LED_BUFFER_ID;
+}
+
 void knox_print_sys_led(int sg_fd)
 {
-  jbod_led_buffer_length = KNOX_LED_BUFFER_LENGTH;
-  jbod_led_buffer_id = KNOX_LED_BUFFER_ID;
-  jbod_leds = knox_leds;
-  jbod_print_sys_led(sg_fd);
+  struct led_state state;
+
+  knox_led_state(&state);
+  jbod_print_sys_led(sg_fd, &state);
 }
 
-struct led_info honeybadger_leds[] = {
+static const struct led_info honeybadger_leds[] = {
   {SEVEN_SEG,    -1, "7 Segment LED ", NULL, NULL},
   {SINGLE_COLOR, -1, "Fan Module 1", "Red", NULL},
   {SINGLE_COLOR, -1, "Fan Module 2", "Red", NULL},
@@ -434,23 +442,25 @@ struct led_info honeybadger_leds[] = {
 #define HONEYBADGER_LED_BUFFER_ID 0x7a
 #define HONEYBADGER_LED_BUFFER_LENGTH 16
 
-void honeybadger_print_sys_led(int sg_fd)
+static void honeybadger_led_state(struct led_state *state)
 {
-  int i;
-  unsigned char buf[HONEYBADGER_LED_BUFFER_LENGTH];
-
-  for (i = 0; i < HONEYBADGER_LED_BUFFER_LENGTH; ++i) {
-    scsi_read_buffer(sg_fd, HONEYBADGER_LED_BUFFER_ID, i, buf + i, 1);
-  }
+  memset(state, 0, sizeof(*state));
+  state->leds = honeybadger_leds;
+  state->count = HONEYBADGER_LED_BUFFER_LENGTH;
+  state->buffer_id = HONEYBADGER_LED_BUFFER_ID;
+  state->probe_bulk_read = 1;
+}
 
-  IF_PRINT_NONE_JSON {
-    printf("%s\t%s\t%s\n", "ID", "Name", "Status");
-  }
+void honeybadger_print_sys_led(int sg_fd)
+{
+  struct led_state state;
 
-  for (i = 0; i < HONEYBADGER_LED_BUFFER_LENGTH; i ++) {
-    honeybadger_leds[i].status = buf[i];
-    print_led(i, honeybadger_leds + i);
+  honeybadger_led_state(&state);
+  if (read_led_state(sg_fd, &state) != 0) {
+    perr("Failed to read LED status.\n");
+    return;
   }
+  print_led_state(&state);
 }
 
 void knox_control_sys_led(int sg_fd, int led_id, int value)
@@ -459,36 +469,30 @@ void knox_control_sys_led(int sg_fd, int led_id, int value)
 }
 
 static void knox_ses_pwm_control(struct cooling_fan *fan, int pwm,
-                          unsigned char *page_two)
+                          struct ses_txn *txn)
 {
-  unsigned char *fan_element_ptr = page_two + fan->page_two_offset;
-
-  fan->common_control = fan->common_status & 0xf0;
-  fan->common_control |= 0x80;
+  const unsigned char and_mask[SES_ELEMENT_SIZE] = {0xf0, 0, 0, 0};
+  unsigned char or_mask[SES_ELEMENT_SIZE] = {0x80, 0, 0, 0};
 
-  fan_element_ptr[0] = fan->common_control;
-  fan_element_ptr[1] = 0;
-  fan_element_ptr[2] = pwm & 0xff;
-  fan_element_ptr[3] = (pwm == 0) ? 0x00 : 0x20;
+  or_mask[2] = pwm & 0xff;
+  or_mask[3] = (pwm == 0) ? 0x00 : 0x20;
+  ses_txn_element(txn, fan->page_two_offset, and_mask, or_mask);
 }
 
 void knox_control_fan_pwm(int sg_fd, int pwm)
 {
-  struct ses_pages pages;
-  struct ses_status_info ses_status;
-  int page_two_size;
+  struct ses_txn txn;
   int i;
 
   perr("NOTE: PWM control in Knox has some bug at this time...\n");
 
-  read_ses_pages(sg_fd, &pages, &page_two_size);
-
-  interpret_ses_pages(&pages, &ses_status);
+  if (ses_txn_begin(sg_fd, &txn) != 0)
+    return;
 
-  for (i = 0; i < ses_status.fan_count; i ++)
-    knox_ses_pwm_control(ses_status.fans + i, pwm, pages.page_two);
+  for (i = 0; i < txn.status.fan_count; i ++)
+    knox_ses_pwm_control(txn.status.fans + i, pwm, &txn);
 
-  sg_send_ses_page(sg_fd, pages.page_two, page_two_size);
+  ses_txn_commit(&txn);
 }
 
 void knox_power_cycle_enclosure(int sg_fd)
@@ -497,42 +501,38 @@ void knox_power_cycle_enclosure(int sg_fd)
   scsi_write_buffer(sg_fd, 0xe9, 0, buf, 3);
 }
 
+/* the printed status is what was written, not read back */
 void knox_identify_enclosure(int sg_fd, int val)
 {
-  unsigned char buf[KNOX_LED_BUFFER_LENGTH];
-  scsi_read_buffer(sg_fd, KNOX_LED_BUFFER_ID, 0, buf, KNOX_LED_BUFFER_LENGTH);
+  struct led_state state;
+
+  knox_led_state(&state);
+  if (read_led_state(sg_fd, &state) != 0) {
+    perr("Failed to read LED status.\n");
+    return;
+  }
   if (val == 1) {
-    buf[0] = 1;
-    buf[8] = 2;
-    scsi_write_buffer(sg_fd, KNOX_LED_BUFFER_ID, 0,
-                      buf, KNOX_LED_BUFFER_LENGTH);
+    state.status[0] = 1;
+    state.status[8] = 2;
   } else if (val == 0) {
-    buf[0] = 0;
-    buf[8] = 1;
-    scsi_write_buffer(sg_fd, KNOX_LED_BUFFER_ID, 0,
-                      buf, KNOX_LED_BUFFER_LENGTH);
+    state.status[0] = 0;
+    state.status[8] = 1;
   }
-  knox_print_sys_led(sg_fd);
+  if ((val == 1 || val == 0) &&
+      write_led_state(sg_fd, &state, 0, KNOX_LED_BUFFER_LENGTH) != 0) {
+    perr("Failed to set identify LED.\n");
+    return;
+  }
+  print_led_state(&state);
 }
 
 void honeybadger_identify_enclosure(int sg_fd, int val)
 {
-  unsigned char buf[HONEYBADGER_LED_BUFFER_LENGTH];
-  scsi_read_buffer(sg_fd, HONEYBADGER_LED_BUFFER_ID, 0,
-                   buf, HONEYBADGER_LED_BUFFER_LENGTH);
-
   /*
-  if (val == 1) {
-    buf[0] = 1;
-    buf[8] = 2;
-    scsi_write_buffer(sg_fd, HONEYBADGER_LED_BUFFER_ID, 0,
-                      buf, HONEYBADGER_LED_BUFFER_LENGTH);
-  } else if (val == 0) {
-    buf[0] = 0;
-    buf[8] = 1;
-    scsi_write_buffer(sg_fd, HONEYBADGER_LED_BUFFER_ID, 0,
-                      buf, HONEYBADGER_LED_BUFFER_LENGTH);
-  }
+  same as knox_identify_enclosure(), once the LED ids are known:
+  state.status[0] = 1;
+  state.status[8] = 2;
+  write_led_state(sg_fd, &state, 0, HONEYBADGER_LED_BUFFER_LENGTH);
   */
   perr("Identify is not yet implemented for Honey Badger. \n");
   honeybadger_print_sys_led(sg_fd);
@@ -540,51 +540,35 @@ void honeybadger_identify_enclosure(int sg_fd, int val)
 
 #define KNOX_PHYERR_BUFFER_ID 0x77
 #define KNOX_PHYERR_BUFFER_PHY_COUNT 20
-#define KNOX_PHYERR_BUFFER_LENGTH 16
 
 #define HONEYBADGER_PHYERR_BUFFER_PHY_COUNT 24
-int phyerr_buffer_phy_count = KNOX_PHYERR_BUFFER_PHY_COUNT;
 
 void knox_print_phyerr(int sg_fd)
 {
-  unsigned char buf[KNOX_PHYERR_BUFFER_LENGTH];
-  int i;
-  char json_key[16];
-
-  IF_PRINT_NONE_JSON
-    printf("PHY\tInvalid Dword\tRunning Disparity\tLoss of Dword Sync"
-           "\tPhy Reset Problem\n");
-
-  for (i = 0; i < phyerr_buffer_phy_count; i ++) {
-    scsi_read_buffer(sg_fd, KNOX_PHYERR_BUFFER_ID, i,
-                     buf, KNOX_PHYERR_BUFFER_LENGTH);
-    IF_PRINT_NONE_JSON
-      printf("%d\t%u\t%u\t%u\t%u\n",
-             i,
-             four_byte_to_uint(buf + 0),
-             four_byte_to_uint(buf + 4),
-             four_byte_to_uint(buf + 8),
-             four_byte_to_uint(buf + 12)
-            );
-    if (i) PRINT_JSON_MORE_GROUP;
-    snprintf(json_key, 16, "Phy_%u", i);
-    PRINT_JSON_GROUP_HEADER(json_key);
-    PRINT_JSON_ITEM("Invalid Dword", "%u",
-                    four_byte_to_uint(buf + 0));
-    PRINT_JSON_ITEM("Running Disparity", "%u",
-                    four_byte_to_uint(buf + 4));
-    PRINT_JSON_ITEM("Loss of Dword Sync", "%u",
-                    four_byte_to_uint(buf + 8));
-    PRINT_JSON_LAST_ITEM("Phy Reset Problem", "%u",
-                         four_byte_to_uint(buf + 12));
-    PRINT_JSON_GROUP_ENDING;
-  }
+  print_phyerr(sg_fd, KNOX_PHYERR_BUFFER_ID, KNOX_PHYERR_BUFFER_PHY_COUNT);
 }
 
+/* no global phy count, Knox and HoneyBadger may be read in parallel */
 void honeybadger_print_phyerr(int sg_fd)
 {
-  phyerr_buffer_phy_count = HONEYBADGER_PHYERR_BUFFER_PHY_COUNT;
-  knox_print_phyerr(sg_fd);
+  print_phyerr(sg_fd, KNOX_PHYERR_BUFFER_ID,
+               HONEYBADGER_PHYERR_BUFFER_PHY_COUNT);
+}
+
+static const struct metrics_profile knox_metrics = {
+  &power, KNOX_PHYERR_BUFFER_ID, KNOX_PHYERR_BUFFER_PHY_COUNT};
+
+static const struct metrics_profile honeybadger_metrics = {
+  &power, KNOX_PHYERR_BUFFER_ID, HONEYBADGER_PHYERR_BUFFER_PHY_COUNT};
+
+const struct metrics_profile *knox_get_metrics_profile()
+{
+  return &knox_metrics;
+}
+
+const struct metrics_profile *honeybadger_get_metrics_profile()
+{
+  return &honeybadger_metrics;
 }
 
 void knox_reset_phyerr(int sg_fd)
@@ -606,34 +590,32 @@ void knox_print_profile(struct jbod_profile *profile)
   PRINT_JSON_ITEM("fw version", "%s", profile->specific);
 }
 
-struct jbod_short_profile knox_get_short_profile (char *devname)
+struct jbod_short_profile knox_get_short_profile (int sg_fd)
 {
   struct jbod_short_profile p = {"N/A", "N/A", "N/A"};
-  int sg_fd = sg_cmds_open_device(devname, 0 /* rw */, 0 /* not verbose */);
+  const struct scsi_buffer_parameter *list[] = {&node_sn, &tray_asset, &chassis_tag};
+  struct scsi_buffer_plan plan;
 
-  if (sg_fd > 0) {
-    read_buffer_string(sg_fd, &node_sn, p.node_sn, MAX_TAG_LENGTH);
-    read_buffer_string(sg_fd, &tray_asset, p.fb_asset_node, MAX_TAG_LENGTH);
-    read_buffer_string(sg_fd, &chassis_tag, p.fb_asset_chassis, MAX_TAG_LENGTH);
-    sg_cmds_close_device(sg_fd);
-  }
+  scsi_buffer_plan_read(sg_fd, list, sizeof(list) / sizeof(list[0]), &plan);
+  planned_buffer_string(sg_fd, &plan, &node_sn, p.node_sn, MAX_TAG_LENGTH);
+  planned_buffer_string(sg_fd, &plan, &tray_asset, p.fb_asset_node,
+                        MAX_TAG_LENGTH);
+  planned_buffer_string(sg_fd, &plan, &chassis_tag, p.fb_asset_chassis,
+                        MAX_TAG_LENGTH);
+  scsi_buffer_plan_free(&plan);
 
   return p;
 }
 
-struct jbod_short_profile honeybadger_get_short_profile (char *devname)
+struct jbod_short_profile honeybadger_get_short_profile (int sg_fd)
 {
   struct jbod_short_profile p = {"N/A", "N/A", "N/A"};
-  int sg_fd = sg_cmds_open_device(devname, 0 /* rw */, 0 /* not verbose */);
-
-  if (sg_fd > 0) {
-    /*
-    read_buffer_string(sg_fd, &node_sn, p.node_sn, MAX_TAG_LENGTH);
-    read_buffer_string(sg_fd, &tray_asset, p.fb_asset_node, MAX_TAG_LENGTH);
-    read_buffer_string(sg_fd, &chassis_tag, p.fb_asset_chassis, MAX_TAG_LENGTH);
-    */
-    sg_cmds_close_device(sg_fd);
-  }
+
+  /*
+  read_buffer_string(sg_fd, &node_sn, p.node_sn, MAX_TAG_LENGTH);
+  read_buffer_string(sg_fd, &tray_asset, p.fb_asset_node, MAX_TAG_LENGTH);
+  read_buffer_string(sg_fd, &chassis_tag, p.fb_asset_chassis, MAX_TAG_LENGTH);
+  */
 
   return p;
 }
@@ -648,26 +630,34 @@ struct jbod_interface knox = {
   jbod_print_hdd_info,
   jbod_hdd_power_control,
   jbod_hdd_led_control,
+  jbod_hdd_leds_control,
   jbod_print_fan_info,
   knox_control_fan_pwm,
   knox_set_asset_tag,
   knox_set_asset_tag_by_name,
   knox_print_asset_tag,
+  knox_get_asset_tags,
   knox_power_cycle_enclosure,
   knox_print_gpio,
   knox_print_event_log,
+  knox_print_new_events,
   knox_print_event_status,
+  knox_print_event_status_changes,
   knox_print_sys_led,
   knox_control_sys_led,
   knox_show_config,
   knox_config_power_window,
   knox_config_hdd_temp_interval,
   knox_config_fan_profile,
+  knox_get_configs,
   knox_identify_enclosure,
   knox_print_phyerr,
   knox_reset_phyerr,
+  knox_get_metrics_profile,
   knox_print_profile,
   knox_get_short_profile,
+  .get_event_status = knox_get_event_status,
+  .get_gpio = knox_get_gpio,
 };
 
 struct jbod_interface honeybadger = {
@@ -680,24 +670,31 @@ struct jbod_interface honeybadger = {
   jbod_print_hdd_info,
   jbod_hdd_power_control,
   jbod_hdd_led_control,
+  jbod_hdd_leds_control,
   jbod_print_fan_info,
   knox_control_fan_pwm,
   knox_set_asset_tag,
   knox_set_asset_tag_by_name,
   honeybadger_print_asset_tag,
+  honeybadger_get_asset_tags,
   knox_power_cycle_enclosure,
   honeybadger_print_gpio,
   knox_print_event_log,
+  knox_print_new_events,
   honeybadger_print_event_status,
+  honeybadger_print_event_status_changes,
   honeybadger_print_sys_led,
   knox_control_sys_led,
   honeybadger_show_config,
   honeybadger_config_power_window,
   honeybadger_config_hdd_temp_interval,
   knox_config_fan_profile,
+  honeybadger_get_configs,
   honeybadger_identify_enclosure,
   honeybadger_print_phyerr,
   knox_reset_phyerr,
+  honeybadger_get_metrics_profile,
   knox_print_profile,
   honeybadger_get_short_profile,
+  .get_gpio = honeybadger_get_gpio,
 };
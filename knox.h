@@ -12,49 +12,27 @@
 
 #include "scsi_buffer.h"
 
-static struct scsi_buffer_parameter power = {
-  sbp_integer, 0x41, 0, 4, "Power", "W", 2, two_byte_to_int, NULL, NULL};
-
-static struct scsi_buffer_parameter seb_pn = {
-  sbp_string, 0x20, 0, 11, "SEB_PN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter seb_sn = {
-  sbp_string, 0x20, 0x100, 11, "SEB_SN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter knox_dpb_pn = {
-  sbp_string, 0x30, 0, 11, "DPB_PN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter knox_dpb_sn = {
-  sbp_string, 0x30, 0x100, 11, "DPB_SN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter tray_pn = {
-  sbp_string, 0x30, 0x200, 11, "Tray_PN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter tray_sn = {
-  sbp_string, 0x30, 0x300, 12, "Tray_SN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter node_pn = {
-  sbp_string, 0x30, 0x200, 11, "Node_PN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter node_sn = {
-  sbp_string, 0x30, 0x300, 12, "Node_SN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter fcb_pn = {
-  sbp_string, 0x40, 0, 11, "FCB_PN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter fcb_sn = {
-  sbp_string, 0x40, 0x100, 11, "FCB_SN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter tray_asset = {
-  sbp_string, 0x30, 0x500, 7, "FB_Asset_Node", "", 0, NULL, NULL,
-  buf_to_string};
-
-static struct scsi_buffer_parameter chassis_tag = {
-  sbp_string, 0x40, 0x500, 7, "FB_Asset_Chassis", "", 0, NULL, NULL,
-  buf_to_string};
-
-static struct scsi_buffer_parameter rack_pos = {
-  sbp_string, 0x40, 0x600, 2, "Rack_Position", "", 0, NULL, NULL,
-  buf_to_string};
+/*
+ * Vendor buffer map of Knox and Honey Badger, see SCSI_BUFFER_PARAMETER:
+ * X(variable, type, buf_id, buf_offset, len, name, unit, value_offset,
+ *   indexed)
+ */
+#define KNOX_BUFFER_MAP(X)                                                  \
+  X(power, sbp_integer, 0x41, 0, 4, "Power", "W", 2, 1)                     \
+  X(seb_pn, sbp_string, 0x20, 0, 11, "SEB_PN", "", 0, 0)                    \
+  X(seb_sn, sbp_string, 0x20, 0x100, 11, "SEB_SN", "", 0, 0)                \
+  X(knox_dpb_pn, sbp_string, 0x30, 0, 11, "DPB_PN", "", 0, 0)               \
+  X(knox_dpb_sn, sbp_string, 0x30, 0x100, 11, "DPB_SN", "", 0, 0)           \
+  X(tray_pn, sbp_string, 0x30, 0x200, 11, "Tray_PN", "", 0, 0)              \
+  X(tray_sn, sbp_string, 0x30, 0x300, 12, "Tray_SN", "", 0, 0)              \
+  X(node_pn, sbp_string, 0x30, 0x200, 11, "Node_PN", "", 0, 0)              \
+  X(node_sn, sbp_string, 0x30, 0x300, 12, "Node_SN", "", 0, 0)              \
+  X(fcb_pn, sbp_string, 0x40, 0, 11, "FCB_PN", "", 0, 0)                    \
+  X(fcb_sn, sbp_string, 0x40, 0x100, 11, "FCB_SN", "", 0, 0)                \
+  X(tray_asset, sbp_string, 0x30, 0x500, 7, "FB_Asset_Node", "", 0, 0)      \
+  X(chassis_tag, sbp_string, 0x40, 0x500, 7, "FB_Asset_Chassis", "", 0, 0)  \
+  X(rack_pos, sbp_string, 0x40, 0x600, 2, "Rack_Position", "", 0, 0)
+
+KNOX_BUFFER_MAP(SCSI_BUFFER_PARAMETER)
 
 #endif
@@ -7,14 +7,17 @@
  * of patent rights can be found in the PATENTS file in the same directory.
  */
 
+#include "enclosure_cache.h"
 #include "json.h"
 #include "led.h"
+#include "scsi_buffer.h"
 
+#include <errno.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-void print_led(int id, struct led_info *info)
+void print_led(int id, const struct led_info *info)
 {
   char val[64];
 
@@ -63,11 +66,120 @@ void print_led(int id, struct led_info *info)
 
   IF_PRINT_NONE_JSON printf("%d\t%s\t%s\n", id, info->desc, val);
 
-  PRINT_JSON_GROUP_SEPARATE;
-
   PRINT_JSON_GROUP_HEADER(info->desc);
   PRINT_JSON_ITEM("id", "%d", id);
   PRINT_JSON_ITEM("name", "%s", info->desc);
-  PRINT_JSON_LAST_ITEM("status", "%s", val);
+  PRINT_JSON_ITEM("status", "%s", val);
   PRINT_JSON_GROUP_ENDING;
 }
+
+#define LED_BULK_READ_KEY_LENGTH 32
+
+static int read_led_per_byte(int sg_fd, struct led_state *state)
+{
+  int i;
+
+  for (i = 0; i < state->count; ++i) {
+    if (scsi_read_buffer(sg_fd, state->buffer_id, i, state->status + i, 1))
+      return EIO;
+  }
+  return 0;
+}
+
+/*
+ * compare one multi-byte read with byte reads; return 1 if the firmware
+ * answers multi-byte reads correctly, 0 if not, -1 if nothing is proven
+ */
+static int probe_led_bulk_read(int sg_fd, struct led_state *state)
+{
+  unsigned char bulk[MAX_LED_COUNT];
+  int bulk_ok;
+
+  bulk_ok = scsi_read_buffer(sg_fd, state->buffer_id, 0,
+                             bulk, state->count) == 0;
+  if (read_led_per_byte(sg_fd, state) != 0) {
+    if (!bulk_ok)
+      return -1;
+    memcpy(state->status, bulk, state->count);
+    return 1;
+  }
+  return bulk_ok && memcmp(bulk, state->status, state->count) == 0;
+}
+
+/* one command, or byte by byte if the buffer refuses it */
+static int read_led_bulk(int sg_fd, struct led_state *state)
+{
+  if (scsi_read_buffer(sg_fd, state->buffer_id, 0,
+                       state->status, state->count) == 0)
+    return 0;
+  return read_led_per_byte(sg_fd, state);
+}
+
+int read_led_state(int sg_fd, struct led_state *state)
+{
+  struct enclosure_cache *cache;
+  char key[LED_BULK_READ_KEY_LENGTH];
+  const char *bulk_read;
+  int probed;
+
+  if (state->count <= 0 || state->count > MAX_LED_COUNT) {
+    perr("LED reading is not supported.\n");
+    return EINVAL;
+  }
+  if (!state->probe_bulk_read)
+    return read_led_bulk(sg_fd, state);
+
+  cache = (struct enclosure_cache *) malloc(sizeof(struct enclosure_cache));
+  if (cache == NULL)
+    return ENOMEM;
+  if (enclosure_cache_open(sg_fd, cache) != 0) {
+    /* nowhere to remember a probe, so trust one command */
+    free(cache);
+    return read_led_bulk(sg_fd, state);
+  }
+
+  snprintf(key, LED_BULK_READ_KEY_LENGTH, "led_bulk_read_0x%02x",
+           state->buffer_id);
+  bulk_read = enclosure_cache_get(cache, key);
+  if (bulk_read != NULL) {
+    probed = strcmp(bulk_read, "1") == 0;
+    free(cache);
+    return probed ? read_led_bulk(sg_fd, state) :
+                    read_led_per_byte(sg_fd, state);
+  }
+
+  probed = probe_led_bulk_read(sg_fd, state);
+  if (probed >= 0) {
+    enclosure_cache_set(cache, key, probed ? "1" : "0");
+    enclosure_cache_save(cache);
+  }
+  free(cache);
+  return probed >= 0 ? 0 : EIO;
+}
+
+int write_led_state(int sg_fd, struct led_state *state,
+                    int offset, int length)
+{
+  if (offset < 0 || length <= 0 || offset + length > state->count)
+    return EINVAL;
+  if (scsi_write_buffer(sg_fd, state->buffer_id, offset,
+                        state->status + offset, length))
+    return EIO;
+  return 0;
+}
+
+void print_led_state(struct led_state *state)
+{
+  struct led_info info;
+  int i;
+
+  IF_PRINT_NONE_JSON {
+    printf("%s\t%s\t%s\n", "ID", "Name", "Status");
+  }
+
+  for (i = 0; i < state->count; i ++) {
+    info = state->leds[i];
+    info.status = state->status[i];
+    print_led(i, &info);
+  }
+}
@@ -34,11 +34,35 @@ enum duo_color_led_status {
 struct led_info {
   enum led_type type;
   int status;
-  char *desc;
-  char *color_one;
-  char *color_two;
+  const char *desc;
+  const char *color_one;
+  const char *color_two;
 };
 
-extern void print_led(int id, struct led_info *info);
+/* LEDs are one status byte each, at the start of a READ BUFFER buffer */
+#define MAX_LED_COUNT 32
+
+struct led_state {
+  const struct led_info *leds;
+  int count;
+  int buffer_id;
+  /*
+   * some firmware may answer a multi-byte read of the LED buffer with
+   * stale or wrong bytes; probe it once per firmware revision
+   */
+  int probe_bulk_read;
+  unsigned char status[MAX_LED_COUNT];
+};
+
+extern void print_led(int id, const struct led_info *info);
+
+/* read all LEDs of state, with one command unless the firmware cannot */
+extern int read_led_state(int sg_fd, struct led_state *state);
+
+/* write status[offset..offset+length) back to the enclosure */
+extern int write_led_state(int sg_fd, struct led_state *state,
+                           int offset, int length);
+
+extern void print_led_state(struct led_state *state);
 
 #endif
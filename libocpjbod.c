@@ -0,0 +1,512 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <scsi/sg_lib.h>
+#include <scsi/sg_cmds.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "array_device_slot.h"
+#include "enclosure_cache.h"
+#include "event_log.h"
+#include "event_status.h"
+#include "jbod_interface.h"
+#include "libocpjbod.h"
+#include "parallel.h"
+#include "phyerr.h"
+#include "scsi_buffer.h"
+#include "ses.h"
+
+/* libocpjbod.h is installed alone, so it repeats these */
+#if OCPJBOD_CONFIG_COUNT != CONFIG_ITEM_COUNT || \
+    OCPJBOD_LED_FAULT != HDD_LED_FAULT || \
+    OCPJBOD_LED_IDENT != HDD_LED_IDENT || \
+    OCPJBOD_EVENT_DESCRIPTION_LENGTH != EVENT_LOG_DESCRIPTION_LENGTH || \
+    OCPJBOD_MAX_PHYS != PHYERR_MAX_PHY_COUNT || \
+    OCPJBOD_PHYERR_COUNTERS != PHYERR_COUNTER_COUNT
+#error "libocpjbod.h does not match the enclosure headers"
+#endif
+
+struct ocpjbod {
+  char devname[PATH_MAX];
+  int sg_fd;
+  struct jbod_interface *interface;
+  pthread_mutex_t lock;             /* one SCSI command at a time */
+};
+
+int ocpjbod_list(char devnames[][PATH_MAX], int max)
+{
+  struct jbod_device devices[MAX_JBOD_PER_HOST];
+  int count, i;
+
+  count = lib_list_jbod(devices, DEFAULT_PARALLEL);
+  for (i = 0; i < count && i < max; ++i)
+    snprintf(devnames[i], PATH_MAX, "%s", devices[i].sg_device);
+  return i;
+}
+
+struct ocpjbod *ocpjbod_open(const char *devname, int *error)
+{
+  struct ocpjbod *jbod;
+
+  jbod = (struct ocpjbod *) calloc(1, sizeof(struct ocpjbod));
+  if (jbod == NULL) {
+    *error = ENOMEM;
+    return NULL;
+  }
+  snprintf(jbod->devname, sizeof(jbod->devname), "%s", devname);
+  jbod->interface = detect_dev(devname);
+  if (jbod->interface == NULL) {
+    *error = ENODEV;
+    free(jbod);
+    return NULL;
+  }
+  jbod->sg_fd = sg_cmds_open_device(devname, 0 /* rw */,
+                                    0 /* not verbose */);
+  if (jbod->sg_fd < 0) {
+    *error = -jbod->sg_fd;
+    free(jbod);
+    return NULL;
+  }
+  pthread_mutex_init(&jbod->lock, NULL);
+  return jbod;
+}
+
+void ocpjbod_close(struct ocpjbod *jbod)
+{
+  if (jbod == NULL)
+    return;
+  sg_cmds_close_device(jbod->sg_fd);
+  pthread_mutex_destroy(&jbod->lock);
+  free(jbod);
+}
+
+const char *ocpjbod_devname(struct ocpjbod *jbod)
+{
+  return jbod->devname;
+}
+
+static void copy_name(char *dst, size_t size, const char *src)
+{
+  snprintf(dst, size, "%s", src ? src : "");
+}
+
+int ocpjbod_read_info(struct ocpjbod *jbod, struct ocpjbod_info *info)
+{
+  struct jbod_short_profile short_profile;
+  struct jbod_profile *profile;
+  char sas_addr[OCPJBOD_NAME_LENGTH];
+  int i;
+
+  memset(info, 0, sizeof(*info));
+  for (i = 0; i < library_size; ++i) {
+    if (jbod_library[i].interface == jbod->interface) {
+      copy_name(info->type, sizeof(info->type), jbod_library[i].name);
+      break;
+    }
+  }
+
+  pthread_mutex_lock(&jbod->lock);
+  profile = extract_profile(jbod->devname);
+  if (read_enclosure_attr(jbod->sg_fd, "sas_address", sas_addr,
+                          sizeof(sas_addr)) == 0)
+    copy_name(info->sas_addr, sizeof(info->sas_addr), sas_addr);
+  if (jbod->interface->get_short_profile) {
+    short_profile = jbod->interface->get_short_profile(jbod->sg_fd);
+    copy_name(info->node_sn, sizeof(info->node_sn), short_profile.node_sn);
+    copy_name(info->asset_node, sizeof(info->asset_node),
+              short_profile.fb_asset_node);
+    copy_name(info->asset_chassis, sizeof(info->asset_chassis),
+              short_profile.fb_asset_chassis);
+  }
+  pthread_mutex_unlock(&jbod->lock);
+
+  if (profile == NULL)
+    return EIO;
+  copy_name(info->vendor, sizeof(info->vendor), profile->vendor);
+  copy_name(info->product, sizeof(info->product), profile->product);
+  copy_name(info->revision, sizeof(info->revision), profile->revision);
+  free(profile);
+  return 0;
+}
+
+static void copy_ses_status(const struct ses_status_info *ses,
+                            struct shm_enclosure *e)
+{
+  int i;
+
+  e->slot_count = ses->slot_count;
+  for (i = 0; i < e->slot_count; ++i) {
+    const struct array_device_slot *slot = ses->slots + i;
+    struct shm_slot *s = e->slots + i;
+
+    copy_name(s->name, sizeof(s->name), slot->name);
+    copy_name(s->sas_addr, sizeof(s->sas_addr), slot->sas_addr_str);
+    copy_name(s->dev_name, sizeof(s->dev_name), slot->dev_name);
+    copy_name(s->by_slot_name, sizeof(s->by_slot_name), slot->by_slot_name);
+    s->common_status = slot->common_status;
+    s->fault = slot->fault;
+    s->ident = slot->ident;
+    s->device_off = slot->device_off;
+    s->slot = slot->slot;
+    s->phy = slot->phy;
+  }
+
+  e->temp_count = ses->temp_count;
+  for (i = 0; i < e->temp_count; ++i) {
+    const struct temperature_sensor *t = ses->temp_sensors + i;
+    struct shm_sensor *s = e->temp_sensors + i;
+
+    copy_name(s->name, sizeof(s->name), t->name);
+    s->common_status = t->common_status;
+    s->value = t->temperature;
+    s->thresholds[0] = t->ot_critical_threshold;
+    s->thresholds[1] = t->ot_warning_threshold;
+    s->thresholds[2] = t->ut_warning_threshold;
+    s->thresholds[3] = t->ut_critical_threshold;
+  }
+
+  e->vol_count = ses->vol_count;
+  for (i = 0; i < e->vol_count; ++i) {
+    const struct voltage_sensor *v = ses->vol_sensors + i;
+    struct shm_sensor *s = e->vol_sensors + i;
+
+    copy_name(s->name, sizeof(s->name), v->name);
+    s->common_status = v->common_status;
+    s->value = v->voltage;
+    s->thresholds[0] = v->ov_critical_threshold;
+    s->thresholds[1] = v->ov_warning_threshold;
+    s->thresholds[2] = v->uv_warning_threshold;
+    s->thresholds[3] = v->uv_critical_threshold;
+  }
+
+  e->curr_count = ses->curr_count;
+  for (i = 0; i < e->curr_count; ++i) {
+    const struct current_sensor *c = ses->curr_sensors + i;
+    struct shm_sensor *s = e->curr_sensors + i;
+
+    copy_name(s->name, sizeof(s->name), c->name);
+    s->common_status = c->common_status;
+    s->value = c->current;
+    s->thresholds[0] = c->oc_critical_threshold;
+    s->thresholds[1] = c->oc_warning_threshold;
+    s->thresholds[2] = c->uc_warning_threshold;
+    s->thresholds[3] = c->uc_critical_threshold;
+  }
+
+  e->fan_count = ses->fan_count;
+  for (i = 0; i < e->fan_count; ++i) {
+    copy_name(e->fans[i].name, sizeof(e->fans[i].name), ses->fans[i].name);
+    e->fans[i].common_status = ses->fans[i].common_status;
+    e->fans[i].rpm = ses->fans[i].rpm;
+  }
+
+  copy_name(e->sas_addr, sizeof(e->sas_addr), ses->expander.sas_addr_str);
+}
+
+static void read_power(struct ocpjbod *jbod, struct shm_enclosure *e)
+{
+  const struct metrics_profile *profile = NULL;
+
+  e->power = -1;
+  if (jbod->interface->get_metrics_profile)
+    profile = jbod->interface->get_metrics_profile();
+  if (profile == NULL || profile->power == NULL ||
+      read_value_as_int(jbod->sg_fd, profile->power, &e->power) != 0) {
+    e->power = -1;
+    return;
+  }
+  /* as planned_value_as_string() prints it */
+  copy_name(e->power_name, sizeof(e->power_name), profile->power->name);
+  snprintf(e->power_value, sizeof(e->power_value), "%d %s",
+           e->power, profile->power->unit);
+}
+
+int ocpjbod_read_status(struct ocpjbod *jbod, int fresh,
+                        struct shm_enclosure *status)
+{
+  struct ses_status_info *ses;
+  struct timespec now;
+
+  ses = (struct ses_status_info *) calloc(1, sizeof(struct ses_status_info));
+  if (ses == NULL)
+    return ENOMEM;
+
+  memset(status, 0, sizeof(*status));
+  copy_name(status->devname, sizeof(status->devname), jbod->devname);
+  status->power = -1;
+
+  pthread_mutex_lock(&jbod->lock);
+  status->rc = fetch_ses_status_of(jbod->sg_fd, ses,
+                                   SES_FETCH_ALL |
+                                   (fresh ? SES_FETCH_FRESH : 0));
+  if (status->rc == 0) {
+    copy_ses_status(ses, status);
+    read_power(jbod, status);
+  }
+  pthread_mutex_unlock(&jbod->lock);
+  free_ses_status(ses);
+  free(ses);
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  status->updated_ms = (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+  return status->rc;
+}
+
+int ocpjbod_read_tags(struct ocpjbod *jbod, struct ocpjbod_value *tags,
+                      int max, int *count)
+{
+  const struct scsi_buffer_parameter *const *list;
+  struct scsi_buffer_plan plan;
+  char out[4096];
+  int i;
+
+  *count = 0;
+  if (jbod->interface->get_asset_tags == NULL)
+    return ENOTSUP;
+  *count = jbod->interface->get_asset_tags(&list);
+  if (max > *count)
+    max = *count;
+
+  pthread_mutex_lock(&jbod->lock);
+  /* one command per buffer */
+  scsi_buffer_plan_read(jbod->sg_fd, list, max, &plan);
+  for (i = 0; i < max; ++i) {
+    planned_value_as_string(jbod->sg_fd, &plan, list[i], out);
+    copy_name(tags[i].name, sizeof(tags[i].name), list[i]->name);
+    copy_name(tags[i].value, sizeof(tags[i].value), out);
+  }
+  scsi_buffer_plan_free(&plan);
+  pthread_mutex_unlock(&jbod->lock);
+  return 0;
+}
+
+int ocpjbod_write_tag(struct ocpjbod *jbod, const char *name,
+                      const char *value)
+{
+  const struct scsi_buffer_parameter *const *list;
+  int count, len, i, rc;
+
+  if (jbod->interface->get_asset_tags == NULL)
+    return ENOTSUP;
+  count = jbod->interface->get_asset_tags(&list);
+  for (i = 0; i < count; ++i)
+    if (strcmp(name, list[i]->name) == 0)
+      break;
+  if (i == count)
+    return EINVAL;
+
+  /* as jbod_set_asset_tag() writes it */
+  len = strlen(value);
+  if (len > list[i]->len)
+    len = list[i]->len;
+  pthread_mutex_lock(&jbod->lock);
+  rc = scsi_write_buffer(jbod->sg_fd, list[i]->buf_id, list[i]->buf_offset,
+                         (unsigned char *) value, len);
+  invalidate_short_profile(jbod->sg_fd);
+  pthread_mutex_unlock(&jbod->lock);
+  return rc == 0 ? 0 : EIO;
+}
+
+int ocpjbod_read_configs(struct ocpjbod *jbod,
+                         struct ocpjbod_config configs[])
+{
+  const struct config_item *items;
+  int values[CONFIG_ITEM_COUNT];
+  int i;
+
+  if (jbod->interface->get_configs == NULL)
+    return ENOTSUP;
+  items = jbod->interface->get_configs();
+
+  pthread_mutex_lock(&jbod->lock);
+  jbod_read_configs(jbod->sg_fd, items, values);
+  pthread_mutex_unlock(&jbod->lock);
+
+  for (i = 0; i < CONFIG_ITEM_COUNT; ++i) {
+    copy_name(configs[i].name, sizeof(configs[i].name), items[i].name);
+    configs[i].value = values[i];
+  }
+  return 0;
+}
+
+int ocpjbod_hdd_power(struct ocpjbod *jbod, int slot, int on, int timeout)
+{
+  int rc;
+
+  if (jbod->interface->hdd_power_control == NULL)
+    return ENOTSUP;
+  pthread_mutex_lock(&jbod->lock);
+  rc = jbod->interface->hdd_power_control(jbod->sg_fd, slot, on ? 1 : 0,
+                                          timeout, 0 /* cold_storage */);
+  pthread_mutex_unlock(&jbod->lock);
+  return rc;
+}
+
+int ocpjbod_hdd_leds(struct ocpjbod *jbod,
+                     const struct ocpjbod_led_change *changes, int count)
+{
+  struct hdd_led_change *list;
+  int rc, i;
+
+  if (jbod->interface->hdd_leds_control == NULL)
+    return ENOTSUP;
+  if (count < 0)
+    return EINVAL;
+  list = (struct hdd_led_change *)
+    malloc((count ? count : 1) * sizeof(struct hdd_led_change));
+  if (list == NULL)
+    return ENOMEM;
+  for (i = 0; i < count; ++i) {
+    list[i].slot = changes[i].slot;
+    list[i].led = changes[i].led;
+    list[i].op = changes[i].op;
+  }
+
+  pthread_mutex_lock(&jbod->lock);
+  rc = jbod->interface->hdd_leds_control(jbod->sg_fd, list, count);
+  pthread_mutex_unlock(&jbod->lock);
+  free(list);
+  return rc;
+}
+
+/* the used signals of buffer, as jbod_print_gpio() prints them */
+static int read_signals(struct ocpjbod *jbod,
+                        const struct signal_buffer *buffer,
+                        struct ocpjbod_signal *signals, int max, int *count)
+{
+  unsigned char buf[EVENT_STATUS_MAX_COUNT];    /* the longest buffer */
+  int rc, i;
+
+  *count = 0;
+  if (buffer == NULL || buffer->buffer_id == -1 || buffer->length <= 0 ||
+      buffer->length > EVENT_STATUS_MAX_COUNT || buffer->descriptions == NULL)
+    return ENOTSUP;
+
+  pthread_mutex_lock(&jbod->lock);
+  rc = scsi_read_buffer(jbod->sg_fd, buffer->buffer_id, 0, buf,
+                        buffer->length);
+  pthread_mutex_unlock(&jbod->lock);
+  if (rc != 0)
+    return EIO;
+
+  for (i = 0; i < buffer->length; ++i) {
+    const char *const *description = buffer->descriptions[i];
+
+    if (description[0] == NULL || buf[i] > 1)
+      continue;
+    if (*count < max) {
+      struct ocpjbod_signal *s = signals + *count;
+
+      copy_name(s->name, sizeof(s->name), description[0]);
+      copy_name(s->state, sizeof(s->state), description[buf[i] + 1]);
+      s->value = buf[i];
+    }
+    ++*count;
+  }
+  return 0;
+}
+
+int ocpjbod_read_gpio(struct ocpjbod *jbod, struct ocpjbod_signal *signals,
+                      int max, int *count)
+{
+  const struct signal_buffer *gpio = NULL;
+
+  if (jbod->interface->get_gpio)
+    gpio = jbod->interface->get_gpio();
+  return read_signals(jbod, gpio, signals, max, count);
+}
+
+int ocpjbod_read_event_status(struct ocpjbod *jbod,
+                              struct ocpjbod_signal *signals, int max,
+                              int *count)
+{
+  const struct signal_buffer *status = NULL;
+
+  if (jbod->interface->get_event_status)
+    status = jbod->interface->get_event_status();
+  return read_signals(jbod, status, signals, max, count);
+}
+
+int ocpjbod_read_events(struct ocpjbod *jbod, struct ocpjbod_event *events,
+                        int max, int *count)
+{
+  struct event_record *records;
+  int first, n, i;
+
+  *count = 0;
+  /* every enclosure with an event log keeps it in the same buffer */
+  if (jbod->interface->print_event_log == NULL)
+    return ENOTSUP;
+  records = (struct event_record *)
+    malloc(EVENT_LOG_RECORD_COUNT * sizeof(struct event_record));
+  if (records == NULL)
+    return ENOMEM;
+
+  pthread_mutex_lock(&jbod->lock);
+  n = read_event_log(jbod->sg_fd, EVENT_LOG_BUFFER_ID, records);
+  pthread_mutex_unlock(&jbod->lock);
+  if (n < 0) {
+    free(records);
+    return EIO;
+  }
+
+  first = n > max ? n - max : 0;
+  for (i = first; i < n; ++i) {
+    struct ocpjbod_event *e = events + i - first;
+
+    e->timestamp = records[i].timestamp;
+    e->id = records[i].id;
+    e->code = records[i].code;
+    e->data = records[i].data;
+    copy_name(e->description, sizeof(e->description),
+              records[i].description);
+  }
+  *count = n - first;
+  free(records);
+  return 0;
+}
+
+int ocpjbod_read_phyerr(struct ocpjbod *jbod, struct ocpjbod_phyerr *phyerr)
+{
+  const struct metrics_profile *profile = NULL;
+  struct enclosure_cache *cache;
+  struct phyerr_sample sample;
+  int rc;
+
+  memset(phyerr, 0, sizeof(*phyerr));
+  if (jbod->interface->get_metrics_profile)
+    profile = jbod->interface->get_metrics_profile();
+  if (profile == NULL || profile->phyerr_buffer_id == -1)
+    return ENOTSUP;
+  cache = (struct enclosure_cache *) malloc(sizeof(struct enclosure_cache));
+  if (cache == NULL)
+    return ENOMEM;
+
+  /* the cache only says how the counters can be read, see phyerr.c */
+  pthread_mutex_lock(&jbod->lock);
+  enclosure_cache_open(jbod->sg_fd, cache);
+  rc = read_phyerr_sample(jbod->sg_fd, profile->phyerr_buffer_id,
+                          profile->phyerr_phy_count, &sample, cache);
+  if (rc == 0)
+    enclosure_cache_save(cache);
+  pthread_mutex_unlock(&jbod->lock);
+  free(cache);
+  if (rc != 0)
+    return rc;
+
+  phyerr->time = sample.time;
+  phyerr->phy_count = sample.phy_count;
+  memcpy(phyerr->counters, sample.counters, sizeof(phyerr->counters));
+  return 0;
+}
@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef LIBOCPJBOD_H
+#define LIBOCPJBOD_H
+
+#include <limits.h>
+#include <stdint.h>
+
+/*
+ * libocpjbod: the enclosures as data instead of printed text. Every call
+ * takes the handle it works on and returns 0 or an errno value. No state
+ * is shared between handles, so different enclosures may be used from
+ * different threads at once; calls on one handle are serialized.
+ *
+ * This header is all that is installed. The library is built with hidden
+ * visibility, so only the calls declared here are exported.
+ */
+struct ocpjbod;
+
+#define OCPJBOD_NAME_LENGTH      32
+#define OCPJBOD_PATH_LENGTH      64
+#define OCPJBOD_TEXT_LENGTH      64
+#define OCPJBOD_SAS_ADDR_LENGTH  16         /* hex digits */
+#define OCPJBOD_MAX_ELEMENTS     64         /* of each type, e.g. slots */
+
+/*
+ * The status of an enclosure, in the layout ocpjbodd publishes in shared
+ * memory; every member has a fixed width.
+ */
+struct shm_slot {
+  char name[OCPJBOD_NAME_LENGTH];
+  char sas_addr[OCPJBOD_SAS_ADDR_LENGTH + 1];
+  char dev_name[OCPJBOD_NAME_LENGTH];       /* "" if not found */
+  char by_slot_name[OCPJBOD_PATH_LENGTH];
+  uint8_t common_status;
+  uint8_t fault;
+  uint8_t ident;
+  uint8_t device_off;
+  int32_t slot;
+  int32_t phy;
+};
+
+/* thresholds are over critical, over warning, under warning, under critical */
+struct shm_sensor {
+  char name[OCPJBOD_NAME_LENGTH];
+  uint32_t common_status;
+  float value;
+  float thresholds[4];
+};
+
+struct shm_fan {
+  char name[OCPJBOD_NAME_LENGTH];
+  uint32_t common_status;
+  int32_t rpm;
+};
+
+struct shm_enclosure {
+  uint32_t seq;
+  int32_t rc;                     /* of the last read, 0 if it is valid */
+  int64_t updated_ms;             /* CLOCK_REALTIME of the last read */
+  char devname[OCPJBOD_NAME_LENGTH];
+  char sas_addr[OCPJBOD_SAS_ADDR_LENGTH + 1];
+  char power_name[OCPJBOD_NAME_LENGTH];     /* "" if not read */
+  char power_value[OCPJBOD_NAME_LENGTH];    /* as printed, e.g. "350 W" */
+  int32_t power;                            /* watts, -1 if not read */
+  int32_t slot_count;
+  int32_t temp_count;
+  int32_t vol_count;
+  int32_t curr_count;
+  int32_t fan_count;
+  struct shm_slot slots[OCPJBOD_MAX_ELEMENTS];
+  struct shm_sensor temp_sensors[OCPJBOD_MAX_ELEMENTS];
+  struct shm_sensor vol_sensors[OCPJBOD_MAX_ELEMENTS];
+  struct shm_sensor curr_sensors[OCPJBOD_MAX_ELEMENTS];
+  struct shm_fan fans[OCPJBOD_MAX_ELEMENTS];
+};
+
+/* what the enclosure is; strings are "" if they could not be read */
+struct ocpjbod_info {
+  char type[OCPJBOD_NAME_LENGTH];           /* e.g. "knox" */
+  char vendor[OCPJBOD_NAME_LENGTH];
+  char product[OCPJBOD_NAME_LENGTH];
+  char revision[OCPJBOD_NAME_LENGTH];
+  char sas_addr[OCPJBOD_NAME_LENGTH];       /* as in sysfs, e.g. "0x50..." */
+  char node_sn[OCPJBOD_NAME_LENGTH];
+  char asset_node[OCPJBOD_NAME_LENGTH];
+  char asset_chassis[OCPJBOD_NAME_LENGTH];
+};
+
+/* a name and its value, e.g. an asset tag */
+struct ocpjbod_value {
+  char name[OCPJBOD_NAME_LENGTH];
+  char value[OCPJBOD_NAME_LENGTH];
+};
+
+/* configuration items, in the order ocpjbod_read_configs() returns them */
+#define OCPJBOD_CONFIG_POWER_WINDOW      0
+#define OCPJBOD_CONFIG_HDD_TEMP_INTERVAL 1
+#define OCPJBOD_CONFIG_FAN_PROFILE       2
+#define OCPJBOD_CONFIG_COUNT             3
+
+/* a configuration item; value is -1 if it is not supported or readable */
+struct ocpjbod_config {
+  char name[OCPJBOD_NAME_LENGTH];
+  int value;
+};
+
+/* drive LEDs */
+#define OCPJBOD_LED_FAULT 0
+#define OCPJBOD_LED_IDENT 1
+
+/* one LED change: op 1 requests the LED of slot, 0 clears the request */
+struct ocpjbod_led_change {
+  int slot;
+  int led;
+  int op;
+};
+
+/* a signal of the enclosure, e.g. a GPIO or an event status */
+struct ocpjbod_signal {
+  char name[OCPJBOD_TEXT_LENGTH];
+  char state[OCPJBOD_TEXT_LENGTH];          /* what value means */
+  int value;                                /* 0 or 1 */
+};
+
+#define OCPJBOD_EVENT_DESCRIPTION_LENGTH 40
+
+/* a record of the event log of the enclosure */
+struct ocpjbod_event {
+  long long timestamp;
+  int id;
+  int code;
+  unsigned int data;
+  char description[OCPJBOD_EVENT_DESCRIPTION_LENGTH + 1];
+};
+
+/*
+ * PHY error counters are invalid dword, running disparity, loss of dword
+ * sync and phy reset problem, in this order
+ */
+#define OCPJBOD_PHYERR_COUNTERS 4
+#define OCPJBOD_MAX_PHYS        64
+
+struct ocpjbod_phyerr {
+  long time;                                /* wall clock of the read */
+  int phy_count;
+  unsigned int counters[OCPJBOD_MAX_PHYS][OCPJBOD_PHYERR_COUNTERS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma GCC visibility push(default)
+
+/* sg devices of the supported enclosures, up to max; return the count */
+extern int ocpjbod_list(char devnames[][PATH_MAX], int max);
+
+/* return NULL and set *error on failure */
+extern struct ocpjbod *ocpjbod_open(const char *devname, int *error);
+
+extern void ocpjbod_close(struct ocpjbod *jbod);
+
+extern const char *ocpjbod_devname(struct ocpjbod *jbod);
+
+extern int ocpjbod_read_info(struct ocpjbod *jbod, struct ocpjbod_info *info);
+
+/*
+ * read slots, sensors, fans and power into status. With fresh, SES pages
+ * kept from an earlier read are read again.
+ */
+extern int ocpjbod_read_status(struct ocpjbod *jbod, int fresh,
+                               struct shm_enclosure *status);
+
+/* read up to max asset tags into tags; set *count to how many there are */
+extern int ocpjbod_read_tags(struct ocpjbod *jbod, struct ocpjbod_value *tags,
+                             int max, int *count);
+
+extern int ocpjbod_write_tag(struct ocpjbod *jbod, const char *name,
+                             const char *value);
+
+/* read all OCPJBOD_CONFIG_COUNT items */
+extern int ocpjbod_read_configs(struct ocpjbod *jbod,
+                                struct ocpjbod_config configs[]);
+
+/*
+ * power a slot on (on = 1) or off, waiting up to timeout seconds for the
+ * drive; return -1 on timeout
+ */
+extern int ocpjbod_hdd_power(struct ocpjbod *jbod, int slot, int on,
+                             int timeout);
+
+/* apply changes with one SES write; nothing is written if any is invalid */
+extern int ocpjbod_hdd_leds(struct ocpjbod *jbod,
+                            const struct ocpjbod_led_change *changes,
+                            int count);
+
+/*
+ * read up to max signals of the GPIO or the event status buffer into
+ * signals; set *count to how many there are
+ */
+extern int ocpjbod_read_gpio(struct ocpjbod *jbod,
+                             struct ocpjbod_signal *signals, int max,
+                             int *count);
+extern int ocpjbod_read_event_status(struct ocpjbod *jbod,
+                                     struct ocpjbod_signal *signals, int max,
+                                     int *count);
+
+/*
+ * read up to max of the newest records of the event log into events,
+ * oldest first; set *count to how many were read
+ */
+extern int ocpjbod_read_events(struct ocpjbod *jbod,
+                               struct ocpjbod_event *events, int max,
+                               int *count);
+
+extern int ocpjbod_read_phyerr(struct ocpjbod *jbod,
+                               struct ocpjbod_phyerr *phyerr);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
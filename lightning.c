@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <curl/curl.h>
@@ -626,7 +627,7 @@ static void lightning_print_drive_info(jbof_handle_t* handle) {
   walk_pci_switch(handle->switchpath, check_drive, &ctx);
   json_object_object_add(enclosure, handle->jbof_id, drives);
   if(print_json) {
-    printf("%s\n", json_object_get_string(enclosure));
+    json_document(json_object_get_string(enclosure));
   } else {
     json_object_object_foreach(drives, drivedev, drive) {
       printf("%s\t", drivedev);
@@ -656,7 +657,7 @@ static void lightning_print_enclosure_info(jbof_handle_t* handle) {
     bmc_request(BMC_API_DEFAULT_URL "/pdpb/flash", NULL));
 
   if (print_json) {
-    printf("%s\n",
+    json_document(
         json_object_to_json_string_ext(info, JSON_C_TO_STRING_PRETTY));
   } else {
     json_object_object_foreach(info, board, bobj) {
@@ -684,7 +685,7 @@ static void lightning_print_sensor_info(jbof_handle_t* handle) {
     bmc_request(BMC_API_DEFAULT_URL "/pdpb/sensors", NULL));
 
   if (print_json) {
-    printf("%s\n",
+    json_document(
       json_object_to_json_string_ext(sensors, JSON_C_TO_STRING_PRETTY));
   } else {
     json_object_object_foreach(sensors, board, bobj) {
@@ -705,7 +706,7 @@ static void lightning_print_fan_info(jbof_handle_t* handle) {
   }
 
   if (print_json) {
-    printf("%s\n",
+    json_document(
       json_object_to_json_string_ext(fans, JSON_C_TO_STRING_PRETTY));
   } else {
     json_object_object_foreach(fans, field, fv) {
@@ -729,7 +730,7 @@ static void lightning_print_led_info(jbof_handle_t* handle) {
     bmc_request(BMC_API_DEFAULT_URL "/peb/identify", NULL));
 
   if (print_json) {
-    printf("%s\n",
+    json_document(
       json_object_to_json_string_ext(leds, JSON_C_TO_STRING_PRETTY));
   } else {
     json_object_object_foreach(leds, board, bobj) {
@@ -777,18 +778,14 @@ static void print_port_evcntrs(
     uint32_t* values,
     size_t count,
     uint8_t port) {
-  bool first = true;
   for (int i = 0; i < count; ++i) {
     if (evcntrs[i].port_mask & (1 << port)) {
       int type_mask = evcntrs[i].type_mask;
       assert(type_mask);
       if (print_json) {
-        if (!first) {
-          printf(",\n");
-        }
-        first = false;
-        printf("\t\t\t{\"%s\" : \"%d\"}",
-            switchtec_evcntr_type_str(&type_mask), values[i]);
+        json_group_begin(NULL);
+        json_item(switchtec_evcntr_type_str(&type_mask), "%u", values[i]);
+        json_group_end();
       } else {
         printf("  %10u\t%s\n",
             values[i], switchtec_evcntr_type_str(&type_mask));
@@ -804,22 +801,24 @@ static void print_port_phyerr_info(
     flashtype_t flash_type) {
 
   if (print_json) {
-    printf("\t\"/Partition%02d/Stack%02d/Port%02d\" : {\n",
+    char port[PATH_MAX];
+    snprintf(port, PATH_MAX, "/Partition%02d/Stack%02d/Port%02d",
         status->port.partition,
         status->port.stack,
         status->port.stk_id);
-    printf("\t\t\"type\" : \"%s\",\n", status->port.upstream ? "USP" : "DSP");
+    json_group_begin(port);
+    json_item("type", "%s", status->port.upstream ? "USP" : "DSP");
     if (status->port.upstream) {
-      printf("\t\t\"slot\" : \"%d\",\n", status->port.log_id);
+      json_item("slot", "%d", status->port.log_id);
     } else if (flash_type == FLASH_TYPE_U2) {
-      printf("\t\t\"slot\" : \"%d\",\n", status->port.log_id - 1);
+      json_item("slot", "%d", status->port.log_id - 1);
     } else {
-      printf("\t\t\"slot\" : \"%d:%d\",\n",
+      json_item("slot", "%d:%d",
           (status->port.log_id - 1) / 2, (status->port.log_id - 1) & 1);
     }
-    printf("\t\t\"phy\" : \"%d\",\n", status->port.phys_id);
-    printf("\t\t\"status\" : \"%s\",\n", status->link_up ? "UP" : "DOWN");
-    printf("\t\t\"counters\" : [\n");
+    json_item("phy", "%d", status->port.phys_id);
+    json_item("status", "%s", status->link_up ? "UP" : "DOWN");
+    json_array_begin("counters");
   } else {
     printf("/Partition%02d/Stack%02d/Port%02d  %s_",
         status->port.partition,
@@ -856,8 +855,8 @@ static void print_port_phyerr_info(
     print_port_evcntrs(evcntrs, values, count, status->port.stk_id);
   }
   if (print_json) {
-      printf("\n\t\t]\n");
-      printf("\t}");
+    json_array_end();
+    json_group_end();
   }
 }
 
@@ -877,20 +876,13 @@ static void lightning_print_phyerr_info(jbof_handle_t* handle, bool clear) {
   assert(status);
   qsort(status, count, sizeof(*status), compare_status);
 
-  if (print_json) {
-    printf("{\n");
-  }
+  JSON_HEADER;
   for (int i = 0; i < count; ++i) {
     if (status[i].port.partition != SWITCHTEC_UNBOUND_PORT) {
-      if (print_json && i) {
-        printf(",\n");
-      }
       print_port_phyerr_info(dev, &status[i], handle->flash_type);
     }
   }
-  if (print_json) {
-    printf("\n}\n");
-  }
+  JSON_ENDING;
 
   if (clear) {
     clear_phyerr_info(dev);
@@ -925,7 +917,7 @@ static void lightning_print_asset_tags(jbof_handle_t* handle) {
     }
   }
   if (print_json) {
-    printf("%s\n",
+    json_document(
       json_object_to_json_string_ext(assets, JSON_C_TO_STRING_PRETTY));
   }
 
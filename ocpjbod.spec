@@ -28,3 +28,6 @@ rm -rf $RPM_BUILD_ROOT
 %files
 %defattr(-,root,root)
 %{_bindir}/ocpjbod
+%{_bindir}/ocpjbodd
+/usr/lib64/libocpjbod.so
+%{_includedir}/ocpjbod/libocpjbod.h
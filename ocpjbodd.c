@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <getopt.h>
+
+#include "daemon.h"
+#include "shm_snapshot.h"
+
+static struct option long_options[] = {
+  {"help",           no_argument,         0,    'h' },
+  {"socket",         required_argument,   0,    's' },
+  {"interval",       required_argument,   0,    'i' },
+  {"shm",            required_argument,   0,    'm' },
+  {0,                0,                   0,    0   },
+};
+
+static void usage(void)
+{
+  printf("%sd [options]\n"
+         "\tanswer %s queries over a Unix socket from what one poller\n"
+         "\treads of the enclosures\n\n"
+         "\t\t--socket <path>  \t- listen on <path> (default %s)\n"
+         "\t\t--interval <ms>  \t- read enclosures every <ms> (default %d)\n"
+         "\t\t--shm <path>     \t- publish every enclosure to <path> each\n"
+         "\t\t                 \t  interval; \"\" does not (default %s)\n",
+         NAME, NAME, DAEMON_SOCKET_PATH, DAEMON_DEFAULT_INTERVAL_MS,
+         SHM_SNAPSHOT_PATH);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *path = DAEMON_SOCKET_PATH;
+  const char *shm_path = SHM_SNAPSHOT_PATH;
+  int interval_ms = DAEMON_DEFAULT_INTERVAL_MS;
+  int c;
+
+  while ((c = getopt_long(argc, argv, "hs:i:m:", long_options, NULL)) != -1) {
+    switch (c) {
+    case 's':
+      path = optarg;
+      break;
+    case 'm':
+      shm_path = optarg;
+      break;
+    case 'i':
+      interval_ms = atoi(optarg);
+      if (interval_ms <= 0) {
+        usage();
+        return 1;
+      }
+      break;
+    default:
+      usage();
+      return c != 'h';
+    }
+  }
+  return daemon_serve(path, shm_path, interval_ms);
+}
@@ -0,0 +1,377 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <scsi/sg_lib.h>
+#include <scsi/sg_cmds.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "enclosure_cache.h"
+#include "jbod_interface.h"
+#include "openmetrics.h"
+#include "parallel.h"
+#include "phyerr.h"
+#include "scsi_buffer.h"
+#include "ses.h"
+
+struct metrics_job {
+  char *devname;
+  char enclosure[PATH_MAX];         /* SAS address, or devname */
+  struct ses_status_info *ses;      /* NULL if not read */
+  struct phyerr_sample *phyerr;     /* NULL if not read */
+  int power;                        /* watts, -1 if not read */
+  int rc;
+};
+
+static void collect_phyerr(int sg_fd, const struct metrics_profile *profile,
+                           struct metrics_job *job)
+{
+  struct enclosure_cache *cache;
+
+  if (profile->phyerr_buffer_id == -1)
+    return;
+  cache = (struct enclosure_cache *) malloc(sizeof(struct enclosure_cache));
+  job->phyerr = (struct phyerr_sample *) malloc(sizeof(struct phyerr_sample));
+  if (cache != NULL && job->phyerr != NULL) {
+    /* the cache remembers whether one command reads all phys */
+    enclosure_cache_open(sg_fd, cache);
+    if (read_phyerr_sample(sg_fd, profile->phyerr_buffer_id,
+                           profile->phyerr_phy_count, job->phyerr,
+                           cache) == 0) {
+      enclosure_cache_save(cache);
+      free(cache);
+      return;
+    }
+  }
+  free(cache);
+  free(job->phyerr);
+  job->phyerr = NULL;
+}
+
+static void collect_one(int index, void *arg)
+{
+  struct metrics_job *job = (struct metrics_job *) arg + index;
+  const struct metrics_profile *profile = NULL;
+  struct jbod_interface *jbod;
+  int sg_fd;
+
+  job->power = -1;
+  jbod = detect_dev(job->devname);
+  if (jbod == NULL) {
+    job->rc = ENODEV;
+    return;
+  }
+  sg_fd = sg_cmds_open_device(job->devname, 0 /* rw */, 0 /* not verbose */);
+  if (sg_fd < 0) {
+    job->rc = ENODEV;
+    return;
+  }
+
+  if (read_enclosure_attr(sg_fd, "sas_address", job->enclosure,
+                          PATH_MAX) != 0)
+    snprintf(job->enclosure, PATH_MAX, "%s", job->devname);
+
+  job->ses = (struct ses_status_info *) malloc(sizeof(struct ses_status_info));
+  /* neither thresholds nor disk names are exported */
+  if (job->ses == NULL || fetch_ses_status_of(sg_fd, job->ses, 0) != 0) {
+    free(job->ses);
+    job->ses = NULL;
+    job->rc = EIO;
+  }
+
+  if (jbod->get_metrics_profile)
+    profile = jbod->get_metrics_profile();
+  if (profile != NULL) {
+    if (profile->power != NULL &&
+        read_value_as_int(sg_fd, profile->power, &job->power) != 0)
+      job->power = -1;
+    collect_phyerr(sg_fd, profile, job);
+  }
+  sg_cmds_close_device(sg_fd);
+}
+
+static void print_label_value(FILE *out, const char *value)
+{
+  fputc('"', out);
+  for (; value != NULL && *value; ++value) {
+    if (*value == '\n') {
+      fputs("\\n", out);
+      continue;
+    }
+    if (*value == '\\' || *value == '"')
+      fputc('\\', out);
+    fputc(*value, out);
+  }
+  fputc('"', out);
+}
+
+static void print_label(FILE *out, const char *name, const char *value)
+{
+  fprintf(out, ",%s=", name);
+  print_label_value(out, value);
+}
+
+/* name{enclosure="...",device="..." ; the caller closes the labels */
+static void begin_sample(FILE *out, const char *name, struct metrics_job *job)
+{
+  fprintf(out, "%s{enclosure=", name);
+  print_label_value(out, job->enclosure);
+  print_label(out, "device", job->devname);
+}
+
+/*
+ * the position of an element among those of its type, so that elements
+ * with the same or no name still make distinct series
+ */
+static void print_index(FILE *out, int index)
+{
+  char id[16];
+
+  snprintf(id, sizeof(id), "%d", index);
+  print_label(out, "index", id);
+}
+
+static void print_family(FILE *out, const char *name, const char *type,
+                         const char *unit, const char *help)
+{
+  fprintf(out, "# TYPE %s %s\n", name, type);
+  if (unit != NULL)
+    fprintf(out, "# UNIT %s %s\n", name, unit);
+  fprintf(out, "# HELP %s %s\n", name, help);
+}
+
+static int element_present(unsigned char common_status)
+{
+  return STATUS_CODE(common_status) != ELEMENT_STATUS_UNSUPPORTED &&
+         STATUS_CODE(common_status) != ELEMENT_STATUS_NOT_INSTALLED;
+}
+
+static void print_sensors(FILE *out, struct metrics_job *jobs, int count)
+{
+  struct ses_status_info *ses;
+  int i, j;
+
+  print_family(out, "ocpjbod_temperature_celsius", "gauge", "celsius",
+               "Temperature sensor reading.");
+  for (i = 0; i < count; ++i) {
+    for (ses = jobs[i].ses, j = 0; ses && j < ses->temp_count; ++j) {
+      if (!element_present(ses->temp_sensors[j].common_status))
+        continue;
+      begin_sample(out, "ocpjbod_temperature_celsius", jobs + i);
+      print_label(out, "sensor", ses->temp_sensors[j].name);
+      print_index(out, j);
+      fprintf(out, "} %d\n", ses->temp_sensors[j].temperature);
+    }
+  }
+
+  print_family(out, "ocpjbod_voltage_volts", "gauge", "volts",
+               "Voltage sensor reading.");
+  for (i = 0; i < count; ++i) {
+    for (ses = jobs[i].ses, j = 0; ses && j < ses->vol_count; ++j) {
+      if (!element_present(ses->vol_sensors[j].common_status))
+        continue;
+      begin_sample(out, "ocpjbod_voltage_volts", jobs + i);
+      print_label(out, "sensor", ses->vol_sensors[j].name);
+      print_index(out, j);
+      fprintf(out, "} %.2f\n", ses->vol_sensors[j].voltage);
+    }
+  }
+
+  print_family(out, "ocpjbod_current_amperes", "gauge", "amperes",
+               "Current sensor reading.");
+  for (i = 0; i < count; ++i) {
+    for (ses = jobs[i].ses, j = 0; ses && j < ses->curr_count; ++j) {
+      if (!element_present(ses->curr_sensors[j].common_status))
+        continue;
+      begin_sample(out, "ocpjbod_current_amperes", jobs + i);
+      print_label(out, "sensor", ses->curr_sensors[j].name);
+      print_index(out, j);
+      fprintf(out, "} %.2f\n", ses->curr_sensors[j].current);
+    }
+  }
+
+  print_family(out, "ocpjbod_fan_speed_rpm", "gauge", "rpm",
+               "Fan speed.");
+  for (i = 0; i < count; ++i) {
+    for (ses = jobs[i].ses, j = 0; ses && j < ses->fan_count; ++j) {
+      if (!element_present(ses->fans[j].common_status))
+        continue;
+      begin_sample(out, "ocpjbod_fan_speed_rpm", jobs + i);
+      print_label(out, "fan", ses->fans[j].name);
+      print_index(out, j);
+      fprintf(out, "} %d\n", ses->fans[j].rpm);
+    }
+  }
+}
+
+/* one gauge per slot, from one field of the slot */
+#define SLOT_FIELD_POWER_ON 0
+#define SLOT_FIELD_FAULT    1
+#define SLOT_FIELD_IDENT    2
+
+static int slot_field(struct array_device_slot *slot, int field)
+{
+  switch (field) {
+    case SLOT_FIELD_POWER_ON:
+      return !slot->device_off;
+    case SLOT_FIELD_FAULT:
+      return slot->fault != 0;
+    default:
+      return slot->ident != 0;
+  }
+}
+
+static void print_slots(FILE *out, struct metrics_job *jobs, int count)
+{
+  static const char *const names[] = {
+    "ocpjbod_slot_power_on", "ocpjbod_slot_fault", "ocpjbod_slot_ident"};
+  static const char *const helps[] = {
+    "Whether the drive slot is powered on.",
+    "Whether the fault LED of the slot is requested or sensed.",
+    "Whether the ident LED of the slot is on."};
+  struct array_device_slot *slot;
+  char id[16];
+  int field, i, j;
+
+  for (field = SLOT_FIELD_POWER_ON; field <= SLOT_FIELD_IDENT; ++field) {
+    print_family(out, names[field], "gauge", NULL, helps[field]);
+    for (i = 0; i < count; ++i) {
+      for (j = 0; jobs[i].ses && j < jobs[i].ses->slot_count; ++j) {
+        slot = jobs[i].ses->slots + j;
+        snprintf(id, sizeof(id), "%d", slot->slot);
+        begin_sample(out, names[field], jobs + i);
+        print_label(out, "slot", id);
+        fprintf(out, "} %d\n", slot_field(slot, field));
+      }
+    }
+  }
+
+  print_family(out, "ocpjbod_slot_status", "gauge", NULL,
+               "Status of the drive slot as a label, as shown by hdd.");
+  for (i = 0; i < count; ++i) {
+    for (j = 0; jobs[i].ses && j < jobs[i].ses->slot_count; ++j) {
+      slot = jobs[i].ses->slots + j;
+      snprintf(id, sizeof(id), "%d", slot->slot);
+      begin_sample(out, "ocpjbod_slot_status", jobs + i);
+      print_label(out, "slot", id);
+      print_label(out, "status", status_str(*slot));
+      fprintf(out, "} 1\n");
+    }
+  }
+}
+
+static void print_power_and_phyerr(FILE *out, struct metrics_job *jobs,
+                                   int count)
+{
+  char phy[16];
+  int i, j, k;
+
+  print_family(out, "ocpjbod_power_watts", "gauge", "watts",
+               "Power draw of the enclosure.");
+  for (i = 0; i < count; ++i) {
+    if (jobs[i].power < 0)
+      continue;
+    begin_sample(out, "ocpjbod_power_watts", jobs + i);
+    fprintf(out, "} %d\n", jobs[i].power);
+  }
+
+  print_family(out, "ocpjbod_phy_errors", "counter", NULL,
+               "Phy error counter of the expander, reset by phyerr --clear.");
+  for (i = 0; i < count; ++i) {
+    for (j = 0; jobs[i].phyerr && j < jobs[i].phyerr->phy_count; ++j) {
+      snprintf(phy, sizeof(phy), "%d", j);
+      for (k = 0; k < PHYERR_COUNTER_COUNT; ++k) {
+        begin_sample(out, "ocpjbod_phy_errors_total", jobs + i);
+        print_label(out, "phy", phy);
+        print_label(out, "counter", phyerr_counter_names[k]);
+        fprintf(out, "} %u\n", jobs[i].phyerr->counters[j][k]);
+      }
+    }
+  }
+
+  print_family(out, "ocpjbod_up", "gauge", NULL,
+               "Whether the SES pages of the enclosure were read.");
+  for (i = 0; i < count; ++i) {
+    begin_sample(out, "ocpjbod_up", jobs + i);
+    fprintf(out, "} %d\n", jobs[i].ses != NULL);
+  }
+}
+
+/* write to a file next to path, then rename it over path */
+static int write_metrics(const char *path, struct metrics_job *jobs,
+                         int count)
+{
+  char tmp_path[PATH_MAX];
+  FILE *out;
+  int rc = 0;
+
+  snprintf(tmp_path, PATH_MAX, "%s.%d.tmp", path, (int) getpid());
+  out = fopen(tmp_path, "w");
+  if (out == NULL) {
+    perr("Cannot create %s.\n", tmp_path);
+    return errno;
+  }
+
+  print_sensors(out, jobs, count);
+  print_slots(out, jobs, count);
+  print_power_and_phyerr(out, jobs, count);
+  fprintf(out, "# EOF\n");
+
+  if (fflush(out) != 0 || fsync(fileno(out)) != 0)
+    rc = errno;
+  if (fclose(out) != 0 && rc == 0)
+    rc = errno;
+  if (rc == 0 && rename(tmp_path, path) != 0)
+    rc = errno;
+  if (rc != 0) {
+    perr("Cannot write %s.\n", path);
+    unlink(tmp_path);
+  }
+  return rc;
+}
+
+int export_openmetrics(const char *path, char *devnames[], int count,
+                       int max_parallel)
+{
+  struct metrics_job *jobs;
+  int rc;
+  int i;
+
+  jobs = (struct metrics_job *) calloc(count, sizeof(struct metrics_job));
+  if (jobs == NULL) {
+    perr("Cannot allocate memory.\n");
+    return ENOMEM;
+  }
+  for (i = 0; i < count; ++i)
+    jobs[i].devname = devnames[i];
+
+  run_parallel(count, max_parallel, collect_one, jobs);
+
+  /* an enclosure that fails is reported by ocpjbod_up, not an error */
+  for (i = 0; i < count; ++i) {
+    if (jobs[i].rc == ENODEV)
+      perr("%s is not a jbod device\n", jobs[i].devname);
+    else if (jobs[i].rc)
+      perr("Failed to read SES pages of %s.\n", jobs[i].devname);
+  }
+  rc = write_metrics(path, jobs, count);
+
+  for (i = 0; i < count; ++i) {
+    if (jobs[i].ses) {
+      free_ses_status(jobs[i].ses);
+      free(jobs[i].ses);
+    }
+    free(jobs[i].phyerr);
+  }
+  free(jobs);
+  return rc;
+}
@@ -0,0 +1,26 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef OPENMETRICS_H
+#define OPENMETRICS_H
+
+/* enclosures to read at the same time */
+#define OPENMETRICS_DEFAULT_PARALLEL 8
+
+/*
+ * read sensors, fans, slots, power and phy error counters of devnames,
+ * one SES snapshot per enclosure, and write them to path in the
+ * OpenMetrics text format. The file is written next to path and renamed,
+ * so a collector never reads a partial file. Samples are labeled with
+ * the SAS address of the enclosure and its devname.
+ */
+extern int export_openmetrics(const char *path, char *devnames[], int count,
+                              int max_parallel);
+
+#endif
@@ -21,10 +21,24 @@
 #endif
 #include <getopt.h>
 
+#include "history.h"
 #include "options.h"
+#include "shm_snapshot.h"
 #include "jbod_interface.h"
 #include "jbof_interface.h"
 #include "json.h"
+#include "asset_tag.h"
+#include "daemon.h"
+#include "enclosure_config.h"
+#include "event_status.h"
+#include "event_log.h"
+#include "hdd_led.h"
+#include "libocpjbod.h"
+#include "openmetrics.h"
+#include "parallel.h"
+#include "phyerr.h"
+#include "power_cycle.h"
+#include "slot_watch.h"
 
 #ifdef UTIL_VERSION
 #define VERSION_STRING UTIL_VERSION
@@ -32,6 +46,10 @@
 #define VERSION_STRING "00.rc"
 #endif
 
+/* command lines of batch */
+#define BATCH_MAX_LINE 4096
+#define BATCH_MAX_ARGS 64
+
 struct option long_options[] = {
   {"help",           no_argument,         0,    'h' },
   {"hdd-on",         required_argument,   0,    'O' },
@@ -58,10 +76,27 @@ struct option long_options[] = {
   {"timeout",        required_argument,   0,    'm' },
   {"cold-storage",   no_argument,         0,    'z' },
   {"dirty",          no_argument,         0,    'y' },
+  {"parallel",       required_argument,   0,    'N' },
+  {"ident-on",       required_argument,   0,    'I' },
+  {"ident-off",      required_argument,   0,    'J' },
+  {"watch",          no_argument,         0,    'W' },
+  {"import",         required_argument,   0,    'M' },
+  {"export",         no_argument,         0,    'E' },
+  {"new",            no_argument,         0,    'n' },
+  {"changes",        no_argument,         0,    'g' },
+  {"apply",          required_argument,   0,    'Y' },
+  {"openmetrics",    required_argument,   0,    'X' },
+  {"ndjson",         no_argument,         0,    NDJSON_OPTION },
+  {"cbor",           no_argument,         0,    CBOR_OPTION },
+  {"fields",         required_argument,   0,    FIELDS_OPTION },
+  {"from-shm",       optional_argument,   0,    FROM_SHM_OPTION },
+  {"record",         required_argument,   0,    RECORD_OPTION },
+  {"since",          required_argument,   0,    SINCE_OPTION },
+  {"resolution",     required_argument,   0,    RESOLUTION_OPTION },
   {0,                0,                   0,    0   },
 };
 
-static const char short_options[] = "O:o:R:F:f:taAp:C:T:i:lsw:H:P:Djcdm:zy";
+static const char short_options[] = "O:o:R:F:f:taAp:C:T:i:lsw:H:P:Djcdm:zyN:I:J:WM:EngY:X:";
 
 static int option_index = 0;
 
@@ -90,11 +125,26 @@ static char* get_devname(int argc, char* argv[]) {
   return NULL;
 }
 
+/* extract all device names from argc/argv, return the count */
+static int get_devnames(int argc, char* argv[], char *devnames[], int max) {
+  int count = 0;
+
+  optind = 1;
+  while (getopt_long(argc, argv, short_options, long_options, NULL) != -1) {
+  }
+
+  while (optind < argc && count < max) {
+    devnames[count++] = argv[optind++];
+  }
+  return count;
+}
+
 /* list all JBODs */
 int execute_list(int argc, char *argv[])
 {
   char c;
   int show_detail = 0;
+  int max_parallel = DEFAULT_PARALLEL;
   int jbod_count;
   struct jbod_device jbod_devices[MAX_JBOD_PER_HOST];
 
@@ -106,13 +156,23 @@ int execute_list(int argc, char *argv[])
       case 'd':
         show_detail = 1;
         break;
+      case 'N':
+        max_parallel = atoi(optarg);
+        break;
       default:
         usage(argc, argv);
         return 1;
     }
   }
 
-  jbod_count = lib_list_jbod(jbod_devices);
+  if (max_parallel < 1) {
+    perr("Cannot specify parallel less than 1, %d.\n", max_parallel);
+    return 1;
+  }
+
+  jbod_count = lib_list_jbod(jbod_devices, max_parallel);
+  if (show_detail)
+    lib_fetch_short_profiles(jbod_devices, jbod_count, max_parallel);
   print_list_of_jbod(jbod_devices, jbod_count, show_detail);
 
   return 0;
@@ -148,6 +208,7 @@ int execute_sensor(int argc, char *argv[])
   char *devname;
   int sg_fd;
   int print_thresholds = 0;
+  const char *shm_path = NULL;
   char c;
 
   optind = 1;
@@ -158,6 +219,9 @@ int execute_sensor(int argc, char *argv[])
       case 't':
         print_thresholds = 1;
         break;
+      case FROM_SHM_OPTION:
+        shm_path = optarg ? optarg : SHM_SNAPSHOT_PATH;
+        break;
       default:
         usage(argc, argv);
         return 1;
@@ -165,12 +229,14 @@ int execute_sensor(int argc, char *argv[])
   }
 
   devname = get_devname(argc, argv);
+  if (shm_path)
+    return shm_snapshot_print(shm_path, devname, SHM_PRINT_SENSORS,
+                              print_thresholds);
   jbod = detect_dev(devname);
   if (jbod) {
     sg_fd = sg_cmds_open_device(devname, 0 /* rw */, 0 /* not verbose */);
     if (sg_fd > 0) {
       jbod->print_all_sensor_reading(sg_fd, print_thresholds);
-      PRINT_JSON_MORE_ITEM;
       jbod->print_power_reading(sg_fd);
       sg_cmds_close_device(sg_fd);
     }
@@ -408,25 +474,166 @@ int jbof_execute_hdd(int argc, char* argv[]) {
   return jbof_show_drives(devname);
 }
 
-/* show HDD info, control HDD power on/off, fault */
+#define MAX_LED_SPECS 64
+
+/* one --fault-on/--fault-off/--ident-on/--ident-off argument */
+struct led_spec {
+  char *arg;    /* "[devname:]slot_list" */
+  int led;
+  int op;
+};
+
+static struct hdd_led_request *find_led_request(
+  struct hdd_led_request *requests, int *count, const char *devname)
+{
+  int i;
+
+  for (i = 0; i < *count; ++i) {
+    if (strcmp(requests[i].devname, devname) == 0)
+      return requests + i;
+  }
+  if (*count >= MAX_JBOD_PER_HOST)
+    return NULL;
+  snprintf(requests[*count].devname, PATH_MAX, "%s", devname);
+  return requests + (*count)++;
+}
+
+/*
+ * apply LED specs to their enclosures, one page 0x02 write per enclosure.
+ * A spec without "devname:" applies to every device in devnames.
+ */
+static int execute_hdd_leds(struct led_spec *specs, int spec_count,
+                            char *devnames[], int dev_count, int max_parallel)
+{
+  struct hdd_led_request *requests;
+  struct hdd_led_request *request;
+  struct jbod_interface *jbod;
+  int request_count = 0;
+  char devname[PATH_MAX];
+  char *slot_list;
+  int sg_fd;
+  int ret = 0;
+  int i, j;
+
+  requests = (struct hdd_led_request *)
+    calloc(MAX_JBOD_PER_HOST, sizeof(struct hdd_led_request));
+  if (requests == NULL) {
+    perr("Cannot allocate memory.\n");
+    return ENOMEM;
+  }
+
+  for (i = 0; i < spec_count && ret == 0; ++i) {
+    slot_list = strrchr(specs[i].arg, ':');
+    if (slot_list) {
+      snprintf(devname, PATH_MAX, "%.*s",
+               (int) (slot_list - specs[i].arg), specs[i].arg);
+      ++slot_list;
+      request = find_led_request(requests, &request_count, devname);
+      ret = request ? add_hdd_led_changes(request, slot_list,
+                                          specs[i].led, specs[i].op) : E2BIG;
+    } else if (dev_count == 0) {
+      perr("No jbod device for slot list %s.\n", specs[i].arg);
+      ret = ENODEV;
+    } else {
+      for (j = 0; j < dev_count && ret == 0; ++j) {
+        request = find_led_request(requests, &request_count, devnames[j]);
+        ret = request ? add_hdd_led_changes(request, specs[i].arg,
+                                            specs[i].led, specs[i].op) : E2BIG;
+      }
+    }
+    if (ret == EINVAL)
+      perr("Invalid slot list %s.\n", specs[i].arg);
+    else if (ret == E2BIG)
+      perr("Too many LED changes, at %s.\n", specs[i].arg);
+  }
+  if (ret != 0) {
+    free(requests);
+    return ret;
+  }
+
+  hdd_led_control_enclosures(requests, request_count, max_parallel);
+
+  for (i = 0; i < request_count; ++i) {
+    if (requests[i].rc != 0) {
+      perr("%s: operation failed with return code = %d\n",
+           requests[i].devname, requests[i].rc);
+      if (ret == 0)
+        ret = requests[i].rc;
+      if (requests[i].rc == ENODEV)
+        continue;
+    }
+    jbod = detect_dev(requests[i].devname);
+    if (jbod == NULL)
+      continue;
+    sg_fd = sg_cmds_open_device(requests[i].devname, 0 /* rw */,
+                                0 /* not verbose */);
+    if (sg_fd < 0)
+      continue;
+    if (request_count > 1)
+      IF_PRINT_NONE_JSON printf(">>> %s \n", requests[i].devname);
+    PRINT_JSON_GROUP_HEADER(requests[i].devname);
+    jbod->print_hdd_info(sg_fd);
+    PRINT_JSON_GROUP_ENDING;
+    sg_cmds_close_device(sg_fd);
+  }
+  free(requests);
+  return ret;
+}
+
+/* in a worker: the SES pages execute_hdd_info() will print from */
+static void prefetch_hdd_info(int index, void *arg)
+{
+  struct jbod_device *d = (struct jbod_device *) arg + index;
+
+  jbod_prefetch_ses(d->sg_device, SES_FETCH_DEV_NAMES);
+}
+
+/* show HDD info, control HDD power on/off, fault/ident LEDs */
+/* print the HDDs of one JBOD of hdd --all */
+static void execute_hdd_info(int index, void *arg)
+{
+  struct jbod_device *d = (struct jbod_device *) arg + index;
+  struct jbod_interface *jbod;
+  int sg_fd;
+
+  jbod = detect_dev(d->sg_device);
+  if (jbod == NULL)
+    return;
+  IF_PRINT_NONE_JSON
+    printf(">>> %s \n", d->sg_device);
+  sg_fd = sg_cmds_open_device(d->sg_device, 0 /* rw */, 0 /* not verbose */);
+  if (sg_fd > 0) {
+    PRINT_JSON_GROUP_HEADER(d->sg_device);
+    jbod->print_hdd_info(sg_fd);
+    PRINT_JSON_GROUP_ENDING;
+    sg_cmds_close_device(sg_fd);
+  }
+}
+
 int execute_hdd(int argc, char *argv[])
 {
   struct jbod_interface *jbod;
   char *devname;
+  char *devnames[MAX_JBOD_PER_HOST];
+  int dev_count;
   int sg_fd;
   char c;
   int hdd_on_id = -1;
   int hdd_off_id = -1;
-  int fault_led_on_id = -1;
-  int fault_led_off_id = -1;
+  struct led_spec led_specs[MAX_LED_SPECS];
+  int led_spec_count = 0;
   int show_all = 0;
   int jbod_count = 0;
   int timeout = 0;
+  int max_parallel = HDD_LED_DEFAULT_PARALLEL;
   struct jbod_device jbod_devices[MAX_JBOD_PER_HOST];
   int i;
   int ret;
   int cold_storage = 0;
   int dirty = 0;
+  int kept;
+  int watch = 0;
+  const char *shm_path = NULL;
 
   optind = 1;
   while ((c = getopt_long(argc, argv, short_options,
@@ -440,10 +647,18 @@ int execute_hdd(int argc, char *argv[])
         hdd_off_id = atoi(optarg);
         break;
       case 'F':
-        fault_led_on_id = atoi(optarg);
-        break;
       case 'f':
-        fault_led_off_id = atoi(optarg);
+      case 'I':
+      case 'J':
+        if (led_spec_count >= MAX_LED_SPECS) {
+          perr("Cannot specify more than %d LED options.\n", MAX_LED_SPECS);
+          return 1;
+        }
+        led_specs[led_spec_count].arg = optarg;
+        led_specs[led_spec_count].led =
+          (c == 'F' || c == 'f') ? HDD_LED_FAULT : HDD_LED_IDENT;
+        led_specs[led_spec_count].op = (c == 'F' || c == 'I');
+        ++led_spec_count;
         break;
       case 'a':
         show_all = 1;
@@ -451,12 +666,21 @@ int execute_hdd(int argc, char *argv[])
       case 'm':
         timeout = atoi(optarg);
         break;
+      case 'N':
+        max_parallel = atoi(optarg);
+        break;
       case 'z':
         cold_storage = 1;
         break;
       case 'y':
         dirty = 1;
         break;
+      case 'W':
+        watch = 1;
+        break;
+      case FROM_SHM_OPTION:
+        shm_path = optarg ? optarg : SHM_SNAPSHOT_PATH;
+        break;
       default:
         usage(argc, argv);
         return 1;
@@ -468,35 +692,63 @@ int execute_hdd(int argc, char *argv[])
     return 1;
   }
 
+  if (watch && (led_spec_count || hdd_on_id != -1 || hdd_off_id != -1)) {
+    perr("Cannot combine watch and hdd control.\n");
+    return 1;
+  }
+
+  if (max_parallel < 1) {
+    perr("Cannot specify parallel less than 1, %d.\n", max_parallel);
+    return 1;
+  }
+
   if (hdd_on_id != -1 && hdd_off_id != -1) {
     perr("Cannot specify both hdd_on and hdd_off.\n");
     return 1;
   }
 
-  if (fault_led_on_id != -1 && fault_led_off_id != -1) {
-    perr("Cannot specify both fault_led_on and fault_led_off.\n");
+  if (led_spec_count && (hdd_on_id != -1 || hdd_off_id != -1)) {
+    perr("Cannot combine hdd power and LED control.\n");
     return 1;
   }
 
-  if (show_all) {
-    jbod_count = lib_list_jbod(jbod_devices);
-    for (i = 0; i < jbod_count; ++i) {
-      PRINT_JSON_RESET_GROUP;
-      jbod = detect_dev(jbod_devices[i].sg_device);
-      if (jbod) {
-        IF_PRINT_NONE_JSON
-          printf(">>> %s \n", jbod_devices[i].sg_device);
-        sg_fd = sg_cmds_open_device(jbod_devices[i].sg_device, 0 /* rw */,
-                                    0 /* not verbose */);
-        if (sg_fd > 0) {
-          if (i) PRINT_JSON_MORE_GROUP;
-          PRINT_JSON_GROUP_HEADER(jbod_devices[i].sg_device);
-          jbod->print_hdd_info(sg_fd);
-          PRINT_JSON_GROUP_ENDING;
-          sg_cmds_close_device(sg_fd);
-        }
-      }
+  if (shm_path) {
+    if (led_spec_count || watch || hdd_on_id != -1 || hdd_off_id != -1) {
+      perr("Cannot combine --from-shm and hdd control.\n");
+      return 1;
+    }
+    devname = show_all ? NULL : get_devname(argc, argv);
+    if (devname == NULL)
+      return shm_snapshot_print(shm_path, NULL, SHM_PRINT_SLOTS, 0);
+    PRINT_JSON_GROUP_HEADER(devname);
+    ret = shm_snapshot_print(shm_path, devname, SHM_PRINT_SLOTS, 0);
+    PRINT_JSON_GROUP_ENDING;
+    return ret;
+  }
+
+  if (led_spec_count || watch) {
+    if (show_all) {
+      dev_count = lib_list_jbod(jbod_devices, max_parallel);
+      for (i = 0; i < dev_count; ++i)
+        devnames[i] = jbod_devices[i].sg_device;
+    } else {
+      dev_count = get_devnames(argc, argv, devnames, MAX_JBOD_PER_HOST);
     }
+    if (watch)
+      return watch_slots(devnames, dev_count);
+    return execute_hdd_leds(led_specs, led_spec_count,
+                            devnames, dev_count, max_parallel);
+  }
+
+  if (show_all) {
+    jbod_count = lib_list_jbod(jbod_devices, max_parallel);
+    /* read in parallel, print in the order of the list */
+    kept = ses_keeping_snapshots();
+    ses_keep_snapshots(1);
+    run_parallel_ordered(jbod_count, max_parallel, prefetch_hdd_info,
+                         execute_hdd_info, jbod_devices);
+    if (!kept)
+      ses_keep_snapshots(0);
     return 0;
   }
 
@@ -517,10 +769,6 @@ int execute_hdd(int argc, char *argv[])
         timeout = -1;   /* skip graceful shutdown */
       ret = jbod->hdd_power_control(sg_fd, hdd_off_id, 0, timeout,
                                     cold_storage);
-    } else if (fault_led_on_id != -1) {
-      ret = jbod->hdd_led_control(sg_fd, fault_led_on_id, 1);
-    } else if (fault_led_off_id != -1) {
-      ret = jbod->hdd_led_control(sg_fd, fault_led_off_id, 0);
     }
     if (ret != 0) {
       perr("operation failed with return code = %d\n", ret);
@@ -595,6 +843,7 @@ int execute_fan(int argc, char *argv[])
   char *devname;
   int sg_fd;
   int set_pwm = -1;
+  const char *shm_path = NULL;
   char c;
 
   optind = 1;
@@ -608,6 +857,9 @@ int execute_fan(int argc, char *argv[])
       case 'A':
         set_pwm = 0;
         break;
+      case FROM_SHM_OPTION:
+        shm_path = optarg ? optarg : SHM_SNAPSHOT_PATH;
+        break;
       default:
         usage(argc, argv);
         return 1;
@@ -615,6 +867,13 @@ int execute_fan(int argc, char *argv[])
   }
 
   devname = get_devname(argc, argv);
+  if (shm_path) {
+    if (set_pwm != -1) {
+      perr("Cannot combine --from-shm and fan control.\n");
+      return 1;
+    }
+    return shm_snapshot_print(shm_path, devname, SHM_PRINT_FANS, 0);
+  }
   jbod = detect_dev(devname);
   if (jbod) {
     sg_fd = sg_cmds_open_device(devname, 0 /* rw */, 0 /* not verbose */);
@@ -711,49 +970,174 @@ int execute_info(int argc, char *argv[])
   return 0;
 }
 
-/* power cycle expander */
+/* power cycle expander(s), and wait for them to come back */
 int execute_power_cycle(int argc, char *argv[])
 {
-  struct jbod_interface *jbod;
-  char *devname;
-  int sg_fd;
-
-  devname = get_devname(argc, argv);
+  struct power_cycle_result *results;
+  struct jbod_device jbod_devices[MAX_JBOD_PER_HOST];
+  char *devnames[MAX_JBOD_PER_HOST];
+  int count;
+  int show_all = 0;
+  int timeout = POWER_CYCLE_DEFAULT_TIMEOUT;
+  int max_parallel = POWER_CYCLE_DEFAULT_PARALLEL;
+  int ret = 0;
+  int i;
+  char c;
 
-  jbod = detect_dev(devname);
-  if (jbod) {
-    sg_fd = sg_cmds_open_device(devname, 0 /* rw */, 0 /* not verbose */);
-    if (sg_fd > 0) {
-      jbod->power_cycle_enclosure(sg_fd);
-      sg_cmds_close_device(sg_fd);
+  optind = 1;
+  while ((c = getopt_long(argc, argv, short_options,
+                          long_options, &option_index)) != -1) {
+    switch(c) {
+      CASE_JSON;
+      case 'a':
+        show_all = 1;
+        break;
+      case 'm':
+        timeout = atoi(optarg);
+        break;
+      case 'N':
+        max_parallel = atoi(optarg);
+        break;
+      default:
+        usage(argc, argv);
+        return 1;
     }
+  }
+
+  if (timeout < 0) {
+    perr("Cannot specify negative timeout, %d.\n", timeout);
+    return 1;
+  }
+
+  if (max_parallel < 1) {
+    perr("Cannot specify parallel less than 1, %d.\n", max_parallel);
+    return 1;
+  }
+
+  if (show_all) {
+    count = lib_list_jbod(jbod_devices, max_parallel);
+    for (i = 0; i < count; ++i)
+      devnames[i] = jbod_devices[i].sg_device;
   } else {
-    perr("%s is not a jbod device\n", devname);
+    count = get_devnames(argc, argv, devnames, MAX_JBOD_PER_HOST);
+  }
+
+  if (count == 0) {
+    perr("No jbod device to power cycle.\n");
     return ENODEV;
   }
-  return 0;
+
+  results = (struct power_cycle_result *)
+    calloc(count, sizeof(struct power_cycle_result));
+  if (results == NULL) {
+    perr("Cannot allocate memory.\n");
+    return ENOMEM;
+  }
+  for (i = 0; i < count; ++i)
+    snprintf(results[i].devname, PATH_MAX, "%s", devnames[i]);
+
+  power_cycle_enclosures(results, count, max_parallel, timeout);
+
+  for (i = 0; i < count; ++i) {
+    if (results[i].rc == ENODEV)
+      perr("%s is not a jbod device\n", results[i].devname);
+    print_power_cycle_result(results + i);
+    if (ret == 0)
+      ret = results[i].rc;
+  }
+  free(results);
+  return ret;
+}
+
+/* signals read through libocpjbod, printed as the jbod_print_* did */
+static void print_signals(const struct ocpjbod_signal *signals, int count,
+                          int width, const char *value_name)
+{
+  int i;
+
+  for (i = 0; i < count; ++i) {
+    IF_PRINT_NONE_JSON
+      printf("%*s:\t%s (%d)\n", width, signals[i].name, signals[i].state,
+             signals[i].value);
+
+    PRINT_JSON_GROUP_HEADER(signals[i].name);
+    PRINT_JSON_ITEM("name", "%s", signals[i].name);
+    PRINT_JSON_ITEM("status", "%s", signals[i].state);
+    PRINT_JSON_ITEM(value_name, "%d", signals[i].value);
+    PRINT_JSON_GROUP_ENDING;
+  }
+}
+
+/* show the GPIOs (gpio = 1) or the event status of devname */
+static int execute_signals(const char *devname, int gpio)
+{
+  struct ocpjbod_signal signals[EVENT_STATUS_MAX_COUNT];
+  struct ocpjbod *handle;
+  int count = 0;
+  int rc;
+
+  handle = ocpjbod_open(devname, &rc);
+  if (handle == NULL) {
+    if (rc == ENODEV)
+      perr("%s is not a jbod device\n", devname);
+    else
+      perr("Cannot open %s: %s\n", devname, strerror(rc));
+    return rc;
+  }
+  if (gpio)
+    rc = ocpjbod_read_gpio(handle, signals, EVENT_STATUS_MAX_COUNT, &count);
+  else
+    rc = ocpjbod_read_event_status(handle, signals, EVENT_STATUS_MAX_COUNT,
+                                   &count);
+  ocpjbod_close(handle);
+
+  if (rc == ENOTSUP) {
+    perr("%s reading is not supported.\n", gpio ? "GPIO" : "Event status");
+  } else if (rc != 0) {
+    perr("Failed to read %s buffer.\n", gpio ? "GPIO" : "event status");
+  } else {
+    if (count > EVENT_STATUS_MAX_COUNT)
+      count = EVENT_STATUS_MAX_COUNT;
+    print_signals(signals, count, gpio ? 50 : 0, gpio ? "val" : "value");
+  }
+  return rc;
 }
 
 /* show GPIO values */
 int execute_gpio(int argc, char *argv[]) {
-  struct jbod_interface *jbod;
-  char *devname;
-  int sg_fd;
+  return execute_signals(get_devname(argc, argv), 1);
+}
 
-  devname = get_devname(argc, argv);
+/* export or import the tags of many enclosures */
+static int execute_asset_tag_bulk(int argc, char *argv[], int show_all,
+                                  int do_export, char *import_file,
+                                  int max_parallel)
+{
+  struct jbod_device jbod_devices[MAX_JBOD_PER_HOST];
+  char *devnames[MAX_JBOD_PER_HOST];
+  int count;
+  int i;
 
-  jbod = detect_dev(devname);
-  if (jbod) {
-    sg_fd = sg_cmds_open_device(devname, 0 /* rw */, 0 /* not verbose */);
-    if (sg_fd > 0) {
-      jbod->print_gpio(sg_fd);
-      sg_cmds_close_device(sg_fd);
-    }
+  if (max_parallel < 1) {
+    perr("Cannot specify parallel less than 1, %d.\n", max_parallel);
+    return 1;
+  }
+
+  if (show_all) {
+    count = lib_list_jbod(jbod_devices, max_parallel);
+    for (i = 0; i < count; ++i)
+      devnames[i] = jbod_devices[i].sg_device;
   } else {
-    perr("%s is not a jbod device\n", devname);
+    count = get_devnames(argc, argv, devnames, MAX_JBOD_PER_HOST);
+  }
+  if (count == 0) {
+    perr("No enclosure specified.\n");
     return ENODEV;
   }
-  return 0;
+
+  if (do_export)
+    return export_asset_tags(devnames, count, max_parallel);
+  return import_asset_tags(import_file, devnames, count, max_parallel);
 }
 
 /* show/change asset tags */
@@ -761,6 +1145,10 @@ int execute_asset_tag(int argc, char *argv[]) {
   int tag_id = -1;
   char *tag_name = NULL;
   char *tag = NULL;
+  char *import_file = NULL;
+  int do_export = 0;
+  int show_all = 0;
+  int max_parallel = ASSET_TAG_DEFAULT_PARALLEL;
   char c;
   struct jbod_interface *jbod;
   char *devname;
@@ -778,12 +1166,32 @@ int execute_asset_tag(int argc, char *argv[]) {
       case 'T':
         tag = optarg;
         break;
+      case 'M':
+        import_file = optarg;
+        break;
+      case 'E':
+        do_export = 1;
+        break;
+      case 'a':
+        show_all = 1;
+        break;
+      case 'N':
+        max_parallel = atoi(optarg);
+        break;
       default:
         usage(argc, argv);
         return 1;
     }
   }
 
+  if (import_file != NULL && do_export) {
+    perr("Cannot import and export at the same time.\n");
+    return 1;
+  }
+  if (import_file != NULL || do_export)
+    return execute_asset_tag_bulk(argc, argv, show_all, do_export,
+                                  import_file, max_parallel);
+
   devname = get_devname(argc, argv);
 
   jbod = detect_dev(devname);
@@ -836,14 +1244,110 @@ static int jbof_execute_asset_tag(int argc, char* argv[]) {
   return EXIT_SUCCESS;
 }
 
+/* event status of one enclosure, read by a worker */
+struct event_status_job {
+  char *devname;
+  struct jbod_interface *jbod;
+  const struct signal_buffer *status;   /* NULL to read and print at once */
+  unsigned char buf[EVENT_STATUS_MAX_COUNT];
+  int length;
+  int sg_fd;
+};
+
+static void read_event_status_one(int index, void *arg)
+{
+  struct event_status_job *job = (struct event_status_job *) arg + index;
+
+  job->sg_fd = -1;
+  job->jbod = detect_dev(job->devname);
+  if (job->jbod == NULL)
+    return;
+  job->sg_fd = sg_cmds_open_device(job->devname, 0 /* rw */,
+                                   0 /* not verbose */);
+  if (job->sg_fd < 0)
+    return;
+  if (job->jbod->get_event_status) {
+    job->status = job->jbod->get_event_status();
+    job->length = jbod_read_event_status(job->sg_fd, job->status, job->buf);
+  }
+}
+
+/* event status changes of all devnames, in one report */
+static int execute_event_status_changes(char *devnames[], int count,
+                                        int max_parallel)
+{
+  struct event_status_job *jobs;
+  struct event_status_job *job;
+  int changes = 0;
+  int ret = 0;
+  int n;
+  int i;
+
+  jobs = (struct event_status_job *)
+    calloc(count, sizeof(struct event_status_job));
+  if (jobs == NULL) {
+    perr("Cannot allocate memory.\n");
+    return ENOMEM;
+  }
+  for (i = 0; i < count; ++i)
+    jobs[i].devname = devnames[i];
+  /* read in parallel; the changes are printed below, in order */
+  run_parallel(count, max_parallel, read_event_status_one, jobs);
+
+  for (i = 0; i < count; ++i) {
+    job = jobs + i;
+    if (job->jbod == NULL) {
+      perr("%s is not a jbod device\n", job->devname);
+      ret = ENODEV;
+      continue;
+    }
+    if (job->sg_fd < 0) {
+      perr("Cannot open %s.\n", job->devname);
+      ret = ENODEV;
+      continue;
+    }
+
+    PRINT_JSON_GROUP_HEADER(job->devname);
+    if (job->status == NULL)
+      n = job->jbod->print_event_status_changes(job->sg_fd, job->devname);
+    else if (job->length == 0)
+      n = -1;
+    else
+      n = print_event_status_changes(job->sg_fd, job->devname,
+                                     job->status->buffer_id, job->buf,
+                                     job->length, job->status->descriptions);
+    PRINT_JSON_GROUP_ENDING;
+    sg_cmds_close_device(job->sg_fd);
+
+    if (n < 0)
+      ret = EIO;
+    else
+      changes += n;
+  }
+  free(jobs);
+  IF_PRINT_NONE_JSON
+    printf("%d event status change(s) in %d JBOD(s).\n", changes, count);
+  return ret;
+}
+
 /* show event status, event log */
 int execute_event(int argc, char *argv[])
 {
   struct jbod_interface *jbod;
+  struct jbod_device jbod_devices[MAX_JBOD_PER_HOST];
+  char *devnames[MAX_JBOD_PER_HOST];
   char *devname;
   int sg_fd;
+  int count;
   int show_status = 0;
   int show_log = 0;
+  int show_new = 0;
+  int show_changes = 0;
+  int show_all = 0;
+  int watch = 0;
+  int max_parallel = DEFAULT_PARALLEL;
+  int ret = 0;
+  int i;
   char c;
 
   optind = 1;
@@ -857,19 +1361,65 @@ int execute_event(int argc, char *argv[])
       case 'l':
         show_log = 1;
         break;
+      case 'n':
+        show_new = 1;
+        break;
+      case 'W':
+        watch = 1;
+        break;
+      case 'g':
+        show_changes = 1;
+        break;
+      case 'a':
+        show_all = 1;
+        break;
+      case 'N':
+        max_parallel = atoi(optarg);
+        break;
       default:
         usage(argc, argv);
         return 1;
     }
   }
 
+  if (max_parallel < 1) {
+    perr("Cannot specify parallel less than 1, %d.\n", max_parallel);
+    return 1;
+  }
+
+  if (watch && !show_new) {
+    perr("--watch requires --log --new.\n");
+    return EINVAL;
+  }
+
+  if (show_status && show_changes) {
+    if (show_all) {
+      count = lib_list_jbod(jbod_devices, max_parallel);
+      for (i = 0; i < count; ++i)
+        devnames[i] = jbod_devices[i].sg_device;
+    } else {
+      count = get_devnames(argc, argv, devnames, MAX_JBOD_PER_HOST);
+    }
+    if (count == 0) {
+      perr("No jbod device to read event status.\n");
+      return ENODEV;
+    }
+    return execute_event_status_changes(devnames, count, max_parallel);
+  }
+
   devname = get_devname(argc, argv);
+  if (show_status)
+    return execute_signals(devname, 0);
   jbod = detect_dev(devname);
   if (jbod) {
     sg_fd = sg_cmds_open_device(devname, 0 /* rw */, 0 /* not verbose */);
     if (sg_fd > 0) {
-      if (show_status) {
-        jbod->print_event_status(sg_fd);
+      if (show_log && show_new) {
+        ret = jbod->print_new_events(sg_fd, devname);
+        while (watch) {
+          usleep(EVENT_LOG_WATCH_INTERVAL_MS * 1000);
+          ret = jbod->print_new_events(sg_fd, devname);
+        }
       } else if (show_log) {
         jbod->print_event_log(sg_fd);
       } else {
@@ -881,7 +1431,39 @@ int execute_event(int argc, char *argv[])
     perr("%s is not a jbod device\n", devname);
     return ENODEV;
   }
-  return 0;
+  return ret;
+}
+
+/* export or apply the config of many enclosures */
+static int execute_config_bulk(int argc, char *argv[], int show_all,
+                               int do_export, char *apply_file,
+                               int max_parallel)
+{
+  struct jbod_device jbod_devices[MAX_JBOD_PER_HOST];
+  char *devnames[MAX_JBOD_PER_HOST];
+  int count;
+  int i;
+
+  if (max_parallel < 1) {
+    perr("Cannot specify parallel less than 1, %d.\n", max_parallel);
+    return 1;
+  }
+
+  if (show_all) {
+    count = lib_list_jbod(jbod_devices, max_parallel);
+    for (i = 0; i < count; ++i)
+      devnames[i] = jbod_devices[i].sg_device;
+  } else {
+    count = get_devnames(argc, argv, devnames, MAX_JBOD_PER_HOST);
+  }
+  if (count == 0) {
+    perr("No enclosure specified.\n");
+    return ENODEV;
+  }
+
+  if (do_export)
+    return export_configs(devnames, count, max_parallel);
+  return apply_configs(apply_file, devnames, count, max_parallel);
 }
 
 int execute_config(int argc, char *argv[]) {
@@ -891,6 +1473,10 @@ int execute_config(int argc, char *argv[]) {
   int power_window = -1;
   int hdd_temp_int = -1;
   int fan_profile = -1;
+  char *apply_file = NULL;
+  int do_export = 0;
+  int show_all = 0;
+  int max_parallel = CONFIG_DEFAULT_PARALLEL;
   char c;
 
   optind = 1;
@@ -907,12 +1493,32 @@ int execute_config(int argc, char *argv[]) {
       case 'P':
         fan_profile = atoi(optarg);
         break;
+      case 'Y':
+        apply_file = optarg;
+        break;
+      case 'E':
+        do_export = 1;
+        break;
+      case 'a':
+        show_all = 1;
+        break;
+      case 'N':
+        max_parallel = atoi(optarg);
+        break;
       default:
         usage(argc, argv);
         return 1;
     }
   }
 
+  if (apply_file != NULL && do_export) {
+    perr("Cannot apply and export at the same time.\n");
+    return 1;
+  }
+  if (apply_file != NULL || do_export)
+    return execute_config_bulk(argc, argv, show_all, do_export,
+                               apply_file, max_parallel);
+
   devname = get_devname(argc, argv);
   jbod = detect_dev(devname);
   if (jbod) {
@@ -1025,7 +1631,7 @@ int execute_version(int argc, char *argv[])
   IF_PRINT_NONE_JSON
     printf("Version: %s\n", VERSION_STRING);
 
-  PRINT_JSON_LAST_ITEM("Version", "%s", VERSION_STRING);
+  PRINT_JSON_ITEM("Version", "%s", VERSION_STRING);
   return 0;
 }
 
@@ -1040,11 +1646,11 @@ int _execute_phyerr(char *devname, int clear, int index)
       if (clear)
         jbod->reset_phyerr(sg_fd);
       else {
-        if (index) PRINT_JSON_MORE_GROUP;
         PRINT_JSON_GROUP_HEADER(devname);
         jbod->print_phyerr(sg_fd);
         PRINT_JSON_GROUP_ENDING;
       }
+      sg_cmds_close_device(sg_fd);
     }
   } else {
     perr("%s is not a jbod device\n", devname);
@@ -1053,11 +1659,75 @@ int _execute_phyerr(char *devname, int clear, int index)
   return 0;
 }
 
+/* phy errors of one enclosure, read by a worker for phyerr --all */
+struct phyerr_job {
+  char *devname;
+  int clear;
+  int rc;
+  struct phyerr_report *report;     /* NULL to read and print at once */
+};
+
+static void read_phyerr_one(int index, void *arg)
+{
+  struct phyerr_job *job = (struct phyerr_job *) arg + index;
+  const struct metrics_profile *profile = NULL;
+  struct jbod_interface *jbod;
+  int sg_fd;
+
+  jbod = detect_dev(job->devname);
+  if (jbod == NULL) {
+    job->rc = ENODEV;
+    return;
+  }
+  if (job->clear) {
+    job->rc = _execute_phyerr(job->devname, 1, index);
+    return;
+  }
+  if (jbod->get_metrics_profile)
+    profile = jbod->get_metrics_profile();
+  if (profile == NULL || profile->phyerr_buffer_id == -1)
+    return;
+  sg_fd = sg_cmds_open_device(job->devname, 0 /* rw */, 0 /* not verbose */);
+  if (sg_fd < 0) {
+    job->rc = ENODEV;
+    return;
+  }
+  job->report = (struct phyerr_report *) malloc(sizeof(struct phyerr_report));
+  if (job->report == NULL)
+    job->rc = ENOMEM;
+  else
+    job->rc = read_phyerr_report(sg_fd, profile->phyerr_buffer_id,
+                                 profile->phyerr_phy_count, job->report);
+  sg_cmds_close_device(sg_fd);
+}
+
+static void print_phyerr_one(int index, void *arg)
+{
+  struct phyerr_job *job = (struct phyerr_job *) arg + index;
+
+  if (job->clear)
+    return;
+  if (job->rc == ENODEV) {
+    perr("%s is not a jbod device\n", job->devname);
+  } else if (job->rc != 0) {
+    perr("%s: failed to read phy error counters.\n", job->devname);
+  } else if (job->report == NULL) {
+    job->rc = _execute_phyerr(job->devname, 0, index);
+  } else {
+    PRINT_JSON_GROUP_HEADER(job->devname);
+    print_phyerr_report(job->report);
+    PRINT_JSON_GROUP_ENDING;
+  }
+  free(job->report);
+  job->report = NULL;
+}
+
 int execute_phyerr(int argc, char *argv[])
 {
   char  c;
   int show_all = 0;
   int clear = 0;
+  int max_parallel = DEFAULT_PARALLEL;
 
   optind = 1;
   while ((c = getopt_long(argc, argv, short_options,
@@ -1070,24 +1740,38 @@ int execute_phyerr(int argc, char *argv[])
       case 'c':
         clear = 1;
         break;
+      case 'N':
+        max_parallel = atoi(optarg);
+        break;
       default:
         usage(argc, argv);
         return 1;
     }
   }
 
+  if (max_parallel < 1) {
+    perr("Cannot specify parallel less than 1, %d.\n", max_parallel);
+    return 1;
+  }
+
   int result = 0;
 
   if (show_all) {
     struct jbod_device jbod_devices[MAX_JBOD_PER_HOST];
-    int jbod_count = lib_list_jbod(jbod_devices);
+    struct phyerr_job jobs[MAX_JBOD_PER_HOST];
+    int jbod_count = lib_list_jbod(jbod_devices, max_parallel);
+
+    memset(jobs, 0, sizeof(jobs));
     for (int i = 0; i < jbod_count; ++i) {
-      PRINT_JSON_RESET_GROUP;
-      if ( (result = _execute_phyerr(jbod_devices[i].sg_device, clear, i)) ) {
-        /* return any non-zero return value, breaking the loop */
-        break;
-      }
+      jobs[i].devname = jbod_devices[i].sg_device;
+      jobs[i].clear = clear;
     }
+    /* read in parallel, print in the order of the list */
+    run_parallel_ordered(jbod_count, max_parallel, read_phyerr_one,
+                         print_phyerr_one, jobs);
+    /* return the first non-zero return value */
+    for (int i = 0; i < jbod_count && result == 0; ++i)
+      result = jobs[i].rc;
   } else {
     /* one-shot traditional behavior */
     result = _execute_phyerr(get_devname(argc, argv), clear, 0 /* index */);
@@ -1096,6 +1780,160 @@ int execute_phyerr(int argc, char *argv[])
   return result;
 }
 
+int execute_export(int argc, char *argv[])
+{
+  struct jbod_device jbod_devices[MAX_JBOD_PER_HOST];
+  char *devnames[MAX_JBOD_PER_HOST];
+  char *path = NULL;
+  int max_parallel = OPENMETRICS_DEFAULT_PARALLEL;
+  int show_all = 0;
+  int count;
+  int i;
+  char c;
+
+  optind = 1;
+  while ((c = getopt_long(argc, argv, short_options,
+                          long_options, &option_index)) != -1) {
+    switch(c) {
+      case 'X':
+        path = optarg;
+        break;
+      case 'a':
+        show_all = 1;
+        break;
+      case 'N':
+        max_parallel = atoi(optarg);
+        break;
+      default:
+        usage(argc, argv);
+        return 1;
+    }
+  }
+
+  if (path == NULL) {
+    perr("Please specify --openmetrics <path>.\n");
+    return 1;
+  }
+  if (max_parallel < 1) {
+    perr("Cannot specify parallel less than 1, %d.\n", max_parallel);
+    return 1;
+  }
+
+  if (show_all) {
+    count = lib_list_jbod(jbod_devices, max_parallel);
+    for (i = 0; i < count; ++i)
+      devnames[i] = jbod_devices[i].sg_device;
+  } else {
+    count = get_devnames(argc, argv, devnames, MAX_JBOD_PER_HOST);
+  }
+  if (count == 0) {
+    perr("No enclosure specified.\n");
+    return ENODEV;
+  }
+  return export_openmetrics(path, devnames, count, max_parallel);
+}
+
+/* record sensor history, or print what was recorded */
+int execute_history(int argc, char *argv[])
+{
+  struct jbod_device jbod_devices[MAX_JBOD_PER_HOST];
+  char *devnames[MAX_JBOD_PER_HOST];
+  int interval_ms = 0;
+  int since_sec = HISTORY_DEFAULT_SINCE_SEC;
+  int resolution = -1;
+  int max_parallel = HISTORY_DEFAULT_PARALLEL;
+  int show_all = 0;
+  int detail = 0;
+  int ret = 0;
+  int count;
+  int rc;
+  int i;
+  char c;
+
+  optind = 1;
+  while ((c = getopt_long(argc, argv, short_options,
+                          long_options, &option_index)) != -1) {
+    switch(c) {
+      CASE_JSON;
+      case RECORD_OPTION:
+        interval_ms = atoi(optarg);
+        if (interval_ms < HISTORY_MIN_INTERVAL_MS) {
+          perr("Cannot record more often than every %d ms.\n",
+               HISTORY_MIN_INTERVAL_MS);
+          return 1;
+        }
+        break;
+      case SINCE_OPTION:
+        since_sec = atoi(optarg);
+        break;
+      case RESOLUTION_OPTION:
+        resolution = history_resolution_from_name(optarg);
+        if (resolution < 0) {
+          perr("Unknown resolution %s; use 1s, 1m or 1h.\n", optarg);
+          return 1;
+        }
+        break;
+      case 'd':
+        detail = 1;
+        break;
+      case 'a':
+        show_all = 1;
+        break;
+      case 'N':
+        max_parallel = atoi(optarg);
+        break;
+      default:
+        usage(argc, argv);
+        return 1;
+    }
+  }
+
+  if (since_sec < 1) {
+    perr("Cannot specify since less than 1, %d.\n", since_sec);
+    return 1;
+  }
+  if (max_parallel < 1) {
+    perr("Cannot specify parallel less than 1, %d.\n", max_parallel);
+    return 1;
+  }
+
+  if (interval_ms == 0) {
+    if (show_all)
+      return history_print(NULL, resolution, since_sec, detail);
+    count = get_devnames(argc, argv, devnames, MAX_JBOD_PER_HOST);
+    if (count == 0) {
+      perr("No enclosure specified.\n");
+      return ENODEV;
+    }
+    for (i = 0; i < count; ++i) {
+      if (count > 1) {
+        IF_PRINT_NONE_JSON
+          printf(">>> %s \n", devnames[i]);
+        PRINT_JSON_GROUP_HEADER(devnames[i]);
+      }
+      rc = history_print(devnames[i], resolution, since_sec, detail);
+      if (rc != 0)
+        ret = rc;
+      if (count > 1)
+        PRINT_JSON_GROUP_ENDING;
+    }
+    return ret;
+  }
+
+  if (show_all) {
+    count = lib_list_jbod(jbod_devices, max_parallel);
+    for (i = 0; i < count; ++i)
+      devnames[i] = jbod_devices[i].sg_device;
+  } else {
+    count = get_devnames(argc, argv, devnames, MAX_JBOD_PER_HOST);
+  }
+  if (count == 0) {
+    perr("No enclosure specified.\n");
+    return ENODEV;
+  }
+  return history_record(devnames, count, interval_ms, max_parallel);
+}
+
 static int jbof_execute_phyerr(int argc, char* argv[]) {
   char* devname = get_devname(argc, argv);
   assert(devname);
@@ -1123,52 +1961,294 @@ static int jbof_execute_phyerr(int argc, char* argv[]) {
   return EXIT_SUCCESS;
 }
 
+static int execute_batch(int argc, char *argv[]);
+
 struct cmd_options all_cmds[] = {
   {LIST, "list", execute_list, jbof_execute_list, "list all enclosures\n"
-   "\t\t\t--detail        \t- show some details of each JBOD"},
-  {INFO, "info", execute_info, jbof_execute_info, "show info of the JBOD"},
+   "\t\t\t--detail        \t- show some details of each JBOD\n"
+   "\t\t\t--parallel <n>  \t- read details of up to <n> JBODs at a time", "dN"},
+  {INFO, "info", execute_info, jbof_execute_info, "show info of the JBOD", ""},
   {SENSOR, "sensor", execute_sensor, jbof_execute_sensor,
    "print sensor values\n"
-   "\t\t\t--thresholds    \t- also prints thresholds"},
+   "\t\t\t--thresholds    \t- also prints thresholds\n"
+   "\t\t\t--from-shm[=path]\t- print what ocpjbodd published last", "tQ"},
   {HDD, "hdd", execute_hdd, jbof_execute_hdd, "hdd info/control\n"
    "\t\t\t--hdd-on id     \t- turn on HDD\n"
    "\t\t\t--hdd-off id    \t- turn off HDD\n"
    "\t\t\t--hdd-remove id \t- remove HDD from OS w/o powering off (JBOF only)\n"
    "\t\t\t--dirty         \t- skip graceful shutdown of HDD\n"
-   "\t\t\t--fault-on id   \t- turn on fault LED\n"
-   "\t\t\t--fault-off id  \t- turn off fault LED\n"
+   "\t\t\t--fault-on list \t- turn on fault LED\n"
+   "\t\t\t--fault-off list\t- turn off fault LED\n"
+   "\t\t\t--ident-on list \t- turn on ident LED\n"
+   "\t\t\t--ident-off list\t- turn off ident LED\n"
+   "\t\t\t                \t  list: [sg_device:]id[-id][,...], e.g. 1,3,5-7\n"
+   "\t\t\t--parallel <n>  \t- update up to <n> JBODs at a time\n"
    "\t\t\t--timeout <secs>\t- wait for drive on/off for up to <secs>\n"
    "\t\t\t--cold-storage  \t- special features for cold storage\n"
-   "\t\t\t--all           \t- show HDDs from all JBODs"},
-  {LED, "led", execute_led, jbof_execute_led, "show status of chassis LEDs"},
+   "\t\t\t--watch         \t- stream slot changes as NDJSON\n"
+   "\t\t\t--all           \t- show HDDs from (or set LEDs on) all JBODs\n"
+   "\t\t\t                \t  read up to --parallel at a time, print in order\n"
+   "\t\t\t--from-shm[=path]\t- print what ocpjbodd published last",
+   "aNQ"},
+  {LED, "led", execute_led, jbof_execute_led, "show status of chassis LEDs",
+   ""},
   {FAN, "fan", execute_fan, jbof_execute_fan, "fan rpm/pwm\n"
    "\t\t\t--pwm  <pwm>    \t- set fan pwm\n"
    "\t\t\t--precool <0|1> \t- enable/disable precool mode (Seagate M.2 only)\n"
-   "\t\t\t--auto          \t- return pwm control to firmware"},
+   "\t\t\t--auto          \t- return pwm control to firmware\n"
+   "\t\t\t--from-shm[=path]\t- print what ocpjbodd published last", "Q"},
   {POWER_CYCLE, "power_cycle", execute_power_cycle, NULL,
-   "power cycle the expander"},
-  {GPIO, "gpio", execute_gpio, NULL, "show GPIO status"},
+   "power cycle the expander(s) and wait for them to come back\n"
+   "\t\t\t--all           \t- power cycle all JBODs\n"
+   "\t\t\t--parallel <n>  \t- power cycle up to <n> JBODs at a time\n"
+   "\t\t\t--timeout <secs>\t- wait up to <secs> (default 300, 0: no wait)"},
+  {GPIO, "gpio", execute_gpio, NULL, "show GPIO status", ""},
   {ASSET_TAG, "tag", execute_asset_tag, jbof_execute_asset_tag,
    "show/change asset tag(s)\n"
-   "\t\t\t--id <tag_id> --tag <tag>\t- update tag"},
+   "\t\t\t--id <tag_id> --tag <tag>\t- update tag\n"
+   "\t\t\t--export        \t- print tags of all given JBODs as JSON\n"
+   "\t\t\t--import <file> \t- write tags from a file of --export\n"
+   "\t\t\t--all           \t- export/import all JBODs on the host\n"
+   "\t\t\t--parallel <n>  \t- export/import up to <n> JBODs at a time", "EaN"},
   {EVENT, "event", execute_event, NULL, "show event log/status\n"
    "\t\t\t--log           \t- show event log\n"
-   "\t\t\t--status        \t- show event status"},
+   "\t\t\t--log --new     \t- stream events since the last call as NDJSON\n"
+   "\t\t\t--log --new --watch\t- keep streaming new events\n"
+   "\t\t\t--status        \t- show event status\n"
+   "\t\t\t--status --changes\t- show changes since the last call\n"
+   "\t\t\t--all           \t- show changes of all JBODs on the host\n"
+   "\t\t\t--parallel <n>  \t- read up to <n> JBODs at a time", "lsN"},
   {CONFIG, "config", execute_config, NULL, "change configurations\n"
    "\t\t\t--power-win <sec> \t- config RMS window of power reading\n"
    "\t\t\t--hdd-temp-int <min> \t- config HDD temperature pooling interval\n"
-   "\t\t\t--fan-profile <id> \t- select fan control profile"},
+   "\t\t\t--fan-profile <id> \t- select fan control profile\n"
+   "\t\t\t--export        \t- print config of all given JBODs as JSON\n"
+   "\t\t\t--apply <file>  \t- write items that differ from a profile\n"
+   "\t\t\t--all           \t- export/apply all JBODs on the host\n"
+   "\t\t\t--parallel <n>  \t- export/apply up to <n> JBODs at a time", "EaN"},
   {IDENTIFY, "identify", execute_identify, jbof_execute_identify,
    "identify enclosure tray\n"
    "\t\t\t--off \t- turn off identify (default is turn on)"},
   {PHYERR, "phyerr", execute_phyerr, jbof_execute_phyerr,
    "show/clear phy error counters\n"
-   "\t\t\t--clear \t- clear phy error counters"},
-  {PWM, "pwm", execute_pwm, NULL, "show scsi expander pwm"},
-  {CFM, "cfm", execute_cfm, NULL, "show scsi expander cfm"},
+   "\t\t\t--clear \t- clear phy error counters\n"
+   "\t\t\t--all           \t- show/clear all JBODs on the host\n"
+   "\t\t\t--parallel <n>  \t- read or clear up to <n> JBODs at a time",
+   "aN"},
+  {PWM, "pwm", execute_pwm, NULL, "show scsi expander pwm", ""},
+  {CFM, "cfm", execute_cfm, NULL, "show scsi expander cfm", ""},
+  {EXPORT, "export", execute_export, NULL,
+   "write metrics of the JBOD(s) for a metrics collector\n"
+   "\t\t\t--openmetrics <path>\t- sensors, fans, slots, power and phy\n"
+   "\t\t\t                \t  errors in OpenMetrics text format\n"
+   "\t\t\t--all           \t- export all JBODs on the host\n"
+   "\t\t\t--parallel <n>  \t- read up to <n> JBODs at a time"},
+  {HISTORY, "history", execute_history, NULL,
+   "sensor, fan and power history of the JBOD(s), recorded on the host\n"
+   "\t\t\t--record <ms>   \t- sample every <ms> until stopped\n"
+   "\t\t\t--since <secs>  \t- min, avg and max of the last <secs>\n"
+   "\t\t\t                \t  (default 3600)\n"
+   "\t\t\t--resolution <r>\t- 1s, 1m or 1h (default: finest with the range)\n"
+   "\t\t\t--detail        \t- also print every record\n"
+   "\t\t\t--all           \t- record or show all JBODs\n"
+   "\t\t\t--parallel <n>  \t- record up to <n> JBODs at a time",
+   "SVda"},
+  {BATCH, "batch", execute_batch, NULL,
+   "run commands from a file (or stdin), one per line, e.g. \"hdd /dev/sg1\";\n"
+   "\t\t\t                \t  SES reads are shared until a command writes;\n"
+   "\t\t\t                \t  lines take the output format of the batch and\n"
+   "\t\t\t                \t  cannot stream (--watch, --new, --record)"},
+  /* never forwarded, so a daemon left from an older version is not asked */
   {VERSION, "version", execute_version, execute_version, "show version number"},
 };
 
+/* split line in place at blanks, except in quotes; return the count */
+static int split_command_line(char *line, char *args[], int max)
+{
+  char *in = line;
+  char *out = line;
+  char quote, end;
+  int count = 0;
+
+  for (;;) {
+    while (*in == ' ' || *in == '\t')
+      ++in;
+    if (*in == '\0' || *in == '#')
+      return count;
+    if (count == max)
+      return -1;
+    args[count++] = out;
+    quote = 0;
+    while (*in != '\0' && (quote || (*in != ' ' && *in != '\t'))) {
+      if (quote && *in == quote)
+        quote = 0;
+      else if (!quote && (*in == '"' || *in == '\''))
+        quote = *in;
+      else
+        *out++ = *in;
+      ++in;
+    }
+    if (quote)
+      return -1;
+    end = *in;
+    *out++ = '\0';
+    if (end == '\0')
+      return count;
+    ++in;
+  }
+}
+
+/*
+ * options a command of a batch cannot take: the output format is the one
+ * of the batch, so --fields would outlive the line too, and streams print
+ * as they go rather than into the output of the batch
+ */
+static int batch_rejects(int argc, char *argv[])
+{
+  static const char rejected_options[] = {
+    'j', NDJSON_OPTION, CBOR_OPTION, FIELDS_OPTION,
+    'W' /* --watch */, 'n' /* event --new */, RECORD_OPTION, '\0'
+  };
+  int saved_opterr = opterr;
+  int rejected = 0;
+  int c;
+
+  opterr = 0;
+  optind = 1;
+  while ((c = getopt_long(argc - 1, argv + 1, short_options,
+                          long_options, NULL)) != -1) {
+    if (strchr(rejected_options, c) != NULL)
+      rejected = 1;
+  }
+  opterr = saved_opterr;
+  optind = 1;
+  return rejected;
+}
+
+/* run one command of a batch as parse_cmd() would, in the open document */
+static int execute_batch_command(int argc, char *argv[])
+{
+  int i;
+
+  for (i = 0; i < sizeof(all_cmds) / sizeof(struct cmd_options); i ++) {
+    if (strcmp(all_cmds[i].key_word, argv[1]) != 0)
+      continue;
+    if (all_cmds[i].cmd == BATCH)
+      break;
+    if (jbof_target_count_) {
+      if (!all_cmds[i].execute_flash) {
+        perr("this command is not suported by jbof target\n");
+        return EINVAL;
+      }
+      return all_cmds[i].execute_flash(argc - 1, argv + 1);
+    }
+    return all_cmds[i].execute(argc - 1, argv + 1);
+  }
+  perr("Unknown command %s\n", argv[1]);
+  return EINVAL;
+}
+
+/*
+ * run command lines from a file or stdin. Detected interfaces and SES
+ * pages are kept from one command to the next, until a command writes to
+ * an enclosure. The output format is the one of batch; each command is one
+ * top level member, keyed by its line number, with its rc. Lines choosing
+ * their own output or streaming fail, see batch_rejects().
+ */
+/*
+ * whether a line fgets() returned without its newline ends there; if not,
+ * the rest of it is skipped
+ */
+static int batch_line_ends(FILE *input)
+{
+  int c = getc(input);
+
+  if (c == EOF || c == '\n')
+    return 1;
+  while (c != EOF && c != '\n')
+    c = getc(input);
+  return 0;
+}
+
+static int execute_batch(int argc, char *argv[])
+{
+  char line[BATCH_MAX_LINE];
+  char command[BATCH_MAX_LINE];
+  char *args[BATCH_MAX_ARGS + 2];
+  char key[16];
+  FILE *input = stdin;
+  int lineno = 0;
+  int count;
+  int ret = 0;
+  int rc;
+  char c;
+
+  optind = 1;
+  while ((c = getopt_long(argc, argv, short_options,
+                          long_options, &option_index)) != -1) {
+    switch(c) {
+      CASE_JSON;
+      default:
+        usage(argc, argv);
+        return 1;
+    }
+  }
+  if (optind < argc) {
+    input = fopen(argv[optind], "r");
+    if (input == NULL) {
+      perr("Cannot open %s: %s\n", argv[optind], strerror(errno));
+      return errno;
+    }
+  }
+
+  jbod_keep_snapshots(1);
+  while (fgets(line, sizeof(line), input) != NULL) {
+    ++lineno;
+    /* a longer line is not run in pieces */
+    if (strchr(line, '\n') == NULL && !batch_line_ends(input)) {
+      perr("Line %d: longer than %d characters\n", lineno,
+           BATCH_MAX_LINE - 1);
+      ret = EINVAL;
+      continue;
+    }
+    line[strcspn(line, "\r\n")] = '\0';
+    snprintf(command, sizeof(command), "%s", line);
+    count = split_command_line(line, args + 1, BATCH_MAX_ARGS);
+    if (count == 0)
+      continue;
+    if (count < 0) {
+      perr("Line %d: cannot parse %s\n", lineno, command);
+      ret = EINVAL;
+      continue;
+    }
+    args[0] = argv[0];
+    args[count + 1] = NULL;
+
+    snprintf(key, sizeof(key), "%d", lineno);
+    IF_PRINT_NONE_JSON printf("# %s\n", command);
+    PRINT_JSON_GROUP_HEADER(key);
+    PRINT_JSON_ITEM("command", "%s", command);
+    if (batch_rejects(count + 1, args)) {
+      perr("Line %d: output and streaming options cannot be used in a "
+           "batch\n", lineno);
+      rc = EINVAL;
+    } else {
+      rc = execute_batch_command(count + 1, args);
+    }
+    PRINT_JSON_ITEM("rc", "%d", rc);
+    PRINT_JSON_GROUP_ENDING;
+    if (rc != 0) {
+      IF_PRINT_NONE_JSON perr("Line %d: %s returned %d\n", lineno, command, rc);
+      ret = rc;
+    }
+  }
+  jbod_keep_snapshots(0);
+
+  if (input != stdin)
+    fclose(input);
+  return ret;
+}
+
 void usage(int argc, char *argv[])
 {
   static int called_usage = 0;
@@ -1189,7 +2269,11 @@ void usage(int argc, char *argv[])
   execute_version(argc, argv);
   printf("\n"
          "Global options:\n"
-         "\t\t\t--json          \t- show output in JSON format\n\n"
+         "\t\t\t--json          \t- show output in JSON format\n"
+         "\t\t\t--ndjson        \t- print each JBOD as a JSON line when ready\n"
+         "\t\t\t--cbor          \t- show output in CBOR, with typed numbers\n"
+         "\t\t\t--fields <list> \t- print and read only these JSON items,\n"
+         "\t\t\t                \t  e.g. devname,ArrayDevice07/status\n\n"
          "Commands:\n");
 
   for (i = 0; i < sizeof(all_cmds) / sizeof(struct cmd_options); i ++) {
@@ -1240,10 +2324,52 @@ int parse_global_options(int argc, char *argv[])
  * handled in some subcommands, making it impossible to use it in said
  * subcommands.
  */
+int is_query_command(int argc, char *argv[])
+{
+  /* --json, --ndjson and --fields only shape the output */
+  static const char global_query_options[] = {
+    'j', NDJSON_OPTION, FIELDS_OPTION, '\0'
+  };
+  const struct cmd_options *cmd = NULL;
+  int saved_opterr = opterr;
+  int query = 1;
+  int from_shm = 0;
+  int c, i;
+
+  if (argc < 2)
+    return 0;
+  for (i = 0; i < sizeof(all_cmds) / sizeof(struct cmd_options); i ++) {
+    if (strcmp(all_cmds[i].key_word, argv[1]) == 0)
+      cmd = all_cmds + i;
+  }
+  if (cmd == NULL || cmd->query_options == NULL)
+    return 0;
+
+  opterr = 0;
+  optind = 1;
+  while ((c = getopt_long(argc - 1, argv + 1, short_options,
+                          long_options, NULL)) != -1) {
+    if (strchr(global_query_options, c) == NULL &&
+        strchr(cmd->query_options, c) == NULL)
+      query = 0;
+    if (c == FROM_SHM_OPTION)
+      from_shm = 1;
+  }
+  opterr = saved_opterr;
+  optind = 1;
+  return query && from_shm ? QUERY_FROM_SHM : query;
+}
+
 int parse_cmd(int argc, char *argv[])
 {
+  int query = is_query_command(argc, argv);
   int i;
 
+  /* ocpjbodd has the answer, without discovery or SES reads here */
+  if (query == 1 && daemon_forward(argc, argv, &i) == 0) {
+    return i;
+  }
+
   /*
    * TODO: (ngie) `usage(..)` and other callers consume `jbof_target_count_`,
    * so this value must be derived up front.
@@ -1254,7 +2380,8 @@ int parse_cmd(int argc, char *argv[])
    * Thought: what if fbjbod was hardlinked to an appropriate command name
    * and DTRT for handling both cases based on that fact?
    */
-  jbof_target_count_ = list_jbof(jbof_targets_, false, true);
+  if (query != QUERY_FROM_SHM)
+    jbof_target_count_ = list_jbof(jbof_targets_, false, true);
 
   if (argc < 2) {
     goto fail;
@@ -1290,6 +2417,8 @@ int parse_cmd(int argc, char *argv[])
         ret = all_cmds[i].execute(argc - 1, argv + 1);
         JSON_ENDING;
       }
+      if (!query)
+        daemon_invalidate();
       return ret;
     }
   }
@@ -12,7 +12,7 @@
 
 enum fb_jbod_cmd {INFO, LIST, SENSOR, HDD, LED, FAN, POWER_CYCLE,
                   GPIO, ASSET_TAG, EVENT, CONFIG, IDENTIFY, VERSION, PHYERR,
-                  PWM, CFM};
+                  PWM, CFM, EXPORT, BATCH, HISTORY};
 
 struct cmd_options {
   enum fb_jbod_cmd cmd;
@@ -20,6 +20,7 @@ struct cmd_options {
   int (*execute) (int argc, char *argv[]);
   int (*execute_flash) (int argc, char *argv[]);
   char *help_msg;
+  char *query_options;  /* options that only read, or NULL if none */
 };
 
 /* all supported commands */
@@ -28,4 +29,21 @@ extern struct cmd_options all_cmds[];
 extern void usage(int argc, char *argv[]);
 extern int parse_cmd(int argc, char *argv[]);
 
+/* --from-shm, and --record, --since and --resolution of history, have no
+ * short options */
+#define FROM_SHM_OPTION   'Q'
+#define RECORD_OPTION     'U'
+#define SINCE_OPTION      'S'
+#define RESOLUTION_OPTION 'V'
+
+/* a query that reads the snapshots of ocpjbodd in shared memory itself */
+#define QUERY_FROM_SHM 2
+
+/*
+ * whether a command line, argv[1] being the command, only reads the
+ * enclosures, so ocpjbodd may answer it: 0 if not, else 1, or
+ * QUERY_FROM_SHM with --from-shm
+ */
+extern int is_query_command(int argc, char *argv[]);
+
 #endif
@@ -0,0 +1,248 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "parallel.h"
+
+/* the indices a worker has left, [next, end) */
+struct parallel_queue {
+  pthread_mutex_t lock;
+  int next;
+  int end;
+};
+
+struct parallel_ctx {
+  int count;
+  int workers;
+  struct parallel_queue *queues;
+  void (*fn)(int index, void *arg);
+  void *arg;
+  /* for run_parallel_ordered(), the indices fn is done with */
+  unsigned char *finished;
+  pthread_mutex_t finished_lock;
+  pthread_cond_t finished_cond;
+};
+
+struct parallel_worker {
+  struct parallel_ctx *ctx;
+  int id;
+};
+
+/* the owner works from the front of its queue */
+static int take(struct parallel_queue *queue)
+{
+  int index = -1;
+
+  pthread_mutex_lock(&queue->lock);
+  if (queue->next < queue->end)
+    index = queue->next++;
+  pthread_mutex_unlock(&queue->lock);
+  return index;
+}
+
+/*
+ * move the back half of the first queue with work left, after id's own,
+ * to queue id; return 0 if there is no work left anywhere
+ */
+static int steal(struct parallel_ctx *ctx, int id)
+{
+  struct parallel_queue *victim;
+  struct parallel_queue *own = ctx->queues + id;
+  int begin, end;
+  int i;
+
+  for (i = 1; i < ctx->workers; ++i) {
+    victim = ctx->queues + (id + i) % ctx->workers;
+    pthread_mutex_lock(&victim->lock);
+    end = victim->end;
+    begin = victim->end - (victim->end - victim->next) / 2;
+    if (victim->next < victim->end && begin == victim->end)
+      begin = victim->next;                 /* the last one */
+    victim->end = begin;
+    pthread_mutex_unlock(&victim->lock);
+    if (begin < end) {
+      /* nobody steals from an empty queue, so own is not contended */
+      pthread_mutex_lock(&own->lock);
+      own->next = begin;
+      own->end = end;
+      pthread_mutex_unlock(&own->lock);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void finish(struct parallel_ctx *ctx, int index)
+{
+  if (ctx->finished == NULL)
+    return;
+  pthread_mutex_lock(&ctx->finished_lock);
+  ctx->finished[index] = 1;
+  pthread_cond_broadcast(&ctx->finished_cond);
+  pthread_mutex_unlock(&ctx->finished_lock);
+}
+
+static void *parallel_worker(void *data)
+{
+  struct parallel_worker *worker = data;
+  struct parallel_ctx *ctx = worker->ctx;
+  int index;
+
+  do {
+    while ((index = take(ctx->queues + worker->id)) >= 0) {
+      ctx->fn(index, ctx->arg);
+      finish(ctx, index);
+    }
+  } while (steal(ctx, worker->id));
+  return NULL;
+}
+
+/*
+ * give each worker an even, contiguous share of [0, count) and start
+ * them, but the first if caller_works; return how many were started
+ */
+static int start_workers(struct parallel_ctx *ctx, pthread_t *threads,
+                         struct parallel_worker *workers, int caller_works)
+{
+  int started = 0;
+  int i;
+
+  for (i = 0; i < ctx->workers; ++i) {
+    pthread_mutex_init(&ctx->queues[i].lock, NULL);
+    ctx->queues[i].next = (long) ctx->count * i / ctx->workers;
+    ctx->queues[i].end = (long) ctx->count * (i + 1) / ctx->workers;
+    workers[i].ctx = ctx;
+    workers[i].id = i;
+  }
+  for (i = caller_works ? 1 : 0; i < ctx->workers; ++i) {
+    if (pthread_create(threads + started, NULL, parallel_worker,
+                       workers + i) != 0) {
+      /* the others steal the share of this one */
+      perr("Cannot create worker thread, continue with %d.\n",
+           started + caller_works);
+      break;
+    }
+    ++started;
+  }
+  return started;
+}
+
+static void stop_workers(struct parallel_ctx *ctx, pthread_t *threads,
+                         int started)
+{
+  int i;
+
+  for (i = 0; i < started; ++i)
+    pthread_join(threads[i], NULL);
+  for (i = 0; i < ctx->workers; ++i)
+    pthread_mutex_destroy(&ctx->queues[i].lock);
+}
+
+void run_parallel(int count, int max_parallel,
+                  void (*fn)(int index, void *arg), void *arg)
+{
+  struct parallel_ctx ctx = {count, 0, NULL, fn, arg, NULL};
+  struct parallel_worker *workers;
+  pthread_t *threads;
+  int started;
+  int i;
+
+  if (max_parallel > count)
+    max_parallel = count;
+
+  threads = NULL;
+  workers = NULL;
+  if (max_parallel > 1) {
+    threads = (pthread_t *) calloc(max_parallel, sizeof(pthread_t));
+    workers = (struct parallel_worker *)
+      calloc(max_parallel, sizeof(struct parallel_worker));
+    ctx.queues = (struct parallel_queue *)
+      calloc(max_parallel, sizeof(struct parallel_queue));
+  }
+  if (threads == NULL || workers == NULL || ctx.queues == NULL) {
+    for (i = 0; i < count; ++i)
+      fn(i, arg);
+    goto done;
+  }
+
+  /* the calling thread is one of the workers */
+  ctx.workers = max_parallel;
+  started = start_workers(&ctx, threads, workers, 1);
+  parallel_worker(workers);
+  stop_workers(&ctx, threads, started);
+
+done:
+  free(threads);
+  free(workers);
+  free(ctx.queues);
+}
+
+void run_parallel_ordered(int count, int max_parallel,
+                          void (*fn)(int index, void *arg),
+                          void (*done)(int index, void *arg), void *arg)
+{
+  struct parallel_ctx ctx = {count, 0, NULL, fn, arg, NULL};
+  struct parallel_worker *workers;
+  pthread_t *threads;
+  int started = 0;
+  int i;
+
+  if (max_parallel > count)
+    max_parallel = count;
+
+  threads = NULL;
+  workers = NULL;
+  if (max_parallel > 1) {
+    threads = (pthread_t *) calloc(max_parallel, sizeof(pthread_t));
+    workers = (struct parallel_worker *)
+      calloc(max_parallel, sizeof(struct parallel_worker));
+    ctx.queues = (struct parallel_queue *)
+      calloc(max_parallel, sizeof(struct parallel_queue));
+    ctx.finished = (unsigned char *) calloc(count, 1);
+  }
+  if (threads == NULL || workers == NULL || ctx.queues == NULL ||
+      ctx.finished == NULL) {
+    for (i = 0; i < count; ++i) {
+      fn(i, arg);
+      done(i, arg);
+    }
+    goto out;
+  }
+
+  pthread_mutex_init(&ctx.finished_lock, NULL);
+  pthread_cond_init(&ctx.finished_cond, NULL);
+
+  /* the calling thread only gathers, so done() never waits for a read */
+  ctx.workers = max_parallel;
+  started = start_workers(&ctx, threads, workers, 0);
+  for (i = 0; i < count; ++i) {
+    if (started == 0) {
+      fn(i, arg);
+    } else {
+      pthread_mutex_lock(&ctx.finished_lock);
+      while (!ctx.finished[i])
+        pthread_cond_wait(&ctx.finished_cond, &ctx.finished_lock);
+      pthread_mutex_unlock(&ctx.finished_lock);
+    }
+    done(i, arg);
+  }
+  stop_workers(&ctx, threads, started);
+
+  pthread_cond_destroy(&ctx.finished_cond);
+  pthread_mutex_destroy(&ctx.finished_lock);
+
+out:
+  free(threads);
+  free(workers);
+  free(ctx.queues);
+  free(ctx.finished);
+}
@@ -0,0 +1,39 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#define DEFAULT_PARALLEL 8
+
+/*
+ * call fn(index, arg) for every index in [0, count), using up to
+ * max_parallel threads. Returns after all calls are done.
+ *
+ * Each thread starts with an even, contiguous share of the indices and
+ * steals the back half of another share once its own is done, so one
+ * slow enclosure holds up only the indices behind it in its share, and
+ * those only until another thread is free. Everything done for one
+ * index happens in one call, in order.
+ */
+extern void run_parallel(int count, int max_parallel,
+                         void (*fn)(int index, void *arg), void *arg);
+
+/*
+ * same as run_parallel(), and call done(index, arg) in the calling thread
+ * in the order of the indices, as soon as fn is done with the index and
+ * all before it: read in fn, print in done, and the output is the same
+ * as that of a serial loop
+ */
+extern void run_parallel_ordered(int count, int max_parallel,
+                                 void (*fn)(int index, void *arg),
+                                 void (*done)(int index, void *arg),
+                                 void *arg);
+
+#endif
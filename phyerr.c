@@ -0,0 +1,290 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "enclosure_cache.h"
+#include "json.h"
+#include "phyerr.h"
+#include "scsi_buffer.h"
+
+#define PHYERR_KEY_LENGTH 32
+
+const char *const phyerr_counter_names[PHYERR_COUNTER_COUNT] = {
+  "Invalid Dword",
+  "Running Disparity",
+  "Loss of Dword Sync",
+  "Phy Reset Problem",
+};
+
+static void decode_records(unsigned char *buf, int first, int count,
+                           struct phyerr_sample *sample)
+{
+  int i, j;
+
+  for (i = 0; i < count; ++i) {
+    for (j = 0; j < PHYERR_COUNTER_COUNT; ++j)
+      sample->counters[first + i][j] =
+        four_byte_to_uint(buf + i * PHYERR_RECORD_LENGTH + j * 4);
+  }
+}
+
+static int read_records(int sg_fd, int buffer_id, int phy_count,
+                        struct phyerr_sample *sample)
+{
+  unsigned char buf[PHYERR_RECORD_LENGTH];
+  int i;
+
+  for (i = 0; i < phy_count; ++i) {
+    if (scsi_read_buffer(sg_fd, buffer_id, i, buf, PHYERR_RECORD_LENGTH))
+      return EIO;
+    decode_records(buf, i, 1, sample);
+  }
+  return 0;
+}
+
+static int read_bulk(int sg_fd, int buffer_id, int phy_count,
+                     struct phyerr_sample *sample)
+{
+  unsigned char buf[PHYERR_MAX_PHY_COUNT * PHYERR_RECORD_LENGTH];
+
+  if (scsi_read_buffer(sg_fd, buffer_id, 0, buf,
+                       phy_count * PHYERR_RECORD_LENGTH))
+    return EIO;
+  decode_records(buf, 0, phy_count, sample);
+  return 0;
+}
+
+/*
+ * Whether one read from record 0 returns the following records too is up
+ * to the firmware. Compare it once with record reads; a counter that
+ * moves in between only costs falling back to record reads.
+ */
+static int probe_bulk(int sg_fd, int buffer_id, int phy_count,
+                      struct phyerr_sample *sample)
+{
+  struct phyerr_sample *bulk;
+  int ret;
+
+  bulk = (struct phyerr_sample *) malloc(sizeof(struct phyerr_sample));
+  if (bulk == NULL)
+    return -1;
+  ret = read_bulk(sg_fd, buffer_id, phy_count, bulk) == 0;
+  if (read_records(sg_fd, buffer_id, phy_count, sample) != 0) {
+    if (ret)
+      memcpy(sample->counters, bulk->counters, sizeof(bulk->counters));
+    else
+      ret = -1;
+  } else if (ret) {
+    ret = memcmp(sample->counters, bulk->counters,
+                 phy_count * sizeof(bulk->counters[0])) == 0;
+  }
+  free(bulk);
+  return ret;
+}
+
+int read_phyerr_sample(int sg_fd, int buffer_id, int phy_count,
+                       struct phyerr_sample *sample,
+                       struct enclosure_cache *cache)
+{
+  char key[PHYERR_KEY_LENGTH];
+  const char *bulk;
+  int ret;
+
+  if (phy_count <= 0 || phy_count > PHYERR_MAX_PHY_COUNT)
+    return EINVAL;
+  memset(sample, 0, sizeof(*sample));
+  sample->phy_count = phy_count;
+  sample->time = (long) time(NULL);
+
+  if (cache->path[0] == '\0')
+    return read_bulk(sg_fd, buffer_id, phy_count, sample) == 0 ? 0 :
+           read_records(sg_fd, buffer_id, phy_count, sample);
+
+  snprintf(key, PHYERR_KEY_LENGTH, "phyerr_bulk_read_0x%02x", buffer_id);
+  bulk = enclosure_cache_get(cache, key);
+  if (bulk != NULL && strcmp(bulk, "1") == 0) {
+    if (read_bulk(sg_fd, buffer_id, phy_count, sample) == 0)
+      return 0;
+    return read_records(sg_fd, buffer_id, phy_count, sample);
+  } else if (bulk != NULL) {
+    return read_records(sg_fd, buffer_id, phy_count, sample);
+  }
+
+  ret = probe_bulk(sg_fd, buffer_id, phy_count, sample);
+  if (ret < 0)
+    return EIO;
+  enclosure_cache_set(cache, key, ret ? "1" : "0");
+  return 0;
+}
+
+/* the previous sample is "phyerr_time" plus one "phyerr_<phy>" per phy */
+static int load_sample(struct enclosure_cache *cache, int phy_count,
+                       struct phyerr_sample *sample)
+{
+  char key[PHYERR_KEY_LENGTH];
+  const char *value;
+  int i;
+
+  memset(sample, 0, sizeof(*sample));
+  value = enclosure_cache_get(cache, "phyerr_time");
+  if (value == NULL || sscanf(value, "%ld", &sample->time) != 1)
+    return ENOENT;
+
+  for (i = 0; i < phy_count; ++i) {
+    snprintf(key, PHYERR_KEY_LENGTH, "phyerr_%d", i);
+    value = enclosure_cache_get(cache, key);
+    if (value == NULL ||
+        sscanf(value, "%u %u %u %u", sample->counters[i],
+               sample->counters[i] + 1, sample->counters[i] + 2,
+               sample->counters[i] + 3) != PHYERR_COUNTER_COUNT)
+      return ENOENT;
+  }
+  sample->phy_count = phy_count;
+  return 0;
+}
+
+static void store_sample(struct enclosure_cache *cache,
+                         struct phyerr_sample *sample)
+{
+  char key[PHYERR_KEY_LENGTH];
+  char value[ENCLOSURE_CACHE_VALUE_LENGTH];
+  int i;
+
+  snprintf(value, ENCLOSURE_CACHE_VALUE_LENGTH, "%ld", sample->time);
+  enclosure_cache_set(cache, "phyerr_time", value);
+  for (i = 0; i < sample->phy_count; ++i) {
+    snprintf(key, PHYERR_KEY_LENGTH, "phyerr_%d", i);
+    snprintf(value, ENCLOSURE_CACHE_VALUE_LENGTH, "%u %u %u %u",
+             sample->counters[i][0], sample->counters[i][1],
+             sample->counters[i][2], sample->counters[i][3]);
+    enclosure_cache_set(cache, key, value);
+  }
+}
+
+/* counters restart from 0 after a clear or an expander reset */
+static unsigned int counter_delta(unsigned int now, unsigned int before)
+{
+  return now >= before ? now - before : now;
+}
+
+static void print_phy(int phy, struct phyerr_sample *sample,
+                      struct phyerr_sample *previous, long interval)
+{
+  unsigned int delta[PHYERR_COUNTER_COUNT];
+  char json_key[PHYERR_KEY_LENGTH];
+  char name[PHYERR_KEY_LENGTH * 2];
+  int i;
+
+  for (i = 0; i < PHYERR_COUNTER_COUNT; ++i)
+    delta[i] = previous ? counter_delta(sample->counters[phy][i],
+                                        previous->counters[phy][i]) : 0;
+
+  IF_PRINT_NONE_JSON {
+    printf("%d", phy);
+    for (i = 0; i < PHYERR_COUNTER_COUNT; ++i)
+      printf("\t%u", sample->counters[phy][i]);
+    for (i = 0; previous && i < PHYERR_COUNTER_COUNT; ++i)
+      printf("\t%u", delta[i]);
+    printf("\n");
+  }
+
+  snprintf(json_key, PHYERR_KEY_LENGTH, "Phy_%u", phy);
+  PRINT_JSON_GROUP_HEADER(json_key);
+  for (i = 0; i < PHYERR_COUNTER_COUNT; ++i) {
+    PRINT_JSON_ITEM(phyerr_counter_names[i], "%u",
+                    sample->counters[phy][i]);
+    if (!previous)
+      continue;
+    snprintf(name, sizeof(name), "%s Delta", phyerr_counter_names[i]);
+    PRINT_JSON_ITEM(name, "%u", delta[i]);
+    snprintf(name, sizeof(name), "%s Rate", phyerr_counter_names[i]);
+    PRINT_JSON_ITEM(name, "%.2f",
+                    interval > 0 ?
+                    (double) delta[i] * PHYERR_RATE_PERIOD / interval :
+                    0.0);
+  }
+  PRINT_JSON_GROUP_ENDING;
+}
+
+int read_phyerr_report(int sg_fd, int buffer_id, int phy_count,
+                       struct phyerr_report *report)
+{
+  struct enclosure_cache *cache;
+  int rc;
+
+  memset(report, 0, sizeof(*report));
+  cache = (struct enclosure_cache *) malloc(sizeof(struct enclosure_cache));
+  if (cache == NULL)
+    return ENOMEM;
+
+  enclosure_cache_open(sg_fd, cache);
+  rc = read_phyerr_sample(sg_fd, buffer_id, phy_count, &report->sample,
+                          cache);
+  if (rc == 0) {
+    report->have_previous =
+      load_sample(cache, phy_count, &report->previous) == 0;
+    if (report->have_previous)
+      report->interval = report->sample.time - report->previous.time;
+    store_sample(cache, &report->sample);
+    enclosure_cache_save(cache);
+  }
+  free(cache);
+  return rc;
+}
+
+void print_phyerr_report(struct phyerr_report *report)
+{
+  int have_previous = report->have_previous;
+  int i;
+
+  IF_PRINT_NONE_JSON {
+    if (have_previous)
+      printf("Delta since %ld seconds ago\n", report->interval);
+    printf("PHY");
+    for (i = 0; i < PHYERR_COUNTER_COUNT; ++i)
+      printf("\t%s", phyerr_counter_names[i]);
+    for (i = 0; have_previous && i < PHYERR_COUNTER_COUNT; ++i)
+      printf("\t%s Delta", phyerr_counter_names[i]);
+    printf("\n");
+  }
+
+  for (i = 0; i < report->sample.phy_count; ++i)
+    print_phy(i, &report->sample, have_previous ? &report->previous : NULL,
+              report->interval);
+
+  if (have_previous) {
+    PRINT_JSON_ITEM("Interval", "%ld", report->interval);
+  }
+}
+
+void print_phyerr(int sg_fd, int buffer_id, int phy_count)
+{
+  struct phyerr_report *report;
+  int rc;
+
+  report = (struct phyerr_report *) malloc(sizeof(struct phyerr_report));
+  if (report == NULL) {
+    perr("Cannot allocate memory.\n");
+    return;
+  }
+  rc = read_phyerr_report(sg_fd, buffer_id, phy_count, report);
+  if (rc == ENOMEM)
+    perr("Cannot allocate memory.\n");
+  else if (rc != 0)
+    perr("Failed to read phy error counters.\n");
+  else
+    print_phyerr_report(report);
+  free(report);
+}
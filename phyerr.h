@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef PHYERR_H
+#define PHYERR_H
+
+/*
+ * The phy error buffer holds one record per phy; the READ BUFFER offset
+ * is the record index. Each record is four big-endian counters.
+ */
+#define PHYERR_COUNTER_COUNT  4
+#define PHYERR_RECORD_LENGTH  (PHYERR_COUNTER_COUNT * 4)
+#define PHYERR_MAX_PHY_COUNT  64
+
+/* rates are reported per this many seconds */
+#define PHYERR_RATE_PERIOD    3600
+
+extern const char *const phyerr_counter_names[PHYERR_COUNTER_COUNT];
+
+struct phyerr_sample {
+  long time;                    /* wall clock, so it survives reboots */
+  int phy_count;
+  unsigned int counters[PHYERR_MAX_PHY_COUNT][PHYERR_COUNTER_COUNT];
+};
+
+struct enclosure_cache;
+
+/*
+ * read the records of all phys, in one command if the firmware allows it;
+ * cache is open, and remembers whether it does
+ */
+extern int read_phyerr_sample(int sg_fd, int buffer_id, int phy_count,
+                              struct phyerr_sample *sample,
+                              struct enclosure_cache *cache);
+
+/* the counters of all phys, and those of the previous run if there was one */
+struct phyerr_report {
+  int have_previous;
+  long interval;                /* seconds since the previous run */
+  struct phyerr_sample sample;
+  struct phyerr_sample previous;
+};
+
+/*
+ * read the records of all phys and the sample saved by the previous run
+ * on the same expander, then save this sample
+ */
+extern int read_phyerr_report(int sg_fd, int buffer_id, int phy_count,
+                              struct phyerr_report *report);
+
+/* print counters, with deltas and rates when there was a previous run */
+extern void print_phyerr_report(struct phyerr_report *report);
+
+/*
+ * read the records of all phys, in one command if the firmware allows it,
+ * and print their counters, with deltas and rates since the sample
+ * saved by the previous run on the same expander, then save this sample
+ */
+extern void print_phyerr(int sg_fd, int buffer_id, int phy_count);
+
+#endif
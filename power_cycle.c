@@ -0,0 +1,211 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <scsi/sg_lib.h>
+#include <scsi/sg_cmds.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jbod_interface.h"
+#include "json.h"
+#include "parallel.h"
+#include "power_cycle.h"
+#include "uevent.h"
+
+/* how often to probe SES when no uevent arrives */
+#define POWER_CYCLE_PROBE_INTERVAL_MS 1000
+#define SES_PAGE_ZERO_PROBE_SIZE 64
+
+struct power_cycle_ctx {
+  struct power_cycle_result *results;
+  int timeout;
+};
+
+/* /dev/bsg/X is in subsystem bsg, /dev/sgX in scsi_generic */
+static const char *dev_subsystem(const char *devname)
+{
+  return strncmp(devname, "/dev/bsg/", 9) == 0 ? "bsg" : "scsi_generic";
+}
+
+/* SAS address of the SES target, from sysfs; return 0 on success */
+static int read_sysfs_sas_address(const char *devname,
+                                  char out[SAS_ADDR_STR_LENGTH + 3])
+{
+  char path[PATH_MAX];
+  char name[PATH_MAX];
+  int fd, len;
+
+  snprintf(name, PATH_MAX, "%s", devname);
+  snprintf(path, PATH_MAX, "/sys/class/%s/%s/device/sas_address",
+           dev_subsystem(devname), basename(name));
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 1;
+  len = read(fd, out, SAS_ADDR_STR_LENGTH + 2);
+  close(fd);
+  if (len != SAS_ADDR_STR_LENGTH + 2)
+    return 1;
+  out[len] = '\0';
+  return 0;
+}
+
+/* return whether devname answers SES page 0 */
+static int ses_answers(const char *devname)
+{
+  unsigned char buf[SES_PAGE_ZERO_PROBE_SIZE];
+  int sg_fd;
+  int ret;
+
+  sg_fd = sg_cmds_open_device(devname, 0 /* rw */, 0 /* not verbose */);
+  if (sg_fd < 0)
+    return 0;
+  ret = sg_ll_receive_diag(sg_fd, 1 /* pcv */, 0, buf, sizeof(buf),
+                           0 /* not noisy */, 0 /* not verbose */);
+  sg_cmds_close_device(sg_fd);
+  return ret == 0 && buf[0] == 0;
+}
+
+/*
+ * wait for the enclosure to come back. An expander counts as ready only
+ * after it was seen going away (remove uevent or failed probe), so a probe
+ * that races with the reset is not mistaken for a recovered enclosure.
+ */
+static int wait_enclosure_ready(struct power_cycle_result *r, int uevent_fd,
+                                const char *sas_addr, long long deadline_ms)
+{
+  const char *subsystem = dev_subsystem(r->devname);
+  char path[PATH_MAX];
+  char new_addr[SAS_ADDR_STR_LENGTH + 3];
+  struct uevent ev;
+  long long now, last_probe = 0;
+  int seen_down = 0;
+  int probe;
+  int ret;
+
+  while ((now = monotonic_ms()) < deadline_ms) {
+    probe = now - last_probe >= POWER_CYCLE_PROBE_INTERVAL_MS;
+
+    if (uevent_fd >= 0) {
+      ret = uevent_read(uevent_fd, &ev, POWER_CYCLE_PROBE_INTERVAL_MS);
+      if (ret < 0) {
+        uevent_close(uevent_fd);
+        uevent_fd = -1;
+      } else if (ret == 1 && ev.devname[0] &&
+                 strcmp(ev.subsystem, subsystem) == 0) {
+        snprintf(path, PATH_MAX, "/dev/%s", ev.devname);
+        if (strcmp(ev.action, "remove") == 0 &&
+            strcmp(path, r->new_devname) == 0) {
+          seen_down = 1;
+        } else if (strcmp(ev.action, "add") == 0 && sas_addr[0] &&
+                   read_sysfs_sas_address(path, new_addr) == 0 &&
+                   strcmp(new_addr, sas_addr) == 0) {
+          /* re-enumerated, possibly under a new name */
+          snprintf(r->new_devname, PATH_MAX, "%s", path);
+          seen_down = 1;
+          probe = 1;
+        }
+      }
+    } else {
+      usleep(POWER_CYCLE_PROBE_INTERVAL_MS * 1000);
+      probe = 1;
+    }
+
+    if (!probe)
+      continue;
+    last_probe = monotonic_ms();
+    if (!ses_answers(r->new_devname))
+      seen_down = 1;
+    else if (seen_down)
+      return 0;
+  }
+  return ETIMEDOUT;
+}
+
+static void power_cycle_one(int index, void *arg)
+{
+  struct power_cycle_ctx *ctx = arg;
+  struct power_cycle_result *r = ctx->results + index;
+  struct jbod_interface *jbod;
+  char sas_addr[SAS_ADDR_STR_LENGTH + 3] = "";
+  int uevent_fd = -1;
+  long long start_ms;
+  int sg_fd;
+
+  snprintf(r->new_devname, PATH_MAX, "%s", r->devname);
+  r->seconds = 0;
+
+  jbod = detect_dev(r->devname);
+  if (jbod == NULL) {
+    r->rc = ENODEV;
+    return;
+  }
+
+  if (ctx->timeout > 0) {
+    read_sysfs_sas_address(r->devname, sas_addr);
+    /* subscribe before the reset, so no event is missed */
+    uevent_fd = uevent_open();
+  }
+
+  sg_fd = sg_cmds_open_device(r->devname, 0 /* rw */, 0 /* not verbose */);
+  if (sg_fd < 0) {
+    uevent_close(uevent_fd);
+    r->rc = ENODEV;
+    return;
+  }
+  jbod->power_cycle_enclosure(sg_fd);
+  sg_cmds_close_device(sg_fd);
+  start_ms = monotonic_ms();
+
+  r->rc = 0;
+  if (ctx->timeout > 0) {
+    r->rc = wait_enclosure_ready(r, uevent_fd, sas_addr,
+                                 start_ms + ctx->timeout * 1000LL);
+    r->seconds = (monotonic_ms() - start_ms) / 1000;
+  }
+  uevent_close(uevent_fd);
+}
+
+void power_cycle_enclosures(struct power_cycle_result *results,
+                            int count, int max_parallel, int timeout)
+{
+  struct power_cycle_ctx ctx = {results, timeout};
+
+  run_parallel(count, max_parallel, power_cycle_one, &ctx);
+}
+
+void print_power_cycle_result(struct power_cycle_result *r)
+{
+  const char *status;
+
+  if (r->rc == 0)
+    status = "Ready";
+  else if (r->rc == ETIMEDOUT)
+    status = "Timeout";
+  else
+    status = "Failed";
+
+  IF_PRINT_NONE_JSON {
+    printf("%s\t%s", r->devname, status);
+    if (r->rc == 0 && strcmp(r->devname, r->new_devname) != 0)
+      printf("\tnow %s", r->new_devname);
+    printf("\t%d s\n", r->seconds);
+  }
+
+  PRINT_JSON_GROUP_HEADER(r->devname);
+  PRINT_JSON_ITEM("status", "%s", status);
+  PRINT_JSON_ITEM("rc", "%d", r->rc);
+  PRINT_JSON_ITEM("new_devname", "%s", r->new_devname);
+  PRINT_JSON_ITEM("seconds", "%d", r->seconds);
+  PRINT_JSON_GROUP_ENDING;
+}
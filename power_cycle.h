@@ -0,0 +1,38 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef POWER_CYCLE_H
+#define POWER_CYCLE_H
+
+#include <limits.h>
+
+/* seconds to wait for an expander to answer SES again */
+#define POWER_CYCLE_DEFAULT_TIMEOUT 300
+
+/* enclosures to reset at the same time */
+#define POWER_CYCLE_DEFAULT_PARALLEL 4
+
+struct power_cycle_result {
+  char devname[PATH_MAX];       /* device to power cycle */
+  char new_devname[PATH_MAX];   /* device after re-enumeration */
+  int rc;                       /* 0 if reset (and ready, if waited) */
+  int seconds;                  /* time until the enclosure was ready */
+};
+
+/*
+ * power cycle the expander of every results[i].devname, up to max_parallel
+ * at a time. If timeout > 0, also wait up to timeout seconds for each
+ * expander to re-enumerate and answer SES again.
+ */
+extern void power_cycle_enclosures(struct power_cycle_result *results,
+                                   int count, int max_parallel, int timeout);
+
+extern void print_power_cycle_result(struct power_cycle_result *result);
+
+#endif
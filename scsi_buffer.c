@@ -9,91 +9,581 @@
 
 #include <scsi/sg_lib.h>
 #include <scsi/sg_cmds.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "common.h"
+#include "enclosure_cache.h"
 #include "scsi_buffer.h"
+#include "ses.h"
 #include "json.h"
 
+/* a READ BUFFER answer of an enclosure, kept for ocpjbodd */
+struct kept_read {
+  dev_t rdev;                       /* of the sg device */
+  int buf_id;
+  int offset;
+  int len;
+  int learned;                      /* read from the device by us */
+  unsigned char *data;
+};
+
+static int keep_reads = 0;
+static struct kept_read kept_reads[SCSI_BUFFER_MAX_KEPT_READS];
+static int kept_read_count = 0;
+static pthread_mutex_t kept_read_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* the kept read holding the range, or NULL; with the lock held */
+static struct kept_read *find_kept_read(dev_t rdev, int buf_id, int offset,
+                                        int len)
+{
+  struct kept_read *kept;
+  int i;
+
+  for (i = 0; i < kept_read_count; ++i) {
+    kept = kept_reads + i;
+    if (kept->rdev == rdev && kept->buf_id == buf_id &&
+        kept->offset <= offset && offset + len <= kept->offset + kept->len)
+      return kept;
+  }
+  return NULL;
+}
+
+static void keep_read(dev_t rdev, int buf_id, int offset,
+                      const unsigned char *data, int len, int learned)
+{
+  struct kept_read *kept = NULL;
+  unsigned char *copy;
+  int i;
+
+  if (len <= 0)
+    return;
+  copy = (unsigned char *) malloc(len);
+  if (copy == NULL)
+    return;
+  memcpy(copy, data, len);
+
+  pthread_mutex_lock(&kept_read_lock);
+  for (i = 0; i < kept_read_count && kept == NULL; ++i) {
+    if (kept_reads[i].rdev == rdev && kept_reads[i].buf_id == buf_id &&
+        kept_reads[i].offset == offset && kept_reads[i].len == len)
+      kept = kept_reads + i;
+  }
+  if (kept == NULL && kept_read_count < SCSI_BUFFER_MAX_KEPT_READS)
+    kept = kept_reads + kept_read_count++;
+  if (kept != NULL) {
+    free(kept->data);
+    kept->rdev = rdev;
+    kept->buf_id = buf_id;
+    kept->offset = offset;
+    kept->len = len;
+    kept->learned = learned;
+    kept->data = copy;
+    copy = NULL;
+  }
+  pthread_mutex_unlock(&kept_read_lock);
+  free(copy);
+}
+
+/* a range that cannot be read any more is read by the next command again */
+static void forget_read(dev_t rdev, int buf_id, int offset, int len)
+{
+  int i;
+
+  pthread_mutex_lock(&kept_read_lock);
+  for (i = 0; i < kept_read_count; ++i) {
+    if (kept_reads[i].rdev == rdev && kept_reads[i].buf_id == buf_id &&
+        kept_reads[i].offset == offset && kept_reads[i].len == len) {
+      free(kept_reads[i].data);
+      kept_reads[i] = kept_reads[--kept_read_count];
+      kept_reads[kept_read_count].data = NULL;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&kept_read_lock);
+}
+
+void scsi_buffer_keep_reads(int keep)
+{
+  keep_reads = keep;
+  if (!keep)
+    scsi_buffer_drop_reads();
+}
+
+void scsi_buffer_drop_reads(void)
+{
+  int i;
+
+  pthread_mutex_lock(&kept_read_lock);
+  for (i = 0; i < kept_read_count; ++i) {
+    free(kept_reads[i].data);
+    kept_reads[i].data = NULL;
+  }
+  kept_read_count = 0;
+  pthread_mutex_unlock(&kept_read_lock);
+}
+
+void scsi_buffer_keep_read(dev_t rdev, int buf_id, int offset,
+                           const unsigned char *data, int len)
+{
+  keep_read(rdev, buf_id, offset, data, len, 0);
+}
+
+void scsi_buffer_foreach_read(int learned_only,
+                              scsi_buffer_read_fn fn, void *arg)
+{
+  struct kept_read *kept;
+  int i;
+
+  pthread_mutex_lock(&kept_read_lock);
+  for (i = 0; i < kept_read_count; ++i) {
+    kept = kept_reads + i;
+    if (!learned_only || kept->learned)
+      fn(kept->rdev, kept->buf_id, kept->offset, kept->data, kept->len, arg);
+  }
+  pthread_mutex_unlock(&kept_read_lock);
+}
+
+void scsi_buffer_refresh_reads(int sg_fd)
+{
+  struct kept_read *stale;
+  struct stat dev_stat;
+  unsigned char *data;
+  int count = 0;
+  int i;
+
+  if (fstat(sg_fd, &dev_stat) != 0)
+    return;
+
+  /* the ranges aside, so other enclosures are not held up by the reads */
+  pthread_mutex_lock(&kept_read_lock);
+  stale = (struct kept_read *) malloc(kept_read_count *
+                                      sizeof(struct kept_read) + 1);
+  for (i = 0; stale != NULL && i < kept_read_count; ++i) {
+    if (kept_reads[i].rdev == dev_stat.st_rdev) {
+      stale[count] = kept_reads[i];
+      stale[count++].data = NULL;
+    }
+  }
+  pthread_mutex_unlock(&kept_read_lock);
+  if (stale == NULL)
+    return;
+
+  for (i = 0; i < count; ++i) {
+    data = (unsigned char *) malloc(stale[i].len);
+    if (data == NULL)
+      break;
+    if (sg_ll_read_buffer(sg_fd, 1, stale[i].buf_id, stale[i].offset,
+                          (void *) data, stale[i].len, 1, 0) == 0)
+      keep_read(dev_stat.st_rdev, stale[i].buf_id, stale[i].offset, data,
+                stale[i].len, 1);
+    else
+      forget_read(dev_stat.st_rdev, stale[i].buf_id, stale[i].offset,
+                  stale[i].len);
+    free(data);
+  }
+  free(stale);
+}
+
 int scsi_read_buffer(
   int sg_fd, int buffer_id, int buffer_offset,
   unsigned char *rsp, int max_rsp_size)
 {
+  struct kept_read *kept;
+  struct stat dev_stat;
+  int keep = keep_reads && fstat(sg_fd, &dev_stat) == 0;
+  int rc;
+
+  if (keep) {
+    pthread_mutex_lock(&kept_read_lock);
+    kept = find_kept_read(dev_stat.st_rdev, buffer_id, buffer_offset,
+                          max_rsp_size);
+    if (kept != NULL)
+      memcpy(rsp, kept->data + buffer_offset - kept->offset, max_rsp_size);
+    pthread_mutex_unlock(&kept_read_lock);
+    if (kept != NULL)
+      return 0;
+  }
 
-  return sg_ll_read_buffer(sg_fd, 1, buffer_id,
-                           buffer_offset, (void *) rsp,
-                           max_rsp_size, 1, 0);
+  rc = sg_ll_read_buffer(sg_fd, 1, buffer_id,
+                         buffer_offset, (void *) rsp,
+                         max_rsp_size, 1, 0);
+  if (keep && rc == 0)
+    keep_read(dev_stat.st_rdev, buffer_id, buffer_offset, rsp, max_rsp_size,
+              1);
+  return rc;
 }
 
 int scsi_write_buffer(
   int sg_fd, int buffer_id, int buffer_offset,
   unsigned char *msg, int msg_size)
 {
-
+  ses_drop_snapshots();
+  scsi_buffer_drop_reads();
   return sg_ll_write_buffer(sg_fd, 1, buffer_id,
                             buffer_offset, (void *) msg,
                             msg_size, 1, 0);
 }
 
-void read_buffer_string(int sg_fd, struct scsi_buffer_parameter *sbp,
-                        char *buf, int max_length)
+#define SCSI_BUFFER_GEOMETRY_KEY_LENGTH 32
+
+/* READ BUFFER mode 3 returns 4 bytes: offset boundary, then capacity */
+#define READ_BUFFER_DESCRIPTOR_MODE 3
+#define READ_BUFFER_DESCRIPTOR_LENGTH 4
+#define READ_BUFFER_ONLY_OFFSET_ZERO 0xff
+
+/*
+ * return EIO if the firmware has no descriptor mode, ERANGE if the
+ * descriptor is not believable; the geometry is unknown in both cases
+ */
+static int probe_geometry(int sg_fd, int buf_id,
+                          struct scsi_buffer_geometry *geometry)
+{
+  unsigned char desc[READ_BUFFER_DESCRIPTOR_LENGTH];
+  int capacity;
+
+  geometry->capacity = -1;
+  geometry->offset_boundary = -1;
+  if (sg_ll_read_buffer(sg_fd, READ_BUFFER_DESCRIPTOR_MODE, buf_id, 0,
+                        (void *) desc, READ_BUFFER_DESCRIPTOR_LENGTH,
+                        0 /* not noisy */, 0 /* not verbose */) != 0)
+    return EIO;
+
+  /* some firmware answers with zeros; no buffer we read is empty */
+  capacity = (desc[1] << 16) | (desc[2] << 8) | desc[3];
+  if (capacity == 0)
+    return ERANGE;
+  geometry->capacity = capacity;
+  if (desc[0] == READ_BUFFER_ONLY_OFFSET_ZERO)
+    geometry->offset_boundary = 0;
+  else if (desc[0] < 31)
+    geometry->offset_boundary = 1 << desc[0];
+  return 0;
+}
+
+int scsi_buffer_cached_geometry(int sg_fd, struct enclosure_cache *cache,
+                                int buf_id,
+                                struct scsi_buffer_geometry *geometry)
+{
+  char key[SCSI_BUFFER_GEOMETRY_KEY_LENGTH];
+  char value[ENCLOSURE_CACHE_VALUE_LENGTH];
+  const char *cached;
+
+  snprintf(key, SCSI_BUFFER_GEOMETRY_KEY_LENGTH, "buffer_0x%02x", buf_id);
+  cached = enclosure_cache_get(cache, key);
+  if (cached != NULL &&
+      sscanf(cached, "%d %d", &geometry->capacity,
+             &geometry->offset_boundary) == 2)
+    return 0;
+
+  /*
+   * firmware without descriptor mode is remembered as unknown, too; a
+   * descriptor that is not believable is asked for again next time
+   */
+  if (probe_geometry(sg_fd, buf_id, geometry) == ERANGE)
+    return 0;
+  snprintf(value, ENCLOSURE_CACHE_VALUE_LENGTH, "%d %d",
+           geometry->capacity, geometry->offset_boundary);
+  enclosure_cache_set(cache, key, value);
+  return 0;
+}
+
+/* the start of a span holding offset, as allowed by the buffer */
+static int aligned_start(const struct scsi_buffer_geometry *geometry,
+                         int offset)
+{
+  if (geometry->offset_boundary == 0)
+    return 0;
+  if (geometry->offset_boundary > 1)
+    return offset - offset % geometry->offset_boundary;
+  return offset;
+}
+
+/* whether a span up to end is inside the buffer, as far as is known */
+static int within_capacity(const struct scsi_buffer_geometry *geometry,
+                           int end)
+{
+  return geometry->capacity <= 0 || end <= geometry->capacity;
+}
+
+/*
+ * add sbp to the span of its buffer, if the span stays small enough and
+ * inside the buffer, as a READ BUFFER past its end fails as a whole
+ */
+static int plan_add(struct scsi_buffer_plan *plan,
+                    const struct scsi_buffer_parameter *sbp,
+                    const struct scsi_buffer_geometry *geometry)
+{
+  struct scsi_buffer_span *span;
+  int start, end;
+  int i;
+
+  if (sbp->indexed)
+    return 0;
+
+  for (i = 0; i < plan->span_count; ++i) {
+    span = plan->spans + i;
+    if (span->buf_id != sbp->buf_id)
+      continue;
+    start = span->start < sbp->buf_offset ? span->start : sbp->buf_offset;
+    end = span->start + span->len > sbp->buf_offset + sbp->len ?
+      span->start + span->len : sbp->buf_offset + sbp->len;
+    start = aligned_start(geometry, start);
+    if (end - start <= SCSI_BUFFER_PLAN_MAX_SPAN_SIZE &&
+        within_capacity(geometry, end)) {
+      span->start = start;
+      span->len = end - start;
+      return 1;
+    }
+  }
+
+  start = aligned_start(geometry, sbp->buf_offset);
+  end = sbp->buf_offset + sbp->len;
+  if (plan->span_count >= SCSI_BUFFER_PLAN_MAX_SPANS ||
+      end - start > SCSI_BUFFER_PLAN_MAX_SPAN_SIZE ||
+      !within_capacity(geometry, end))
+    return 0;
+  span = plan->spans + plan->span_count++;
+  span->buf_id = sbp->buf_id;
+  span->start = start;
+  span->len = end - start;
+  return 1;
+}
+
+void scsi_buffer_plan_read(
+  int sg_fd, const struct scsi_buffer_parameter *const *sbps, int count,
+  struct scsi_buffer_plan *plan)
+{
+  struct enclosure_cache *cache;
+  struct scsi_buffer_geometry geometries[SCSI_BUFFER_PLAN_MAX_SPANS];
+  int buf_ids[SCSI_BUFFER_PLAN_MAX_SPANS];
+  struct scsi_buffer_geometry unknown = {-1, -1};
+  struct scsi_buffer_geometry *geometry;
+  struct scsi_buffer_span *span;
+  int buf_count = 0;
+  int i, j;
+
+  memset(plan, 0, sizeof(*plan));
+  if (count == 0)
+    return;
+
+  /* geometry of every buffer in the plan, probed once per firmware */
+  cache = (struct enclosure_cache *) malloc(sizeof(struct enclosure_cache));
+  if (cache != NULL && enclosure_cache_open(sg_fd, cache) != 0) {
+    free(cache);
+    cache = NULL;
+  }
+  for (i = 0; i < count; ++i) {
+    for (j = 0; j < buf_count; ++j) {
+      if (buf_ids[j] == sbps[i]->buf_id)
+        break;
+    }
+    geometry = j < buf_count ? geometries + j : &unknown;
+    if (j == buf_count && !sbps[i]->indexed && cache != NULL &&
+        buf_count < SCSI_BUFFER_PLAN_MAX_SPANS) {
+      buf_ids[buf_count] = sbps[i]->buf_id;
+      geometry = geometries + buf_count++;
+      scsi_buffer_cached_geometry(sg_fd, cache, sbps[i]->buf_id, geometry);
+    }
+    plan_add(plan, sbps[i], geometry);
+  }
+  if (cache != NULL)
+    enclosure_cache_save(cache);
+  free(cache);
+
+  for (i = 0; i < plan->span_count; ++i) {
+    span = plan->spans + i;
+    span->data = (unsigned char *) calloc(1, span->len);
+    if (span->data == NULL) {
+      span->rc = -1;
+      continue;
+    }
+    span->rc = scsi_read_buffer(sg_fd, span->buf_id, span->start,
+                                span->data, span->len);
+  }
+}
+
+void scsi_buffer_plan_free(struct scsi_buffer_plan *plan)
+{
+  int i;
+
+  for (i = 0; i < plan->span_count; ++i) {
+    free(plan->spans[i].data);
+    plan->spans[i].data = NULL;
+  }
+  plan->span_count = 0;
+}
+
+struct scsi_buffer_span *scsi_buffer_plan_span(
+  struct scsi_buffer_plan *plan, const struct scsi_buffer_parameter *sbp)
+{
+  struct scsi_buffer_span *span;
+  int i;
+
+  if (plan == NULL || sbp->indexed)
+    return NULL;
+
+  for (i = 0; i < plan->span_count; ++i) {
+    span = plan->spans + i;
+    if (span->buf_id == sbp->buf_id && span->rc == 0 &&
+        span->start <= sbp->buf_offset &&
+        sbp->buf_offset + sbp->len <= span->start + span->len)
+      return span;
+  }
+  return NULL;
+}
+
+unsigned char *scsi_buffer_plan_value(
+  struct scsi_buffer_plan *plan, const struct scsi_buffer_parameter *sbp)
+{
+  struct scsi_buffer_span *span = scsi_buffer_plan_span(plan, sbp);
+
+  return span ? span->data + sbp->buf_offset - span->start : NULL;
+}
+
+void planned_buffer_string(int sg_fd, struct scsi_buffer_plan *plan,
+                           const struct scsi_buffer_parameter *sbp,
+                           char *buf, int max_length)
 {
 
   int read_length = max_length - 1 > sbp->len ? sbp->len : max_length - 1;
+  unsigned char *value = scsi_buffer_plan_value(plan, sbp);
 
-  scsi_read_buffer(sg_fd, sbp->buf_id, sbp->buf_offset,
-                   (unsigned char *) buf, read_length);
+  if (value)
+    memcpy(buf, value, read_length);
+  else
+    scsi_read_buffer(sg_fd, sbp->buf_id, sbp->buf_offset,
+                     (unsigned char *) buf, read_length);
   buf[read_length] = '\0';
   fix_none_ascii(buf, read_length);
 }
 
-void read_value_as_string(
-    int sg_fd, struct scsi_buffer_parameter *sbp, char out[4096])
+void read_buffer_string(int sg_fd, const struct scsi_buffer_parameter *sbp,
+                        char *buf, int max_length)
+{
+  planned_buffer_string(sg_fd, NULL, sbp, buf, max_length);
+}
+
+/* big-endian integer of len bytes */
+static inline int decode_integer(const unsigned char *buf, int len)
+{
+  int val = 0;
+  int i;
+
+  for (i = 0; i < len; ++i)
+    val = (val << 8) | buf[i];
+  return val;
+}
+
+void planned_value_as_string(
+    int sg_fd, struct scsi_buffer_plan *plan,
+    const struct scsi_buffer_parameter *sbp, char out[4096])
 {
   unsigned char buf[4096];
-  char *str, *esc_str;
+  unsigned char *value = scsi_buffer_plan_value(plan, sbp);
+  int len = sbp->len - sbp->value_offset;
 
-  scsi_read_buffer(sg_fd, sbp->buf_id, sbp->buf_offset, buf, sbp->len);
+  if (value == NULL) {
+    scsi_read_buffer(sg_fd, sbp->buf_id, sbp->buf_offset, buf, sbp->len);
+    value = buf;
+  }
 
   switch (sbp->type) {
     case sbp_integer:
       snprintf(
         out, 4096, "%d %s",
-        sbp->to_int_callback(buf + sbp->value_offset), sbp->unit);
-      break;
-    case sbp_floatp:
-      snprintf(
-        out, 4096, "%.2f %s",
-        sbp->to_float_callback(buf + sbp->value_offset), sbp->unit);
+        decode_integer(value + sbp->value_offset, len), sbp->unit);
       break;
     case sbp_string:
-      str = sbp->to_string_callback(
-          buf + sbp->value_offset,
-          sbp->len - sbp->value_offset);
-      esc_str = str_escape(str);
-      snprintf(
-        out, 4096, "%s%s",
-        str,
-        sbp->unit);
-      free(str);
-      free(esc_str);
+      memcpy(out, value + sbp->value_offset, len);
+      fix_none_ascii(out, len);
+      snprintf(out + len, 4096 - len, "%s", sbp->unit);
       break;
   }
 }
 
-void print_read_value(int sg_fd, struct scsi_buffer_parameter *sbp)
+void read_value_as_string(
+    int sg_fd, const struct scsi_buffer_parameter *sbp, char out[4096])
+{
+  planned_value_as_string(sg_fd, NULL, sbp, out);
+}
+
+int read_value_as_int(
+    int sg_fd, const struct scsi_buffer_parameter *sbp, int *value)
+{
+  unsigned char buf[4096];
+  int rc;
+
+  if (sbp->type != sbp_integer)
+    return EINVAL;
+  rc = scsi_read_buffer(sg_fd, sbp->buf_id, sbp->buf_offset, buf, sbp->len);
+  if (rc == 0)
+    *value = decode_integer(buf + sbp->value_offset,
+                            sbp->len - sbp->value_offset);
+  return rc;
+}
+
+void print_planned_value(int sg_fd, struct scsi_buffer_plan *plan,
+                         const struct scsi_buffer_parameter *sbp)
 {
   char out[4096];
-  read_value_as_string(sg_fd, sbp, out);
+
+  if (!json_field_wanted(sbp->name))
+    return;
+  planned_value_as_string(sg_fd, plan, sbp, out);
 
   IF_PRINT_NONE_JSON {
     printf("%s\t%s\n", sbp->name, out);
   }
-  PRINT_JSON_LAST_ITEM(
+  PRINT_JSON_ITEM(
     sbp->name, "%s", out);
 }
 
+void print_read_value(int sg_fd, const struct scsi_buffer_parameter *sbp)
+{
+  print_planned_value(sg_fd, NULL, sbp);
+}
+
+int select_wanted_values(const struct scsi_buffer_parameter *const *sbps,
+                         int count, const struct scsi_buffer_parameter **wanted)
+{
+  int selected = 0;
+  int i;
+
+  for (i = 0; i < count; ++i) {
+    if (json_field_wanted(sbps[i]->name))
+      wanted[selected++] = sbps[i];
+  }
+  return selected;
+}
+
+void print_read_values(int sg_fd, const struct scsi_buffer_parameter *const *sbps,
+                       int count)
+{
+  const struct scsi_buffer_parameter **wanted;
+  struct scsi_buffer_plan plan;
+  int i;
+
+  wanted = (const struct scsi_buffer_parameter **)
+    calloc(count + 1, sizeof(*wanted));
+  if (wanted == NULL) {
+    perr("Cannot allocate memory.\n");
+    return;
+  }
+  /* spans of unselected values are not read at all */
+  count = select_wanted_values(sbps, count, wanted);
+  scsi_buffer_plan_read(sg_fd, wanted, count, &plan);
+  for (i = 0; i < count; ++i) {
+    print_planned_value(sg_fd, &plan, wanted[i]);
+  }
+  scsi_buffer_plan_free(&plan);
+  free(wanted);
+}
+
 int two_byte_to_int(unsigned char *buf)
 {
   return (int)buf[0] * 256 + (int)buf[1];
@@ -10,6 +10,8 @@
 #ifndef SCSI_BUFFER_H
 #define SCSI_BUFFER_H
 
+#include <sys/types.h>
+
 /* read buffer with mode=1 */
 extern int scsi_read_buffer(
   int sg_fd, int buffer_id, int buffer_offset,
@@ -20,8 +22,40 @@ extern int scsi_write_buffer(
   int sg_fd, int buffer_id, int buffer_offset,
   unsigned char *msg, int msg_size);
 
-/* directions to interpret buffer parameter */
-typedef enum {sbp_integer, sbp_floatp, sbp_string} value_type;
+/* how many READ BUFFER answers scsi_buffer_keep_reads() keeps at most */
+#define SCSI_BUFFER_MAX_KEPT_READS 1024
+
+/*
+ * with keep set, scsi_read_buffer() answers from what it read of the same
+ * enclosure before, until any SES page or buffer is written. For
+ * ocpjbodd, whose poller reads everything kept again every interval.
+ */
+extern void scsi_buffer_keep_reads(int keep);
+extern void scsi_buffer_drop_reads(void);
+
+/* read again what is kept of the enclosure of sg_fd; forget what fails */
+extern void scsi_buffer_refresh_reads(int sg_fd);
+
+typedef void (*scsi_buffer_read_fn)(dev_t rdev, int buf_id, int offset,
+                                    const unsigned char *data, int len,
+                                    void *arg);
+
+/*
+ * call fn with every kept read, or only with those read from the device by
+ * this process if learned_only is set; the reads are locked meanwhile
+ */
+extern void scsi_buffer_foreach_read(int learned_only,
+                                     scsi_buffer_read_fn fn, void *arg);
+
+/* keep a read that another process made */
+extern void scsi_buffer_keep_read(dev_t rdev, int buf_id, int offset,
+                                  const unsigned char *data, int len);
+
+/*
+ * directions to interpret buffer parameter: an integer is the big-endian
+ * number in bytes [value_offset, len); a string is those bytes as text
+ */
+typedef enum {sbp_integer, sbp_string} value_type;
 
 struct scsi_buffer_parameter {
   value_type type;
@@ -38,17 +72,112 @@ struct scsi_buffer_parameter {
   /* offset of the value in the read data */
   int value_offset;
 
-  /* how to interpret the data */
-  int (*to_int_callback) (unsigned char *buf);
-  float (*to_float_callback) (unsigned char *buf);
-  char *(*to_string_callback) (unsigned char *buf, int len);
+  /* buf_offset is a record index rather than a byte offset */
+  int indexed;
 };
 
+/*
+ * Each platform lists its parameters once, in a buffer map of
+ *   X(variable, type, buf_id, buf_offset, len, name, unit, value_offset,
+ *     indexed)
+ * and expands it with SCSI_BUFFER_PARAMETER into const definitions.
+ */
+#define SCSI_BUFFER_PARAMETER(var, type, buf_id, buf_offset, len, name,  \
+                              unit, value_offset, indexed)              \
+  static const struct scsi_buffer_parameter var = {                     \
+    type, buf_id, buf_offset, len, name, unit, value_offset, indexed};
+
+/*
+ * READ BUFFER descriptor (mode 3) of one buffer. Firmware reports
+ * capacities that do not match what it returns, so reads keep the
+ * lengths of the vendor tables; a plan only does not coalesce them into a
+ * span past the capacity, and aligns spans to the offset boundary.
+ */
+struct scsi_buffer_geometry {
+  int capacity;                 /* bytes, -1 if unknown */
+  int offset_boundary;          /* offsets are multiples of it; 0 if only
+                                   offset 0 is allowed; -1 if unknown */
+};
+
+struct enclosure_cache;
+
+/*
+ * geometry of buffer buf_id, probed with descriptor mode once per firmware
+ * revision and kept in cache, an enclosure cache that is already open
+ */
+extern int scsi_buffer_cached_geometry(int sg_fd,
+                                       struct enclosure_cache *cache,
+                                       int buf_id,
+                                       struct scsi_buffer_geometry *geometry);
+
+/* maximal bytes read by one READ BUFFER of a plan */
+#define SCSI_BUFFER_PLAN_MAX_SPAN_SIZE 4096
+#define SCSI_BUFFER_PLAN_MAX_SPANS 16
+
+/* a range of one buffer, read with a single command */
+struct scsi_buffer_span {
+  int buf_id;
+  int start;                    /* byte offset of data[0] in the buffer */
+  int len;
+  int rc;                       /* return code of the read */
+  unsigned char *data;
+};
+
+/*
+ * READ BUFFER commands covering a list of parameters: parameters in the
+ * same buffer share one read of the span covering all of them, aligned to
+ * the offset boundary of the buffer. Indexed parameters are not
+ * planned, and are read one by one.
+ */
+struct scsi_buffer_plan {
+  struct scsi_buffer_span spans[SCSI_BUFFER_PLAN_MAX_SPANS];
+  int span_count;
+};
+
+/* read all spans needed for sbps */
+extern void scsi_buffer_plan_read(
+  int sg_fd, const struct scsi_buffer_parameter *const *sbps, int count,
+  struct scsi_buffer_plan *plan);
+
+extern void scsi_buffer_plan_free(struct scsi_buffer_plan *plan);
+
+/* the span holding sbp, or NULL if it was not read by the plan */
+extern struct scsi_buffer_span *scsi_buffer_plan_span(
+  struct scsi_buffer_plan *plan, const struct scsi_buffer_parameter *sbp);
+
+/* the value of sbp in a plan, or NULL if it was not read by the plan */
+extern unsigned char *scsi_buffer_plan_value(
+  struct scsi_buffer_plan *plan, const struct scsi_buffer_parameter *sbp);
+
 extern void read_value_as_string(
-    int sg_fd, struct scsi_buffer_parameter *sbp, char out[4096]);
+    int sg_fd, const struct scsi_buffer_parameter *sbp, char out[4096]);
+
+/* value of an sbp_integer, without its unit; return the read error */
+extern int read_value_as_int(
+    int sg_fd, const struct scsi_buffer_parameter *sbp, int *value);
+
+/* same as read_value_as_string(), but take the value from plan if read */
+extern void planned_value_as_string(
+    int sg_fd, struct scsi_buffer_plan *plan,
+    const struct scsi_buffer_parameter *sbp, char out[4096]);
 
 /* read the value and print it */
-extern void print_read_value(int sg_fd, struct scsi_buffer_parameter *sbp);
+extern void print_read_value(int sg_fd, const struct scsi_buffer_parameter *sbp);
+
+extern void print_planned_value(int sg_fd, struct scsi_buffer_plan *plan,
+                                const struct scsi_buffer_parameter *sbp);
+
+/*
+ * copy the values of sbps that --fields selects to wanted, which has room
+ * for count; return how many were copied
+ */
+extern int select_wanted_values(const struct scsi_buffer_parameter *const *sbps,
+                                int count,
+                                const struct scsi_buffer_parameter **wanted);
+
+/* read a list of values with a plan, and print them as JSON items */
+extern void print_read_values(int sg_fd, const struct scsi_buffer_parameter *const *sbps,
+                              int count);
 
 /* two byte to a integer*/
 extern int two_byte_to_int(unsigned char *buf);
@@ -61,6 +190,10 @@ extern unsigned int four_byte_to_uint(unsigned char *buf);
 /* copy data from buffer to a string */
 extern char *buf_to_string(unsigned char *buf, int len);
 
-extern void read_buffer_string(int sg_fd, struct scsi_buffer_parameter *sbp,
+extern void read_buffer_string(int sg_fd, const struct scsi_buffer_parameter *sbp,
                                char *buf, int max_length);
+
+extern void planned_buffer_string(int sg_fd, struct scsi_buffer_plan *plan,
+                                  const struct scsi_buffer_parameter *sbp,
+                                  char *buf, int max_length);
 #endif
@@ -12,6 +12,14 @@
 #include "ses.h"
 #include "json.h"
 
+const char *const sensor_fields[] = {"type", "unit", "value", NULL};
+
+const char *const sensor_threshold_fields[] = {
+  "OT critical", "OT warning", "UT warning", "UT critical",
+  "OV critical", "OV warning", "UV warning", "UV critical",
+  "OC critical", "OC warning", NULL
+};
+
 void print_temperature_sensor_threshold(struct temperature_sensor *sensor)
 {
   IF_PRINT_NONE_JSON
@@ -20,11 +28,10 @@ void print_temperature_sensor_threshold(struct temperature_sensor *sensor)
            sensor->ot_warning_threshold,
            sensor->ut_warning_threshold,
            sensor->ut_critical_threshold);
-  PRINT_JSON_MORE_ITEM;
   PRINT_JSON_ITEM("OT critical", "%d", sensor->ot_critical_threshold);
   PRINT_JSON_ITEM("OT warning", "%d", sensor->ot_warning_threshold);
   PRINT_JSON_ITEM("UT warning", "%d", sensor->ut_warning_threshold);
-  PRINT_JSON_LAST_ITEM("UT critical", "%d", sensor->ut_critical_threshold);
+  PRINT_JSON_ITEM("UT critical", "%d", sensor->ut_critical_threshold);
 }
 
 void print_volatage_sensor_threshold(struct voltage_sensor *sensor)
@@ -35,11 +42,10 @@ void print_volatage_sensor_threshold(struct voltage_sensor *sensor)
            sensor->ov_warning_threshold * 100,
            sensor->uv_warning_threshold * 100,
            sensor->uv_critical_threshold * 100);
-  PRINT_JSON_MORE_ITEM;
   PRINT_JSON_ITEM("OV critical", "%.2f", sensor->ov_critical_threshold);
   PRINT_JSON_ITEM("OV warning", "%.2f", sensor->ov_warning_threshold);
   PRINT_JSON_ITEM("UV warning", "%.2f", sensor->uv_warning_threshold);
-  PRINT_JSON_LAST_ITEM("UV critical", "%.2f", sensor->uv_critical_threshold);
+  PRINT_JSON_ITEM("UV critical", "%.2f", sensor->uv_critical_threshold);
 }
 
 void print_current_sensor_threshold(struct current_sensor *sensor)
@@ -48,9 +54,8 @@ void print_current_sensor_threshold(struct current_sensor *sensor)
     printf("\t\tThresholds:\t%.2f %%, %.2f %%",
            sensor->oc_critical_threshold * 100,
            sensor->oc_warning_threshold * 100);
-  PRINT_JSON_MORE_ITEM;
   PRINT_JSON_ITEM("OC critical", "%.2f %%", sensor->oc_critical_threshold);
-  PRINT_JSON_LAST_ITEM("OC warning", "%.2f %%", sensor->oc_warning_threshold);
+  PRINT_JSON_ITEM("OC warning", "%.2f %%", sensor->oc_warning_threshold);
 }
 
 void print_temperature_sensor(struct temperature_sensor *sensor,
@@ -63,7 +68,7 @@ void print_temperature_sensor(struct temperature_sensor *sensor,
   PRINT_JSON_GROUP_HEADER(sensor->name);
   PRINT_JSON_ITEM("type", "%s", "temperature");
   PRINT_JSON_ITEM("unit", "%s", "Celcius");
-  PRINT_JSON_LAST_ITEM("value", "%d", sensor->temperature);
+  PRINT_JSON_ITEM("value", "%d", sensor->temperature);
 
   if (print_thresholds) {
     print_temperature_sensor_threshold(sensor);
@@ -83,7 +88,7 @@ void print_volatage_sensor(struct voltage_sensor *sensor,
   PRINT_JSON_GROUP_HEADER(sensor->name);
   PRINT_JSON_ITEM("type", "%s", "voltage");
   PRINT_JSON_ITEM("unit", "%s", "Volt");
-  PRINT_JSON_LAST_ITEM("value", "%.2f", sensor->voltage);
+  PRINT_JSON_ITEM("value", "%.2f", sensor->voltage);
 
   if (print_thresholds) {
     print_volatage_sensor_threshold(sensor);
@@ -102,7 +107,7 @@ void print_current_sensor(struct current_sensor *sensor,
   PRINT_JSON_GROUP_HEADER(sensor->name);
   PRINT_JSON_ITEM("type", "%s", "current");
   PRINT_JSON_ITEM("unit", "%s", "Amphere");
-  PRINT_JSON_LAST_ITEM("value", "%.2f", sensor->current);
+  PRINT_JSON_ITEM("value", "%.2f", sensor->current);
 
   if (print_thresholds) {
     print_current_sensor_threshold(sensor);
@@ -64,6 +64,10 @@ struct current_sensor {
   char *name;
 };
 
+/* JSON items of a sensor, for --fields; thresholds are read separately */
+extern const char *const sensor_fields[];
+extern const char *const sensor_threshold_fields[];
+
 extern void print_temperature_sensor(struct temperature_sensor *sensor,
                                      int print_thresholds);
 extern void print_volatage_sensor(struct voltage_sensor *sensor,
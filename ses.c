@@ -9,6 +9,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,6 +22,20 @@
 #include "sensors.h"
 #include "expander.h"
 #include "array_device_slot.h"
+#include "scsi_buffer.h"
+
+/* SES pages of an enclosure, kept between commands of a batch */
+struct ses_snapshot {
+  dev_t rdev;                       /* of the sg device */
+  int what;                         /* SES_FETCH_THRESHOLDS if page 0x05 */
+  int page_two_size;
+  struct ses_pages *pages;
+};
+
+static int keep_snapshots = 0;
+static struct ses_snapshot snapshots[MAX_JBOD_PER_HOST];
+static int snapshot_count = 0;
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
 
 
 static int check_page_zero(unsigned char *page_zero)
@@ -87,6 +102,8 @@ int sg_read_ses_page(int sg_fd, int page_code, unsigned char *buf,
 
 int sg_send_ses_page(int sg_fd, unsigned char *buf, int size)
 {
+  ses_drop_snapshots();
+  scsi_buffer_drop_reads();
   return sg_ll_send_diag(sg_fd, 0 /* sf_code */, 1, 0 /* sf_bit */,
                          0 /* devofl_bit */, 0 /* unitofl_bit */,
                          0 /* long_duration */, buf, size,
@@ -123,8 +140,117 @@ int extract_element_list(
   return 0;
 }
 
-int read_ses_pages(int sg_fd, struct ses_pages *pages,
-                    int *page_two_size)
+void ses_keep_snapshots(int keep)
+{
+  keep_snapshots = keep;
+  if (!keep)
+    ses_drop_snapshots();
+}
+
+int ses_keeping_snapshots(void)
+{
+  return keep_snapshots;
+}
+
+void ses_drop_snapshots(void)
+{
+  int i;
+
+  pthread_mutex_lock(&snapshot_lock);
+  for (i = 0; i < snapshot_count; ++i)
+    free(snapshots[i].pages);
+  snapshot_count = 0;
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+/* the snapshot of the enclosure of sg_fd, or NULL; with the lock held */
+static struct ses_snapshot *find_snapshot(dev_t rdev)
+{
+  int i;
+
+  for (i = 0; i < snapshot_count; ++i) {
+    if (snapshots[i].rdev == rdev)
+      return snapshots + i;
+  }
+  return NULL;
+}
+
+static int load_snapshot(dev_t rdev, struct ses_pages *pages,
+                         int *page_two_size, int what)
+{
+  struct ses_snapshot *snapshot;
+  int rc = -1;
+
+  pthread_mutex_lock(&snapshot_lock);
+  snapshot = find_snapshot(rdev);
+  if (snapshot != NULL &&
+      (snapshot->what & what & SES_FETCH_THRESHOLDS) ==
+      (what & SES_FETCH_THRESHOLDS)) {
+    memcpy(pages, snapshot->pages, sizeof(*pages));
+    if (page_two_size)
+      *page_two_size = snapshot->page_two_size;
+    rc = 0;
+  }
+  pthread_mutex_unlock(&snapshot_lock);
+  return rc;
+}
+
+static void save_snapshot(dev_t rdev, const struct ses_pages *pages,
+                          int page_two_size, int what)
+{
+  struct ses_snapshot *snapshot;
+
+  pthread_mutex_lock(&snapshot_lock);
+  snapshot = find_snapshot(rdev);
+  if (snapshot == NULL && snapshot_count < MAX_JBOD_PER_HOST) {
+    snapshot = snapshots + snapshot_count;
+    snapshot->pages = (struct ses_pages *) malloc(sizeof(*pages));
+    if (snapshot->pages != NULL)
+      ++snapshot_count;
+    else
+      snapshot = NULL;
+  }
+  if (snapshot != NULL) {
+    snapshot->rdev = rdev;
+    snapshot->what = what;
+    snapshot->page_two_size = page_two_size;
+    memcpy(snapshot->pages, pages, sizeof(*pages));
+  }
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+static void forget_snapshot(dev_t rdev)
+{
+  struct ses_snapshot *snapshot;
+
+  pthread_mutex_lock(&snapshot_lock);
+  snapshot = find_snapshot(rdev);
+  if (snapshot != NULL) {
+    free(snapshot->pages);
+    *snapshot = snapshots[--snapshot_count];
+  }
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void ses_foreach_snapshot(ses_snapshot_fn fn, void *arg)
+{
+  int i;
+
+  pthread_mutex_lock(&snapshot_lock);
+  for (i = 0; i < snapshot_count; ++i)
+    fn(snapshots[i].rdev, snapshots[i].pages, snapshots[i].page_two_size,
+       snapshots[i].what, arg);
+  pthread_mutex_unlock(&snapshot_lock);
+}
+
+void ses_keep_snapshot(dev_t rdev, const struct ses_pages *pages,
+                       int page_two_size, int what)
+{
+  save_snapshot(rdev, pages, page_two_size, what);
+}
+
+static int read_ses_pages_from_device(int sg_fd, struct ses_pages *pages,
+                                      int *page_two_size, int what)
 {
   int size = 0;
   int rc = 0;
@@ -147,9 +273,15 @@ int read_ses_pages(int sg_fd, struct ses_pages *pages,
   if (page_two_size)
     *page_two_size = size;
 
-  rc = sg_read_ses_page(sg_fd, 0x5, pages->page_five, MAX_SES_PAGE_SIZE, &size);
-  if (0 != rc) {
-    return rc;
+  /* thresholds only; the element offsets of page 0x05 follow page 0x01 */
+  if (what & SES_FETCH_THRESHOLDS) {
+    rc = sg_read_ses_page(sg_fd, 0x5, pages->page_five, MAX_SES_PAGE_SIZE,
+                          &size);
+    if (0 != rc) {
+      return rc;
+    }
+  } else {
+    memset(pages->page_five, 0, MAX_SES_PAGE_SIZE);
   }
 
   rc =
@@ -166,9 +298,50 @@ int read_ses_pages(int sg_fd, struct ses_pages *pages,
   return rc;
 }
 
+int read_ses_pages(int sg_fd, struct ses_pages *pages,
+                    int *page_two_size)
+{
+  return read_ses_pages_of(sg_fd, pages, page_two_size,
+                           SES_FETCH_ALL | SES_FETCH_FRESH);
+}
+
+int read_ses_pages_of(int sg_fd, struct ses_pages *pages,
+                      int *page_two_size, int what)
+{
+  struct stat dev_stat;
+  int keep = keep_snapshots && fstat(sg_fd, &dev_stat) == 0;
+  int two_size = 0;
+  int rc;
+
+  /* a fresh read still replaces the snapshot, for the next commands */
+  if (keep && !(what & SES_FETCH_FRESH) &&
+      load_snapshot(dev_stat.st_rdev, pages, page_two_size, what) == 0)
+    return 0;
+  rc = read_ses_pages_from_device(sg_fd, pages, &two_size, what);
+  if (rc != 0) {
+    /* nor is an enclosure that stopped answering answered from the past */
+    if (keep)
+      forget_snapshot(dev_stat.st_rdev);
+    return rc;
+  }
+  if (page_two_size)
+    *page_two_size = two_size;
+  if (keep)
+    save_snapshot(dev_stat.st_rdev, pages, two_size, what);
+  return 0;
+}
+
 int interpret_ses_pages(
   struct ses_pages *pages,
   struct ses_status_info *ses_info)
+{
+  return interpret_ses_pages_of(pages, ses_info, SES_FETCH_ALL);
+}
+
+int interpret_ses_pages_of(
+  struct ses_pages *pages,
+  struct ses_status_info *ses_info,
+  int what)
 {
   int page_two_index = 8;
   int page_five_index = 8;
@@ -277,10 +450,12 @@ int interpret_ses_pages(
     }
   }
 
-  if (stat(DEV_DISK_BY_SLOT, &file_stat) != 0)
-    mkdir(DEV_DISK_BY_SLOT, 0755);
-  for (i = 0; i < ses_info->slot_count; i ++)
-    find_dev_name(ses_info->slots + i, ses_info->expander.sas_addr_str);
+  if (what & SES_FETCH_DEV_NAMES) {
+    if (stat(DEV_DISK_BY_SLOT, &file_stat) != 0)
+      mkdir(DEV_DISK_BY_SLOT, 0755);
+    for (i = 0; i < ses_info->slot_count; i ++)
+      find_dev_name(ses_info->slots + i, ses_info->expander.sas_addr_str);
+  }
 
 #ifdef DEBUG
   for (i = 0; i < ses_info->slot_count; i ++)
@@ -10,6 +10,8 @@
 #ifndef SES_H
 #define SES_H
 
+#include <sys/types.h>
+
 #include "common.h"
 #include "array_device_slot.h"
 #include "enclosure_info.h"
@@ -104,13 +106,48 @@ struct ses_status_info {
   struct enclosure_control enclosure_control;
 };
 
+/* optional parts of a SES snapshot, for the *_of() variants */
+#define SES_FETCH_THRESHOLDS  0x1   /* page 0x05 */
+#define SES_FETCH_DEV_NAMES   0x2   /* sysfs lookup of the disk in each slot */
+#define SES_FETCH_ALL         (SES_FETCH_THRESHOLDS | SES_FETCH_DEV_NAMES)
+#define SES_FETCH_FRESH       0x4   /* never from a kept snapshot */
+
 extern int interpret_ses_pages(
   struct ses_pages *pages,
   struct ses_status_info *ses_info);
 
+extern int interpret_ses_pages_of(
+  struct ses_pages *pages,
+  struct ses_status_info *ses_info,
+  int what);
+
 extern int read_ses_pages(int sg_fd, struct ses_pages *pages,
                            int *page_two_size);
 
+extern int read_ses_pages_of(int sg_fd, struct ses_pages *pages,
+                             int *page_two_size, int what);
+
+/*
+ * with keep set, read_ses_pages_of() reuses the pages it read from an
+ * enclosure until any SES page or buffer is written, for commands run one
+ * after another by batch. read_ses_pages() and SES_FETCH_FRESH always read,
+ * and replace the snapshot with what they read.
+ */
+extern void ses_keep_snapshots(int keep);
+extern int ses_keeping_snapshots(void);
+extern void ses_drop_snapshots(void);
+
+typedef void (*ses_snapshot_fn)(dev_t rdev, const struct ses_pages *pages,
+                                int page_two_size, int what, void *arg);
+
+/*
+ * call fn with every kept snapshot, locked meanwhile, and keep one made by
+ * another process; for ocpjbodd, whose poller reads the enclosures
+ */
+extern void ses_foreach_snapshot(ses_snapshot_fn fn, void *arg);
+extern void ses_keep_snapshot(dev_t rdev, const struct ses_pages *pages,
+                              int page_two_size, int what);
+
 /* read ses page; return errno and provide number of bytes read in count */
 extern int sg_read_ses_page(int sg_fd, int page_code, unsigned char *buf,
                             int buf_size, int *count);
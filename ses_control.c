@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <scsi/sg_lib.h>
+#include <scsi/sg_cmds.h>
+
+#include "ses_control.h"
+
+/* page 0x02 header: page code, flags, length, generation code */
+#define SES_PAGE_HEADER_SIZE 8
+
+static unsigned int page_generation(unsigned char *page)
+{
+  return ((unsigned int) page[4] << 24) | (page[5] << 16) |
+         (page[6] << 8) | page[7];
+}
+
+static int page_length(unsigned char *page)
+{
+  return (page[2] << 8) + page[3] + 4;
+}
+
+int ses_txn_begin(int sg_fd, struct ses_txn *txn)
+{
+  int rc;
+
+  memset(txn, 0, sizeof(*txn));
+  txn->sg_fd = sg_fd;
+
+  rc = read_ses_pages(sg_fd, &txn->pages, NULL);
+  if (0 != rc) {
+    perr("Couldn't read ses pages: %d\n", rc);
+    return rc;
+  }
+  interpret_ses_pages(&txn->pages, &txn->status);
+  txn->generation = page_generation(txn->pages.page_one);
+  return 0;
+}
+
+int ses_txn_element(
+  struct ses_txn *txn,
+  int page_two_offset,
+  const unsigned char and_mask[SES_ELEMENT_SIZE],
+  const unsigned char or_mask[SES_ELEMENT_SIZE])
+{
+  struct ses_txn_edit *edit;
+
+  if (txn->edit_count >= SES_TXN_MAX_EDITS) {
+    perr("Too many changes in one transaction\n");
+    return E2BIG;
+  }
+  if (page_two_offset < SES_PAGE_HEADER_SIZE ||
+      page_two_offset + SES_ELEMENT_SIZE > MAX_SES_PAGE_SIZE)
+    return EINVAL;
+
+  edit = txn->edits + txn->edit_count++;
+  edit->page_two_offset = page_two_offset;
+  memcpy(edit->and_mask, and_mask, SES_ELEMENT_SIZE);
+  memcpy(edit->or_mask, or_mask, SES_ELEMENT_SIZE);
+  /* byte 0 of every changed element has SELECT */
+  edit->or_mask[0] |= 0x80;
+  return 0;
+}
+
+/*
+ * build the control page from the latest status page: only edited
+ * elements are selected; an element edited twice keeps both changes.
+ */
+static void build_control_page(struct ses_txn *txn, unsigned char *status,
+                               unsigned char *control, int size)
+{
+  struct ses_txn_edit *edit;
+  unsigned char *base;
+  int i, j;
+
+  memset(control, 0, size);
+  memcpy(control, status, SES_PAGE_HEADER_SIZE);
+  /* don't re-request the indications reported in the status header */
+  control[1] = 0;
+
+  for (i = 0; i < txn->edit_count; ++i) {
+    edit = txn->edits + i;
+    if (edit->page_two_offset + SES_ELEMENT_SIZE > size)
+      continue;
+    base = (control[edit->page_two_offset] & 0x80) ? control : status;
+    for (j = 0; j < SES_ELEMENT_SIZE; ++j) {
+      control[edit->page_two_offset + j] =
+        (base[edit->page_two_offset + j] & edit->and_mask[j]) |
+        edit->or_mask[j];
+    }
+  }
+}
+
+int ses_txn_commit(struct ses_txn *txn)
+{
+  unsigned char status[MAX_SES_PAGE_SIZE];
+  unsigned char control[MAX_SES_PAGE_SIZE];
+  unsigned char page_one[MAX_SES_PAGE_SIZE];
+  int size;
+  int attempt;
+  int rc;
+
+  if (txn->edit_count == 0)
+    return 0;
+
+  for (attempt = 0; attempt <= SES_TXN_MAX_RETRY; ++attempt) {
+    rc = sg_read_ses_page(txn->sg_fd, 0x2, status, MAX_SES_PAGE_SIZE, &size);
+    if (0 != rc)
+      return rc;
+
+    if (page_generation(status) != txn->generation) {
+      /* configuration changed; edits are only valid for the same layout */
+      rc = sg_read_ses_page(txn->sg_fd, 0x1, page_one, MAX_SES_PAGE_SIZE,
+                            &size);
+      if (0 != rc)
+        return rc;
+      if (page_length(page_one) != page_length(txn->pages.page_one) ||
+          memcmp(page_one + SES_PAGE_HEADER_SIZE,
+                 txn->pages.page_one + SES_PAGE_HEADER_SIZE,
+                 page_length(page_one) - SES_PAGE_HEADER_SIZE) != 0) {
+        perr("Enclosure configuration changed, generation %u -> %u\n",
+             txn->generation, page_generation(page_one));
+        return ESTALE;
+      }
+      txn->generation = page_generation(page_one);
+      continue;
+    }
+
+    size = page_length(status);
+    build_control_page(txn, status, control, size);
+    rc = sg_send_ses_page(txn->sg_fd, control, size);
+    if (rc != SG_LIB_CAT_ILLEGAL_REQ)
+      return rc;
+    /* most likely a generation code mismatch, rebuild from fresh status */
+#ifdef DEBUG
+    perr("Page 0x02 refused, retrying (%d)\n", attempt + 1);
+#endif
+  }
+
+  perr("Page 0x02 control conflicts persist after %d retries\n",
+       SES_TXN_MAX_RETRY);
+  return EAGAIN;
+}
@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef SES_CONTROL_H
+#define SES_CONTROL_H
+
+#include "ses.h"
+
+/* element changes that can be accumulated in one transaction */
+#define SES_TXN_MAX_EDITS 256
+
+/* times to rebuild and resend page 0x02 after a generation code conflict */
+#define SES_TXN_MAX_RETRY 3
+
+#define SES_ELEMENT_SIZE 4
+
+/*
+ * change of one control element in page 0x02:
+ * control[i] = (latest status[i] & and_mask[i]) | or_mask[i]
+ */
+struct ses_txn_edit {
+  int page_two_offset;
+  unsigned char and_mask[SES_ELEMENT_SIZE];
+  unsigned char or_mask[SES_ELEMENT_SIZE];
+};
+
+/*
+ * a control transaction on SES page 0x02. Changes are accumulated by
+ * offset and sent with a single sg_send_ses_page() on commit. Only the
+ * changed elements are selected, so elements changed meanwhile by another
+ * process are left alone.
+ */
+struct ses_txn {
+  int sg_fd;
+  struct ses_pages pages;               /* as read by ses_txn_begin() */
+  struct ses_status_info status;        /* interpreted from pages */
+  unsigned int generation;              /* expected generation code */
+  struct ses_txn_edit edits[SES_TXN_MAX_EDITS];
+  int edit_count;
+};
+
+/* read and interpret all SES pages, and start an empty transaction */
+extern int ses_txn_begin(int sg_fd, struct ses_txn *txn);
+
+/* queue a change of the element at page_two_offset */
+extern int ses_txn_element(
+  struct ses_txn *txn,
+  int page_two_offset,
+  const unsigned char and_mask[SES_ELEMENT_SIZE],
+  const unsigned char or_mask[SES_ELEMENT_SIZE]);
+
+/*
+ * send all queued changes in one page 0x02 write. The changes are applied
+ * on a freshly read status page with the current generation code. If the
+ * enclosure rejects the page because its configuration changed in between,
+ * the page is rebuilt and resent, up to SES_TXN_MAX_RETRY times.
+ *
+ * return 0 on success, ESTALE if the element layout changed (page 0x01
+ * differs), EAGAIN if conflicts persist, or the sg error code.
+ */
+extern int ses_txn_commit(struct ses_txn *txn);
+
+#endif
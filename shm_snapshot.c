@@ -0,0 +1,405 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jbod_interface.h"
+#include "json.h"
+#include "shm_snapshot.h"
+
+static size_t snapshot_size(void)
+{
+  return sizeof(struct shm_header) +
+    SHM_MAX_ENCLOSURES * sizeof(struct shm_enclosure);
+}
+
+static struct shm_snapshot *map_snapshot(int fd, int prot)
+{
+  struct shm_snapshot *snapshot;
+  void *base;
+
+  base = mmap(NULL, snapshot_size(), prot, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED)
+    return NULL;
+  snapshot = (struct shm_snapshot *) malloc(sizeof(struct shm_snapshot));
+  if (snapshot == NULL) {
+    munmap(base, snapshot_size());
+    return NULL;
+  }
+  snapshot->fd = fd;
+  snapshot->size = snapshot_size();
+  snapshot->header = (struct shm_header *) base;
+  snapshot->enclosures = (struct shm_enclosure *)
+    ((char *) base + sizeof(struct shm_header));
+  return snapshot;
+}
+
+struct shm_snapshot *shm_snapshot_create(const char *path, int interval_ms)
+{
+  struct shm_snapshot *snapshot;
+  char tmp[PATH_MAX];
+  int fd;
+
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  unlink(tmp);
+  /* only the daemon writes; the snapshot holds nothing secret */
+  fd = open(tmp, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    perr("Cannot create %s: %s\n", tmp, strerror(errno));
+    return NULL;
+  }
+  /* sparse; enclosures take memory once they are published */
+  if (ftruncate(fd, snapshot_size()) != 0 ||
+      (snapshot = map_snapshot(fd, PROT_READ | PROT_WRITE)) == NULL) {
+    perr("Cannot map %s: %s\n", tmp, strerror(errno));
+    close(fd);
+    unlink(tmp);
+    return NULL;
+  }
+
+  snapshot->header->version = SHM_SNAPSHOT_VERSION;
+  snapshot->header->header_size = sizeof(struct shm_header);
+  snapshot->header->enclosure_size = sizeof(struct shm_enclosure);
+  snapshot->header->max_enclosures = SHM_MAX_ENCLOSURES;
+  snapshot->header->enclosure_count = 0;
+  snapshot->header->interval_ms = interval_ms;
+  __atomic_store_n(&snapshot->header->magic, SHM_SNAPSHOT_MAGIC,
+                   __ATOMIC_RELEASE);
+
+  if (rename(tmp, path) != 0) {
+    perr("Cannot rename %s to %s: %s\n", tmp, path, strerror(errno));
+    shm_snapshot_close(snapshot);
+    unlink(tmp);
+    return NULL;
+  }
+  return snapshot;
+}
+
+struct shm_snapshot *shm_snapshot_open(const char *path)
+{
+  struct shm_snapshot *snapshot;
+  struct shm_header *header;
+  struct stat st;
+  int fd;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &st) != 0 || st.st_size < snapshot_size() ||
+      (snapshot = map_snapshot(fd, PROT_READ)) == NULL) {
+    close(fd);
+    return NULL;
+  }
+  header = snapshot->header;
+  if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) !=
+      SHM_SNAPSHOT_MAGIC ||
+      header->version != SHM_SNAPSHOT_VERSION ||
+      header->header_size != sizeof(struct shm_header) ||
+      header->enclosure_size != sizeof(struct shm_enclosure) ||
+      header->max_enclosures != SHM_MAX_ENCLOSURES) {
+    shm_snapshot_close(snapshot);
+    return NULL;
+  }
+  return snapshot;
+}
+
+void shm_snapshot_close(struct shm_snapshot *snapshot)
+{
+  munmap(snapshot->header, snapshot->size);
+  close(snapshot->fd);
+  free(snapshot);
+}
+
+/* replace an enclosure; readers retry while seq is odd */
+static void write_enclosure(struct shm_enclosure *dst,
+                            const struct shm_enclosure *src)
+{
+  const size_t offset = offsetof(struct shm_enclosure, rc);
+  uint32_t seq = dst->seq;          /* there is one writer */
+
+  __atomic_store_n(&dst->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy((char *) dst + offset, (const char *) src + offset,
+         sizeof(struct shm_enclosure) - offset);
+  __atomic_store_n(&dst->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* copy len bytes at offset of an enclosure that is not being written */
+static int read_enclosure(const struct shm_enclosure *src, size_t offset,
+                          void *dst, size_t len)
+{
+  uint32_t begin, end;
+  int i;
+
+  for (i = 0; i < SHM_READ_RETRIES; ++i) {
+    begin = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+    if (begin & 1)
+      continue;
+    memcpy(dst, (const char *) src + offset, len);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    end = __atomic_load_n(&src->seq, __ATOMIC_RELAXED);
+    if (begin == end)
+      return 0;
+  }
+  return EAGAIN;
+}
+
+/* "/dev/sg1" and "sg1" name the same device */
+static int same_device(const char *a, const char *b)
+{
+  const char *slash;
+
+  if ((slash = strrchr(a, '/')) != NULL)
+    a = slash + 1;
+  if ((slash = strrchr(b, '/')) != NULL)
+    b = slash + 1;
+  return strcmp(a, b) == 0;
+}
+
+int shm_snapshot_read(struct shm_snapshot *snapshot, const char *devname,
+                      int index, struct shm_enclosure *out)
+{
+  char name[SHM_NAME_LENGTH];
+  int count;
+  int i, rc;
+
+  count = __atomic_load_n(&snapshot->header->enclosure_count,
+                          __ATOMIC_ACQUIRE);
+  if (count > SHM_MAX_ENCLOSURES)
+    count = SHM_MAX_ENCLOSURES;
+
+  if (devname == NULL) {
+    if (index < 0 || index >= count)
+      return ENOENT;
+    return read_enclosure(snapshot->enclosures + index, 0, out,
+                          sizeof(struct shm_enclosure));
+  }
+
+  for (i = 0; i < count; ++i) {
+    /* the name first, so only one enclosure is copied */
+    rc = read_enclosure(snapshot->enclosures + i,
+                        offsetof(struct shm_enclosure, devname),
+                        name, sizeof(name));
+    if (rc != 0)
+      return rc;
+    name[sizeof(name) - 1] = '\0';
+    if (!same_device(name, devname))
+      continue;
+    rc = read_enclosure(snapshot->enclosures + i, 0, out,
+                        sizeof(struct shm_enclosure));
+    if (rc != 0)
+      return rc;
+    out->devname[sizeof(out->devname) - 1] = '\0';
+    if (same_device(out->devname, devname))
+      return 0;
+  }
+  return ENOENT;
+}
+
+/* counts of a file written by another process are not trusted */
+static int clamp_count(int count)
+{
+  if (count < 0)
+    return 0;
+  return count < SHM_MAX_ELEMENTS ? count : SHM_MAX_ELEMENTS;
+}
+
+void shm_snapshot_publish(struct shm_snapshot *snapshot, int index,
+                          const struct shm_enclosure *e)
+{
+  if (index >= 0 && index < SHM_MAX_ENCLOSURES)
+    write_enclosure(snapshot->enclosures + index, e);
+}
+
+void shm_snapshot_set_count(struct shm_snapshot *snapshot, int count)
+{
+  if (count > SHM_MAX_ENCLOSURES)
+    count = SHM_MAX_ENCLOSURES;
+  __atomic_store_n(&snapshot->header->enclosure_count, count,
+                   __ATOMIC_RELEASE);
+}
+
+/* a ses_status_info for the printers, naming into e */
+static void to_ses_status(struct shm_enclosure *e,
+                          struct ses_status_info *ses)
+{
+  int i;
+
+  memset(ses, 0, sizeof(*ses));
+  ses->slot_count = clamp_count(e->slot_count);
+  for (i = 0; i < ses->slot_count; ++i) {
+    struct shm_slot *s = e->slots + i;
+    struct array_device_slot *slot = ses->slots + i;
+
+    s->name[sizeof(s->name) - 1] = '\0';
+    s->sas_addr[sizeof(s->sas_addr) - 1] = '\0';
+    s->dev_name[sizeof(s->dev_name) - 1] = '\0';
+    s->by_slot_name[sizeof(s->by_slot_name) - 1] = '\0';
+    slot->common_status = s->common_status;
+    slot->slot = s->slot;
+    slot->phy = s->phy;
+    slot->fault = s->fault & 0x3;
+    slot->ident = s->ident;
+    slot->device_off = s->device_off;
+    memcpy(slot->sas_addr_str, s->sas_addr, sizeof(slot->sas_addr_str));
+    slot->name = s->name;
+    slot->dev_name = s->dev_name[0] ? s->dev_name : NULL;
+    slot->by_slot_name = s->by_slot_name;
+  }
+
+  ses->temp_count = clamp_count(e->temp_count);
+  for (i = 0; i < ses->temp_count; ++i) {
+    struct shm_sensor *s = e->temp_sensors + i;
+    struct temperature_sensor *t = ses->temp_sensors + i;
+
+    s->name[sizeof(s->name) - 1] = '\0';
+    t->name = s->name;
+    t->common_status = s->common_status;
+    t->temperature = s->value;
+    t->ot_critical_threshold = s->thresholds[0];
+    t->ot_warning_threshold = s->thresholds[1];
+    t->ut_warning_threshold = s->thresholds[2];
+    t->ut_critical_threshold = s->thresholds[3];
+  }
+
+  ses->vol_count = clamp_count(e->vol_count);
+  for (i = 0; i < ses->vol_count; ++i) {
+    struct shm_sensor *s = e->vol_sensors + i;
+    struct voltage_sensor *v = ses->vol_sensors + i;
+
+    s->name[sizeof(s->name) - 1] = '\0';
+    v->name = s->name;
+    v->common_status = s->common_status;
+    v->voltage = s->value;
+    v->ov_critical_threshold = s->thresholds[0];
+    v->ov_warning_threshold = s->thresholds[1];
+    v->uv_warning_threshold = s->thresholds[2];
+    v->uv_critical_threshold = s->thresholds[3];
+  }
+
+  ses->curr_count = clamp_count(e->curr_count);
+  for (i = 0; i < ses->curr_count; ++i) {
+    struct shm_sensor *s = e->curr_sensors + i;
+    struct current_sensor *c = ses->curr_sensors + i;
+
+    s->name[sizeof(s->name) - 1] = '\0';
+    c->name = s->name;
+    c->common_status = s->common_status;
+    c->current = s->value;
+    c->oc_critical_threshold = s->thresholds[0];
+    c->oc_warning_threshold = s->thresholds[1];
+    c->uc_warning_threshold = s->thresholds[2];
+    c->uc_critical_threshold = s->thresholds[3];
+  }
+
+  ses->fan_count = clamp_count(e->fan_count);
+  for (i = 0; i < ses->fan_count; ++i) {
+    e->fans[i].name[sizeof(e->fans[i].name) - 1] = '\0';
+    ses->fans[i].name = e->fans[i].name;
+    ses->fans[i].common_status = e->fans[i].common_status;
+    ses->fans[i].rpm = e->fans[i].rpm;
+  }
+}
+
+static int print_enclosure(struct shm_enclosure *e, int what,
+                           int print_thresholds)
+{
+  struct ses_status_info *ses;
+  int i;
+
+  if (e->rc != 0) {
+    perr("%s was not read: %s\n", e->devname, strerror(e->rc));
+    return e->rc;
+  }
+  ses = (struct ses_status_info *) malloc(sizeof(struct ses_status_info));
+  if (ses == NULL)
+    return ENOMEM;
+  to_ses_status(e, ses);
+
+  if (what & SHM_PRINT_SENSORS) {
+    for (i = 0; i < ses->temp_count; i++)
+      print_temperature_sensor(ses->temp_sensors + i, print_thresholds);
+    for (i = 0; i < ses->vol_count; i++)
+      print_volatage_sensor(ses->vol_sensors + i, print_thresholds);
+    for (i = 0; i < ses->curr_count; i++)
+      print_current_sensor(ses->curr_sensors + i, print_thresholds);
+    e->power_name[sizeof(e->power_name) - 1] = '\0';
+    e->power_value[sizeof(e->power_value) - 1] = '\0';
+    if (e->power_name[0] && json_field_wanted(e->power_name)) {
+      IF_PRINT_NONE_JSON printf("%s\t%s\n", e->power_name, e->power_value);
+      PRINT_JSON_ITEM(e->power_name, "%s", e->power_value);
+    }
+  }
+  if (what & SHM_PRINT_SLOTS) {
+    for (i = 0; i < ses->slot_count; i++)
+      print_array_device_slot(ses->slots + i);
+  }
+  if (what & SHM_PRINT_FANS) {
+    for (i = 0; i < ses->fan_count; i++)
+      print_cooling_fan(ses->fans + i);
+  }
+  free(ses);
+  return 0;
+}
+
+int shm_snapshot_print(const char *path, const char *devname, int what,
+                       int print_thresholds)
+{
+  struct shm_snapshot *snapshot;
+  struct shm_enclosure *e;
+  int i, rc;
+
+  snapshot = shm_snapshot_open(path);
+  if (snapshot == NULL) {
+    perr("No snapshot in %s; is %sd running?\n", path, NAME);
+    return ENOENT;
+  }
+  e = (struct shm_enclosure *) malloc(sizeof(struct shm_enclosure));
+  if (e == NULL) {
+    shm_snapshot_close(snapshot);
+    return ENOMEM;
+  }
+
+  if (devname) {
+    rc = shm_snapshot_read(snapshot, devname, -1, e);
+    if (rc == ENOENT)
+      perr("%s is not in %s\n", devname, path);
+    else if (rc != 0)
+      perr("%s: %s\n", devname, strerror(rc));
+    else
+      rc = print_enclosure(e, what, print_thresholds);
+  } else {
+    rc = 0;
+    for (i = 0; (rc = shm_snapshot_read(snapshot, NULL, i, e)) != ENOENT;
+         ++i) {
+      if (rc != 0)
+        continue;
+      e->devname[sizeof(e->devname) - 1] = '\0';
+      IF_PRINT_NONE_JSON
+        printf(">>> %s \n", e->devname);
+      PRINT_JSON_GROUP_HEADER(e->devname);
+      print_enclosure(e, what, print_thresholds);
+      PRINT_JSON_GROUP_ENDING;
+    }
+    rc = 0;
+  }
+  free(e);
+  shm_snapshot_close(snapshot);
+  return rc;
+}
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef SHM_SNAPSHOT_H
+#define SHM_SNAPSHOT_H
+
+#include <stdint.h>
+
+#include "common.h"
+#include "libocpjbod.h"
+#include "ses.h"
+
+/* where ocpjbodd publishes the latest SES snapshot of every enclosure */
+#define SHM_SNAPSHOT_PATH "/run/" NAME "d.shm"
+
+#define SHM_SNAPSHOT_MAGIC   0x534a434fu     /* "OCJS" */
+#define SHM_SNAPSHOT_VERSION 1
+
+#define SHM_MAX_ENCLOSURES   MAX_JBOD_PER_HOST
+#define SHM_MAX_ELEMENTS     OCPJBOD_MAX_ELEMENTS
+#define SHM_NAME_LENGTH      OCPJBOD_NAME_LENGTH
+#define SHM_PATH_LENGTH      OCPJBOD_PATH_LENGTH
+
+/* the enclosures are laid out in libocpjbod.h, which is installed alone */
+#if SHM_MAX_ELEMENTS != MAX_COUNT_PER_ELEMENT || \
+    OCPJBOD_SAS_ADDR_LENGTH != SAS_ADDR_STR_LENGTH
+#error "the layout in libocpjbod.h does not match ses.h"
+#endif
+
+/* attempts of a reader while the publisher keeps updating an enclosure */
+#define SHM_READ_RETRIES     1000
+
+/*
+ * The file is a header followed by SHM_MAX_ENCLOSURES fixed size
+ * enclosures; every member has a fixed width, so readers in any language
+ * can map it. A new layout gets a new SHM_SNAPSHOT_VERSION.
+ *
+ * Each enclosure is guarded by a seqlock: the publisher makes seq odd,
+ * updates the enclosure and makes seq even again. A reader copies the
+ * enclosure and retries if seq was odd or changed meanwhile, so reads take
+ * no lock and no system call.
+ */
+struct shm_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t enclosure_size;
+  uint32_t max_enclosures;
+  uint32_t enclosure_count;       /* published by the last sweep */
+  uint32_t interval_ms;           /* between sweeps */
+  uint32_t reserved;
+};
+
+/* struct shm_enclosure and its members are in libocpjbod.h */
+
+struct shm_snapshot {
+  int fd;
+  size_t size;
+  struct shm_header *header;
+  struct shm_enclosure *enclosures;
+};
+
+/* what shm_snapshot_print() prints */
+#define SHM_PRINT_SENSORS 0x1
+#define SHM_PRINT_SLOTS   0x2
+#define SHM_PRINT_FANS    0x4
+
+/*
+ * create the file at path for the publisher; an older file is replaced
+ * only once the new one is complete. Return NULL on errors.
+ */
+extern struct shm_snapshot *shm_snapshot_create(const char *path,
+                                                int interval_ms);
+
+/* map the file at path read-only; return NULL if it is missing or foreign */
+extern struct shm_snapshot *shm_snapshot_open(const char *path);
+
+extern void shm_snapshot_close(struct shm_snapshot *snapshot);
+
+/*
+ * copy the enclosure devname, or enclosure index if devname is NULL, into
+ * out. Return 0, ENOENT if it is not published, or EAGAIN if the
+ * publisher kept updating it.
+ */
+extern int shm_snapshot_read(struct shm_snapshot *snapshot,
+                             const char *devname, int index,
+                             struct shm_enclosure *out);
+
+/*
+ * replace enclosure index with e, then make the first count enclosures
+ * visible to readers once a sweep is done; for the one publisher
+ */
+extern void shm_snapshot_publish(struct shm_snapshot *snapshot, int index,
+                                 const struct shm_enclosure *e);
+extern void shm_snapshot_set_count(struct shm_snapshot *snapshot, int count);
+
+/*
+ * print what of devname, or of all enclosures if devname is NULL, like the
+ * commands reading the enclosures do
+ */
+extern int shm_snapshot_print(const char *path, const char *devname,
+                              int what, int print_thresholds);
+
+#endif
@@ -0,0 +1,353 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <scsi/sg_lib.h>
+#include <scsi/sg_cmds.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "json.h"
+#include "ses.h"
+#include "slot_watch.h"
+#include "uevent.h"
+
+#define WATCH_NAME_LENGTH 64
+
+#define SLOT_CHANGE_STATUS  0x1
+#define SLOT_CHANGE_FAULT   0x2
+#define SLOT_CHANGE_IDENT   0x4
+#define SLOT_CHANGE_DEVNAME 0x8
+
+/* the part of array_device_slot that is watched */
+struct slot_state {
+  int status_code;        /* -1 before the first read */
+  int device_off;
+  int fault;
+  int ident;
+  int slot;
+  int page_two_offset;
+  SAS_ADDR_STR(sas_addr_str);
+  char name[WATCH_NAME_LENGTH];
+  char dev_name[WATCH_NAME_LENGTH];
+};
+
+struct enclosure_watch {
+  char *devname;
+  int sg_fd;
+  int valid;                            /* slots match page_two */
+  int page_two_size;
+  unsigned char page_two[MAX_SES_PAGE_SIZE];
+  struct slot_state slots[MAX_COUNT_PER_ELEMENT];
+  int slot_count;
+};
+
+static unsigned int page_two_generation(unsigned char *page_two)
+{
+  return ((unsigned int) page_two[4] << 24) | (page_two[5] << 16) |
+         (page_two[6] << 8) | page_two[7];
+}
+
+static const char *slot_state_str(struct slot_state *s)
+{
+  if (s->status_code == ELEMENT_STATUS_NOT_INSTALLED)
+    return "Not Installed";
+  else if (s->device_off)
+    return "Power Off";
+  else
+    return "Power On";
+}
+
+/* same bits as extract_array_device_slot_info() */
+static void decode_slot_element(unsigned char *element, struct slot_state *s)
+{
+  s->status_code = STATUS_CODE(element[0]);
+  s->fault = (element[3] & 0x60) >> 5;
+  s->ident = element[2] & 0x02 ? 1 : 0;
+  s->device_off = element[3] & 0x10 ? 1 : 0;
+}
+
+static void print_slot_transition(struct enclosure_watch *e, int id,
+                                  struct slot_state *s, int changes)
+{
+  json_record_begin();
+  json_item("time", "%ld", (long) time(NULL));
+  json_item("device", "%s", e->devname);
+  json_item("id", "%d", id);
+  json_item("slot", "%d", s->slot);
+  json_item("name", "%s", s->name);
+  json_array_begin("changed");
+  if (changes & SLOT_CHANGE_STATUS)
+    json_item(NULL, "%s", "status");
+  if (changes & SLOT_CHANGE_FAULT)
+    json_item(NULL, "%s", "fault");
+  if (changes & SLOT_CHANGE_IDENT)
+    json_item(NULL, "%s", "ident");
+  if (changes & SLOT_CHANGE_DEVNAME)
+    json_item(NULL, "%s", "devname");
+  json_array_end();
+  json_item("status", "%s", slot_state_str(s));
+  json_item("fault", "%s", fault_led_status_str(s->fault));
+  json_item("ident", "%s", s->ident ? "On" : "Off");
+  json_item("sas_addr", "0x%s", s->sas_addr_str);
+  json_item("devname", "%s", s->dev_name);
+  json_record_end();
+}
+
+/* store the new state of slot id; print it if changed; return whether so */
+static int update_slot(struct enclosure_watch *e, int id,
+                       struct slot_state *new_state)
+{
+  struct slot_state *old_state = e->slots + id;
+  int changes = 0;
+
+  if (old_state->status_code != new_state->status_code ||
+      old_state->device_off != new_state->device_off)
+    changes |= SLOT_CHANGE_STATUS;
+  if (old_state->fault != new_state->fault)
+    changes |= SLOT_CHANGE_FAULT;
+  if (old_state->ident != new_state->ident)
+    changes |= SLOT_CHANGE_IDENT;
+  if (strcmp(old_state->dev_name, new_state->dev_name) != 0)
+    changes |= SLOT_CHANGE_DEVNAME;
+
+  *old_state = *new_state;
+  if (changes)
+    print_slot_transition(e, id, old_state, changes);
+  return changes != 0;
+}
+
+/* read all pages, including sas addresses and OS device names */
+static int full_refresh(struct enclosure_watch *e)
+{
+  struct ses_pages *pages;
+  struct ses_status_info *ses_info;
+  struct array_device_slot *slot;
+  struct slot_state new_state;
+  int changed = 0;
+  int i;
+
+  pages = (struct ses_pages *) calloc(1, sizeof(struct ses_pages));
+  ses_info = (struct ses_status_info *)
+    calloc(1, sizeof(struct ses_status_info));
+  if (pages == NULL || ses_info == NULL)
+    goto done;
+
+  if (read_ses_pages(e->sg_fd, pages, &e->page_two_size) != 0) {
+    e->valid = 0;
+    goto done;
+  }
+  interpret_ses_pages(pages, ses_info);
+
+  for (i = 0; i < ses_info->slot_count; ++i) {
+    slot = ses_info->slots + i;
+    memset(&new_state, 0, sizeof(new_state));
+    decode_slot_element(pages->page_two + slot->page_two_offset, &new_state);
+    new_state.slot = slot->slot;
+    new_state.page_two_offset = slot->page_two_offset;
+    memcpy(new_state.sas_addr_str, slot->sas_addr_str,
+           sizeof(new_state.sas_addr_str));
+    snprintf(new_state.name, WATCH_NAME_LENGTH, "%s", slot->name);
+    if (slot->dev_name)
+      snprintf(new_state.dev_name, WATCH_NAME_LENGTH, "%s", slot->dev_name);
+    if (i >= e->slot_count) {
+      /* new slot, report every field */
+      e->slots[i].status_code = -1;
+      e->slots[i].fault = -1;
+      e->slots[i].ident = -1;
+    }
+    changed |= update_slot(e, i, &new_state);
+
+    free(slot->name);
+    free(slot->dev_name);
+    free(slot->by_slot_name);
+  }
+  e->slot_count = ses_info->slot_count;
+  memcpy(e->page_two, pages->page_two, e->page_two_size);
+  e->valid = 1;
+
+done:
+  free(pages);
+  free(ses_info);
+  return changed;
+}
+
+/*
+ * read page 0x02 only. An identical page costs nothing more; a new
+ * generation code, or a slot that was inserted, removed or powered,
+ * needs the other pages for sas address and device name.
+ */
+static int poll_enclosure(struct enclosure_watch *e)
+{
+  unsigned char page_two[MAX_SES_PAGE_SIZE];
+  struct slot_state new_states[MAX_COUNT_PER_ELEMENT];
+  struct slot_state *s;
+  int size;
+  int changed = 0;
+  int i;
+
+  if (!e->valid)
+    return full_refresh(e);
+
+  if (sg_read_ses_page(e->sg_fd, 0x2, page_two, MAX_SES_PAGE_SIZE,
+                       &size) != 0) {
+    e->valid = 0;
+    return 0;
+  }
+  if (size == e->page_two_size && memcmp(page_two, e->page_two, size) == 0)
+    return 0;
+  if (size != e->page_two_size ||
+      page_two_generation(page_two) != page_two_generation(e->page_two))
+    return full_refresh(e);
+
+  for (i = 0; i < e->slot_count; ++i) {
+    s = new_states + i;
+    *s = e->slots[i];
+    decode_slot_element(page_two + s->page_two_offset, s);
+    if (s->status_code != e->slots[i].status_code ||
+        s->device_off != e->slots[i].device_off)
+      return full_refresh(e);
+  }
+
+  for (i = 0; i < e->slot_count; ++i)
+    changed |= update_slot(e, i, new_states + i);
+  memcpy(e->page_two, page_two, size);
+  return changed;
+}
+
+/* follow sd disks appearing and disappearing; return whether relevant */
+static int handle_block_uevent(struct enclosure_watch *encs, int count,
+                               struct uevent *ev)
+{
+  char path[PATH_MAX];
+  char sas_address[SAS_ADDR_STR_LENGTH + 3] = "";
+  char dev_name[WATCH_NAME_LENGTH];
+  struct slot_state new_state;
+  struct slot_state *s;
+  int len = strlen(ev->devname);
+  int fd;
+  int i, j;
+
+  /* whole sd disks only, not partitions */
+  if (strcmp(ev->subsystem, "block") != 0 ||
+      strncmp(ev->devname, "sd", 2) != 0 ||
+      len == 0 || isdigit((unsigned char) ev->devname[len - 1]))
+    return 0;
+  snprintf(dev_name, WATCH_NAME_LENGTH, "/dev/%s", ev->devname);
+
+  if (strcmp(ev->action, "add") == 0) {
+    snprintf(path, PATH_MAX, "/sys/block/%s/device/sas_address",
+             ev->devname);
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+      return 0;
+    if (read(fd, sas_address, SAS_ADDR_STR_LENGTH + 2) !=
+        SAS_ADDR_STR_LENGTH + 2)
+      sas_address[0] = '\0';
+    close(fd);
+    if (sas_address[0] == '\0')
+      return 0;
+  } else if (strcmp(ev->action, "remove") != 0) {
+    return 0;
+  }
+
+  for (i = 0; i < count; ++i) {
+    for (j = 0; j < encs[i].slot_count; ++j) {
+      s = encs[i].slots + j;
+      new_state = *s;
+      if (sas_address[0] &&
+          strncmp(sas_address + 2, s->sas_addr_str, SAS_ADDR_STR_LENGTH) == 0)
+        snprintf(new_state.dev_name, WATCH_NAME_LENGTH, "%s", dev_name);
+      else if (!sas_address[0] && strcmp(s->dev_name, dev_name) == 0)
+        new_state.dev_name[0] = '\0';
+      else
+        continue;
+      update_slot(encs + i, j, &new_state);
+    }
+  }
+  return 1;
+}
+
+int watch_slots(char *devnames[], int count)
+{
+  struct enclosure_watch *encs;
+  struct uevent ev;
+  int interval = WATCH_MIN_INTERVAL_MS;
+  long long deadline, now;
+  int uevent_fd;
+  int opened = 0;
+  int changed;
+  int ret;
+  int i;
+
+  encs = (struct enclosure_watch *)
+    calloc(count, sizeof(struct enclosure_watch));
+  if (encs == NULL) {
+    perr("Cannot allocate memory.\n");
+    return ENOMEM;
+  }
+
+  for (i = 0; i < count; ++i) {
+    encs[i].devname = devnames[i];
+    encs[i].sg_fd = sg_cmds_open_device(devnames[i], 0 /* rw */,
+                                        0 /* not verbose */);
+    if (encs[i].sg_fd < 0)
+      perr("Cannot open %s.\n", devnames[i]);
+    else
+      ++opened;
+  }
+  if (opened == 0) {
+    free(encs);
+    return ENODEV;
+  }
+
+  uevent_fd = uevent_open();
+
+  for (;;) {
+    changed = 0;
+    for (i = 0; i < count; ++i) {
+      if (encs[i].sg_fd >= 0)
+        changed |= poll_enclosure(encs + i);
+    }
+
+    if (changed)
+      interval = WATCH_MIN_INTERVAL_MS;
+    else if (interval < WATCH_MAX_INTERVAL_MS)
+      interval *= 2;
+
+    /* sleep until the next poll, or until a disk appears or disappears */
+    deadline = monotonic_ms() + interval;
+    while ((now = monotonic_ms()) < deadline) {
+      if (uevent_fd < 0) {
+        usleep((deadline - now) * 1000);
+        break;
+      }
+      ret = uevent_read(uevent_fd, &ev, deadline - now);
+      if (ret < 0) {
+        uevent_close(uevent_fd);
+        uevent_fd = -1;
+      } else if (ret == 0) {
+        break;
+      } else if (handle_block_uevent(encs, count, &ev)) {
+        interval = WATCH_MIN_INTERVAL_MS;
+        break;
+      }
+    }
+  }
+
+  /* not reached */
+  uevent_close(uevent_fd);
+  free(encs);
+  return 0;
+}
@@ -0,0 +1,25 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef SLOT_WATCH_H
+#define SLOT_WATCH_H
+
+/* page 0x02 polling interval, doubled while nothing changes */
+#define WATCH_MIN_INTERVAL_MS 250
+#define WATCH_MAX_INTERVAL_MS 4000
+
+/*
+ * watch array device slots of all devnames, and print one NDJSON line per
+ * slot whenever its status, fault, ident or OS device name changes.
+ * The first line of each slot is its initial state. Does not return unless
+ * no enclosure can be opened.
+ */
+extern int watch_slots(char *devnames[], int count);
+
+#endif
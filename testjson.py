@@ -12,7 +12,9 @@ from __future__ import unicode_literals
 
 import commands
 import json
+import os
 import sys
+import tempfile
 
 # cmd, parameter, whether test non-JSON
 all_tests = [
@@ -34,6 +36,16 @@ all_tests = [
     ['version', '', True],
 ]
 
+# batch options, and a line the batch must refuse: a line cannot choose its
+# own output format, nor stream
+batch_rejected = [
+    ['--json', 'sensor --fields status %s'],
+    ['', 'sensor --json %s'],
+    ['--json', 'sensor --cbor %s'],
+    ['--json', 'hdd --watch %s'],
+    ['--json', 'event --log --new --watch %s'],
+]
+
 def find_device(binary):
     ret = []
     fullcmd = '%s list 2> /dev/null' % (binary)
@@ -73,6 +85,90 @@ def testNoneJSONCommand(binary, cmd, parameters):
     print('Pass None JSON: %s' % (fullcmd))
     return True
 
+def testTagRoundTrip(binary, device):
+    # importing an unmodified export must not write anything
+    fd, path = tempfile.mkstemp(suffix='.json')
+    os.close(fd)
+    try:
+        fullcmd = '%s tag --export %s > %s 2>/dev/null' % (
+            binary, device, path)
+        commands.getoutput(fullcmd)
+        fullcmd = '%s tag --import %s --json %s 2>/dev/null' % (
+            binary, path, device)
+        output = commands.getoutput(fullcmd)
+    finally:
+        os.remove(path)
+
+    try:
+        written = int(json.loads(output)[device]['written'])
+    except:
+        print('Fail tag round trip: %s' % fullcmd)
+        print(output)
+        return False
+    if written != 0:
+        print('Fail tag round trip, %d tag(s) written: %s' % (
+                written, fullcmd))
+        return False
+    print('Pass tag round trip: %s' % (fullcmd))
+    return True
+
+
+def runBatch(binary, options, lines):
+    fd, path = tempfile.mkstemp(suffix='.batch')
+    os.write(fd, '\n'.join(lines) + '\n')
+    os.close(fd)
+    try:
+        # a stream never ends; do not wait for one
+        fullcmd = 'timeout 60 %s batch %s %s 2>/dev/null' % (
+            binary, options, path)
+        status, output = commands.getstatusoutput(fullcmd)
+    finally:
+        os.remove(path)
+    return fullcmd, status, output
+
+def sameKeys(a, b):
+    if isinstance(a, dict) != isinstance(b, dict):
+        return False
+    if not isinstance(a, dict):
+        return True
+    for key in b:
+        if key not in a or not sameKeys(a[key], b[key]):
+            return False
+    return True
+
+def testBatchRejects(binary, device, options, line):
+    # the refused line fails, and the next one prints as if it ran alone
+    line = line % device
+    fullcmd, status, output = runBatch(binary, options,
+                                       [line, 'sensor %s' % device])
+    fullcmd = '%s with "%s"' % (fullcmd, line)
+    if status == 0:
+        print('Fail batch, line accepted: %s' % fullcmd)
+        return False
+
+    if options == '':
+        if '{' in output:
+            print('Fail batch, JSON in a text batch: %s' % fullcmd)
+            return False
+        print('Pass batch: %s' % fullcmd)
+        return True
+
+    try:
+        members = json.loads(output)
+        alone = json.loads(commands.getoutput(
+            '%s sensor --json %s 2>/dev/null' % (binary, device)))
+        refused = int(members['1']['rc']) != 0
+        complete = int(members['2']['rc']) == 0 and \
+            sameKeys(members['2'], alone)
+    except:
+        print('Fail batch: %s' % fullcmd)
+        print(output)
+        return False
+    if not refused or not complete:
+        print('Fail batch, line leaked into the next: %s' % fullcmd)
+        return False
+    print('Pass batch: %s' % fullcmd)
+    return True
 
 def usage():
     print('Usage:')
@@ -103,6 +199,13 @@ def main():
                 if not testNoneJSON or \
                    testNoneJSONCommand(binary, cmd, parameters):
                     passed_test += 1
+        total_test += 1
+        if testTagRoundTrip(binary, device):
+            passed_test += 1
+        for test in batch_rejected:
+            total_test += 1
+            if testBatchRejects(binary, device, test[0], test[1]):
+                passed_test += 1
 
     print('\nPassed %.2f %% (%d of %d) tests.' % (
             100 * passed_test / total_test, passed_test, total_test))
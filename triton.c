@@ -17,39 +17,43 @@
 #include "jbod_interface.h"
 #include "scsi_buffer.h"
 #include "ses.h"
+#include "ses_control.h"
 #include "led.h"
+#include "event_log.h"
+#include "phyerr.h"
 #include "cooling.h"
 #include "json.h"
 
 #include "triton.h"
 
-struct jbod_short_profile triton_get_short_profile (char *devname)
+struct jbod_short_profile triton_get_short_profile (int sg_fd)
 {
   struct jbod_short_profile p = {"N/A", "N/A", "N/A"};
-  int sg_fd = sg_cmds_open_device(devname, 0 /* rw */, 0 /* not verbose */);
-
-  if (sg_fd > 0) {
-    read_buffer_string(sg_fd, &triton_dpb_sn, p.node_sn, MAX_TAG_LENGTH);
-    read_buffer_string(sg_fd, &fb_asset_tag, p.fb_asset_node, MAX_TAG_LENGTH);
-    read_buffer_string(sg_fd, &fb_asset_tag, p.fb_asset_chassis,
-                       MAX_TAG_LENGTH);
-    sg_cmds_close_device(sg_fd);
-  }
+  const struct scsi_buffer_parameter *list[] = {&triton_dpb_sn, &fb_asset_tag};
+  struct scsi_buffer_plan plan;
+
+  scsi_buffer_plan_read(sg_fd, list, sizeof(list) / sizeof(list[0]), &plan);
+  planned_buffer_string(sg_fd, &plan, &triton_dpb_sn, p.node_sn,
+                        MAX_TAG_LENGTH);
+  planned_buffer_string(sg_fd, &plan, &fb_asset_tag, p.fb_asset_node,
+                        MAX_TAG_LENGTH);
+  scsi_buffer_plan_free(&plan);
+  /* Triton has one asset tag for both */
+  memcpy(p.fb_asset_chassis, p.fb_asset_node, MAX_TAG_LENGTH);
 
   return p;
 }
 
+static const struct scsi_buffer_parameter *const triton_enclosure_info_list[] =
+{&scc_pn, &scc_sn, &triton_dpb_pn, &triton_dpb_sn, &ww_chassis_pn,
+ &ww_chassis_sn, &fb_pn, &fb_asset_tag};
+
 void triton_print_enclosure_info (int sg_fd)
 {
   jbod_print_enclosure_info(sg_fd);
-  print_read_value(sg_fd, &scc_pn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &scc_sn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &triton_dpb_pn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &triton_dpb_sn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &ww_chassis_pn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &ww_chassis_sn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &fb_pn); PRINT_JSON_MORE_ITEM;
-  print_read_value(sg_fd, &fb_asset_tag);
+  print_read_values(sg_fd, triton_enclosure_info_list,
+                    sizeof(triton_enclosure_info_list) /
+                    sizeof(triton_enclosure_info_list[0]));
 }
 
 void triton_print_profile(struct jbod_profile *profile)
@@ -72,7 +76,7 @@ void triton_print_power_reading(int sg_fd)
   print_read_value(sg_fd, &chassis_power);
 }
 
-struct led_info triton_leds[] = {
+static const struct led_info triton_leds[] = {
   {SEVEN_SEG,    -1, "7 Segment LED ", NULL, NULL},
   {DUO_COLOR, -1, "Fan Module 1", "Blue", "Yellow"},
   {DUO_COLOR, -1, "Fan Module 2", "Blue", "Yellow"},
@@ -84,137 +88,122 @@ struct led_info triton_leds[] = {
 #define TRITON_LED_BUFFER_ID 0x7a
 #define TRITON_LED_BUFFER_LENGTH 6
 
-void triton_print_sys_led(int sg_fd)
-{
-  int i;
-  unsigned char buf[TRITON_LED_BUFFER_LENGTH];
+/* byte after the enclosure LED: 0 for manual control, 0xff for auto */
+#define TRITON_ENCLOSURE_LED_OFFSET 5
 
-  for (i = 0; i < TRITON_LED_BUFFER_LENGTH; ++i) {
-    scsi_read_buffer(sg_fd, TRITON_LED_BUFFER_ID, i, buf + i, 1);
-  }
+static void triton_led_state(struct led_state *state)
+{
+  memset(state, 0, sizeof(*state));
+  state->leds = triton_leds;
+  state->count = TRITON_LED_BUFFER_LENGTH;
+  state->buffer_id = TRITON_LED_BUFFER_ID;
+  state->probe_bulk_read = 1;
+}
 
-  IF_PRINT_NONE_JSON {
-    printf("%s\t%s\t%s\n", "ID", "Name", "Status");
-  }
+void triton_print_sys_led(int sg_fd)
+{
+  struct led_state state;
 
-  for (i = 0; i < TRITON_LED_BUFFER_LENGTH; i ++) {
-    triton_leds[i].status = buf[i];
-    print_led(i, triton_leds + i);
+  triton_led_state(&state);
+  if (read_led_state(sg_fd, &state) != 0) {
+    perr("Failed to read LED status.\n");
+    return;
   }
+  print_led_state(&state);
 }
 
+/* the printed status is what was written, not read back */
 void trition_identify_enclosure(int sg_fd, int val)
 {
+  struct led_state state;
   unsigned char buf[2];
-  scsi_read_buffer(sg_fd, TRITON_LED_BUFFER_ID, 5, buf, 2);
+
+  triton_led_state(&state);
+  if (read_led_state(sg_fd, &state) != 0) {
+    perr("Failed to read LED status.\n");
+    return;
+  }
   if (val == 1) {
     buf[0] = 2;
     buf[1] = 0;
-    scsi_write_buffer(sg_fd, TRITON_LED_BUFFER_ID, 5, buf, 2);
   } else if (val == 0) {
     buf[0] = 0;
     buf[1] = 0xff;
-    scsi_write_buffer(sg_fd, TRITON_LED_BUFFER_ID, 5, buf, 2);
   }
-  triton_print_sys_led(sg_fd);
+  if (val == 1 || val == 0) {
+    if (scsi_write_buffer(sg_fd, TRITON_LED_BUFFER_ID,
+                          TRITON_ENCLOSURE_LED_OFFSET, buf, 2) != 0) {
+      perr("Failed to set identify LED.\n");
+      return;
+    }
+    state.status[TRITON_ENCLOSURE_LED_OFFSET] = buf[0];
+  }
+  print_led_state(&state);
 }
 
+static const char *const triton_gpio_description[19][3] = {
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {"SLOT", "Rear", "Front"},
+  {NULL, "Front", "Rear"},
+  {"Type", "JBOD", "Server"},
+  {"SCC_TYPE_2", "0", "1"},
+  {"SCC_TYPE_1", "0", "1"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {NULL, "Low", "High"},
+  {"EXP_GPIO_2", "0", "1"},
+  {"EXP_GPIO_1", "0", "1"},
+  {"EXP_GPIO_0", "0", "1"},
+  {"BMC_A_HB", "No Heartbeat", "Heartbeat alive"},
+  {"BMC_B_HB", "No Heartbeat", "Heartbeat alive"},
+  {"Peer_EXP_HB", "No Heartbeat", "Heartbeat alive"},
+};
+
+static const struct signal_buffer triton_gpio = {
+  0x70,
+  sizeof(triton_gpio_description) / sizeof(triton_gpio_description[0]),
+  triton_gpio_description};
+
 void triton_print_gpio(int sg_fd)
 {
-  char *triton_gpio_description[19][3] = {
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {"SLOT", "Rear", "Front"},
-    {NULL, "Front", "Rear"},
-    {"Type", "JBOD", "Server"},
-    {"SCC_TYPE_2", "0", "1"},
-    {"SCC_TYPE_1", "0", "1"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {NULL, "Low", "High"},
-    {"EXP_GPIO_2", "0", "1"},
-    {"EXP_GPIO_1", "0", "1"},
-    {"EXP_GPIO_0", "0", "1"},
-    {"BMC_A_HB", "No Heartbeat", "Heartbeat alive"},
-    {"BMC_B_HB", "No Heartbeat", "Heartbeat alive"},
-    {"Peer_EXP_HB", "No Heartbeat", "Heartbeat alive"},
-  };
-
-  gpio_buffer_id = 0x70;
-  gpio_buffer_length = sizeof(triton_gpio_description) /
-    sizeof(triton_gpio_description[0]);
-
-  gpio_descriptions = triton_gpio_description;
-  jbod_print_gpio(sg_fd);
+  jbod_print_gpio(sg_fd, &triton_gpio);
+}
+
+const struct signal_buffer *triton_get_gpio()
+{
+  return &triton_gpio;
 }
 
 
 #define TRITON_PHYERR_BUFFER_ID 0x77
 #define TRITON_PHYERR_BUFFER_PHY_COUNT 48
-#define TRITON_PHYERR_BUFFER_LENGTH 16
 
 void triton_print_phyerr(int sg_fd)
 {
-  unsigned char buf[TRITON_PHYERR_BUFFER_LENGTH];
-  int i;
-  char json_key[16];
-
-  IF_PRINT_NONE_JSON
-    printf("PHY\tInvalid Dword\tRunning Disparity\tLoss of Dword Sync"
-           "\tPhy Reset Problem\n");
-
-  for (i = 0; i < TRITON_PHYERR_BUFFER_PHY_COUNT; i ++) {
-    scsi_read_buffer(sg_fd, TRITON_PHYERR_BUFFER_ID, i,
-                     buf, TRITON_PHYERR_BUFFER_LENGTH);
-    IF_PRINT_NONE_JSON
-      printf("%d\t%u\t%u\t%u\t%u\n",
-             i,
-             four_byte_to_uint(buf + 0),
-             four_byte_to_uint(buf + 4),
-             four_byte_to_uint(buf + 8),
-             four_byte_to_uint(buf + 12)
-            );
-    if (i) PRINT_JSON_MORE_GROUP;
-    snprintf(json_key, 16, "Phy_%u", i);
-    PRINT_JSON_GROUP_HEADER(json_key);
-    PRINT_JSON_ITEM("Invalid Dword", "%u",
-                    four_byte_to_uint(buf + 0));
-    PRINT_JSON_ITEM("Running Disparity", "%u",
-                    four_byte_to_uint(buf + 4));
-    PRINT_JSON_ITEM("Loss of Dword Sync", "%u",
-                    four_byte_to_uint(buf + 8));
-    PRINT_JSON_LAST_ITEM("Phy Reset Problem", "%u",
-                         four_byte_to_uint(buf + 12));
-    PRINT_JSON_GROUP_ENDING;
-  }
+  print_phyerr(sg_fd, TRITON_PHYERR_BUFFER_ID, TRITON_PHYERR_BUFFER_PHY_COUNT);
 }
 
-void triton_reset_phyerr(int sg_fd)
-{
-  unsigned char buf[16] = {0};
+static const struct metrics_profile triton_metrics = {
+  &chassis_power, TRITON_PHYERR_BUFFER_ID, TRITON_PHYERR_BUFFER_PHY_COUNT};
 
-  scsi_write_buffer(sg_fd, TRITON_PHYERR_BUFFER_ID, 0, buf, 16);
+const struct metrics_profile *triton_get_metrics_profile()
+{
+  return &triton_metrics;
 }
 
-void triton_show_power_window(int sg_fd, struct config_item *config)
+void triton_reset_phyerr(int sg_fd)
 {
-  unsigned char buf[4];
-
-  scsi_read_buffer(sg_fd, config->buffer_id, 0, buf, 4);
-
-  IF_PRINT_NONE_JSON printf("%s:\t %d\n", config->name, buf[1] & 0xff);
+  unsigned char buf[16] = {0};
 
-  PRINT_JSON_GROUP_SEPARATE;
-  PRINT_JSON_GROUP_HEADER(config->name);
-  PRINT_JSON_ITEM("name", "%s", config->name);
-  PRINT_JSON_LAST_ITEM("value", "%d", buf[1]);
-  PRINT_JSON_GROUP_ENDING;
+  scsi_write_buffer(sg_fd, TRITON_PHYERR_BUFFER_ID, 0, buf, 16);
 }
 
-void triton_change_power_window(int sg_fd, int val, struct config_item *config)
+void triton_change_power_window(int sg_fd, int val,
+                                const struct config_item *config)
 {
   int i;
   unsigned char buf[2] = {0, (unsigned char) (val & 0xff)};
@@ -225,240 +214,222 @@ void triton_change_power_window(int sg_fd, int val, struct config_item *config)
   }
 }
 
-void set_triton_config()
-{
-  /* Power Window */
-  all_configs[0].buffer_id = 0x41;
-  all_configs[0].buffer_offset = 4;
-  all_configs[0].show_func = triton_show_power_window;
-  all_configs[0].change_func = triton_change_power_window;
+static const struct config_item triton_configs[CONFIG_ITEM_COUNT] = {
+  /* Power Window, read back as the second byte */
+  {0x41, 4, 1, "Power Window", triton_change_power_window},
   /* HDD Temperature Interval */
-  all_configs[1].buffer_id = 0x72;
-  all_configs[1].buffer_offset = 3;
+  {0x72, 3, 3, "HDD Temperature Interval", jbod_change_hdd_temp_interval},
   /* Fan Profile */
-  all_configs[2].buffer_id = -1;
-  all_configs[2].buffer_offset = -1;
+  {-1, -1, -1, "Fan Profile", NULL},
+};
+
+const struct config_item *triton_get_configs()
+{
+  return triton_configs;
 }
 
 void triton_show_config(int sg_fd)
 {
-  set_triton_config();
-  jbod_show_config(sg_fd);
+  jbod_show_config(sg_fd, triton_configs);
 }
 
 void triton_config_power_window(int sg_fd, int val)
 {
-  set_triton_config();
-  jbod_config_power_window(sg_fd, val);
+  change_config(sg_fd, val, triton_configs + CONFIG_POWER_WINDOW);
 }
 
 void triton_config_hdd_temp_interval(int sg_fd, int val)
 {
-  set_triton_config();
-  jbod_config_hdd_temp_interval(sg_fd, val);
+  change_config(sg_fd, val, triton_configs + CONFIG_HDD_TEMP_INTERVAL);
 }
 
 void triton_config_fan_profile(int sg_fd, int val)
 {
-  set_triton_config();
-  jbod_config_fan_profile(sg_fd, val);
+  change_config(sg_fd, val, triton_configs + CONFIG_FAN_PROFILE);
 }
 
-struct scsi_buffer_parameter *triton_asset_tag_list[] = {
+static const struct scsi_buffer_parameter *const triton_asset_tag_list[] = {
   &scc_pn, &scc_sn, &triton_dpb_pn, &triton_dpb_sn, &ww_chassis_pn,
   &ww_chassis_sn, &fb_pn, &fb_asset_tag
 };
 
-void triton_config_asset_tags()
-{
-  asset_tag_count = sizeof(triton_asset_tag_list)
-    / sizeof(struct scsi_buffer_parameter *);
-  asset_tag_list = triton_asset_tag_list;
-}
+#define TRITON_ASSET_TAG_COUNT \
+  (sizeof(triton_asset_tag_list) / sizeof(triton_asset_tag_list[0]))
 
 void triton_set_asset_tag(int sg_fd, int tag_id, char *tag)
 {
-  triton_config_asset_tags();
-  jbod_set_asset_tag(sg_fd, tag_id, tag);
+  jbod_set_asset_tag(sg_fd, triton_asset_tag_list, TRITON_ASSET_TAG_COUNT,
+                     tag_id, tag);
 }
 
 void triton_set_asset_tag_by_name(int sg_fd, char *tag_name, char *tag)
 {
-  triton_config_asset_tags();
-  jbod_set_asset_tag_by_name(sg_fd, tag_name, tag);
+  jbod_set_asset_tag_by_name(sg_fd, triton_asset_tag_list,
+                             TRITON_ASSET_TAG_COUNT, tag_name, tag);
 }
 
 void triton_print_asset_tag(int sg_fd)
 {
-  triton_config_asset_tags();
-  jbod_print_asset_tag(sg_fd);
+  jbod_print_asset_tag(sg_fd, triton_asset_tag_list, TRITON_ASSET_TAG_COUNT);
 }
 
-void triton_print_event_log(int sg_fd)
+int triton_get_asset_tags(const struct scsi_buffer_parameter *const **tags)
 {
-#define EVENT_LOG_BUFFER_SIZE 8192
-  unsigned char buf[EVENT_LOG_BUFFER_SIZE];
-  unsigned char *buf_ptr;
-  int64_t timestamp = 0;
-  int i;
-  char id_str[16];
+  *tags = triton_asset_tag_list;
+  return TRITON_ASSET_TAG_COUNT;
+}
 
+void triton_print_event_log(int sg_fd)
+{
   perr("NOTE: Event log in Triton is not complete at this time...\n");
+  print_event_log(sg_fd, EVENT_LOG_BUFFER_ID);
+}
 
-  sg_ll_read_buffer(sg_fd, 2, 0xe5, 0, (void *) buf,
-                    EVENT_LOG_BUFFER_SIZE, 1, 0);
-
-  for (i = 0; i < EVENT_LOG_BUFFER_SIZE; i += 64) {
-    buf_ptr = buf + i;
-    timestamp = *((int64_t *)(buf_ptr));
-    IF_PRINT_NONE_JSON
-      printf("[%11ld][Event %d] %d %x %s\n", timestamp,
-             buf_ptr[13] * 256 + buf_ptr[12],
-             buf_ptr[15] * 256 + buf_ptr[14],
-             *((int *)(buf_ptr + 16)),
-             (char *)(buf_ptr + 24));
-
-    PRINT_JSON_GROUP_SEPARATE;
-
-    snprintf(id_str, 16, "%d", buf_ptr[13] * 256 + buf_ptr[12]);
-    PRINT_JSON_GROUP_HEADER(id_str);
-    PRINT_JSON_ITEM("timestamp", "%ld", timestamp);
-    PRINT_JSON_ITEM("id", "%d", buf_ptr[13] * 256 + buf_ptr[12]);
-    fix_none_ascii((char *)(buf_ptr + 24), strlen((char *)(buf_ptr + 24)));
-    PRINT_JSON_LAST_ITEM("description", "%s", (char *)(buf_ptr + 24));
-    PRINT_JSON_GROUP_ENDING;
-  }
+int triton_print_new_events(int sg_fd, const char *devname)
+{
+  return print_new_events(sg_fd, devname, EVENT_LOG_BUFFER_ID);
 }
 
+static const char *const triton_event_status_description[100][3] = {
+  /* 0 */
+  {NULL, "Off", "On"},
+  {"I2C bus 0 crash ", "Off", "On"},
+  {"I2C bus 1 crash ", "Off", "On"},
+  {"I2C bus 2 crash ", "Off", "On"},
+  {"I2C bus 3 crash ", "Off", "On"},
+  /* 5 */
+  {"I2C bus 4 crash ", "Off", "On"},
+  {"I2C bus 5 crash ", "Off", "On"},
+  {"I2C bus 6 crash ", "Off", "On"},
+  {"I2C bus 7 crash ", "Off", "On"},
+  {"I2C bus 8 crash ", "Off", "On"},
+  /* 10 */
+  {"I2C bus 9 crash ", "Off", "On"},
+  {"I2C bus 10 cras h", "Off", "On"},
+  {"I2C bus 11 crash ", "Off", "On"},
+  {"Fan 1 front fault ", "Off", "On"},
+  {"Fan 1 rear fault ", "Off", "On"},
+  /* 15 */
+  {"Fan 2 front fault ", "Off", "On"},
+  {"Fan 2 rear fault ", "Off", "On"},
+  {"Fan 3 front fault ", "Off", "On"},
+  {"Fan 3 rear fault ", "Off", "On"},
+  {"Fan 4 front fault ", "Off", "On"},
+  /* 20 */
+  {"Fan 4 rear fault ", "Off", "On"},
+  {"SCC voltage warning ", "Off", "On"},
+  {"DPB voltage warning ", "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  /* 25 */
+  {"SCC current warning ", "Off", "On"},
+  {"DPB current warning ", "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {"DPB temp. sensor 1 warning ", "Off", "On"},
+  /* 30 */
+  {"DPB temp. sensor 2 warning ", "Off", "On"},
+  {"SCC expander temp warning ", "Off", "On"},
+  {"SCC IOC temp warning ", "Off", "On"},
+  {"HDD0 X SMART temp warning ", "Off", "On"},
+  {NULL, "Off", "On"},
+  /* 35 */
+  {NULL, "Off", "On"},
+  {"HDD0 fault ", "Off", "On"},
+  {"HDD1 fault ", "Off", "On"},
+  {"HDD2 fault ", "Off", "On"},
+  {"HDD3 fault ", "Off", "On"},
+  /* 40 */
+  {"HDD4 fault ", "Off", "On"},
+  {"HDD5 fault ", "Off", "On"},
+  {"HDD6 fault ", "Off", "On"},
+  {"HDD7 fault ", "Off", "On"},
+  {"HDD8 fault ", "Off", "On"},
+  /* 45 */
+  {"HDD9 fault ", "Off", "On"},
+  {"HDD10 fault ", "Off", "On"},
+  {"HDD11 fault ", "Off", "On"},
+  {"HDD12 fault ", "Off", "On"},
+  {"HDD13 fault ", "Off", "On"},
+  /* 50 */
+  {"HDD14 fault ", "Off", "On"},
+  {"HDD15 fault ", "Off", "On"},
+  {"HDD16 fault ", "Off", "On"},
+  {"HDD17 fault ", "Off", "On"},
+  {"HDD18 fault ", "Off", "On"},
+  /* 55 */
+  {"HDD19 fault ", "Off", "On"},
+  {"HDD20 fault ", "Off", "On"},
+  {"HDD21 fault ", "Off", "On"},
+  {"HDD22 fault ", "Off", "On"},
+  {"HDD23 fault ", "Off", "On"},
+  /* 60 */
+  {"HDD24 fault ", "Off", "On"},
+  {"HDD25 fault ", "Off", "On"},
+  {"HDD26 fault ", "Off", "On"},
+  {"HDD27 fault ", "Off", "On"},
+  {"HDD28 fault ", "Off", "On"},
+  /* 65 */
+  {"HDD29 fault ", "Off", "On"},
+  {"HDD30 fault ", "Off", "On"},
+  {"HDD31 fault ", "Off", "On"},
+  {"HDD32 fault ", "Off", "On"},
+  {"HDD33 fault ", "Off", "On"},
+  /* 70 */
+  {"HDD34 fault ", "Off", "On"},
+  {"HDD35 fault ", "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  /* 75 */
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  /* 80 */
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  /* 85 */
+  {NULL, "Off", "On"},
+  {"Fan 1 removed", "Off", "On"},
+  {"Fan 2 removed", "Off", "On"},
+  {"Fan 3 removed", "Off", "On"},
+  {"Fan 4 removed", "Off", "On"},
+  /* 90 */
+  {"Internal Mini-SAS link error 1 ", "Off", "On"},
+  {"Internal Mini-SAS link error 2 ", "Off", "On"},
+  {"Drawer pulled out ", "Off", "On"},
+  {"Peer SCC pulled out ", "Off", "On"},
+  {"IOM A pulled out ", "Off", "On"},
+  /* 95 */
+  {"IOM B pulled out ", "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {NULL, "Off", "On"},
+  {"HW config mismatch ", "Off", "On"},
+};
+
+static const struct signal_buffer triton_event_status = {
+  0x76, 100, triton_event_status_description};
+
 void triton_print_event_status(int sg_fd)
 {
-  event_status_buffer_id = 0x76;
-  event_status_buffer_length = 100;
-  char *triton_event_status_description[100][3] = {
-    /* 0 */
-    {NULL, "Off", "On"},
-    {"I2C bus 0 crash ", "Off", "On"},
-    {"I2C bus 1 crash ", "Off", "On"},
-    {"I2C bus 2 crash ", "Off", "On"},
-    {"I2C bus 3 crash ", "Off", "On"},
-    /* 5 */
-    {"I2C bus 4 crash ", "Off", "On"},
-    {"I2C bus 5 crash ", "Off", "On"},
-    {"I2C bus 6 crash ", "Off", "On"},
-    {"I2C bus 7 crash ", "Off", "On"},
-    {"I2C bus 8 crash ", "Off", "On"},
-    /* 10 */
-    {"I2C bus 9 crash ", "Off", "On"},
-    {"I2C bus 10 cras h", "Off", "On"},
-    {"I2C bus 11 crash ", "Off", "On"},
-    {"Fan 1 front fault ", "Off", "On"},
-    {"Fan 1 rear fault ", "Off", "On"},
-    /* 15 */
-    {"Fan 2 front fault ", "Off", "On"},
-    {"Fan 2 rear fault ", "Off", "On"},
-    {"Fan 3 front fault ", "Off", "On"},
-    {"Fan 3 rear fault ", "Off", "On"},
-    {"Fan 4 front fault ", "Off", "On"},
-    /* 20 */
-    {"Fan 4 rear fault ", "Off", "On"},
-    {"SCC voltage warning ", "Off", "On"},
-    {"DPB voltage warning ", "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    /* 25 */
-    {"SCC current warning ", "Off", "On"},
-    {"DPB current warning ", "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {"DPB temp. sensor 1 warning ", "Off", "On"},
-    /* 30 */
-    {"DPB temp. sensor 2 warning ", "Off", "On"},
-    {"SCC expander temp warning ", "Off", "On"},
-    {"SCC IOC temp warning ", "Off", "On"},
-    {"HDD0 X SMART temp warning ", "Off", "On"},
-    {NULL, "Off", "On"},
-    /* 35 */
-    {NULL, "Off", "On"},
-    {"HDD0 fault ", "Off", "On"},
-    {"HDD1 fault ", "Off", "On"},
-    {"HDD2 fault ", "Off", "On"},
-    {"HDD3 fault ", "Off", "On"},
-    /* 40 */
-    {"HDD4 fault ", "Off", "On"},
-    {"HDD5 fault ", "Off", "On"},
-    {"HDD6 fault ", "Off", "On"},
-    {"HDD7 fault ", "Off", "On"},
-    {"HDD8 fault ", "Off", "On"},
-    /* 45 */
-    {"HDD9 fault ", "Off", "On"},
-    {"HDD10 fault ", "Off", "On"},
-    {"HDD11 fault ", "Off", "On"},
-    {"HDD12 fault ", "Off", "On"},
-    {"HDD13 fault ", "Off", "On"},
-    /* 50 */
-    {"HDD14 fault ", "Off", "On"},
-    {"HDD15 fault ", "Off", "On"},
-    {"HDD16 fault ", "Off", "On"},
-    {"HDD17 fault ", "Off", "On"},
-    {"HDD18 fault ", "Off", "On"},
-    /* 55 */
-    {"HDD19 fault ", "Off", "On"},
-    {"HDD20 fault ", "Off", "On"},
-    {"HDD21 fault ", "Off", "On"},
-    {"HDD22 fault ", "Off", "On"},
-    {"HDD23 fault ", "Off", "On"},
-    /* 60 */
-    {"HDD24 fault ", "Off", "On"},
-    {"HDD25 fault ", "Off", "On"},
-    {"HDD26 fault ", "Off", "On"},
-    {"HDD27 fault ", "Off", "On"},
-    {"HDD28 fault ", "Off", "On"},
-    /* 65 */
-    {"HDD29 fault ", "Off", "On"},
-    {"HDD30 fault ", "Off", "On"},
-    {"HDD31 fault ", "Off", "On"},
-    {"HDD32 fault ", "Off", "On"},
-    {"HDD33 fault ", "Off", "On"},
-    /* 70 */
-    {"HDD34 fault ", "Off", "On"},
-    {"HDD35 fault ", "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    /* 75 */
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    /* 80 */
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    /* 85 */
-    {NULL, "Off", "On"},
-    {"Fan 1 removed", "Off", "On"},
-    {"Fan 2 removed", "Off", "On"},
-    {"Fan 3 removed", "Off", "On"},
-    {"Fan 4 removed", "Off", "On"},
-    /* 90 */
-    {"Internal Mini-SAS link error 1 ", "Off", "On"},
-    {"Internal Mini-SAS link error 2 ", "Off", "On"},
-    {"Drawer pulled out ", "Off", "On"},
-    {"Peer SCC pulled out ", "Off", "On"},
-    {"IOM A pulled out ", "Off", "On"},
-    /* 95 */
-    {"IOM B pulled out ", "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {NULL, "Off", "On"},
-    {"HW config mismatch ", "Off", "On"},
-  };
-
-  event_status_descriptions = triton_event_status_description;
-  jbod_print_event_status(sg_fd);
+  jbod_print_event_status(sg_fd, &triton_event_status);
+}
+
+const struct signal_buffer *triton_get_event_status()
+{
+  return &triton_event_status;
+}
+
+int triton_print_event_status_changes(int sg_fd, const char *devname)
+{
+  return jbod_print_event_status_changes(sg_fd, devname,
+                                         &triton_event_status);
 }
 
 void triton_power_cycle_enclosure(int sg_fd)
@@ -468,34 +439,28 @@ void triton_power_cycle_enclosure(int sg_fd)
 }
 
 static void triton_ses_pwm_control(struct cooling_fan *fan, int pwm,
-                          unsigned char *page_two)
+                          struct ses_txn *txn)
 {
-  unsigned char *fan_element_ptr = page_two + fan->page_two_offset;
-
-  fan->common_control = fan->common_status & 0xf0;
-  fan->common_control |= 0x80;
+  const unsigned char and_mask[SES_ELEMENT_SIZE] = {0xf0, 0, 0, 0};
+  unsigned char or_mask[SES_ELEMENT_SIZE] = {0x80, 0, 0, 0};
 
-  fan_element_ptr[0] = fan->common_control;
-  fan_element_ptr[1] = 0;
-  fan_element_ptr[2] = pwm & 0xff;
-  fan_element_ptr[3] = (pwm == 0) ? 0x00 : 0x20;
+  or_mask[2] = pwm & 0xff;
+  or_mask[3] = (pwm == 0) ? 0x00 : 0x20;
+  ses_txn_element(txn, fan->page_two_offset, and_mask, or_mask);
 }
 
 void triton_control_fan_pwm(int sg_fd, int pwm)
 {
-  struct ses_pages pages;
-  struct ses_status_info ses_status;
-  int page_two_size;
+  struct ses_txn txn;
   int i;
 
-  read_ses_pages(sg_fd, &pages, &page_two_size);
+  if (ses_txn_begin(sg_fd, &txn) != 0)
+    return;
 
-  interpret_ses_pages(&pages, &ses_status);
+  for (i = 0; i < txn.status.fan_count; i ++)
+    triton_ses_pwm_control(txn.status.fans + i, pwm, &txn);
 
-  for (i = 0; i < ses_status.fan_count; i ++)
-    triton_ses_pwm_control(ses_status.fans + i, pwm, pages.page_two);
-
-  sg_send_ses_page(sg_fd, pages.page_two, page_two_size);
+  ses_txn_commit(&txn);
 }
 
 enum {
@@ -510,10 +475,12 @@ void triton_print_pwm(int sg_fd) {
                                     data, sizeof(data));
   if (result < 0) {
     perr("unable to read expander pwm, error=%d\n", result);
-  } else if (print_json) {
-    printf("\"PWM_SENSOR_%d\": %d\n", data[0], data[1]);
   } else {
-    printf("PWM_SENSOR_%d\t%d%%\n", data[0], data[1]);
+    char key[32];
+
+    snprintf(key, sizeof(key), "PWM_SENSOR_%d", data[0]);
+    IF_PRINT_NONE_JSON printf("%s\t%d%%\n", key, data[1]);
+    PRINT_JSON_ITEM(key, "%d", data[1]);
   }
 }
 
@@ -529,10 +496,12 @@ void triton_print_cfm(int sg_fd) {
                                     data, sizeof(data));
   if (result < 0) {
     perr("unable to read expander pwm, error=%d\n", result);
-  } else if (print_json) {
-    printf("\"AIR_FLOW_SENSOR_%d\": %d\n", data[0], data[1]);
   } else {
-    printf("AIR_FLOW_SENSOR_%d\t%d CFM\n", data[0], data[1]);
+    char key[32];
+
+    snprintf(key, sizeof(key), "AIR_FLOW_SENSOR_%d", data[0]);
+    IF_PRINT_NONE_JSON printf("%s\t%d CFM\n", key, data[1]);
+    PRINT_JSON_ITEM(key, "%d", data[1]);
   }
 }
 
@@ -546,26 +515,34 @@ struct jbod_interface triton = {
   jbod_print_hdd_info,
   jbod_hdd_power_control,
   jbod_hdd_led_control,
+  jbod_hdd_leds_control,
   jbod_print_fan_info,
   triton_control_fan_pwm,
   triton_set_asset_tag,
   triton_set_asset_tag_by_name,
   triton_print_asset_tag,
+  triton_get_asset_tags,
   triton_power_cycle_enclosure,
   triton_print_gpio,
   triton_print_event_log,
+  triton_print_new_events,
   triton_print_event_status,
+  triton_print_event_status_changes,
   triton_print_sys_led,
   NULL, /* knox_control_sys_led, */
   triton_show_config,
   triton_config_power_window,
   triton_config_hdd_temp_interval,
   NULL, /* knox_config_fan_profile, */
+  triton_get_configs,
   trition_identify_enclosure,
   triton_print_phyerr,
   triton_reset_phyerr,
+  triton_get_metrics_profile,
   triton_print_profile,
   triton_get_short_profile,
   .print_pwm = triton_print_pwm,
   .print_cfm = triton_print_cfm,
+  .get_event_status = triton_get_event_status,
+  .get_gpio = triton_get_gpio,
 };
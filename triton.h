@@ -12,40 +12,23 @@
 
 #include "scsi_buffer.h"
 
-#if 0  /* TODO: implement code that uses this (currently unused). */
-static struct scsi_buffer_parameter scc_power = {
-  sbp_integer, 0x41, 0, 4, "SCC_Power", "W", 2, two_byte_to_int, NULL, NULL};
-
-static struct scsi_buffer_parameter dpb_power = {
-  sbp_integer, 0x41, 1, 4, "DPB_Power", "W", 2, two_byte_to_int, NULL, NULL};
-#endif
-
-static struct scsi_buffer_parameter chassis_power = {
-  sbp_integer, 0x41, 2, 4, "Chassis_Power", "W", 2, two_byte_to_int, NULL,
-  NULL};
-
-static struct scsi_buffer_parameter scc_pn = {
-  sbp_string, 0x40, 0, 13, "SCC_PN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter scc_sn = {
-  sbp_string, 0x40, 0x100, 20, "SCC_SN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter triton_dpb_pn = {
-  sbp_string, 0x30, 0, 13, "DPB_PN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter triton_dpb_sn = {
-  sbp_string, 0x30, 0x100, 20, "DPB_SN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter ww_chassis_pn = {
-  sbp_string, 0x30, 0x200, 11, "Chassis_PN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter ww_chassis_sn = {
-  sbp_string, 0x30, 0x300, 13, "Chassis_SN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter fb_pn = {
-  sbp_string, 0x30, 0x400, 13, "FB_PN", "", 0, NULL, NULL, buf_to_string};
-
-static struct scsi_buffer_parameter fb_asset_tag = {
-  sbp_string, 0x30, 0x500, 7, "asset_tag", "", 0, NULL, NULL, buf_to_string};
+/*
+ * Vendor buffer map of Triton, see SCSI_BUFFER_PARAMETER:
+ * X(variable, type, buf_id, buf_offset, len, name, unit, value_offset,
+ *   indexed)
+ * TODO: SCC_Power (0x41, record 0) and DPB_Power (record 1) are not used.
+ */
+#define TRITON_BUFFER_MAP(X)                                                 \
+  X(chassis_power, sbp_integer, 0x41, 2, 4, "Chassis_Power", "W", 2, 1)      \
+  X(scc_pn, sbp_string, 0x40, 0, 13, "SCC_PN", "", 0, 0)                     \
+  X(scc_sn, sbp_string, 0x40, 0x100, 20, "SCC_SN", "", 0, 0)                 \
+  X(triton_dpb_pn, sbp_string, 0x30, 0, 13, "DPB_PN", "", 0, 0)              \
+  X(triton_dpb_sn, sbp_string, 0x30, 0x100, 20, "DPB_SN", "", 0, 0)          \
+  X(ww_chassis_pn, sbp_string, 0x30, 0x200, 11, "Chassis_PN", "", 0, 0)      \
+  X(ww_chassis_sn, sbp_string, 0x30, 0x300, 13, "Chassis_SN", "", 0, 0)      \
+  X(fb_pn, sbp_string, 0x30, 0x400, 13, "FB_PN", "", 0, 0)                   \
+  X(fb_asset_tag, sbp_string, 0x30, 0x500, 7, "asset_tag", "", 0, 0)
+
+TRITON_BUFFER_MAP(SCSI_BUFFER_PARAMETER)
 
 #endif
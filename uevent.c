@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "common.h"
+#include "uevent.h"
+
+#define UEVENT_BUFFER_SIZE 8192
+
+/* multicast group of events sent by the kernel (not udev) */
+#define UEVENT_KERNEL_GROUP 1
+
+int uevent_open(void)
+{
+  struct sockaddr_nl addr;
+  int fd;
+
+  fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+              NETLINK_KOBJECT_UEVENT);
+  if (fd < 0) {
+#ifdef DEBUG
+    perr("Cannot open uevent socket: %s\n", strerror(errno));
+#endif
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = UEVENT_KERNEL_GROUP;
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+#ifdef DEBUG
+    perr("Cannot bind uevent socket: %s\n", strerror(errno));
+#endif
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* message is "action@devpath\0KEY=value\0KEY=value\0..." */
+static void parse_uevent(char *msg, int len, struct uevent *ev)
+{
+  char *p = msg;
+
+  memset(ev, 0, sizeof(*ev));
+  while (p < msg + len) {
+    if (strncmp(p, "ACTION=", 7) == 0)
+      snprintf(ev->action, UEVENT_ACTION_LENGTH, "%s", p + 7);
+    else if (strncmp(p, "SUBSYSTEM=", 10) == 0)
+      snprintf(ev->subsystem, UEVENT_SUBSYSTEM_LENGTH, "%s", p + 10);
+    else if (strncmp(p, "DEVNAME=", 8) == 0)
+      snprintf(ev->devname, UEVENT_DEVNAME_LENGTH, "%s", p + 8);
+    else if (strncmp(p, "DEVPATH=", 8) == 0)
+      snprintf(ev->devpath, PATH_MAX, "%s", p + 8);
+    p += strlen(p) + 1;
+  }
+}
+
+int uevent_read(int fd, struct uevent *ev, int timeout_ms)
+{
+  char buf[UEVENT_BUFFER_SIZE];
+  struct pollfd pfd = {fd, POLLIN, 0};
+  int len;
+
+  for (;;) {
+    len = recv(fd, buf, sizeof(buf) - 1, 0);
+    if (len > 0) {
+      buf[len] = '\0';
+      /* skip libudev messages, which start with "libudev\0" */
+      if (strchr(buf, '@') == NULL)
+        continue;
+      parse_uevent(buf, len, ev);
+      return 1;
+    }
+    if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      return -1;
+
+    len = poll(&pfd, 1, timeout_ms);
+    if (len == 0)
+      return 0;
+    if (len < 0 && errno != EINTR)
+      return -1;
+  }
+}
+
+void uevent_close(int fd)
+{
+  if (fd >= 0)
+    close(fd);
+}
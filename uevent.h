@@ -0,0 +1,38 @@
+/**
+ * Copyright (c) 2013-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef UEVENT_H
+#define UEVENT_H
+
+#include <limits.h>
+
+#define UEVENT_ACTION_LENGTH    16
+#define UEVENT_SUBSYSTEM_LENGTH 32
+#define UEVENT_DEVNAME_LENGTH   64
+
+/* a kernel uevent, e.g. "add" of scsi_generic/sg3 */
+struct uevent {
+  char action[UEVENT_ACTION_LENGTH];
+  char subsystem[UEVENT_SUBSYSTEM_LENGTH];
+  char devname[UEVENT_DEVNAME_LENGTH];    /* relative to /dev */
+  char devpath[PATH_MAX];                 /* relative to /sys */
+};
+
+/* open a netlink socket for kernel uevents; return fd or -1 */
+extern int uevent_open(void);
+
+/*
+ * wait up to timeout_ms for the next uevent;
+ * return 1 if ev is filled, 0 on timeout, -1 on error
+ */
+extern int uevent_read(int fd, struct uevent *ev, int timeout_ms);
+
+extern void uevent_close(int fd);
+
+#endif